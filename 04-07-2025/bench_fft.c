@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h> // For QueryPerformanceCounter
+#else
+#include <time.h>    // For clock_gettime
+#endif
+
+#include "fft.h"
+
+// Microbenchmark for fft.h: checks each size against a direct DFT, then times the
+// cached-plan transform for 256..8192 points with each window, plus what a plan costs
+// to build (the work compute_fft() used to face on every call without a cache).
+//
+// Build: gcc -O2 bench_fft.c -o bench_fft.exe -lm -Wall -Wextra
+// Usage: bench_fft [iterations] [hop]
+//   hop: samples between spectra in the live client (FFT_HOP_SIZE), used for the
+//        per-sample cost column
+
+// Configuration
+#define MIN_POINTS 256
+#define MAX_POINTS 8192
+#define DEFAULT_ITERATIONS 200
+#define DEFAULT_HOP 32
+#define SAMPLING_RATE 50.0 // 20 ms interval, as in the teraterm recordings
+
+double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+// Load-cell-like test signal: DC-removed noise plus a 3.1 Hz vibration of amplitude 40
+void make_signal(double* x, int n) {
+    srand(1);
+    for (int i = 0; i < n; ++i) {
+        x[i] = 40.0 * sin(2.0 * M_PI * 3.1 * i / SAMPLING_RATE) + (rand() % 2001 - 1000) / 100.0;
+    }
+}
+
+// Largest difference between fft_real_forward() and a direct O(n^2) DFT, relative to the peak
+double check_against_dft(FftPlan* plan, const double* x) {
+    int n = plan->n;
+    double* re = (double*)malloc(sizeof(double) * (n / 2 + 1));
+    double* im = (double*)malloc(sizeof(double) * (n / 2 + 1));
+    if (!re || !im) { free(re); free(im); return INFINITY; }
+    fft_real_forward(plan, x, re, im);
+    double max_err = 0.0, peak = 1e-12;
+    for (int k = 0; k <= n / 2; ++k) {
+        double dr = 0.0, di = 0.0;
+        for (int t = 0; t < n; ++t) {
+            double v = x[t] * plan->window[t];
+            double phase = 2.0 * M_PI * (double)((long long)k * t % n) / n;
+            dr += v * cos(phase);
+            di -= v * sin(phase);
+        }
+        double err = hypot(re[k] - dr, im[k] - di);
+        if (err > max_err) max_err = err;
+        if (hypot(dr, di) > peak) peak = hypot(dr, di);
+    }
+    free(re);
+    free(im);
+    return max_err / peak;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    int hop = (argc > 2) ? atoi(argv[2]) : DEFAULT_HOP;
+    if (iterations < 1) iterations = 1;
+    if (hop < 1) hop = 1;
+
+    double* x = (double*)malloc(sizeof(double) * MAX_POINTS);
+    double* mags = (double*)malloc(sizeof(double) * MAX_POINTS / 2);
+    if (!x || !mags) { perror("malloc"); return 1; }
+    make_signal(x, MAX_POINTS);
+
+    const FftWindowType windows[] = { FFT_WINDOW_RECT, FFT_WINDOW_HANN, FFT_WINDOW_HAMMING };
+    printf("%d iterations, hop %d samples, fs %.0f Hz\n", iterations, hop, SAMPLING_RATE);
+    printf("%6s %-8s %10s %12s %12s %14s %10s %9s\n",
+           "points", "window", "plan us", "fft us", "Msamples/s", "us/sample@hop", "peak Hz", "rel err");
+
+    for (int n = MIN_POINTS; n <= MAX_POINTS; n *= 2) {
+        for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); ++w) {
+            double t0 = now_seconds();
+            FftPlan* fresh = fft_plan_create(n, windows[w]);
+            double plan_s = now_seconds() - t0;
+            fft_plan_destroy(fresh);
+
+            FftPlan* plan = fft_plan_get(n, windows[w]);
+            if (!plan) { fprintf(stderr, "No plan for %d points\n", n); return 1; }
+            double rel_err = check_against_dft(plan, x);
+
+            int bins = 0;
+            double best = 1e30;
+            for (int it = 0; it < iterations; ++it) {
+                double t1 = now_seconds();
+                bins = fft_real_magnitude(fft_plan_get(n, windows[w]), x, mags);
+                double t2 = now_seconds();
+                if (t2 - t1 < best) best = t2 - t1;
+            }
+            double peak_hz = fft_peak_bin(mags, bins) * SAMPLING_RATE / n;
+
+            printf("%6d %-8s %10.1f %12.2f %12.1f %14.3f %10.3f %9.1e\n", n, fft_window_name(windows[w]),
+                   plan_s * 1e6, best * 1e6, n / best / 1e6, best * 1e6 / hop, peak_hz, rel_err);
+            if (rel_err > 1e-9) {
+                fprintf(stderr, "FFT disagrees with the direct DFT at %d points\n", n);
+                return 1;
+            }
+        }
+    }
+
+    fft_plan_cache_free();
+    free(x);
+    free(mags);
+    return 0;
+}
@@ -0,0 +1,213 @@
+// Circular Buffer implementation (similar to Python's collections.deque), v2.
+//
+// One writer thread and any number of readers, without a lock: the writer
+// fills slots and then publishes them by bumping `written`. Capacity is a power of two
+// (indexing is a mask) with at least CIRCULAR_BUFFER_SLACK slots beyond the max_size
+// values readers see, so the writer can run ahead while a reader looks at the data.
+//
+// Readers don't copy: circular_buffer_view() returns the newest values as up to two
+// contiguous spans. With CIRCULAR_BUFFER_MIRRORED the storage is mapped twice back to
+// back, so the view is always a single span (the capacity is then rounded up to the
+// system's mapping granularity, e.g. 8192 doubles for 64 KiB on Windows).
+#ifndef CIRCULAR_BUFFER_H
+#define CIRCULAR_BUFFER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>     // For CreateFileMapping, MapViewOfFileEx
+#else
+#include <sys/mman.h>    // For mmap, shm_open
+#include <fcntl.h>       // For O_CREAT
+#include <unistd.h>      // For ftruncate, getpid
+#endif
+
+#ifndef CIRCULAR_BUFFER_MIRRORED
+#define CIRCULAR_BUFFER_MIRRORED 0  // 1 = double-mapped storage, every view is one span
+#endif
+#define CIRCULAR_BUFFER_SLACK 64    // Minimum writer headroom beyond max_size, in values
+
+typedef struct {
+    double* data;
+    uint32_t capacity;    // Power of two >= max_size + CIRCULAR_BUFFER_SLACK
+    uint32_t mask;        // capacity - 1
+    int max_size;         // Values readers see (the newest max_size)
+    int mirrored;         // data[capacity .. 2 * capacity) aliases data[0 .. capacity)
+    atomic_uint written;  // Values appended since init
+    atomic_uint start;    // Value of `written` at the last reset (older values aren't shown)
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+} CircularBuffer;
+
+// Newest values of a buffer, oldest first: span1[0 .. len1) then span2[0 .. len2)
+typedef struct {
+    const double* span1;
+    int len1;
+    const double* span2;
+    int len2;             // 0 when the values are contiguous
+    int count;            // len1 + len2
+    unsigned int end;     // `written` when the view was taken
+} CircularBufferView;
+
+// Maps bytes of shared memory twice in a row. Returns the base, or NULL if unsupported here.
+static inline double* circular_buffer_map_mirrored(CircularBuffer* cb, size_t bytes) {
+#ifdef _WIN32
+    cb->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)bytes, NULL);
+    if (!cb->mapping) return NULL;
+    // Find a free 2 * bytes range, release it and map both views into it. Another thread
+    // can grab the range in between, so retry a few times.
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        char* base = (char*)VirtualAlloc(NULL, bytes * 2, MEM_RESERVE, PAGE_NOACCESS);
+        if (!base) break;
+        VirtualFree(base, 0, MEM_RELEASE);
+        char* first = (char*)MapViewOfFileEx(cb->mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes, base);
+        char* second = first ? (char*)MapViewOfFileEx(cb->mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes, base + bytes) : NULL;
+        if (first && second) return (double*)first;
+        if (first) UnmapViewOfFile(first);
+    }
+    CloseHandle(cb->mapping);
+    cb->mapping = NULL;
+    return NULL;
+#else
+    char name[64];
+    snprintf(name, sizeof(name), "/circular_buffer_%d_%p", (int)getpid(), (void*)cb);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return NULL;
+    shm_unlink(name);
+    char* base = NULL;
+    if (ftruncate(fd, (off_t)bytes) == 0) {
+        base = (char*)mmap(NULL, bytes * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) base = NULL;
+    }
+    if (base && (mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+                 mmap(base + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+        munmap(base, bytes * 2);
+        base = NULL;
+    }
+    close(fd);
+    return (double*)base;
+#endif
+}
+
+static inline size_t circular_buffer_map_granularity(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static inline void init_circular_buffer(CircularBuffer* cb, int max_size) {
+    memset(cb, 0, sizeof(*cb));
+    uint32_t capacity = 2;
+    while (capacity < (uint32_t)max_size + CIRCULAR_BUFFER_SLACK) capacity *= 2;
+#if CIRCULAR_BUFFER_MIRRORED
+    while (capacity * sizeof(double) % circular_buffer_map_granularity() != 0) capacity *= 2;
+    cb->data = circular_buffer_map_mirrored(cb, capacity * sizeof(double));
+    cb->mirrored = (cb->data != NULL);
+    if (!cb->mirrored) fprintf(stderr, "Warning: mirrored circular buffer unavailable, using two-span views.\n");
+#endif
+    if (!cb->data) cb->data = (double*)malloc(sizeof(double) * capacity);
+    if (!cb->data) { perror("Failed to allocate circular buffer data"); exit(EXIT_FAILURE); }
+    cb->capacity = capacity;
+    cb->mask = capacity - 1;
+    cb->max_size = max_size;
+    atomic_init(&cb->written, 0);
+    atomic_init(&cb->start, 0);
+}
+
+static inline void free_circular_buffer(CircularBuffer* cb) {
+    if (!cb->data) return;
+    if (cb->mirrored) {
+#ifdef _WIN32
+        UnmapViewOfFile((char*)cb->data + cb->capacity * sizeof(double));
+        UnmapViewOfFile(cb->data);
+        CloseHandle(cb->mapping);
+#else
+        munmap(cb->data, cb->capacity * sizeof(double) * 2);
+#endif
+    } else {
+        free(cb->data);
+    }
+    cb->data = NULL;
+}
+
+// Writer only: empties the buffer as far as readers are concerned
+static inline void reset_circular_buffer(CircularBuffer* cb) {
+    atomic_store_explicit(&cb->start, atomic_load_explicit(&cb->written, memory_order_relaxed), memory_order_release);
+}
+
+// Writer only: appends n values with at most two copies and one publish
+static inline void append_circular_buffer_n(CircularBuffer* cb, const double* values, int n) {
+    if (n <= 0) return;
+    unsigned int written = atomic_load_explicit(&cb->written, memory_order_relaxed);
+    if ((uint32_t)n > cb->capacity) { // Only the last capacity values can survive anyway
+        written += (unsigned int)n - cb->capacity;
+        values += n - (int)cb->capacity;
+        n = (int)cb->capacity;
+    }
+    uint32_t pos = written & cb->mask;
+    uint32_t first = cb->mirrored ? (uint32_t)n : cb->capacity - pos;
+    if (first > (uint32_t)n) first = (uint32_t)n;
+    memcpy(cb->data + pos, values, first * sizeof(double));
+    memcpy(cb->data, values + first, (n - first) * sizeof(double));
+    atomic_store_explicit(&cb->written, written + (unsigned int)n, memory_order_release);
+}
+
+// Writer only
+static inline void append_circular_buffer(CircularBuffer* cb, double value) {
+    unsigned int written = atomic_load_explicit(&cb->written, memory_order_relaxed);
+    cb->data[written & cb->mask] = value;
+    atomic_store_explicit(&cb->written, written + 1, memory_order_release);
+}
+
+// Reader: the newest (up to max_size) values since the last reset, without copying.
+// Returns the number of values.
+static inline int circular_buffer_view(CircularBuffer* cb, CircularBufferView* view) {
+    unsigned int written = atomic_load_explicit(&cb->written, memory_order_acquire);
+    unsigned int available = written - atomic_load_explicit(&cb->start, memory_order_acquire);
+    unsigned int count = (available < (unsigned int)cb->max_size) ? available : (unsigned int)cb->max_size;
+    uint32_t pos = (written - count) & cb->mask;
+    uint32_t first = cb->mirrored ? count : cb->capacity - pos;
+    if (first > count) first = count;
+    view->span1 = cb->data + pos;
+    view->len1 = (int)first;
+    view->span2 = cb->data;
+    view->len2 = (int)(count - first);
+    view->count = (int)count;
+    view->end = written;
+    return view->count;
+}
+
+// Reader: copies the n (<= capacity) values starting at index `from` (counted like `written`,
+// all already published) into out. Returns 1 if they were intact, 0 if the writer has
+// overwritten some of them meanwhile (out is then unusable).
+static inline int circular_buffer_read(CircularBuffer* cb, unsigned int from, int n, double* out) {
+    if (n <= 0) return 1;
+    uint32_t pos = from & cb->mask;
+    uint32_t first = cb->mirrored ? (uint32_t)n : cb->capacity - pos;
+    if (first > (uint32_t)n) first = (uint32_t)n;
+    memcpy(out, cb->data + pos, first * sizeof(double));
+    memcpy(out + first, cb->data, (n - first) * sizeof(double));
+    return atomic_load_explicit(&cb->written, memory_order_acquire) - from < cb->capacity;
+}
+
+static inline double circular_buffer_view_at(const CircularBufferView* view, int i) {
+    return (i < view->len1) ? view->span1[i] : view->span2[i - view->len1];
+}
+
+// Reader: 1 if the writer hasn't reached any slot of the view since it was taken (every
+// value read from it was intact), 0 if the data should be treated as a glitch
+static inline int circular_buffer_view_intact(CircularBuffer* cb, const CircularBufferView* view) {
+    unsigned int written = atomic_load_explicit(&cb->written, memory_order_acquire);
+    return written - view->end < cb->capacity - (unsigned int)view->count;
+}
+
+#endif // CIRCULAR_BUFFER_H
@@ -3,6 +3,7 @@
 #include <string.h>      // For strcmp, strcpy, strlen, strtok, strstr
 #include <stdint.h>      // For uint32_t, uint64_t
 #include <math.h>        // For sqrt, fabs, NAN, isnan
+#include <stdatomic.h>   // For the lock-free sample ring
 #include <direct.h>      // For _mkdir on Windows
 
 // === Windows Specific Includes ===
@@ -17,6 +18,14 @@
 #include <gtk/gtk.h>     // For GTK widgets and functions
 #include <cairo.h>       // For drawing in GtkDrawingArea
 
+#include "fft.h"         // Real FFT with cached plans and Hann/Hamming windows
+#include "spsc_ring.h"   // Lock-free sample ring between the network and DSP threads
+#include "circular_buffer.h" // Lock-free plot buffers with zero-copy views
+#include "weight_archive.h" // Binary column output for each processed file
+#include "dsp_arena.h"   // Per-file buffers, reset between files
+#include "plot_trace.h"  // Cached plot frames and incrementally drawn traces
+#include "metrics.h"     // Stage latency histograms, periodic stats dump, LOG_VERBOSE
+
 // === Configuration ===
 #define SERVER_IP "127.0.0.1"
 #define SERVER_PORT 9999
@@ -34,72 +43,123 @@
 // Buffer sizes for live plot and DSP operations (equivalent to Python's deque maxlen)
 #define PLOT_BUFFER_SIZE 500
 #define DSP_BUFFER_SIZE 500 // Should be >= max(FIR_NUM_TAPS, FFT_WINDOW_SIZE)
+#define DSP_RING_SIZE 512   // Power of two >= DSP_BUFFER_SIZE, so the DSP window is indexed with a mask
 #define FFT_WINDOW_SIZE 256
+#define FFT_HOP_SIZE 32    // Recompute the spectrum (and re-design the FIR) every N samples
+#define FFT_WINDOW_TYPE FFT_WINDOW_HANN // FFT_WINDOW_RECT, FFT_WINDOW_HANN or FFT_WINDOW_HAMMING
 #define FIR_NUM_TAPS 51
+#define GUI_REFRESH_MS 40  // How often the status label and the end-of-data check update
+#define PLOT_MAX_FPS 30    // Plot redraws per second at most, on the frame clock (0 = every frame, i.e. vsync)
+#define WRITE_BINARY_ARCHIVE 1 // Each file's results as output_data\all_data_<file>.bin (see weight_archive.h)
+#define WRITE_TEXT_EXPORT 0    // 1 = also write the old all_data_<file>.txt text dump
+#define METRICS_FIR_SAMPLE_EVERY 16 // Time one FIR output in N: a timer read costs about as much as the filter
+#define VIEW_ZOOM_STEPS 4  // Spans the raw and filtered plots offer: PLOT_BUFFER_SIZE samples, then 10x, 100x, 1000x that
+
+// Network -> DSP hand-off
+#define SAMPLE_RING_CAPACITY 65536 // Samples (not files) buffered ahead of the DSP thread; ~22 min at 50 Hz
+#define RING_OVERFLOW_MODE RING_OVERFLOW_BLOCK // RING_OVERFLOW_BLOCK, RING_OVERFLOW_DROP_OLDEST or RING_OVERFLOW_DECIMATE
+#define FILE_INFO_SLOTS 16  // Files the network thread may run ahead of the DSP thread
+
+// Live view: files are processed (and saved) at full speed; the plots play the results back
+#define LIVE_VIEW_DEFAULT_MODE LIVE_VIEW_REAL_TIME // LIVE_VIEW_REAL_TIME or LIVE_VIEW_CATCH_UP (also a check box)
+#define LIVE_VIEW_SPEED 1.0         // Real-time playback speed factor
+#define LIVE_VIEW_SPECTRUM_BINS (FFT_WINDOW_SIZE / 2)
+#define LIVE_VIEW_SPECTRUM_SLOTS (LIVE_VIEW_HISTORY / FFT_HOP_SIZE)
+#include "live_view.h"   // After the configuration: sized from FFT_WINDOW_SIZE and FFT_HOP_SIZE
+#include "summary_pyramid.h" // Min/max/mean buckets: saved with each file, drawn when zoomed out
 
 // === Global Data Structures and Synchronization ===
 
-// Circular Buffer implementation (similar to Python's collections.deque)
-typedef struct {
-    double* data;
-    int head; // Index of the oldest element
-    int tail; // Index where the next element will be inserted
-    int count; // Current number of elements in the buffer
-    int max_size; // Maximum capacity of the buffer
-} CircularBuffer;
-
 CircularBuffer current_raw_buffer;       // Buffer for raw data points (normalized to weights) for live plot
 CircularBuffer current_filtered_buffer;  // Buffer for filtered data points for live plot (DC-removed for plotting)
-CircularBuffer dsp_raw_adc_buffer;       // Buffer to hold raw ADC values for DSP operations (FFT/FIR input)
+// Both are filled by the GUI thread from live_history, at the pace of live_view
+
+LiveViewHistory live_history;            // DSP thread -> GUI thread: every processed sample and spectrum
+LiveViewCursor live_view;                // GUI thread only: playback position, file and spectrum shown
+unsigned int view_span = PLOT_BUFFER_SIZE; // GUI thread only: samples the raw and filtered plots cover
 
 // Windows synchronization primitives
-CRITICAL_SECTION plot_lock;        // Protects current_raw_buffer, current_filtered_buffer, dsp_raw_adc_buffer during access
-CRITICAL_SECTION queue_lock;       // Protects the data_queue
-CONDITION_VARIABLE queue_cond;     // Used to signal the main thread when data is available in data_queue
+CRITICAL_SECTION plot_lock;        // Protects the g_file_state fields the GUI reads (file name, last_fft_*)
 
 // Flags to control thread execution
 volatile int plotting_active = 0;      // Controls if the plotting and processing loop should continue
 volatile int network_thread_running = 0; // Indicates if the network thread is active
+volatile int dsp_thread_running = 0;     // Indicates if the DSP thread is active
 
-// Data structure to hold a full file's data received from the network
+// Description of one received file. Samples travel through sample_ring tagged with the
+// file's sequence number; the description waits in file_infos[seq % FILE_INFO_SLOTS].
 typedef struct {
-    double* raw_adc_values;  // Dynamically allocated array of raw ADC values for one file
     int num_samples;         // Number of samples in this file
     int interval_ms;         // Sampling interval for this file (determines sampling rate)
     char file_name[256];     // Name of the file (for display/saving)
-} QueuedData;
+} FileInfo;
 
-// Simple array-based circular queue for passing file data from network thread to main thread
-QueuedData* data_queue[10]; // Max 10 files in queue
-int queue_head = 0;
-int queue_tail = 0;
-int queue_count = 0;
+SampleRing sample_ring;                 // Network thread -> DSP thread, no locks
+FileInfo file_infos[FILE_INFO_SLOTS];   // Written by the network thread before the file's first sample
+uint32_t producer_file_seq = 0;         // Network thread only: sequence number of the last file published
+atomic_uint consumer_file_seq;          // DSP thread: sequence number of the file it has started
+atomic_int current_file_progress;       // DSP thread: samples of the current file processed (for the status label)
 
-// Global state for managing the processing of a single file in the GUI's main loop
+// State of the file the DSP thread is working on. The DSP thread owns it; the GUI only
+// reads current_file_name, current_file_num_samples and is_processing_file (for the status)
+// while holding plot_lock.
 typedef struct {
-    double* current_file_raw_adc_values; // The full raw ADC data for the file currently being processed
     int current_file_num_samples;       // Total samples in the current file
     int current_file_interval_ms;       // Sampling interval for the current file
     char current_file_name[256];        // Name of the current file
-    int current_file_index;             // Index of the next sample to process in current_file_raw_adc_values
+    int current_file_index;             // Index of the next sample to process in the current file
     int is_processing_file;             // Flag: 1 if a file is currently being processed, 0 otherwise
     
-    // Data collected for saving to file (these are dynamically growing arrays)
+    // Data collected for saving to file (from file_arena; sized for the file up front, grown by doubling)
     double* all_raw_weights_to_save;
     int all_raw_weights_len_to_save;
     double* all_filtered_weights_to_save; // This will store DC-retained filtered data if needed, or DC-removed
     int all_filtered_weights_len_to_save;
+    int save_capacity;                    // Allocated length of both save arrays (grown by doubling)
     
-    // Last computed DSP results (these are updated for the plot and saved at end of file)
+    // Last computed DSP results (updated for the plot and saved at end of file; also from file_arena)
     double* last_fir_coefficients_to_save;
     int last_fir_coefficients_len_to_save;
     double* last_fft_frequencies_to_save;
     int last_fft_frequencies_len_to_save;
     double* last_fft_magnitude_to_save;
     int last_fft_magnitude_len_to_save;
+
+    // 1:10, 1:100 and 1:1000 summaries of the saved weights, built sample by sample (buckets from file_arena)
+    SummaryPyramid raw_summary;
+    SummaryPyramid filtered_summary;
+    SummaryLevels raw_summary_to_save;
+    SummaryLevels filtered_summary_to_save;
 } FileProcessingState;
 
 FileProcessingState g_file_state = {0}; // Initialize global state to zeros/NULLs
+DspArena file_arena; // DSP thread only: g_file_state's arrays, reset when the file has been saved
+
+// Sliding-window DSP engine, fed one sample at a time by the DSP thread.
+// Nothing on the per-sample path allocates or rescans the window:
+// - DC offset: running sum over the last DSP_BUFFER_SIZE raw ADC values
+// - FIR: direct form over the same ring, one output per input
+// - FFT: every FFT_HOP_SIZE samples over the last FFT_WINDOW_SIZE values; its dominant
+//   frequency becomes the FIR low-pass cut-off, as in the Python client
+// Each sample is stored twice, DSP_RING_SIZE apart, so the newest N <= DSP_RING_SIZE
+// values are always one contiguous run and neither the FIR nor the FFT copy wraps.
+typedef struct {
+    double sampling_rate;
+    double window[2 * DSP_RING_SIZE];       // Last raw ADC values (ring, mirrored in the upper half)
+    unsigned int samples;                   // Samples pushed since the last reset
+    int window_count;                       // min(samples, DSP_BUFFER_SIZE)
+    double window_sum;                      // Exact: ADC values are integers far below 2^53 / DSP_BUFFER_SIZE
+    double fir_coefficients[FIR_NUM_TAPS];
+    double fir_gain;                        // Sum of the coefficients (DC gain)
+    double fir_cutoff_hz;                   // Cut-off of the current design (0 = pass-through)
+    int samples_since_fft;
+    double fft_input[FFT_WINDOW_SIZE];      // Scratch for the DC-removed FFT window
+    double fft_frequencies[FFT_WINDOW_SIZE / 2]; // Latest spectrum (fft_len bins)
+    double fft_magnitude[FFT_WINDOW_SIZE / 2];
+    int fft_len;
+} DspEngine;
+
+DspEngine g_dsp; // Used only by the DSP thread
 
 // GTK Widget pointers for access in callbacks
 GtkWidget *main_window = NULL;
@@ -108,8 +168,21 @@ GtkWidget *filtered_plot_area = NULL;  // Dedicated drawing area for filtered da
 GtkWidget *fft_plot_area = NULL;       // Dedicated drawing area for FFT data
 GtkWidget *label_status = NULL;        // For displaying messages
 
+// GUI-thread state of one plot: cached frame, incrementally drawn trace, the y range in use
+// and what the plot showed when its last redraw was queued
+typedef struct {
+    PlotFrameCache frame;
+    PlotTrace trace;            // Unused by the FFT plot, which is redrawn whole once per spectrum
+    double y_min, y_max;
+    unsigned int seen_written;
+    unsigned int seen_start;
+    unsigned int seen_version;
+} LivePlot;
+
+LivePlot raw_plot, filtered_plot, fft_plot;
+
 // Global variable to hold the ID of the GSource (timeout) for data processing
-guint data_processing_source_id = 0; 
+guint data_processing_source_id = 0; // GUI refresh timer
 
 // Custom 64-bit host-to-network byte swap (needed for FILE_CONTENT_LENGTH_BYTES)
 uint64_t ntohll_custom(uint64_t val) {
@@ -119,20 +192,21 @@ uint64_t ntohll_custom(uint64_t val) {
 // === Function Prototypes ===
 
 // Circular Buffer functions
-void init_circular_buffer(CircularBuffer* cb, int max_size);
-void free_circular_buffer(CircularBuffer* cb);
-void append_circular_buffer(CircularBuffer* cb, double value);
-double* get_circular_buffer_snapshot(CircularBuffer* cb, int* actual_len);
-
-// Data Processing functions
+double normalize_to_weight(double adc_value);
 double* normalize_to_weights(const int* values, int num_values);
-double* remove_dc_offset_temp(const double* values, int num_values, int* out_len); // Used for DSP input
-void compute_fft(const double* values, int num_values, double sampling_rate,
-                 double** frequencies_out, double** magnitude_out, double* dominant_frequency_out, int* fft_len_out);
-void fir_filter(const double* values, int num_values, double cut_off_frequency, double sampling_rate,
-                double** filtered_values_out, double** fir_coefficients_out, int* filtered_len_out, int* coeff_len_out);
+void compute_fft(const double* values, int num_values, double sampling_rate, int max_bins,
+                 double* frequencies_out, double* magnitude_out, double* dominant_frequency_out, int* fft_len_out);
+int design_lowpass_fir(double cut_off_frequency, double sampling_rate, double* coefficients_out);
+void dsp_engine_reset(DspEngine* engine, double sampling_rate);
+int dsp_engine_push(DspEngine* engine, double raw_adc, double* filtered_out);
 
 // File I/O
+void write_weight_archive(const char* file_name, double sampling_rate, const double* raw_weights_all, int raw_len,
+                          const double* filtered_weights_all, int filtered_len,
+                          const double* fir_coefficients, int fir_coeff_len,
+                          const double* fft_frequencies_last, int fft_freq_len,
+                          const double* fft_magnitude_last, int fft_mag_len,
+                          const SummaryLevels* raw_summary, const SummaryLevels* filtered_summary);
 void write_data_to_file(const char* file_name, const double* raw_weights_all, int raw_len,
                         const double* filtered_weights_all, int filtered_len,
                         const double* fir_coefficients, int fir_coeff_len,
@@ -147,8 +221,18 @@ DWORD WINAPI network_thread_func(LPVOID lpParam); // Network thread entry point
 gboolean draw_raw_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data);
 gboolean draw_filtered_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data);
 gboolean draw_fft_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data);
-void update_all_plots_gui(); // Function to trigger redraws for all plots
-gboolean process_data_gui_callback(gpointer user_data); // GTK idle callback for data processing
+gboolean draw_series_plot(GtkWidget *widget, cairo_t *cr, LivePlot* plot, CircularBuffer* buffer, SummaryHistory* summary,
+                          const char* title_prefix, int symmetric, int num_ytick_labels, const char* y_format);
+int queue_plot_if_changed(GtkWidget* area, LivePlot* plot, unsigned int written, unsigned int start, unsigned int version);
+gboolean plot_tick_callback(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data); // Frame clock: coalesced plot redraws
+gboolean gui_refresh_callback(gpointer user_data); // GTK timeout: status label and end-of-data check
+DWORD WINAPI dsp_thread_func(LPVOID lpParam); // DSP thread entry point
+void begin_file(uint32_t file_seq);
+void process_file_sample(double current_raw_adc, int step);
+void finish_file(void);
+int publish_file(const char* file_name, const double* raw_adc_values, int num_samples, int interval_ms);
+int grow_save_buffers(FileProcessingState* state);
+void save_summary_buckets(SummaryLevels* levels, const SummaryPyramid* pyramid, int mask);
 void on_window_destroy(GtkWidget *widget, gpointer data);
 
 // Helper for drawing common plot elements (axes, grids, labels)
@@ -159,130 +243,171 @@ void draw_plot_frame(cairo_t *cr, guint width, guint height,
                      int num_xtick_labels, int num_ytick_labels, const char* y_format);
 
 
-// === Circular Buffer Implementations (unchanged) ===
-void init_circular_buffer(CircularBuffer* cb, int max_size) {
-    cb->data = (double*)malloc(sizeof(double) * max_size);
-    if (!cb->data) { perror("Failed to allocate circular buffer data"); exit(EXIT_FAILURE); }
-    cb->head = 0; cb->tail = 0; cb->count = 0; cb->max_size = max_size;
-}
-
-void free_circular_buffer(CircularBuffer* cb) {
-    if (cb->data) { free(cb->data); cb->data = NULL; }
-}
-
-void append_circular_buffer(CircularBuffer* cb, double value) {
-    if (cb->data == NULL) { fprintf(stderr, "Error: Circular buffer not initialized.\n"); return; }
-    cb->data[cb->tail] = value;
-    cb->tail = (cb->tail + 1) % cb->max_size;
-    if (cb->count < cb->max_size) { cb->count++; } else { cb->head = (cb->head + 1) % cb->max_size; }
-}
-
-// Returns a dynamically allocated array containing the current elements. Caller must free.
-double* get_circular_buffer_snapshot(CircularBuffer* cb, int* actual_len) {
-    EnterCriticalSection(&plot_lock); // Lock to ensure consistent read
-    *actual_len = cb->count;
-    if (cb->count == 0) { LeaveCriticalSection(&plot_lock); return NULL; }
-
-    double* snapshot = (double*)malloc(sizeof(double) * cb->count);
-    if (!snapshot) { perror("Failed to allocate snapshot buffer"); LeaveCriticalSection(&plot_lock); return NULL; }
-
-    if (cb->head < cb->tail) {
-        memcpy(snapshot, cb->data + cb->head, cb->count * sizeof(double));
-    } else { // Data wraps around
-        int part1_len = cb->max_size - cb->head;
-        memcpy(snapshot, cb->data + cb->head, part1_len * sizeof(double)); 
-        memcpy(snapshot + part1_len, cb->data, cb->tail * sizeof(double));
-    }
-    LeaveCriticalSection(&plot_lock);
-    return snapshot;
+// === Data Normalization ===
+double normalize_to_weight(double adc_value) {
+    double data_in = adc_value / ADC_MAX_VAL;
+    return (SCALE_CAL != 0) ? (data_in - ZERO_CAL) / SCALE_CAL : NAN;
 }
 
-// === Data Normalization (unchanged) ===
 double* normalize_to_weights(const int* values, int num_values) {
     if (num_values <= 0 || !values) return NULL;
     double* weights = (double*)malloc(sizeof(double) * num_values);
     if (!weights) { perror("Failed to allocate weights buffer"); return NULL; }
 
     for (int i = 0; i < num_values; ++i) {
-        double data_in = (double)values[i] / ADC_MAX_VAL;
-        weights[i] = (SCALE_CAL != 0) ? (data_in - ZERO_CAL) / SCALE_CAL : NAN;
+        weights[i] = normalize_to_weight((double)values[i]);
     }
     return weights;
 }
 
-// === DSP Functions (Placeholders - unchanged) ===
-double* remove_dc_offset_temp(const double* values, int num_values, int* out_len) {
-    *out_len = num_values;
-    if (num_values == 0 || !values) return NULL;
-
-    double* result = (double*)malloc(sizeof(double) * num_values);
-    if (!result) { perror("Failed to allocate result buffer for DC offset removal"); return NULL; }
+// === DSP Functions ===
+// Amplitude spectrum of the last power-of-two run of values (FFT_WINDOW_SIZE in practice),
+// windowed with FFT_WINDOW_TYPE, into the caller's arrays of max_bins. The plan for that
+// size is built on the first call and reused.
+void compute_fft(const double* values, int num_values, double sampling_rate, int max_bins,
+                 double* frequencies_out, double* magnitude_out, double* dominant_frequency_out, int* fft_len_out) {
+    *dominant_frequency_out = 0.0; *fft_len_out = 0;
+    int n = fft_floor_power_of_two(num_values < 2 * max_bins ? num_values : 2 * max_bins);
+    FftPlan* plan = (values && n >= FFT_MIN_SIZE) ? fft_plan_get(n, FFT_WINDOW_TYPE) : NULL;
+    if (!plan) return;
+
+    int bins = n / 2;
+    fft_real_magnitude(plan, values + (num_values - n), magnitude_out);
+    for (int i = 0; i < bins; ++i) {
+        frequencies_out[i] = (double)i * sampling_rate / n;
+    }
+    *dominant_frequency_out = frequencies_out[fft_peak_bin(magnitude_out, bins)];
+    *fft_len_out = bins;
+}
 
-    double sum = 0.0; int nan_count = 0;
-    for (int i = 0; i < num_values; ++i) {
-        if (!isnan(values[i])) { sum += values[i]; } else { nan_count++; }
+// Windowed-sinc low-pass, Hamming window, unity DC gain: the same taps as
+// scipy.signal.firwin(FIR_NUM_TAPS, cut_off / nyquist, window="hamming").
+// Returns 0, or -1 (coefficients untouched) if the cut-off is outside (0, nyquist).
+int design_lowpass_fir(double cut_off_frequency, double sampling_rate, double* coefficients_out) {
+    double nyquist = sampling_rate / 2.0;
+    if (nyquist <= 0 || cut_off_frequency <= 0 || cut_off_frequency >= nyquist) return -1;
+
+    double fc = cut_off_frequency / sampling_rate; // Cycles per sample
+    double sum = 0.0;
+    for (int i = 0; i < FIR_NUM_TAPS; ++i) {
+        double m = i - (FIR_NUM_TAPS - 1) / 2.0;
+        double sinc = (m == 0.0) ? 2.0 * fc : sin(2.0 * G_PI * fc * m) / (G_PI * m);
+        double hamming = (FIR_NUM_TAPS > 1) ? 0.54 - 0.46 * cos(2.0 * G_PI * i / (FIR_NUM_TAPS - 1)) : 1.0;
+        coefficients_out[i] = sinc * hamming;
+        sum += coefficients_out[i];
     }
+    for (int i = 0; i < FIR_NUM_TAPS; ++i) coefficients_out[i] /= sum;
+    return 0;
+}
 
-    if (num_values - nan_count == 0) { for (int i = 0; i < num_values; ++i) result[i] = NAN; return result; }
-    
-    double mean = sum / (num_values - nan_count);
-    for (int i = 0; i < num_values; ++i) { result[i] = values[i] - mean; }
-    return result;
+// Clears the window and restores pass-through coefficients, e.g. at the start of a file
+void dsp_engine_reset(DspEngine* engine, double sampling_rate) {
+    memset(engine, 0, sizeof(*engine));
+    engine->sampling_rate = sampling_rate;
+    engine->fir_coefficients[0] = 1.0; // Pass-through until the first spectrum picks a cut-off
+    engine->fir_gain = 1.0;
 }
 
-void compute_fft(const double* values, int num_values, double sampling_rate,
-                 double** frequencies_out, double** magnitude_out, double* dominant_frequency_out, int* fft_len_out) {
-    *fft_len_out = num_values / 2;
-    if (num_values < 2) {
-        *frequencies_out = NULL; *magnitude_out = NULL; *dominant_frequency_out = 0.0; *fft_len_out = 0; return;
+// Feeds one raw ADC sample. *filtered_out gets the DC-removed FIR output (NAN until
+// FIR_NUM_TAPS samples have arrived). Returns 1 when a new spectrum was computed into
+// engine->fft_frequencies / fft_magnitude (valid until the next one).
+int dsp_engine_push(DspEngine* engine, double raw_adc, double* filtered_out) {
+    const unsigned int mask = DSP_RING_SIZE - 1;
+    // Running-sum DC offset
+    if (engine->window_count == DSP_BUFFER_SIZE) {
+        engine->window_sum -= engine->window[(engine->samples - DSP_BUFFER_SIZE) & mask];
+    } else {
+        engine->window_count++;
     }
-    *frequencies_out = (double*)calloc(*fft_len_out, sizeof(double));
-    *magnitude_out = (double*)calloc(*fft_len_out, sizeof(double));
-    if (!*frequencies_out || !*magnitude_out) {
-        perror("Failed to allocate FFT buffers");
-        free(*frequencies_out); free(*magnitude_out);
-        *frequencies_out = NULL; *magnitude_out = NULL; *dominant_frequency_out = 0.0; *fft_len_out = 0; return;
+    unsigned int slot = engine->samples & mask;
+    engine->window[slot] = raw_adc;
+    engine->window[slot + DSP_RING_SIZE] = raw_adc;
+    engine->window_sum += raw_adc;
+    engine->samples++;
+    double mean = engine->window_sum / engine->window_count;
+
+    // Streaming FIR over the newest FIR_NUM_TAPS samples. Filtering x - mean equals
+    // filtering x and subtracting mean * gain, so the window never has to be re-centred.
+    *filtered_out = NAN;
+    if (engine->window_count >= FIR_NUM_TAPS) {
+        uint64_t begin = (engine->samples % METRICS_FIR_SAMPLE_EVERY == 0) ? metrics_begin() : 0;
+        const double* newest = engine->window + ((engine->samples - FIR_NUM_TAPS) & mask) + FIR_NUM_TAPS - 1;
+        double acc = 0.0;
+        for (int k = 0; k < FIR_NUM_TAPS; ++k) {
+            acc += engine->fir_coefficients[k] * newest[-k];
+        }
+        *filtered_out = acc - mean * engine->fir_gain;
+        if (begin) metrics_end(METRIC_FIR, begin, 1);
     }
 
-    // --- PLACEHOLDER FFT IMPLEMENTATION ---
-    // This provides a flat line output. Replace with real FFT algorithm (e.g., FFTW)
-    // to see meaningful frequency spectrum.
-    for(int i = 0; i < *fft_len_out; ++i) {
-        (*frequencies_out)[i] = (double)i * sampling_rate / num_values;
-        (*magnitude_out)[i] = 1.0; // Flat magnitude
+    // Spectrum of the last FFT_WINDOW_SIZE samples, once per hop
+    if (engine->window_count < FFT_WINDOW_SIZE || ++engine->samples_since_fft < FFT_HOP_SIZE) {
+        return 0;
     }
-    *dominant_frequency_out = (*fft_len_out > 1) ? (*frequencies_out)[1] : 0.0;
-    // --- END PLACEHOLDER ---
+    engine->samples_since_fft = 0;
+    uint64_t begin = metrics_begin();
+    const double* oldest = engine->window + ((engine->samples - FFT_WINDOW_SIZE) & mask);
+    for (int i = 0; i < FFT_WINDOW_SIZE; ++i) {
+        engine->fft_input[i] = oldest[i] - mean;
+    }
+    double dominant_frequency = 0.0;
+    compute_fft(engine->fft_input, FFT_WINDOW_SIZE, engine->sampling_rate, FFT_WINDOW_SIZE / 2,
+                engine->fft_frequencies, engine->fft_magnitude, &dominant_frequency, &engine->fft_len);
+    if (dominant_frequency != engine->fir_cutoff_hz &&
+        design_lowpass_fir(dominant_frequency, engine->sampling_rate, engine->fir_coefficients) == 0) {
+        engine->fir_cutoff_hz = dominant_frequency;
+        engine->fir_gain = 0.0;
+        for (int k = 0; k < FIR_NUM_TAPS; ++k) engine->fir_gain += engine->fir_coefficients[k];
+    }
+    metrics_end(METRIC_FFT, begin, 0); // Spectrum plus the FIR re-design it drives
+    return (engine->fft_len > 0);
 }
 
-void fir_filter(const double* values, int num_values, double cut_off_frequency, double sampling_rate,
-                double** filtered_values_out, double** fir_coefficients_out, int* filtered_len_out, int* coeff_len_out) {
-    *filtered_len_out = num_values;
-    *coeff_len_out = FIR_NUM_TAPS;
+// === Data Saving Functions ===
+// Binary column archive: the arrays are written as they are, one large fwrite each. Each
+// summary level is a column of min, max, mean triples ("raw_summary_10" ... "filtered_summary_1000").
+void write_weight_archive(const char* file_name, double sampling_rate, const double* raw_weights_all, int raw_len,
+                          const double* filtered_weights_all, int filtered_len,
+                          const double* fir_coefficients, int fir_coeff_len,
+                          const double* fft_frequencies_last, int fft_freq_len,
+                          const double* fft_magnitude_last, int fft_mag_len,
+                          const SummaryLevels* raw_summary, const SummaryLevels* filtered_summary) {
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "output_data\\all_data_%s.bin", file_name);
+
+    _mkdir("output_data"); // Creates the directory if it doesn't exist
 
-    if (num_values == 0 || !values || sampling_rate <= 0) {
-        *filtered_values_out = NULL; *fir_coefficients_out = NULL; *filtered_len_out = 0; *coeff_len_out = 0; return;
+    ArchiveHeader header;
+    archive_header_init(&header, file_name, sampling_rate, ZERO_CAL, SCALE_CAL);
+    header.sample_count = (uint64_t)raw_len;
+    header.fir_taps = (uint32_t)fir_coeff_len;
+    header.fft_size = (fft_mag_len > 0) ? FFT_WINDOW_SIZE : 0;
+    ArchiveColumn columns[ARCHIVE_MAX_COLUMNS] = {
+        { "fir_coefficients", ARCHIVE_F64, fir_coefficients, (uint64_t)fir_coeff_len },
+        { "raw_weight", ARCHIVE_F64, raw_weights_all, (uint64_t)raw_len },
+        { "filtered_weight", ARCHIVE_F64, filtered_weights_all, (uint64_t)filtered_len },
+        { "fft_frequency_hz", ARCHIVE_F64, fft_frequencies_last, (uint64_t)fft_freq_len },
+        { "fft_magnitude", ARCHIVE_F64, fft_magnitude_last, (uint64_t)fft_mag_len },
+    };
+    int column_count = (fft_mag_len > 0) ? 5 : 3;
+    char summary_names[2 * SUMMARY_LEVELS][ARCHIVE_NAME_BYTES];
+    const SummaryLevels* summaries[2] = { raw_summary, filtered_summary };
+    for (int s = 0; s < 2; ++s) {
+        for (int level = 0; level < SUMMARY_LEVELS && summaries[s]; ++level) {
+            char* name = summary_names[s * SUMMARY_LEVELS + level];
+            snprintf(name, ARCHIVE_NAME_BYTES, "%s_summary_%u", s ? "filtered" : "raw", summary_level_ratio(level));
+            ArchiveColumn column = { name, ARCHIVE_F64, summaries[s]->buckets[level], 3 * (uint64_t)summaries[s]->len[level] };
+            columns[column_count++] = column;
+        }
     }
-
-    *filtered_values_out = (double*)calloc(num_values, sizeof(double)); 
-    *fir_coefficients_out = (double*)calloc(FIR_NUM_TAPS, sizeof(double));
-    if (!*filtered_values_out || !*fir_coefficients_out) {
-        perror("Failed to allocate FIR buffers");
-        free(*filtered_values_out); free(*fir_coefficients_out);
-        *filtered_values_out = NULL; *fir_coefficients_out = NULL; *filtered_len_out = 0; *coeff_len_out = 0; return;
+    if (archive_write(filepath, &header, columns, column_count) != 0) {
+        perror("[CLIENT] Error writing output archive");
+        return;
     }
-    
-    // --- PLACEHOLDER FIR FILTER IMPLEMENTATION ---
-    // This simply copies the input to the output. Replace with real FIR filter logic.
-    for(int i = 0; i < num_values; ++i) (*filtered_values_out)[i] = values[i];
-    
-    // Dummy coefficients
-    for(int i = 0; i < FIR_NUM_TAPS; ++i) (*fir_coefficients_out)[i] = 0.0;
-    if (FIR_NUM_TAPS > 0) (*fir_coefficients_out)[FIR_NUM_TAPS / 2] = 1.0; // Impulse response for no-op filter
-    // --- END PLACEHOLDER ---
+    LOG_VERBOSE("[CLIENT] Successfully wrote all data for %s to %s\n", file_name, filepath);
 }
 
-// === Data Saving Function (unchanged) ===
+// The original text dump (WRITE_TEXT_EXPORT)
 void write_data_to_file(const char* file_name, const double* raw_weights_all, int raw_len,
                         const double* filtered_weights_all, int filtered_len,
                         const double* fir_coefficients, int fir_coeff_len,
@@ -293,7 +418,7 @@ void write_data_to_file(const char* file_name, const double* raw_weights_all, in
 
     _mkdir("output_data"); // Creates the directory if it doesn't exist
 
-    printf("[CLIENT] Attempting to write data to %s\n", filepath);
+    LOG_VERBOSE("[CLIENT] Attempting to write data to %s\n", filepath);
 
     FILE* fp = fopen(filepath, "w");
     if (fp == NULL) { perror("[CLIENT] Error opening output file"); return; }
@@ -319,21 +444,55 @@ void write_data_to_file(const char* file_name, const double* raw_weights_all, in
     fprintf(fp, "]\n\n");
 
     fclose(fp);
-    printf("[CLIENT] Successfully wrote all data for %s to %s\n", file_name, filepath);
+    LOG_VERBOSE("[CLIENT] Successfully wrote all data for %s to %s\n", file_name, filepath);
 }
 
 // === Network Helper Function (unchanged) ===
 int recvall(SOCKET sock, void* buffer, size_t len) {
     size_t total_received = 0;
     while (total_received < len) {
+        uint64_t begin = metrics_begin();
         int bytes_received = recv(sock, (char*)buffer + total_received, (int)(len - total_received), 0);
         if (bytes_received <= 0) { return -1; }
+        metrics_end(METRIC_RECV_WAIT, begin, (uint64_t)bytes_received);
         total_received += bytes_received;
     }
     return (int)total_received;
 }
 
-// === Network Thread Function (unchanged) ===
+// Network thread: hands one parsed file to the DSP thread through sample_ring.
+// Returns 0, or -1 if the GUI closed while waiting for room.
+int publish_file(const char* file_name, const double* raw_adc_values, int num_samples, int interval_ms) {
+    uint32_t seq = ++producer_file_seq;
+    // The DSP thread may still be reading the description this slot held FILE_INFO_SLOTS files ago
+    while (seq - atomic_load_explicit(&consumer_file_seq, memory_order_acquire) >= FILE_INFO_SLOTS) {
+        if (!plotting_active) return -1;
+        ring_wait();
+    }
+    FileInfo* info = &file_infos[seq % FILE_INFO_SLOTS];
+    info->num_samples = num_samples;
+    info->interval_ms = interval_ms;
+    strncpy(info->file_name, file_name, sizeof(info->file_name) - 1);
+    info->file_name[sizeof(info->file_name) - 1] = '\0';
+    // The release store of the first sample's ring slot publishes *info as well
+
+    RingSample sample = { 0.0, seq, RING_SAMPLE, 1 };
+    for (int i = 0; i < num_samples; ++i) {
+        sample.value = raw_adc_values[i];
+        if (sample_ring_push(&sample_ring, sample, RING_OVERFLOW_MODE, &plotting_active) != 0) return -1;
+    }
+    sample.kind = RING_END_OF_FILE;
+    sample.value = 0.0;
+    if (sample_ring_push(&sample_ring, sample, RING_OVERFLOW_MODE, &plotting_active) != 0) return -1;
+    metrics_record(METRIC_QUEUE_DEPTH, sample_ring_count(&sample_ring), 0); // Samples ahead of the DSP thread
+
+    LOG_VERBOSE("[CLIENT] Queued file '%s': %d samples (ring %u/%u, %u dropped, %u decimated so far).\n",
+           file_name, num_samples, sample_ring_count(&sample_ring), sample_ring_capacity(&sample_ring),
+           atomic_load(&sample_ring.dropped), atomic_load(&sample_ring.decimated));
+    return 0;
+}
+
+// === Network Thread Function ===
 DWORD WINAPI network_thread_func(LPVOID lpParam) {
     network_thread_running = 1;
     SOCKET sock = INVALID_SOCKET;
@@ -386,6 +545,8 @@ DWORD WINAPI network_thread_func(LPVOID lpParam) {
     }
     free(config_data_bytes);
 
+    DspArena net_arena; // One file's content and parsed samples, reset once the file is queued
+    dsp_arena_init(&net_arena);
     while (plotting_active) { // Continue as long as GUI is active
         uint32_t filename_len_network;
         if (recvall(sock, &filename_len_network, FILENAME_LENGTH_BYTES) == -1) {
@@ -401,7 +562,7 @@ DWORD WINAPI network_thread_func(LPVOID lpParam) {
             printf("[CLIENT] Server disconnected while receiving filename.\n"); break;
         }
         file_name[filename_length] = '\0';
-        printf("[CLIENT] Received file name: %s\n", file_name);
+        LOG_VERBOSE("[CLIENT] Received file name: %s\n", file_name);
 
         if (strcmp(file_name, "END_OF_TRANSMISSION") == 0) {
             printf("[CLIENT] Received END_OF_TRANSMISSION signal from server. Stopping file reception.\n"); break;
@@ -425,18 +586,20 @@ DWORD WINAPI network_thread_func(LPVOID lpParam) {
         }
         uint64_t file_content_length = ntohll_custom(file_content_len_network);
 
-        printf("[CLIENT] Expecting file content of length: %llu bytes for %s\n", (unsigned long long)file_content_length, file_name);
+        LOG_VERBOSE("[CLIENT] Expecting file content of length: %llu bytes for %s\n", (unsigned long long)file_content_length, file_name);
 
-        char* file_content_data = (char*)malloc((size_t)file_content_length + 1);
-        if (!file_content_data) { perror("malloc for file content"); break; }
+        char* file_content_data = (char*)dsp_arena_alloc(&net_arena, (size_t)file_content_length + 1);
+        if (!file_content_data) { perror("Out of memory for file content"); break; }
         if (recvall(sock, file_content_data, (size_t)file_content_length) == -1) {
-            printf("[CLIENT] Server disconnected while receiving file content for %s.\n", file_name); free(file_content_data); break;
+            printf("[CLIENT] Server disconnected while receiving file content for %s.\n", file_name); break;
         }
         file_content_data[file_content_length] = '\0';
-        printf("[CLIENT] Received file content. Actual Length: %zu bytes.\n", strlen(file_content_data));
+        LOG_VERBOSE("[CLIENT] Received file content. Actual Length: %zu bytes.\n", strlen(file_content_data));
+        uint64_t parse_begin = metrics_begin();
 
-        double* raw_adc_values = NULL;
+        double* raw_adc_values = NULL; // The arena's newest allocation, so doubling usually extends it in place
         int raw_adc_count = 0;
+        int raw_adc_capacity = 0;
         char* line_content_ptr = file_content_data; // Use a new pointer for strtok
         
         char* current_adc_line;
@@ -445,49 +608,36 @@ DWORD WINAPI network_thread_func(LPVOID lpParam) {
             if (strstr(current_adc_line, "ADC:") != NULL) {
                 int adc_val;
                 if (sscanf(current_adc_line, "ADC:%d", &adc_val) == 1) {
-                    raw_adc_count++;
-                    raw_adc_values = (double*)realloc(raw_adc_values, sizeof(double) * raw_adc_count);
-                    if (!raw_adc_values) { perror("realloc for raw_adc_values"); break; }
-                    raw_adc_values[raw_adc_count - 1] = (double)adc_val;
+                    if (raw_adc_count == raw_adc_capacity) {
+                        int new_capacity = raw_adc_capacity ? raw_adc_capacity * 2 : 1024;
+                        double* grown = (double*)dsp_arena_grow(&net_arena, raw_adc_values, sizeof(double) * raw_adc_capacity,
+                                                                sizeof(double) * new_capacity);
+                        if (!grown) { perror("Out of memory for raw_adc_values"); break; } // Queue what was parsed
+                        raw_adc_values = grown;
+                        raw_adc_capacity = new_capacity;
+                    }
+                    raw_adc_values[raw_adc_count++] = (double)adc_val;
                 } else { fprintf(stderr, "[CLIENT] Warning: Invalid ADC value in line: %s. Skipping.\n", current_adc_line); }
             }
         }
-        
-        free(file_content_data);
+
+
+        metrics_end(METRIC_PARSE, parse_begin, (uint64_t)raw_adc_count);
 
         if (raw_adc_values && raw_adc_count > 0) {
-            EnterCriticalSection(&queue_lock);
-            if (queue_count < 10) {
-                QueuedData* data_item = (QueuedData*)malloc(sizeof(QueuedData));
-                if (!data_item) { perror("malloc for QueuedData"); free(raw_adc_values); }
-                else {
-                    data_item->raw_adc_values = raw_adc_values;
-                    data_item->num_samples = raw_adc_count;
-                    data_item->interval_ms = interval_ms;
-                    strncpy(data_item->file_name, file_name, sizeof(data_item->file_name) - 1);
-                    data_item->file_name[sizeof(data_item->file_name) - 1] = '\0';
-
-                    data_queue[queue_tail] = data_item;
-                    queue_tail = (queue_tail + 1) % 10;
-                    queue_count++;
-                    WakeConditionVariable(&queue_cond);
-                    printf("[CLIENT] Put full file '%s' into queue (%d items).\n", file_name, queue_count);
-                }
-            } else {
-                printf("[CLIENT] Queue is full, dropping file '%s'.\n", file_name);
-                free(raw_adc_values);
-            }
-            LeaveCriticalSection(&queue_lock);
+            int published = publish_file(file_name, raw_adc_values, raw_adc_count, interval_ms);
+            dsp_arena_reset(&net_arena); // publish_file() copied the samples into the ring
+            if (published != 0) break; // GUI closed while waiting for room
         } else {
             printf("[CLIENT] No valid ADC values found in file %s. Not adding to queue.\n", file_name);
-            free(raw_adc_values);
+            dsp_arena_reset(&net_arena);
         }
     }
+    dsp_arena_free(&net_arena);
 
     closesocket(sock);
     printf("[CLIENT] Network connection closed.\n");
     network_thread_running = 0;
-    WakeConditionVariable(&queue_cond);
     WSACleanup();
     return 0;
 }
@@ -608,159 +758,146 @@ void draw_plot_frame(cairo_t *cr, guint width, guint height,
 }
 
 
-// --- RAW PLOT DRAW CALLBACK ---
-gboolean draw_raw_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data) {
+// Zoomed-out view of a time-series plot: the view_span positions up to the playback
+// position as at most PLOT_BUFFER_SIZE buckets of one summary level, a min-max band with the
+// mean over it. Always drawn whole; the cost depends on the plot, not on the span.
+void draw_summary_plot(GtkWidget *widget, cairo_t *cr, LivePlot* plot, SummaryHistory* summary, int level,
+                       const char* title_prefix, int symmetric, int num_ytick_labels, const char* y_format) {
     guint width = gtk_widget_get_allocated_width(widget);
     guint height = gtk_widget_get_allocated_height(widget);
-
-    // Plot margins
     const double margin_left = 60.0, margin_right = 20.0, margin_top = 20.0, margin_bottom = 40.0;
     const double plot_area_width = width - margin_left - margin_right;
     const double plot_area_height = height - margin_top - margin_bottom;
 
-    // --- CRITICAL SECTION: Lock data buffers for reading ---
-    EnterCriticalSection(&plot_lock);
-    int raw_len;
-    double* raw_data_to_plot = get_circular_buffer_snapshot(&current_raw_buffer, &raw_len);
-    
-    // Determine Y-axis range for raw data
-    double min_y = 0.0, max_y = 700.0; 
-    if (raw_data_to_plot && raw_len > 0) {
-        int first_valid = -1;
-        for(int i = 0; i < raw_len; ++i) { if(!isnan(raw_data_to_plot[i])) { first_valid = i; break; } }
-        if(first_valid != -1) {
-            min_y = raw_data_to_plot[first_valid]; max_y = raw_data_to_plot[first_valid];
-            for (int i = first_valid + 1; i < raw_len; ++i) {
-                if (!isnan(raw_data_to_plot[i])) {
-                    if (raw_data_to_plot[i] < min_y) min_y = raw_data_to_plot[i];
-                    if (raw_data_to_plot[i] > max_y) max_y = raw_data_to_plot[i];
-                }
-            }
-        }
+    unsigned int ratio = summary_level_ratio(level);
+    int slots = (int)(view_span / ratio); // Buckets across the whole plot
+    if (slots > PLOT_BUFFER_SIZE) slots = PLOT_BUFFER_SIZE;
+    static SummaryBucket buckets[PLOT_BUFFER_SIZE]; // GUI thread only
+    int count = summary_history_read_before(summary, level, live_view.shown / ratio, slots, buckets);
+    if (count < 0) count = 0; // Overwritten while copying: an empty frame, the next one is fine
+
+    char title[300];
+    snprintf(title, sizeof(title), "%s - %s (1:%u summary)", title_prefix, live_view.has_file ? live_view.file.file_name : "", ratio);
+    double data_min = NAN, data_max = NAN;
+    for (int i = 0; i < count; ++i) {
+        if (isnan(buckets[i].min)) continue;
+        if (isnan(data_min) || buckets[i].min < data_min) data_min = buckets[i].min;
+        if (isnan(data_max) || buckets[i].max > data_max) data_max = buckets[i].max;
     }
-    // Add padding to Y limits
-    if (!isnan(min_y) && !isnan(max_y) && (max_y - min_y) > 1e-9) {
-        double padding = (max_y - min_y) * 0.1;
-        min_y -= padding;
-        max_y += padding;
-    } else { // Fallback if data is flat or all NaN
-        min_y = -0.1; max_y = 0.1; // Default small range
+    plot_range_fit(&plot->y_min, &plot->y_max, data_min, data_max, 0.1, symmetric);
+
+    double x_max = view_span - 1.0;
+    if (plot_frame_cache_stale(&plot->frame, cr, (int)width, (int)height, x_max, plot->y_min, plot->y_max, title)) {
+        cairo_t* frame_cr = cairo_create(plot->frame.surface);
+        draw_plot_frame(frame_cr, width, height, margin_left, margin_right, margin_top, margin_bottom,
+                        x_max, plot->y_min, plot->y_max,
+                        "Sample Index", "Weight", title,
+                        4, num_ytick_labels, y_format);
+        cairo_destroy(frame_cr);
     }
+    cairo_set_source_surface(cr, plot->frame.surface, 0, 0);
+    cairo_paint(cr);
+    if (count == 0 || plot_area_width < 2 || plot_area_height < 2) return;
 
-    // Draw frame, axes, grids, and labels
-    draw_plot_frame(cr, width, height, margin_left, margin_right, margin_top, margin_bottom,
-                    PLOT_BUFFER_SIZE - 1.0, min_y, max_y,
-                    "Sample Index", "Weight", g_strdup_printf("Raw ADC Data - %s", g_file_state.current_file_name),
-                    4, 5, "%.0f"); // Use %.0f for integer-like weight labels
-
-    // Plot Raw Data (Red)
-    if (raw_data_to_plot && raw_len > 1) {
-        cairo_save(cr); // Save state for plot drawing transformations
-        cairo_translate(cr, margin_left, margin_top + plot_area_height);
-        cairo_scale(cr, plot_area_width / (PLOT_BUFFER_SIZE - 1.0), -plot_area_height / (max_y - min_y));
-        cairo_translate(cr, 0, -min_y);
-
-        cairo_matrix_t current_matrix;
-        cairo_get_matrix(cr, &current_matrix);
-        cairo_set_line_width(cr, 1.5 / current_matrix.xx); // Line thickness for data
-
-        cairo_set_source_rgb(cr, 1.0, 0.0, 0.0); // Red
-        int first_valid = -1;
-        for(int i = 0; i < raw_len; ++i) { if(!isnan(raw_data_to_plot[i])) { first_valid = i; break; } }
-        if(first_valid != -1) {
-            cairo_move_to(cr, (double)first_valid, raw_data_to_plot[first_valid]);
-            for (int i = first_valid + 1; i < raw_len; ++i) {
-                if (!isnan(raw_data_to_plot[i])) { cairo_line_to(cr, (double)i, raw_data_to_plot[i]); }
-                else { cairo_move_to(cr, (double)i, raw_data_to_plot[i-1]); }
-            }
-            cairo_stroke(cr);
-        }
-        cairo_restore(cr); // Restore transformations
+    // Newest bucket at the right edge; bucket i in slot (slots - count + i)
+    const double slot_width = plot_area_width / slots;
+    const double y_scale = plot_area_height / (plot->y_max - plot->y_min);
+    cairo_save(cr);
+    cairo_rectangle(cr, margin_left, margin_top, plot_area_width, plot_area_height);
+    cairo_clip(cr);
+    cairo_set_source_rgba(cr, plot->trace.red, plot->trace.green, plot->trace.blue, 0.3);
+    for (int i = 0; i < count; ++i) {
+        if (isnan(buckets[i].min)) continue;
+        double x = margin_left + (slots - count + i) * slot_width;
+        double top = margin_top + (plot->y_max - buckets[i].max) * y_scale;
+        double bottom = margin_top + (plot->y_max - buckets[i].min) * y_scale;
+        cairo_rectangle(cr, x, top, fmax(slot_width, 1.0), fmax(bottom - top, 1.0));
     }
+    cairo_fill(cr);
 
-    // Free snapshots
-    if (raw_data_to_plot) free(raw_data_to_plot);
-
-    LeaveCriticalSection(&plot_lock);
-    return FALSE;
+    cairo_set_source_rgb(cr, plot->trace.red, plot->trace.green, plot->trace.blue);
+    cairo_set_line_width(cr, 1.5);
+    cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+    int pen = 0;
+    for (int i = 0; i < count; ++i) {
+        if (isnan(buckets[i].mean)) { pen = 0; continue; } // A gap breaks the line, as in the trace
+        double x = margin_left + (slots - count + i + 0.5) * slot_width;
+        double y = margin_top + (plot->y_max - buckets[i].mean) * y_scale;
+        if (pen) cairo_line_to(cr, x, y);
+        else cairo_move_to(cr, x, y);
+        pen = 1;
+    }
+    cairo_stroke(cr);
+    cairo_restore(cr);
 }
 
-// --- FILTERED PLOT DRAW CALLBACK ---
-gboolean draw_filtered_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data) {
+// Draws one of the time-series plots: the cached frame, then the trace brought up to date
+// with the values appended since the last redraw. Spans beyond the plot buffers are drawn
+// from the summary level that suits them instead.
+gboolean draw_series_plot(GtkWidget *widget, cairo_t *cr, LivePlot* plot, CircularBuffer* buffer, SummaryHistory* summary,
+                          const char* title_prefix, int symmetric, int num_ytick_labels, const char* y_format) {
+    uint64_t begin = metrics_begin();
+    int level = summary_pick_level(view_span, PLOT_BUFFER_SIZE);
+    if (level >= 0) {
+        draw_summary_plot(widget, cr, plot, summary, level, title_prefix, symmetric, num_ytick_labels, y_format);
+        metrics_end(METRIC_PLOT_FRAME, begin, 0);
+        return FALSE;
+    }
     guint width = gtk_widget_get_allocated_width(widget);
     guint height = gtk_widget_get_allocated_height(widget);
 
+    // Plot margins
     const double margin_left = 60.0, margin_right = 20.0, margin_top = 20.0, margin_bottom = 40.0;
-    const double plot_area_width = width - margin_left - margin_right;
-    const double plot_area_height = height - margin_top - margin_bottom;
-
-    EnterCriticalSection(&plot_lock);
-    int filtered_len;
-    double* filtered_data_to_plot = get_circular_buffer_snapshot(&current_filtered_buffer, &filtered_len);
-
-    // Determine Y-axis range for filtered data (should be centered around 0)
-    double min_y = -0.1, max_y = 0.1; // Default small range, adjust if data varies more
-    if (filtered_data_to_plot && filtered_len > 0) {
-        int first_valid = -1;
-        for(int i = 0; i < filtered_len; ++i) { if(!isnan(filtered_data_to_plot[i])) { first_valid = i; break; } }
-        if(first_valid != -1) {
-            min_y = filtered_data_to_plot[first_valid]; max_y = filtered_data_to_plot[first_valid];
-            for (int i = first_valid + 1; i < filtered_len; ++i) {
-                if (!isnan(filtered_data_to_plot[i])) {
-                    if (filtered_data_to_plot[i] < min_y) min_y = filtered_data_to_plot[i];
-                    if (filtered_data_to_plot[i] > max_y) max_y = filtered_data_to_plot[i];
-                }
-            }
-        }
+    const int plot_area_width = (int)(width - margin_left - margin_right);
+    const int plot_area_height = (int)(height - margin_top - margin_bottom);
+
+    // Everything shown belongs to the GUI thread: no lock
+    char title[300];
+    snprintf(title, sizeof(title), "%s - %s", title_prefix, live_view.has_file ? live_view.file.file_name : "");
+
+    // Y-axis range over the PLOT_BUFFER_SIZE values shown, kept while it still fits them
+    CircularBufferView view; // Read in place
+    circular_buffer_view(buffer, &view);
+    double data_min, data_max;
+    plot_view_extent(&view, &data_min, &data_max);
+    plot_range_fit(&plot->y_min, &plot->y_max, data_min, data_max, 0.1, symmetric);
+
+    // Frame, axes, grids, and labels: redrawn only when the size, range or title changes
+    if (plot_frame_cache_stale(&plot->frame, cr, (int)width, (int)height, PLOT_BUFFER_SIZE - 1.0, plot->y_min, plot->y_max, title)) {
+        cairo_t* frame_cr = cairo_create(plot->frame.surface);
+        draw_plot_frame(frame_cr, width, height, margin_left, margin_right, margin_top, margin_bottom,
+                        PLOT_BUFFER_SIZE - 1.0, plot->y_min, plot->y_max,
+                        "Sample Index", "Weight", title,
+                        4, num_ytick_labels, y_format);
+        cairo_destroy(frame_cr);
     }
-    // Add padding and ensure centered around 0 (or close to it)
-    if (!isnan(min_y) && !isnan(max_y) && (max_y - min_y) > 1e-9) {
-        double abs_max = fmax(fabs(min_y), fabs(max_y));
-        min_y = -abs_max * 1.1; // 10% padding
-        max_y = abs_max * 1.1;
-        if (max_y - min_y < 1e-9) { min_y = -0.1; max_y = 0.1; } // Fallback
-    } else {
-        min_y = -0.1; max_y = 0.1; // Default
-    }
-
-    // Draw frame, axes, grids, and labels
-    draw_plot_frame(cr, width, height, margin_left, margin_right, margin_top, margin_bottom,
-                    PLOT_BUFFER_SIZE - 1.0, min_y, max_y,
-                    "Sample Index", "Weight", g_strdup_printf("FIR-Filtered ADC Data - %s", g_file_state.current_file_name),
-                    4, 4, "%.2f"); // Use %.2f for decimal weight labels
-
-    // Plot Filtered Data (Green)
-    if (filtered_data_to_plot && filtered_len > 1) {
-        cairo_save(cr);
-        cairo_translate(cr, margin_left, margin_top + plot_area_height);
-        cairo_scale(cr, plot_area_width / (PLOT_BUFFER_SIZE - 1.0), -plot_area_height / (max_y - min_y));
-        cairo_translate(cr, 0, -min_y);
-
-        cairo_matrix_t current_matrix;
-        cairo_get_matrix(cr, &current_matrix);
-        cairo_set_line_width(cr, 1.5 / current_matrix.xx);
+    cairo_set_source_surface(cr, plot->frame.surface, 0, 0);
+    cairo_paint(cr);
 
-        cairo_set_source_rgb(cr, 0.0, 0.8, 0.0); // Green for contrast
-        int first_valid = -1;
-        for(int i = 0; i < filtered_len; ++i) { if(!isnan(filtered_data_to_plot[i])) { first_valid = i; break; } }
-        if(first_valid != -1) {
-            cairo_move_to(cr, (double)first_valid, filtered_data_to_plot[first_valid]);
-            for (int i = first_valid + 1; i < filtered_len; ++i) {
-                if (!isnan(filtered_data_to_plot[i])) { cairo_line_to(cr, (double)i, filtered_data_to_plot[i]); }
-                else { cairo_move_to(cr, (double)i, filtered_data_to_plot[i-1]); }
-            }
-            cairo_stroke(cr);
-        }
-        cairo_restore(cr);
+    plot_trace_update(&plot->trace, cr, buffer, plot_area_width, plot_area_height, plot->y_min, plot->y_max);
+    if (plot->trace.surface) {
+        cairo_set_source_surface(cr, plot->trace.surface, margin_left, margin_top);
+        cairo_paint(cr);
     }
-
-    if (filtered_data_to_plot) free(filtered_data_to_plot);
-    LeaveCriticalSection(&plot_lock);
+    metrics_end(METRIC_PLOT_FRAME, begin, 0);
     return FALSE;
 }
 
+// --- RAW PLOT DRAW CALLBACK ---
+gboolean draw_raw_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data) {
+    return draw_series_plot(widget, cr, &raw_plot, &current_raw_buffer, &live_history.raw_summary, "Raw ADC Data",
+                            0, 5, "%.0f"); // Use %.0f for integer-like weight labels
+}
+
+// --- FILTERED PLOT DRAW CALLBACK ---
+gboolean draw_filtered_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data) {
+    return draw_series_plot(widget, cr, &filtered_plot, &current_filtered_buffer, &live_history.filtered_summary, "FIR-Filtered ADC Data",
+                            1, 4, "%.2f"); // Centred around 0; %.2f for decimal weight labels
+}
+
 // --- FFT PLOT DRAW CALLBACK ---
 gboolean draw_fft_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data) {
+    uint64_t begin = metrics_begin();
     guint width = gtk_widget_get_allocated_width(widget);
     guint height = gtk_widget_get_allocated_height(widget);
 
@@ -768,40 +905,49 @@ gboolean draw_fft_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data) {
     const double plot_area_width = width - margin_left - margin_right;
     const double plot_area_height = height - margin_top - margin_bottom;
 
-    EnterCriticalSection(&plot_lock);
-    // Get FFT data (already stored in g_file_state from last computation in process_data_gui_callback)
-    double* fft_freqs = g_file_state.last_fft_frequencies_to_save;
-    double* fft_mags = g_file_state.last_fft_magnitude_to_save;
-    int fft_plot_len = g_file_state.last_fft_frequencies_len_to_save;
+    char title[300];
+    snprintf(title, sizeof(title), "FFT Spectrum - %s", live_view.has_file ? live_view.file.file_name : "");
+    // The spectrum as of the playback position (live_view's copy, so no lock)
+    const double* fft_freqs = live_view.frequencies;
+    const double* fft_mags = live_view.magnitude;
+    int fft_plot_len = live_view.spectrum_len;
 
     // Determine Y-axis range for FFT plot
     double min_y = 0.0, max_y = 1.0; // Default range
-    if (fft_mags && fft_plot_len > 1) { // Skip DC component (index 0) for scaling
+    if (fft_plot_len > 1) { // Skip DC component (index 0) for scaling
         max_y = fft_mags[1]; // Start from first non-DC component
         for (int i = 2; i < fft_plot_len; ++i) { 
             if (!isnan(fft_mags[i]) && fft_mags[i] > max_y) max_y = fft_mags[i];
         }
     }
     if (max_y < 1e-9) max_y = 1.0; // Avoid zero range
-    double y_padding = max_y * 0.1;
-    min_y = 0.0; // FFT magnitude is always non-negative
-    max_y += y_padding;
+    if (plot_range_fit(&fft_plot.y_min, &fft_plot.y_max, 0.0, max_y, 0.1, 0)) {
+        fft_plot.y_min = 0.0; // FFT magnitude is always non-negative
+    }
+    min_y = fft_plot.y_min;
+    max_y = fft_plot.y_max;
 
     // Determine X-axis range for FFT plot (up to Nyquist or max freq in data)
     double max_x = 0.0;
-    if (fft_freqs && fft_plot_len > 0) {
+    if (fft_plot_len > 0) {
         max_x = fft_freqs[fft_plot_len - 1]; // Max frequency is last element
     }
     if (max_x < 1e-9) max_x = 100.0; // Default to 100Hz if no data
 
-    // Draw frame, axes, grids, and labels
-    draw_plot_frame(cr, width, height, margin_left, margin_right, margin_top, margin_bottom,
-                    max_x, min_y, max_y,
-                    "Frequency (Hz)", "Magnitude", g_strdup_printf("FFT Spectrum - %s (Placeholder)", g_file_state.current_file_name),
-                    4, 4, "%.0e"); // Use scientific notation for magnitude labels
+    // Frame, axes, grids, and labels: redrawn only when the size, range or title changes
+    if (plot_frame_cache_stale(&fft_plot.frame, cr, (int)width, (int)height, max_x, min_y, max_y, title)) {
+        cairo_t* frame_cr = cairo_create(fft_plot.frame.surface);
+        draw_plot_frame(frame_cr, width, height, margin_left, margin_right, margin_top, margin_bottom,
+                        max_x, min_y, max_y,
+                        "Frequency (Hz)", "Magnitude", title,
+                        4, 4, "%.0e"); // Use scientific notation for magnitude labels
+        cairo_destroy(frame_cr);
+    }
+    cairo_set_source_surface(cr, fft_plot.frame.surface, 0, 0);
+    cairo_paint(cr);
 
     // Plot FFT Data (Blue)
-    if (fft_freqs && fft_mags && fft_plot_len > 1) {
+    if (fft_plot_len > 1) {
         cairo_save(cr);
         cairo_translate(cr, margin_left, margin_top + plot_area_height);
         cairo_scale(cr, plot_area_width / max_x, -plot_area_height / (max_y - min_y));
@@ -829,222 +975,292 @@ gboolean draw_fft_plot_callback(GtkWidget *widget, cairo_t *cr, gpointer data) {
         }
         cairo_restore(cr);
     }
-
-    LeaveCriticalSection(&plot_lock);
+    metrics_end(METRIC_PLOT_FRAME, begin, 0);
     return FALSE;
 }
 
-// Function to trigger redraws for all three plot areas
-void update_all_plots_gui() {
-    if (raw_plot_area) gtk_widget_queue_draw(raw_plot_area);
-    if (filtered_plot_area) gtk_widget_queue_draw(filtered_plot_area);
-    if (fft_plot_area) gtk_widget_queue_draw(fft_plot_area);
+// Queues a redraw of one plot if its data or title moved since the last one. Returns 1 if queued.
+int queue_plot_if_changed(GtkWidget* area, LivePlot* plot, unsigned int written, unsigned int start, unsigned int version) {
+    if (!area || (written == plot->seen_written && start == plot->seen_start && version == plot->seen_version)) return 0;
+    plot->seen_written = written;
+    plot->seen_start = start;
+    plot->seen_version = version;
+    gtk_widget_queue_draw(area);
+    return 1;
 }
 
-// GTK Idle/Timeout callback to process data from the network thread's queue and update GUI
-gboolean process_data_gui_callback(gpointer user_data) {
-    // If a file is currently being processed (by this timeout callback)
-    if (g_file_state.is_processing_file) {
-        // Check if there are more samples to process in the current file
-        if (g_file_state.current_file_index < g_file_state.current_file_num_samples) {
-            double current_raw_adc = g_file_state.current_file_raw_adc_values[g_file_state.current_file_index];
-            
-            // --- CRITICAL SECTION: Lock buffers for writing data ---
-            EnterCriticalSection(&plot_lock);
-            
-            append_circular_buffer(&dsp_raw_adc_buffer, current_raw_adc); 
-
-            // Normalize current raw ADC value to weight
-            int temp_adc = (int)current_raw_adc;
-            double* current_raw_weight_arr = normalize_to_weights(&temp_adc, 1);
-            double current_raw_weight = NAN;
-            if (current_raw_weight_arr) {
-                current_raw_weight = current_raw_weight_arr[0];
-                free(current_raw_weight_arr);
-            }
-            append_circular_buffer(&current_raw_buffer, current_raw_weight); // Raw data (with DC) for raw plot
-            
-            // Append to all_raw_weights (for saving later)
-            g_file_state.all_raw_weights_len_to_save++;
-            g_file_state.all_raw_weights_to_save = (double*)realloc(g_file_state.all_raw_weights_to_save, sizeof(double) * g_file_state.all_raw_weights_len_to_save);
-            if (!g_file_state.all_raw_weights_to_save) { perror("realloc failed for all_raw_weights_to_save"); goto cleanup_current_file_on_error; }
-            g_file_state.all_raw_weights_to_save[g_file_state.all_raw_weights_len_to_save - 1] = current_raw_weight;
-
-            double filtered_weight_to_save = NAN; // For saving (DC-retained or DC-removed depending on philosophy)
-            double filtered_weight_for_plot = NAN; // For plotting (DC-removed)
-
-            double sampling_rate = (g_file_state.current_file_interval_ms > 0) ? (1000.0 / g_file_state.current_file_interval_ms) : 1.0;
-            int min_dsp_samples = (FIR_NUM_TAPS > FFT_WINDOW_SIZE) ? FIR_NUM_TAPS : FFT_WINDOW_SIZE;
-
-            // Perform DSP only if enough data is available in the DSP buffer
-            if (dsp_raw_adc_buffer.count >= min_dsp_samples) {
-                int dsp_snapshot_len;
-                double* current_dsp_raw_values_snapshot = get_circular_buffer_snapshot(&dsp_raw_adc_buffer, &dsp_snapshot_len);
-                if (!current_dsp_raw_values_snapshot) { printf("[CLIENT] Error: Could not get DSP buffer snapshot.\n"); goto end_processing_loop_return_continue; } // Modified goto
-                
-                int processed_len_dc_removed;
-                double* processed_window_dc_removed = remove_dc_offset_temp(current_dsp_raw_values_snapshot, dsp_snapshot_len, &processed_len_dc_removed);
-                free(current_dsp_raw_values_snapshot); // Free snapshot after use
-
-                if (processed_window_dc_removed) {
-                    // Compute FFT and store results for plotting and saving
-                    free(g_file_state.last_fft_frequencies_to_save); g_file_state.last_fft_frequencies_to_save = NULL;
-                    free(g_file_state.last_fft_magnitude_to_save); g_file_state.last_fft_magnitude_to_save = NULL;
-                    
-                    double dom_freq;
-                    compute_fft(processed_window_dc_removed, processed_len_dc_removed, sampling_rate,
-                                &g_file_state.last_fft_frequencies_to_save, &g_file_state.last_fft_magnitude_to_save, &dom_freq, &g_file_state.last_fft_frequencies_len_to_save);
-                    g_file_state.last_fft_magnitude_len_to_save = g_file_state.last_fft_frequencies_len_to_save;
-
-                    // Apply FIR filter and store coefficients for saving
-                    free(g_file_state.last_fir_coefficients_to_save); g_file_state.last_fir_coefficients_to_save = NULL;
-                    double* filtered_segment_values_dc_removed = NULL;
-                    int filtered_segment_len;
-                    fir_filter(processed_window_dc_removed, processed_len_dc_removed, dom_freq, sampling_rate,
-                            &filtered_segment_values_dc_removed, &g_file_state.last_fir_coefficients_to_save, &filtered_segment_len, &g_file_state.last_fir_coefficients_len_to_save);
-                    
-                    if (filtered_segment_values_dc_removed && filtered_segment_len > 0) {
-                        double filtered_point_dc_removed = filtered_segment_values_dc_removed[filtered_segment_len - 1];
-                        
-                        // For plotting, use the DC-removed filtered data:
-                        filtered_weight_for_plot = filtered_point_dc_removed; 
-
-                        // For saving, typically you save what you plot (DC-removed in this case) or original DC-retained.
-                        // Based on Matplotlib example's filtered plot, it's DC-removed.
-                        filtered_weight_to_save = filtered_weight_for_plot; 
-                        
-                    } else { filtered_weight_for_plot = current_raw_weight; filtered_weight_to_save = current_raw_weight; } // Fallback
-                    free(processed_window_dc_removed);
-                    if(filtered_segment_values_dc_removed) free(filtered_segment_values_dc_removed); // Free filtered segment
-                } else { filtered_weight_for_plot = current_raw_weight; filtered_weight_to_save = current_raw_weight; }
-            } else { filtered_weight_for_plot = current_raw_weight; filtered_weight_to_save = current_raw_weight; } // Not enough data for DSP yet
-
-            // Append filtered weight (DC-removed) to buffer for plotting
-            if (dsp_raw_adc_buffer.count >= FIR_NUM_TAPS) { append_circular_buffer(&current_filtered_buffer, filtered_weight_for_plot); }
-            else { append_circular_buffer(&current_filtered_buffer, NAN); } // Append NaN if not enough for filter
-            
-            // Append to all_filtered_weights for saving
-            g_file_state.all_filtered_weights_len_to_save++;
-            g_file_state.all_filtered_weights_to_save = (double*)realloc(g_file_state.all_filtered_weights_to_save, sizeof(double) * g_file_state.all_filtered_weights_len_to_save);
-            if (!g_file_state.all_filtered_weights_to_save) { perror("realloc failed for all_filtered_weights_to_save"); goto cleanup_current_file_on_error; }
-            g_file_state.all_filtered_weights_to_save[g_file_state.all_filtered_weights_len_to_save - 1] = filtered_weight_to_save;
-
-            // --- END CRITICAL SECTION ---
-            LeaveCriticalSection(&plot_lock);
-
-            update_all_plots_gui(); // Request GUI redraw for all plots
-            g_file_state.current_file_index++; // Move to next sample
-
-            // Update status label in GUI
-            char status_text[512]; // Increased buffer size to prevent truncation
-            snprintf(status_text, sizeof(status_text), "Processing %s: Sample %d/%d", 
-                     g_file_state.current_file_name, g_file_state.current_file_index, g_file_state.current_file_num_samples);
-            gtk_label_set_text(GTK_LABEL(label_status), status_text);
-
-            return G_SOURCE_CONTINUE; // Keep this timeout active for next sample
-        } else {
-            // Finished processing all samples for the current file
-            printf("[CLIENT] Finished processing file %s. Saving data.\n", g_file_state.current_file_name);
-            write_data_to_file(g_file_state.current_file_name, 
-                               g_file_state.all_raw_weights_to_save, g_file_state.all_raw_weights_len_to_save,
-                               g_file_state.all_filtered_weights_to_save, g_file_state.all_filtered_weights_len_to_save,
-                               g_file_state.last_fir_coefficients_to_save, g_file_state.last_fir_coefficients_len_to_save,
-                               g_file_state.last_fft_frequencies_to_save, g_file_state.last_fft_frequencies_len_to_save,
-                               g_file_state.last_fft_magnitude_to_save, g_file_state.last_fft_magnitude_len_to_save);
-            
-cleanup_current_file_on_error: // Label for goto in case of realloc failure or error during processing
-            // Free resources specific to the just-processed file
-            free(g_file_state.current_file_raw_adc_values); g_file_state.current_file_raw_adc_values = NULL;
-            free(g_file_state.all_raw_weights_to_save); g_file_state.all_raw_weights_to_save = NULL;
-            free(g_file_state.all_filtered_weights_to_save); g_file_state.all_filtered_weights_to_save = NULL;
-            free(g_file_state.last_fir_coefficients_to_save); g_file_state.last_fir_coefficients_to_save = NULL;
-            free(g_file_state.last_fft_frequencies_to_save); g_file_state.last_fft_frequencies_to_save = NULL;
-            free(g_file_state.last_fft_magnitude_to_save); g_file_state.last_fft_magnitude_to_save = NULL;
-            
-            memset(&g_file_state, 0, sizeof(FileProcessingState)); // Clear remaining state variables
-            g_file_state.is_processing_file = 0; // Mark as no file being processed
-
-            gtk_label_set_text(GTK_LABEL(label_status), "Finished processing file. Checking for next data.");
-            
-            // Remove the timeout for the current file as it's finished
-            if (data_processing_source_id != 0) {
-                g_source_remove(data_processing_source_id);
-                data_processing_source_id = 0;
-            }
-            // Now, fall through to check the network queue for a new file
-        }
+// Frame clock tick (once per display refresh): moves the playback on and redraws the plots
+// whose data changed, at most PLOT_MAX_FPS times a second, however fast samples arrive
+gboolean plot_tick_callback(GtkWidget *widget, GdkFrameClock *frame_clock, gpointer user_data) {
+    static gint64 last_redraw_us = 0, last_advance_us = 0;
+    gint64 now_us = gdk_frame_clock_get_frame_time(frame_clock);
+    if (PLOT_MAX_FPS > 0 && now_us - last_redraw_us < G_USEC_PER_SEC / PLOT_MAX_FPS) return G_SOURCE_CONTINUE;
+
+    double elapsed_s = (last_advance_us != 0) ? (double)(now_us - last_advance_us) / G_USEC_PER_SEC : 0.0;
+    last_advance_us = now_us;
+    live_view_advance(&live_history, &live_view, elapsed_s, &current_raw_buffer, &current_filtered_buffer);
+
+    unsigned int version = live_view.version;
+    int queued = queue_plot_if_changed(raw_plot_area, &raw_plot, atomic_load(&current_raw_buffer.written),
+                                       atomic_load(&current_raw_buffer.start), version);
+    queued |= queue_plot_if_changed(filtered_plot_area, &filtered_plot, atomic_load(&current_filtered_buffer.written),
+                                    atomic_load(&current_filtered_buffer.start), version);
+    queued |= queue_plot_if_changed(fft_plot_area, &fft_plot, 0, 0, version);
+    if (queued) last_redraw_us = now_us;
+    return G_SOURCE_CONTINUE;
+}
+
+// "Catch up" check box: follow the newest processed data instead of the recording's pace
+void on_catch_up_toggled(GtkWidget *button, gpointer data) {
+    live_view.mode = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button)) ? LIVE_VIEW_CATCH_UP : LIVE_VIEW_REAL_TIME;
+    live_view.pending = 0.0;
+}
+
+// Zoom selector: step n shows PLOT_BUFFER_SIZE * 10^n samples (summaries from n = 1 on)
+void on_zoom_changed(GtkWidget *combo, gpointer data) {
+    int step = gtk_combo_box_get_active(GTK_COMBO_BOX(combo));
+    if (step < 0) return;
+    view_span = PLOT_BUFFER_SIZE;
+    for (int i = 0; i < step; ++i) view_span *= SUMMARY_FACTOR;
+    gtk_widget_queue_draw(raw_plot_area);
+    gtk_widget_queue_draw(filtered_plot_area);
+}
+
+// Makes room for one more sample in both save arrays. Returns 0, or -1 if out of memory.
+int grow_save_buffers(FileProcessingState* state) {
+    if (state->all_raw_weights_len_to_save < state->save_capacity) return 0;
+    int new_capacity = state->save_capacity ? state->save_capacity * 2 : 1024;
+    size_t old_bytes = sizeof(double) * state->save_capacity, new_bytes = sizeof(double) * new_capacity;
+    double* raw = (double*)dsp_arena_grow(&file_arena, state->all_raw_weights_to_save, old_bytes, new_bytes);
+    if (!raw) return -1;
+    double* filtered = (double*)dsp_arena_grow(&file_arena, state->all_filtered_weights_to_save, old_bytes, new_bytes);
+    if (!filtered) return -1;
+    state->all_raw_weights_to_save = raw; // Both copied: the old arrays stay readable until the reset
+    state->all_filtered_weights_to_save = filtered;
+    state->save_capacity = new_capacity;
+    return 0;
+}
+
+// Keeps the buckets a summary pyramid just closed, growing a level by doubling when it is
+// full (a file longer than announced). A bucket that finds no memory is left out.
+void save_summary_buckets(SummaryLevels* levels, const SummaryPyramid* pyramid, int mask) {
+    for (int level = 0; level < SUMMARY_LEVELS; ++level) {
+        if (!(mask & (1 << level)) || levels->len[level] < levels->capacity[level]) continue;
+        int new_capacity = levels->capacity[level] ? levels->capacity[level] * 2 : 64;
+        SummaryBucket* grown = (SummaryBucket*)dsp_arena_grow(&file_arena, levels->buckets[level],
+                                                              sizeof(SummaryBucket) * levels->capacity[level],
+                                                              sizeof(SummaryBucket) * new_capacity);
+        if (!grown) continue;
+        levels->buckets[level] = grown;
+        levels->capacity[level] = new_capacity;
     }
+    summary_levels_store(levels, pyramid, mask);
+}
 
-end_processing_loop_return_continue: // Modified label for goto, always returns G_SOURCE_CONTINUE if not quitting
-    // If no file is currently being processed, check the network thread's queue for a new file
-    EnterCriticalSection(&queue_lock);
-    if (queue_count > 0) {
-        QueuedData* data_item = data_queue[queue_head];
-        queue_head = (queue_head + 1) % 10;
-        queue_count--;
-        printf("[CLIENT MAIN] Pulled full file '%s' from queue. (%d remaining)\n", data_item->file_name, queue_count);
-
-        // Prepare g_file_state for processing the new file
-        memset(&g_file_state, 0, sizeof(FileProcessingState)); // Clear previous state
-        g_file_state.current_file_raw_adc_values = data_item->raw_adc_values; // Take ownership
-        g_file_state.current_file_num_samples = data_item->num_samples;
-        g_file_state.current_file_interval_ms = data_item->interval_ms;
-        strncpy(g_file_state.current_file_name, data_item->file_name, sizeof(g_file_state.current_file_name) - 1);
-        g_file_state.current_file_name[sizeof(g_file_state.current_file_name) - 1] = '\0';
-        g_file_state.current_file_index = 0;
-        g_file_state.is_processing_file = 1;
-
-        // Clear circular buffers for the new file's data
-        EnterCriticalSection(&plot_lock); // Must lock when modifying shared buffers
-        current_raw_buffer.head = current_raw_buffer.tail = current_raw_buffer.count = 0;
-        current_filtered_buffer.head = current_filtered_buffer.tail = current_filtered_buffer.count = 0;
-        dsp_raw_adc_buffer.head = dsp_raw_adc_buffer.tail = dsp_raw_adc_buffer.count = 0;
-        LeaveCriticalSection(&plot_lock);
-
-        free(data_item); // Free the QueuedData wrapper struct
-        LeaveCriticalSection(&queue_lock);
-        gtk_label_set_text(GTK_LABEL(label_status), "Starting new file processing...");
-        
-        // Start a new timeout for the processing of this file
-        data_processing_source_id = g_timeout_add(g_file_state.current_file_interval_ms, process_data_gui_callback, NULL);
-        if (data_processing_source_id == 0) {
-            fprintf(stderr, "[CLIENT MAIN] Failed to add g_timeout_add for new file processing.\n");
-            // Consider error handling like quitting or retrying
-            gtk_main_quit();
-            return G_SOURCE_REMOVE;
+// Starts a new file: picks up its description, clears the engine and opens the file in the live history
+void begin_file(uint32_t file_seq) {
+    const FileInfo* info = &file_infos[file_seq % FILE_INFO_SLOTS];
+    double sampling_rate = (info->interval_ms > 0) ? (1000.0 / info->interval_ms) : 1.0;
+    dsp_engine_reset(&g_dsp, sampling_rate);
+
+    // Every array the file needs, from the arena (no heap calls once it has seen a file this large).
+    // Decimation only ever drops samples, so the save arrays normally never grow.
+    int save_capacity = (info->num_samples > 0) ? info->num_samples : 1;
+    double* raw_save = (double*)dsp_arena_alloc(&file_arena, sizeof(double) * save_capacity);
+    double* filtered_save = (double*)dsp_arena_alloc(&file_arena, sizeof(double) * save_capacity);
+    double* fir_coefficients = (double*)dsp_arena_alloc(&file_arena, sizeof(double) * FIR_NUM_TAPS);
+    double* fft_frequencies = (double*)dsp_arena_alloc(&file_arena, sizeof(double) * (FFT_WINDOW_SIZE / 2));
+    double* fft_magnitude = (double*)dsp_arena_alloc(&file_arena, sizeof(double) * (FFT_WINDOW_SIZE / 2));
+    SummaryLevels raw_summary = {0}, filtered_summary = {0};
+    for (int level = 0; level < SUMMARY_LEVELS; ++level) {
+        int buckets = summary_level_buckets(save_capacity, level);
+        raw_summary.buckets[level] = (SummaryBucket*)dsp_arena_alloc(&file_arena, sizeof(SummaryBucket) * buckets);
+        filtered_summary.buckets[level] = (SummaryBucket*)dsp_arena_alloc(&file_arena, sizeof(SummaryBucket) * buckets);
+        if (raw_summary.buckets[level]) raw_summary.capacity[level] = buckets;
+        if (filtered_summary.buckets[level]) filtered_summary.capacity[level] = buckets;
+    }
+
+    EnterCriticalSection(&plot_lock);
+    memset(&g_file_state, 0, sizeof(FileProcessingState));
+    if (raw_save && filtered_save) {
+        g_file_state.all_raw_weights_to_save = raw_save;
+        g_file_state.all_filtered_weights_to_save = filtered_save;
+        g_file_state.save_capacity = save_capacity;
+    }
+    g_file_state.last_fir_coefficients_to_save = fir_coefficients;
+    if (fft_frequencies && fft_magnitude) {
+        g_file_state.last_fft_frequencies_to_save = fft_frequencies;
+        g_file_state.last_fft_magnitude_to_save = fft_magnitude;
+    }
+    summary_pyramid_reset(&g_file_state.raw_summary);
+    summary_pyramid_reset(&g_file_state.filtered_summary);
+    g_file_state.raw_summary_to_save = raw_summary;
+    g_file_state.filtered_summary_to_save = filtered_summary;
+    g_file_state.current_file_num_samples = info->num_samples;
+    g_file_state.current_file_interval_ms = info->interval_ms;
+    strncpy(g_file_state.current_file_name, info->file_name, sizeof(g_file_state.current_file_name) - 1);
+    g_file_state.current_file_name[sizeof(g_file_state.current_file_name) - 1] = '\0';
+    g_file_state.is_processing_file = 1;
+    LeaveCriticalSection(&plot_lock);
+    atomic_store_explicit(&consumer_file_seq, file_seq, memory_order_release); // Slot may be reused now
+    atomic_store_explicit(&current_file_progress, 0, memory_order_relaxed);
+    live_view_begin_file(&live_history, info->file_name, info->num_samples, info->interval_ms);
+    LOG_VERBOSE("[CLIENT DSP] Started file '%s' (%d samples).\n", g_file_state.current_file_name, g_file_state.current_file_num_samples);
+}
+
+// Runs one sample through the DSP engine and publishes the results. step > 1 when the
+// network thread decimated (the sample stands for step input samples).
+void process_file_sample(double current_raw_adc, int step) {
+    double current_raw_weight = normalize_to_weight(current_raw_adc);
+
+    double filtered_point_dc_removed;
+    int new_spectrum = dsp_engine_push(&g_dsp, current_raw_adc, &filtered_point_dc_removed);
+
+    if (grow_save_buffers(&g_file_state) == 0) {
+        g_file_state.all_raw_weights_to_save[g_file_state.all_raw_weights_len_to_save++] = current_raw_weight;
+        g_file_state.all_filtered_weights_to_save[g_file_state.all_filtered_weights_len_to_save++] = filtered_point_dc_removed;
+    } else {
+        perror("Out of memory for save buffers"); // Keep plotting; the saved file will be short
+    }
+    // Buckets aligned with the file's first sample; both pyramids close on the same samples
+    int mask = summary_pyramid_push(&g_file_state.raw_summary, current_raw_weight);
+    summary_pyramid_push(&g_file_state.filtered_summary, filtered_point_dc_removed);
+    if (mask) {
+        save_summary_buckets(&g_file_state.raw_summary_to_save, &g_file_state.raw_summary, mask);
+        save_summary_buckets(&g_file_state.filtered_summary_to_save, &g_file_state.filtered_summary, mask);
+    }
+
+    // Raw data (with DC) for the raw plot; filtered is NaN until the FIR is primed
+    live_view_push(&live_history, current_raw_weight, filtered_point_dc_removed);
+    if (new_spectrum) { // Once per FFT_HOP_SIZE samples
+        live_view_push_spectrum(&live_history, g_dsp.fft_frequencies, g_dsp.fft_magnitude, g_dsp.fft_len);
+        if (g_file_state.last_fft_frequencies_to_save) { // The last one is saved with the file
+            memcpy(g_file_state.last_fft_frequencies_to_save, g_dsp.fft_frequencies, sizeof(double) * g_dsp.fft_len);
+            memcpy(g_file_state.last_fft_magnitude_to_save, g_dsp.fft_magnitude, sizeof(double) * g_dsp.fft_len);
+            g_file_state.last_fft_frequencies_len_to_save = g_dsp.fft_len;
+            g_file_state.last_fft_magnitude_len_to_save = g_dsp.fft_len;
         }
+    }
+    g_file_state.current_file_index += step;
+    atomic_store_explicit(&current_file_progress, g_file_state.current_file_index, memory_order_relaxed);
+}
 
-        return G_SOURCE_CONTINUE; // Continue from this call to allow new timeout to take over
+// Saves the current file's data and releases it
+void finish_file(void) {
+    // Coefficients in use at the end of the file are the ones saved
+    g_file_state.last_fir_coefficients_len_to_save = 0;
+    if (g_file_state.last_fir_coefficients_to_save) {
+        memcpy(g_file_state.last_fir_coefficients_to_save, g_dsp.fir_coefficients, sizeof(double) * FIR_NUM_TAPS);
+        g_file_state.last_fir_coefficients_len_to_save = FIR_NUM_TAPS;
     }
-    LeaveCriticalSection(&queue_lock);
+    // The partly filled last buckets are saved too
+    int mask = summary_pyramid_flush(&g_file_state.raw_summary);
+    summary_pyramid_flush(&g_file_state.filtered_summary);
+    save_summary_buckets(&g_file_state.raw_summary_to_save, &g_file_state.raw_summary, mask);
+    save_summary_buckets(&g_file_state.filtered_summary_to_save, &g_file_state.filtered_summary, mask);
+
+    LOG_VERBOSE("[CLIENT DSP] Finished processing file %s (%d of %d samples). Saving data.\n", g_file_state.current_file_name,
+                g_file_state.current_file_index, g_file_state.current_file_num_samples);
+    uint64_t begin = metrics_begin();
+#if WRITE_BINARY_ARCHIVE
+    write_weight_archive(g_file_state.current_file_name, g_dsp.sampling_rate,
+                         g_file_state.all_raw_weights_to_save, g_file_state.all_raw_weights_len_to_save,
+                         g_file_state.all_filtered_weights_to_save, g_file_state.all_filtered_weights_len_to_save,
+                         g_file_state.last_fir_coefficients_to_save, g_file_state.last_fir_coefficients_len_to_save,
+                         g_file_state.last_fft_frequencies_to_save, g_file_state.last_fft_frequencies_len_to_save,
+                         g_file_state.last_fft_magnitude_to_save, g_file_state.last_fft_magnitude_len_to_save,
+                         &g_file_state.raw_summary_to_save, &g_file_state.filtered_summary_to_save);
+#endif
+#if WRITE_TEXT_EXPORT
+    write_data_to_file(g_file_state.current_file_name,
+                       g_file_state.all_raw_weights_to_save, g_file_state.all_raw_weights_len_to_save,
+                       g_file_state.all_filtered_weights_to_save, g_file_state.all_filtered_weights_len_to_save,
+                       g_file_state.last_fir_coefficients_to_save, g_file_state.last_fir_coefficients_len_to_save,
+                       g_file_state.last_fft_frequencies_to_save, g_file_state.last_fft_frequencies_len_to_save,
+                       g_file_state.last_fft_magnitude_to_save, g_file_state.last_fft_magnitude_len_to_save);
+#endif
+    metrics_end(METRIC_WRITE, begin, (uint64_t)g_file_state.all_raw_weights_len_to_save);
+
+    // Release the just-processed file's arrays (the live view has its own copy of the results)
+    EnterCriticalSection(&plot_lock);
+    memset(&g_file_state, 0, sizeof(FileProcessingState)); // Also marks no file as being processed
+    LeaveCriticalSection(&plot_lock);
+    dsp_arena_reset(&file_arena);
+}
 
-    // If no file to process and network thread is done, it's time to quit the GTK main loop
-    if (!network_thread_running && queue_count == 0 && !g_file_state.is_processing_file) {
-        printf("[CLIENT MAIN] No more data from network and queue is empty. Quitting GTK main loop.\n");
-        gtk_main_quit(); // Exits the GTK event loop
-        return G_SOURCE_REMOVE; // Stop this idle callback
+// DSP thread: drains sample_ring as fast as samples arrive, saving each file as soon as its
+// last sample is processed; the GUI plays the results back from live_history at its own
+// pace. A file ends at its end marker, when samples of the next file appear (the marker
+// was dropped), or when the network is done and the ring is empty.
+DWORD WINAPI dsp_thread_func(LPVOID lpParam) {
+    dsp_thread_running = 1;
+    uint32_t current_seq = 0; // 0 = no file open
+    while (plotting_active) {
+        RingSample sample;
+        if (!sample_ring_pop(&sample_ring, &sample)) {
+            if (!network_thread_running && sample_ring_count(&sample_ring) == 0) break;
+            ring_wait();
+            continue;
+        }
+        if (sample.kind == RING_END_OF_FILE) {
+            if (sample.file_seq == current_seq) { finish_file(); current_seq = 0; }
+            continue;
+        }
+        if (sample.file_seq != current_seq) {
+            if (current_seq != 0) finish_file();
+            begin_file(sample.file_seq);
+            current_seq = sample.file_seq;
+        }
+        process_file_sample(sample.value, sample.step);
     }
+    if (current_seq != 0) finish_file(); // GUI closed mid-file: save what was processed
+    dsp_thread_running = 0;
+    return 0;
+}
 
-    // Return G_SOURCE_REMOVE from this call. If there's no file processing and no new file,
-    // this idle/timeout should not continue to be called. It should only be active if
-    // a file is being processed or newly available.
-    // The previous logic had a g_idle_add that ran constantly. Now, the timeout
-    // gets added only when a file is ready. If it returns here and no timeout is active,
-    // it effectively stops itself.
-    if (data_processing_source_id != 0) {
-        // This case indicates an active timeout that should continue.
-        return G_SOURCE_CONTINUE; 
+// GTK timeout: updates the status with the playback position and what the DSP thread is
+// doing (the plots redraw on the frame clock, see plot_tick_callback())
+gboolean gui_refresh_callback(gpointer user_data) {
+    char view_text[384], processing_text[384];
+    char status_text[800]; // Increased buffer size to prevent truncation
+    unsigned int behind = live_view_newest(&live_history) - live_view.shown;
+    if (live_view.has_file) {
+        double behind_s = behind * (live_view.file.interval_ms > 0 ? live_view.file.interval_ms : 1) / 1000.0;
+        snprintf(view_text, sizeof(view_text), "Showing %s: Sample %u/%d (%s, %.1f s behind)", live_view.file.file_name,
+                 live_view.shown - live_view.file.start, live_view.file.num_samples,
+                 (live_view.mode == LIVE_VIEW_CATCH_UP) ? "catching up" : "real time", behind_s);
+        if (live_view.skipped > 0) {
+            size_t used = strlen(view_text);
+            snprintf(view_text + used, sizeof(view_text) - used, ", %u samples skipped", live_view.skipped);
+        }
+    } else {
+        snprintf(view_text, sizeof(view_text), "Waiting for data...");
+    }
+    EnterCriticalSection(&plot_lock);
+    if (g_file_state.is_processing_file) {
+        snprintf(processing_text, sizeof(processing_text), "Processing %s: Sample %d/%d", g_file_state.current_file_name,
+                 atomic_load_explicit(&current_file_progress, memory_order_relaxed), g_file_state.current_file_num_samples);
     } else {
-        // This means no active processing and no new files, so this GSource can be removed.
+        snprintf(processing_text, sizeof(processing_text), "All received data processed and saved");
+    }
+    LeaveCriticalSection(&plot_lock);
+    snprintf(status_text, sizeof(status_text), "%s  |  %s", view_text, processing_text);
+    gtk_label_set_text(GTK_LABEL(label_status), status_text);
+
+    // Once the network and DSP threads are both done and the playback has shown it all, there is nothing more to show
+    if (!network_thread_running && !dsp_thread_running && behind == 0) {
+        printf("[CLIENT MAIN] No more data from network and queue is empty. Quitting GTK main loop.\n");
+        data_processing_source_id = 0;
+        gtk_main_quit(); // Exits the GTK event loop
         return G_SOURCE_REMOVE;
     }
+    return G_SOURCE_CONTINUE;
 }
 
 
 // Callback for when the main window is closed by the user
 void on_window_destroy(GtkWidget *widget, gpointer data) {
-    plotting_active = 0; // Set flag to stop network and processing threads
-    WakeConditionVariable(&queue_cond); // Wake up network thread in case it's waiting on queue_cond
+    plotting_active = 0; // Set flag to stop network and processing threads (both poll it)
     
     // If there's an active timeout, remove it
     if (data_processing_source_id != 0) {
@@ -1063,13 +1279,24 @@ int main(int argc, char *argv[]) {
 
     // 2. Initialize Windows synchronization primitives
     InitializeCriticalSection(&plot_lock);
-    InitializeCriticalSection(&queue_lock);
-    InitializeConditionVariable(&queue_cond);
+    metrics_start_reporter("client");
 
-    // 3. Initialize circular data buffers
+    // 3. Initialize circular data buffers, the network -> DSP sample ring and the DSP -> GUI history
     init_circular_buffer(&current_raw_buffer, PLOT_BUFFER_SIZE);
     init_circular_buffer(&current_filtered_buffer, PLOT_BUFFER_SIZE);
-    init_circular_buffer(&dsp_raw_adc_buffer, DSP_BUFFER_SIZE);
+    if (sample_ring_init(&sample_ring, SAMPLE_RING_CAPACITY) != 0) {
+        perror("Failed to allocate sample ring");
+        return 1;
+    }
+    if (live_view_init(&live_history) != 0) {
+        perror("Failed to allocate live view history");
+        return 1;
+    }
+    live_view_cursor_init(&live_view, LIVE_VIEW_DEFAULT_MODE, LIVE_VIEW_SPEED);
+    atomic_init(&consumer_file_seq, 0);
+    atomic_init(&current_file_progress, 0);
+    plot_trace_init(&raw_plot.trace, 1.0, 0.0, 0.0);      // Red
+    plot_trace_init(&filtered_plot.trace, 0.0, 0.8, 0.0); // Green for contrast
 
     // 4. Set plotting active flag (signals threads to run)
     plotting_active = 1;
@@ -1102,29 +1329,52 @@ int main(int argc, char *argv[]) {
     gtk_box_pack_start(GTK_BOX(vbox), fft_plot_area, FALSE, FALSE, 0);
     g_signal_connect(fft_plot_area, "draw", G_CALLBACK(draw_fft_plot_callback), NULL);
 
-    // Status label at the bottom
+    // Playback mode, then the status label at the bottom
+    GtkWidget *catch_up_check = gtk_check_button_new_with_label("Catch up (show the newest processed data)");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(catch_up_check), live_view.mode == LIVE_VIEW_CATCH_UP);
+    gtk_box_pack_start(GTK_BOX(vbox), catch_up_check, FALSE, FALSE, 0);
+    g_signal_connect(catch_up_check, "toggled", G_CALLBACK(on_catch_up_toggled), NULL);
+
+    GtkWidget *zoom_combo = gtk_combo_box_text_new();
+    for (int step = 0, span = PLOT_BUFFER_SIZE; step < VIEW_ZOOM_STEPS; ++step, span *= SUMMARY_FACTOR) {
+        char zoom_text[64];
+        snprintf(zoom_text, sizeof(zoom_text), "Show the last %d samples", span);
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(zoom_combo), zoom_text);
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(zoom_combo), 0);
+    gtk_box_pack_start(GTK_BOX(vbox), zoom_combo, FALSE, FALSE, 0);
+    g_signal_connect(zoom_combo, "changed", G_CALLBACK(on_zoom_changed), NULL);
+
     label_status = gtk_label_new("Initializing...");
     gtk_box_pack_start(GTK_BOX(vbox), label_status, FALSE, FALSE, 0);
 
     // 6. Show all created widgets
     gtk_widget_show_all(main_window);
+    gtk_widget_add_tick_callback(main_window, plot_tick_callback, NULL, NULL);
 
     // 7. Start the network thread (runs in background to receive data)
+    // network_thread_running is set here so the DSP thread doesn't see it as already finished
+    network_thread_running = 1;
     HANDLE network_thread_handle;
     network_thread_handle = CreateThread(
         NULL, 0, network_thread_func, NULL, 0, NULL);
     if (network_thread_handle == NULL) {
         fprintf(stderr, "Error creating network thread.\n");
         DeleteCriticalSection(&plot_lock);
-        DeleteCriticalSection(&queue_lock);
         return 1;
     }
 
-    // 8. Add an initial idle callback to *kickstart* the processing.
-    // This idle callback will run once, check if there's data, and if so,
-    // it will set up the first g_timeout_add for processing.
-    // If no data is immediately available, it will remove itself.
-    g_idle_add(process_data_gui_callback, NULL);
+    // 8. Start the DSP thread (turns queued files into plot data) and the GUI refresh timer
+    dsp_thread_running = 1;
+    HANDLE dsp_thread_handle = CreateThread(NULL, 0, dsp_thread_func, NULL, 0, NULL);
+    if (dsp_thread_handle == NULL) {
+        fprintf(stderr, "Error creating DSP thread.\n");
+        plotting_active = 0;
+        WaitForSingleObject(network_thread_handle, INFINITE);
+        DeleteCriticalSection(&plot_lock);
+        return 1;
+    }
+    data_processing_source_id = g_timeout_add(GUI_REFRESH_MS, gui_refresh_callback, NULL);
 
     // 9. Start the GTK main loop
     gtk_main();
@@ -1132,27 +1382,36 @@ int main(int argc, char *argv[]) {
     // 10. Program cleanup (executed after gtk_main() exits, typically on window close)
     printf("[CLIENT] GTK main loop exited. Starting cleanup...\n");
 
-    // Signal network thread one last time in case it's blocked, then wait for it to exit
-    WakeConditionVariable(&queue_cond);
+    // Tell the worker threads to stop (they poll the flag while waiting on the ring), then wait for them to exit
+    plotting_active = 0;
+    WaitForSingleObject(dsp_thread_handle, INFINITE);
+    CloseHandle(dsp_thread_handle);
     WaitForSingleObject(network_thread_handle, INFINITE);
     CloseHandle(network_thread_handle);
 
     // Free all dynamically allocated circular buffer data
     free_circular_buffer(&current_raw_buffer);
     free_circular_buffer(&current_filtered_buffer);
-    free_circular_buffer(&dsp_raw_adc_buffer); 
+    live_view_free(&live_history);
+    LivePlot* plots[] = { &raw_plot, &filtered_plot, &fft_plot };
+    for (int i = 0; i < 3; ++i) {
+        plot_frame_cache_free(&plots[i]->frame);
+        plot_trace_free(&plots[i]->trace);
+    }
+    fft_plan_cache_free(); // The DSP thread has exited, so no plan is in use
+    dsp_arena_free(&file_arena);
+    metrics_stop_reporter();
+    metrics_dump(stderr, "client");
     
-    // Free any remaining data associated with g_file_state (if a file was being processed when GUI closed)
-    free(g_file_state.current_file_raw_adc_values); 
-    free(g_file_state.all_raw_weights_to_save);
-    free(g_file_state.all_filtered_weights_to_save);
-    free(g_file_state.last_fir_coefficients_to_save);
-    free(g_file_state.last_fft_frequencies_to_save);
-    free(g_file_state.last_fft_magnitude_to_save);
+    // Samples still queued when the GUI closed are simply discarded
+    if (atomic_load(&sample_ring.dropped) > 0 || atomic_load(&sample_ring.decimated) > 0) {
+        printf("[CLIENT] Sample ring overflow: %u samples dropped, %u decimated.\n",
+               atomic_load(&sample_ring.dropped), atomic_load(&sample_ring.decimated));
+    }
+    sample_ring_free(&sample_ring);
 
     // Delete Windows synchronization primitives
     DeleteCriticalSection(&plot_lock);
-    DeleteCriticalSection(&queue_lock);
 
     printf("[CLIENT] Exiting client application.\n");
 
@@ -0,0 +1,219 @@
+// Real-input FFT for the client's spectrum plot and adaptive FIR cut-off.
+//
+// An n-point real transform is done as an n/2-point complex radix-2 FFT on the
+// even/odd samples packed as re/im, followed by the usual split step. Everything that
+// depends only on n and the window (bit-reversal table, twiddles, window coefficients)
+// lives in an FftPlan, built once by fft_plan_get() and cached for the rest of the run.
+//
+// A plan owns its scratch buffer, so one plan must not be used by two threads at
+// once. In client.c only the DSP thread computes spectra.
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define FFT_MIN_SIZE 4
+#define FFT_MAX_SIZE 65536
+#define FFT_PLAN_CACHE_SIZE 32 // Distinct (size, window) pairs kept alive
+
+typedef enum {
+    FFT_WINDOW_RECT = 0,
+    FFT_WINDOW_HANN,
+    FFT_WINDOW_HAMMING
+} FftWindowType;
+
+typedef struct {
+    int n;                      // Real input length (power of two)
+    FftWindowType window_type;
+    double* window;             // n window coefficients
+    double window_gain;         // Sum of the window (a sine of amplitude A peaks at A * gain / 2)
+    int* bitrev;                // n/2 bit-reversed indices for the complex stage
+    double* twiddle_re;         // n/2 entries of exp(-2*pi*i*k/n)
+    double* twiddle_im;
+    double* work;               // n doubles: n/2 interleaved complex values
+    double* spectrum;           // n + 2 doubles: re then im of bins 0..n/2
+} FftPlan;
+
+static inline int fft_is_power_of_two(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// Largest power of two <= n (0 if n < 1)
+static inline int fft_floor_power_of_two(int n) {
+    int p = 1;
+    if (n < 1) return 0;
+    while (p <= n / 2) p *= 2;
+    return p;
+}
+
+static inline const char* fft_window_name(FftWindowType window) {
+    return (window == FFT_WINDOW_HANN) ? "hann" : (window == FFT_WINDOW_HAMMING) ? "hamming" : "rect";
+}
+
+static inline void fft_plan_destroy(FftPlan* plan) {
+    if (!plan) return;
+    free(plan->window);
+    free(plan->bitrev);
+    free(plan->twiddle_re);
+    free(plan->twiddle_im);
+    free(plan->work);
+    free(plan->spectrum);
+    free(plan);
+}
+
+// Builds a plan for an n-point real FFT. Returns NULL if n isn't a supported power of two
+// or memory runs out. Most callers want fft_plan_get() instead.
+static inline FftPlan* fft_plan_create(int n, FftWindowType window) {
+    if (!fft_is_power_of_two(n) || n < FFT_MIN_SIZE || n > FFT_MAX_SIZE) return NULL;
+    FftPlan* plan = (FftPlan*)calloc(1, sizeof(FftPlan));
+    if (!plan) return NULL;
+    int half = n / 2;
+    plan->n = n;
+    plan->window_type = window;
+    plan->window = (double*)malloc(sizeof(double) * n);
+    plan->bitrev = (int*)malloc(sizeof(int) * half);
+    plan->twiddle_re = (double*)malloc(sizeof(double) * half);
+    plan->twiddle_im = (double*)malloc(sizeof(double) * half);
+    plan->work = (double*)malloc(sizeof(double) * n);
+    plan->spectrum = (double*)malloc(sizeof(double) * (n + 2));
+    if (!plan->window || !plan->bitrev || !plan->twiddle_re || !plan->twiddle_im || !plan->work || !plan->spectrum) {
+        fft_plan_destroy(plan);
+        return NULL;
+    }
+
+    // Periodic windows (as scipy.signal.get_window uses for spectral analysis)
+    plan->window_gain = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double phase = 2.0 * M_PI * i / n;
+        double w = 1.0;
+        if (window == FFT_WINDOW_HANN) w = 0.5 - 0.5 * cos(phase);
+        else if (window == FFT_WINDOW_HAMMING) w = 0.54 - 0.46 * cos(phase);
+        plan->window[i] = w;
+        plan->window_gain += w;
+    }
+
+    int bits = 0;
+    while ((1 << bits) < half) bits++;
+    for (int i = 0; i < half; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+        plan->bitrev[i] = r;
+    }
+    for (int k = 0; k < half; ++k) {
+        plan->twiddle_re[k] = cos(2.0 * M_PI * k / n);
+        plan->twiddle_im[k] = -sin(2.0 * M_PI * k / n);
+    }
+    return plan;
+}
+
+// The process-wide plan table (slots are filled in order and never evicted)
+static inline FftPlan** fft_plan_cache(void) {
+    static FftPlan* plans[FFT_PLAN_CACHE_SIZE];
+    return plans;
+}
+
+// Returns the cached plan for (n, window), building it on first use. NULL on failure.
+static inline FftPlan* fft_plan_get(int n, FftWindowType window) {
+    FftPlan** plans = fft_plan_cache();
+    int slot = 0;
+    for (; slot < FFT_PLAN_CACHE_SIZE && plans[slot]; ++slot) {
+        if (plans[slot]->n == n && plans[slot]->window_type == window) return plans[slot];
+    }
+    if (slot == FFT_PLAN_CACHE_SIZE) {
+        fprintf(stderr, "FFT plan cache full (%d plans), cannot add %d-point %s plan.\n",
+                FFT_PLAN_CACHE_SIZE, n, fft_window_name(window));
+        return NULL;
+    }
+    plans[slot] = fft_plan_create(n, window);
+    return plans[slot];
+}
+
+// Frees every cached plan (call once no thread is computing spectra any more)
+static inline void fft_plan_cache_free(void) {
+    FftPlan** plans = fft_plan_cache();
+    for (int slot = 0; slot < FFT_PLAN_CACHE_SIZE; ++slot) {
+        fft_plan_destroy(plans[slot]);
+        plans[slot] = NULL;
+    }
+}
+
+// Windowed forward transform of plan->n real samples. Writes bins 0..n/2 (n/2 + 1 values)
+// to re_out / im_out.
+static inline void fft_real_forward(FftPlan* plan, const double* in, double* re_out, double* im_out) {
+    int n = plan->n;
+    int half = n / 2;
+    double* z = plan->work;
+
+    // Pack x[2j] + i*x[2j+1] in bit-reversed order
+    for (int j = 0; j < half; ++j) {
+        int r = plan->bitrev[j];
+        z[2 * r] = in[2 * j] * plan->window[2 * j];
+        z[2 * r + 1] = in[2 * j + 1] * plan->window[2 * j + 1];
+    }
+
+    // Iterative radix-2 complex FFT of length half. The twiddles of a len-point
+    // stage are every (n / len)-th entry of the n-point table.
+    for (int len = 2; len <= half; len *= 2) {
+        int step = n / len;
+        int span = len / 2;
+        for (int start = 0; start < half; start += len) {
+            for (int j = 0; j < span; ++j) {
+                double wr = plan->twiddle_re[j * step];
+                double wi = plan->twiddle_im[j * step];
+                double* a = z + 2 * (start + j);
+                double* b = z + 2 * (start + j + span);
+                double tr = b[0] * wr - b[1] * wi;
+                double ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr; b[1] = a[1] - ti;
+                a[0] += tr;       a[1] += ti;
+            }
+        }
+    }
+
+    // Split: X[k] = E[k] + W^k * O[k], with E/O recovered from Z[k] and conj(Z[half - k])
+    re_out[0] = z[0] + z[1];
+    im_out[0] = 0.0;
+    re_out[half] = z[0] - z[1];
+    im_out[half] = 0.0;
+    for (int k = 1; k < half; ++k) {
+        double zr = z[2 * k], zi = z[2 * k + 1];
+        double cr = z[2 * (half - k)], ci = -z[2 * (half - k) + 1];
+        double er = 0.5 * (zr + cr), ei = 0.5 * (zi + ci);
+        double orr = 0.5 * (zi - ci), oi = -0.5 * (zr - cr); // (Z - conj) / 2i
+        double wr = plan->twiddle_re[k], wi = plan->twiddle_im[k];
+        re_out[k] = er + orr * wr - oi * wi;
+        im_out[k] = ei + orr * wi + oi * wr;
+    }
+}
+
+// Single-sided amplitude spectrum: n/2 bins (0 .. fs/2 exclusive), scaled so a sine of
+// amplitude A reads A at its bin whatever the window. Returns the number of bins written.
+static inline int fft_real_magnitude(FftPlan* plan, const double* in, double* magnitude_out) {
+    int half = plan->n / 2;
+    double* re = plan->spectrum;
+    double* im = plan->spectrum + half + 1;
+    fft_real_forward(plan, in, re, im);
+    double scale = (plan->window_gain > 0.0) ? 2.0 / plan->window_gain : 0.0;
+    magnitude_out[0] = fabs(re[0]) * scale * 0.5; // DC has no mirror image
+    for (int k = 1; k < half; ++k) {
+        magnitude_out[k] = sqrt(re[k] * re[k] + im[k] * im[k]) * scale;
+    }
+    return half;
+}
+
+// Index of the largest bin, ignoring DC; 0 if there are no other bins
+static inline int fft_peak_bin(const double* magnitude, int bins) {
+    int peak = 0;
+    for (int k = 1; k < bins; ++k) {
+        if (peak == 0 || magnitude[k] > magnitude[peak]) peak = k;
+    }
+    return peak;
+}
+
+#endif // FFT_H
@@ -0,0 +1,297 @@
+// Processed-sample history between the GTK client's DSP thread and its live plots.
+//
+// The DSP thread runs every file through the DSP engine as fast as its samples arrive (the
+// saved output is ready as soon as the file has been received) and appends each result
+// here. The GUI plays the history back on its own clock into the small plot buffers:
+//   LIVE_VIEW_REAL_TIME  one sample per sampling interval (times a speed factor), the pace
+//                        the data was recorded at, however far processing has run ahead
+//   LIVE_VIEW_CATCH_UP   the newest processed sample on every frame (fast-forward)
+//
+// Positions count the samples appended since start, across files; a file runs from its
+// start to the next file's start. Raw and filtered values are CircularBuffers of
+// LIVE_VIEW_HISTORY values, spectra and file descriptions rings of slots tagged with their
+// position. One writer, one reader, no lock: the reader copies what it needs and then checks
+// that the writer hasn't lapped it. A view more than LIVE_VIEW_MAX_LAG behind the newest
+// sample skips ahead (the rest of the history is headroom for the writer), counting the
+// positions it jumped over.
+//
+// Zoomed-out views don't come from the history but from raw_summary and filtered_summary,
+// min/max/mean buckets of every 10, 100 and 1000 positions (summary_pyramid.h) kept far
+// longer than the samples. They are published before the samples they end at, so all the
+// buckets before position p / ratio are there once p is.
+#ifndef LIVE_VIEW_H
+#define LIVE_VIEW_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "circular_buffer.h"
+#include "summary_pyramid.h"
+
+#ifndef LIVE_VIEW_HISTORY
+#define LIVE_VIEW_HISTORY 65536         // Processed samples kept for playback; ~22 min at 50 Hz
+#endif
+#ifndef LIVE_VIEW_SPECTRUM_BINS
+#define LIVE_VIEW_SPECTRUM_BINS 128     // Largest spectrum stored (FFT size / 2)
+#endif
+#ifndef LIVE_VIEW_SPECTRUM_SLOTS
+#define LIVE_VIEW_SPECTRUM_SLOTS 2048   // Spectra kept; one per 32 samples covers the whole history
+#endif
+#define LIVE_VIEW_FILE_SLOTS 64         // File descriptions kept
+#define LIVE_VIEW_MAX_LAG (LIVE_VIEW_HISTORY / 4 * 3)
+#define LIVE_VIEW_COPY_CHUNK 256        // Values copied per step into the plot buffers
+
+typedef enum {
+    LIVE_VIEW_REAL_TIME = 0,
+    LIVE_VIEW_CATCH_UP
+} LiveViewMode;
+
+typedef struct {
+    unsigned int position;      // History length when it was computed (it covers the samples before)
+    int len;
+    double frequencies[LIVE_VIEW_SPECTRUM_BINS];
+    double magnitude[LIVE_VIEW_SPECTRUM_BINS];
+} LiveViewSpectrum;
+
+typedef struct {
+    unsigned int start;         // Position of the file's first sample
+    int num_samples;            // As announced (decimation or a lost connection make it shorter)
+    int interval_ms;            // Sampling interval, the real-time pace
+    char file_name[256];
+} LiveViewFile;
+
+typedef struct {
+    CircularBuffer raw;                 // Raw weights
+    CircularBuffer filtered;            // DC-removed FIR output, NaN until primed; appended last, so its
+                                        // `written` is the history length
+    LiveViewSpectrum* spectra;          // LIVE_VIEW_SPECTRUM_SLOTS, in position order
+    atomic_uint spectra_written;
+    LiveViewFile files[LIVE_VIEW_FILE_SLOTS];
+    atomic_uint files_written;
+    SummaryPyramid raw_pyramid;         // Writer only: the open buckets of the summaries
+    SummaryPyramid filtered_pyramid;
+    SummaryHistory raw_summary;         // Every position since start, bucketed
+    SummaryHistory filtered_summary;
+} LiveViewHistory;
+
+// The reader's playback state (GUI thread only)
+typedef struct {
+    LiveViewMode mode;
+    double speed;               // Real-time playback rate factor
+    unsigned int shown;         // Positions fed to the plot buffers: the view ends here
+    double pending;             // Real time: samples due but not shown yet (under one)
+    int has_file;
+    unsigned int file_index;    // files_written index of the file shown
+    LiveViewFile file;          // Its description
+    unsigned int spectrum_index; // Next spectra_written index to look at
+    int spectrum_len;           // Spectrum shown (0 = none yet in this file)
+    double frequencies[LIVE_VIEW_SPECTRUM_BINS];
+    double magnitude[LIVE_VIEW_SPECTRUM_BINS];
+    unsigned int version;       // Bumped whenever the file or the spectrum shown changes
+    unsigned int skipped;       // Positions jumped over after falling LIVE_VIEW_MAX_LAG behind
+} LiveViewCursor;
+
+// Returns 0, or -1 if out of memory
+static inline int live_view_init(LiveViewHistory* history) {
+    memset(history, 0, sizeof(*history));
+    history->spectra = (LiveViewSpectrum*)malloc(sizeof(LiveViewSpectrum) * LIVE_VIEW_SPECTRUM_SLOTS);
+    if (!history->spectra) return -1;
+    init_circular_buffer(&history->raw, LIVE_VIEW_HISTORY);
+    init_circular_buffer(&history->filtered, LIVE_VIEW_HISTORY);
+    atomic_init(&history->spectra_written, 0);
+    atomic_init(&history->files_written, 0);
+    summary_pyramid_reset(&history->raw_pyramid);
+    summary_pyramid_reset(&history->filtered_pyramid);
+    if (summary_history_init(&history->raw_summary) != 0 || summary_history_init(&history->filtered_summary) != 0) return -1;
+    return 0;
+}
+
+static inline void live_view_free(LiveViewHistory* history) {
+    free_circular_buffer(&history->raw);
+    free_circular_buffer(&history->filtered);
+    free(history->spectra);
+    history->spectra = NULL;
+    summary_history_free(&history->raw_summary);
+    summary_history_free(&history->filtered_summary);
+}
+
+// History length: positions before this one can be shown
+static inline unsigned int live_view_newest(LiveViewHistory* history) {
+    return atomic_load_explicit(&history->filtered.written, memory_order_acquire);
+}
+
+// Writer: the samples appended from now on belong to this file
+static inline void live_view_begin_file(LiveViewHistory* history, const char* file_name, int num_samples, int interval_ms) {
+    unsigned int index = atomic_load_explicit(&history->files_written, memory_order_relaxed);
+    LiveViewFile* file = &history->files[index % LIVE_VIEW_FILE_SLOTS];
+    file->start = atomic_load_explicit(&history->filtered.written, memory_order_relaxed);
+    file->num_samples = num_samples;
+    file->interval_ms = interval_ms;
+    strncpy(file->file_name, file_name, sizeof(file->file_name) - 1);
+    file->file_name[sizeof(file->file_name) - 1] = '\0';
+    atomic_store_explicit(&history->files_written, index + 1, memory_order_release);
+}
+
+// Writer
+static inline void live_view_push(LiveViewHistory* history, double raw_weight, double filtered) {
+    int mask = summary_pyramid_push(&history->raw_pyramid, raw_weight);
+    summary_pyramid_push(&history->filtered_pyramid, filtered); // Same buckets: both see every position
+    if (mask) {
+        summary_history_push(&history->raw_summary, &history->raw_pyramid, mask);
+        summary_history_push(&history->filtered_summary, &history->filtered_pyramid, mask);
+    }
+    append_circular_buffer(&history->raw, raw_weight);
+    append_circular_buffer(&history->filtered, filtered);
+}
+
+// Writer: a spectrum of the samples pushed so far (len is clamped to LIVE_VIEW_SPECTRUM_BINS)
+static inline void live_view_push_spectrum(LiveViewHistory* history, const double* frequencies, const double* magnitude, int len) {
+    if (len > LIVE_VIEW_SPECTRUM_BINS) len = LIVE_VIEW_SPECTRUM_BINS;
+    unsigned int index = atomic_load_explicit(&history->spectra_written, memory_order_relaxed);
+    LiveViewSpectrum* spectrum = &history->spectra[index % LIVE_VIEW_SPECTRUM_SLOTS];
+    spectrum->position = atomic_load_explicit(&history->filtered.written, memory_order_relaxed);
+    spectrum->len = len;
+    memcpy(spectrum->frequencies, frequencies, sizeof(double) * len);
+    memcpy(spectrum->magnitude, magnitude, sizeof(double) * len);
+    atomic_store_explicit(&history->spectra_written, index + 1, memory_order_release);
+}
+
+static inline void live_view_cursor_init(LiveViewCursor* cursor, LiveViewMode mode, double speed) {
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->mode = mode;
+    cursor->speed = speed;
+}
+
+// Reader: copies file description `index` (published) into out. Returns 0 if the writer has reused its slot.
+static inline int live_view_read_file(LiveViewHistory* history, unsigned int index, LiveViewFile* out) {
+    *out = history->files[index % LIVE_VIEW_FILE_SLOTS];
+    return atomic_load_explicit(&history->files_written, memory_order_acquire) - index < LIVE_VIEW_FILE_SLOTS;
+}
+
+// Reader: makes the cursor's file the one holding position `position` (which is published),
+// emptying the plot buffers when it changes. Returns 1 and the next file's start in
+// *next_start if a later file has been published.
+static inline int live_view_sync_file(LiveViewHistory* history, LiveViewCursor* cursor, unsigned int position,
+                                      CircularBuffer* raw_out, CircularBuffer* filtered_out, unsigned int* next_start) {
+    unsigned int written = atomic_load_explicit(&history->files_written, memory_order_acquire);
+    unsigned int oldest = (written > LIVE_VIEW_FILE_SLOTS - 1) ? written - (LIVE_VIEW_FILE_SLOTS - 1) : 0;
+    unsigned int index = cursor->has_file ? cursor->file_index : oldest;
+    if (written - index > written - oldest) index = oldest; // Its slot was reused: resume at the oldest kept
+    LiveViewFile file, next;
+    if (!live_view_read_file(history, index, &file)) return 0;
+    while (index + 1 != written && live_view_read_file(history, index + 1, &next) &&
+           (int)(position - next.start) >= 0) {
+        index++;
+        file = next;
+    }
+    if (!cursor->has_file || index != cursor->file_index) {
+        cursor->has_file = 1;
+        cursor->file_index = index;
+        cursor->file = file;
+        cursor->spectrum_len = 0;
+        cursor->version++;
+        reset_circular_buffer(raw_out);
+        reset_circular_buffer(filtered_out);
+    }
+    if (index + 1 != written && live_view_read_file(history, index + 1, &next)) {
+        *next_start = next.start;
+        return 1;
+    }
+    return 0;
+}
+
+// Reader: appends positions [from, to) of one file to the plot buffers. Only the values the
+// buffers can show are copied. Returns 0 if the writer had already overwritten them.
+static inline int live_view_feed(LiveViewHistory* history, unsigned int from, unsigned int to,
+                                 CircularBuffer* raw_out, CircularBuffer* filtered_out) {
+    if (to - from > (unsigned int)raw_out->max_size) from = to - (unsigned int)raw_out->max_size;
+    double raw[LIVE_VIEW_COPY_CHUNK], filtered[LIVE_VIEW_COPY_CHUNK];
+    while (from != to) {
+        int n = (to - from < LIVE_VIEW_COPY_CHUNK) ? (int)(to - from) : LIVE_VIEW_COPY_CHUNK;
+        if (!circular_buffer_read(&history->raw, from, n, raw) ||
+            !circular_buffer_read(&history->filtered, from, n, filtered)) {
+            return 0;
+        }
+        append_circular_buffer_n(raw_out, raw, n);
+        append_circular_buffer_n(filtered_out, filtered, n);
+        from += (unsigned int)n;
+    }
+    return 1;
+}
+
+// Reader: shows the newest spectrum computed within the file shown, up to the cursor
+static inline void live_view_sync_spectrum(LiveViewHistory* history, LiveViewCursor* cursor) {
+    unsigned int written = atomic_load_explicit(&history->spectra_written, memory_order_acquire);
+    if (written - cursor->spectrum_index > LIVE_VIEW_SPECTRUM_SLOTS - 1) {
+        cursor->spectrum_index = written - (LIVE_VIEW_SPECTRUM_SLOTS - 1);
+    }
+    int found = 0;
+    unsigned int latest = 0;
+    while (cursor->spectrum_index != written) {
+        unsigned int position = history->spectra[cursor->spectrum_index % LIVE_VIEW_SPECTRUM_SLOTS].position;
+        if ((int)(position - cursor->shown) > 0) break; // Not reached yet
+        found = (int)(position - cursor->file.start) > 0; // Else from an earlier file
+        latest = cursor->spectrum_index++;
+    }
+    if (!found || !cursor->has_file) return;
+    const LiveViewSpectrum* spectrum = &history->spectra[latest % LIVE_VIEW_SPECTRUM_SLOTS];
+    int len = spectrum->len;
+    if (len < 0 || len > LIVE_VIEW_SPECTRUM_BINS) return;
+    memcpy(cursor->frequencies, spectrum->frequencies, sizeof(double) * len);
+    memcpy(cursor->magnitude, spectrum->magnitude, sizeof(double) * len);
+    if (atomic_load_explicit(&history->spectra_written, memory_order_acquire) - latest > LIVE_VIEW_SPECTRUM_SLOTS - 1) return;
+    cursor->spectrum_len = len;
+    cursor->version++;
+}
+
+// Reader: moves the view on by elapsed_s of wall time (real time) or to the newest sample
+// (catch up), feeding the newly shown values to the plot buffers
+static inline void live_view_advance(LiveViewHistory* history, LiveViewCursor* cursor, double elapsed_s,
+                                     CircularBuffer* raw_out, CircularBuffer* filtered_out) {
+    unsigned int newest = live_view_newest(history);
+    if (newest - cursor->shown > LIVE_VIEW_MAX_LAG) { // The history has moved on: skip to what is still kept
+        cursor->skipped += newest - LIVE_VIEW_MAX_LAG - cursor->shown;
+        cursor->shown = newest - LIVE_VIEW_MAX_LAG;
+        cursor->pending = 0.0;
+        reset_circular_buffer(raw_out); // The plots restart at the new position, without a join
+        reset_circular_buffer(filtered_out);
+    }
+    if (cursor->shown == newest) {
+        cursor->pending = 0.0; // Waiting for data doesn't bank playback time
+        return;
+    }
+
+    unsigned int target = newest;
+    unsigned int next_start = 0;
+    int has_next = live_view_sync_file(history, cursor, cursor->shown, raw_out, filtered_out, &next_start);
+    if (cursor->mode == LIVE_VIEW_REAL_TIME) {
+        // Paced by the file shown; the rest of a frame that crosses into the next file keeps this pace
+        double rate_hz = (cursor->file.interval_ms > 0) ? 1000.0 / cursor->file.interval_ms : 1.0;
+        cursor->pending += elapsed_s * cursor->speed * rate_hz;
+        if (cursor->pending >= (double)(newest - cursor->shown)) {
+            cursor->pending = 0.0;
+        } else {
+            target = cursor->shown + (unsigned int)cursor->pending;
+            cursor->pending -= (unsigned int)cursor->pending;
+        }
+    } else {
+        cursor->pending = 0.0;
+    }
+
+    while (cursor->shown != target) {
+        unsigned int end = (has_next && next_start - cursor->shown < target - cursor->shown) ? next_start : target;
+        if (!live_view_feed(history, cursor->shown, end, raw_out, filtered_out)) {
+            cursor->skipped += end - cursor->shown; // Overwritten while copying: leave them out
+            reset_circular_buffer(raw_out);
+            reset_circular_buffer(filtered_out);
+        }
+        cursor->shown = end;
+        if (cursor->shown != target) {
+            has_next = live_view_sync_file(history, cursor, cursor->shown, raw_out, filtered_out, &next_start);
+        }
+    }
+    live_view_sync_spectrum(history, cursor);
+}
+
+#endif // LIVE_VIEW_H
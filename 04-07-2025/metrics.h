@@ -0,0 +1,399 @@
+// Built-in hot-path metrics for the servers and clients: per-stage timers, latency
+// histograms and queue-depth gauges, plus level-gated logging.
+//
+// Every thread records into its own MetricsThread block, claimed from a fixed pool on its
+// first record, so recording is a few relaxed loads and stores on cache lines no other
+// thread writes: no lock and no atomic read-modify-write. metrics_dump() sums the blocks
+// while they are being written, which is close enough for statistics. A thread that ends
+// calls metrics_thread_exit(): its counts move into a retired total and the block goes
+// back to the pool, so a server with a thread per client keeps measuring. Threads beyond
+// METRICS_MAX_THREADS running at once are not recorded (the dump counts their records as lost).
+//
+// Values go into log-linear buckets, four per power of two (each at most 25% wide), so
+// percentiles from nanoseconds to hours come out within a bucket. Each stage also keeps
+// its count, total, max and an item count (bytes or samples), which turns the per-call
+// times into ns per byte or per sample.
+//
+// metrics_start_reporter() dumps to stderr every METRICS_DUMP_MS from a background
+// thread, skipping intervals in which nothing was recorded. -DMETRICS_ENABLED=0 compiles
+// the recording out.
+//
+// LOG_VERBOSE() is for the per-file and per-chunk messages. It compiles to nothing unless
+// LOG_LEVEL is LOG_LEVEL_VERBOSE (build with -DLOG_LEVEL=2), so the hot paths don't pay
+// for console output nobody reads.
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>  // For QueryPerformanceCounter, CreateThread
+#else
+#include <time.h>     // For clock_gettime, nanosleep
+#include <pthread.h>
+#endif
+
+#ifndef METRICS_ENABLED
+#define METRICS_ENABLED 1
+#endif
+#ifndef METRICS_DUMP_MS
+#define METRICS_DUMP_MS 10000       // Periodic dump interval of metrics_start_reporter()
+#endif
+#define METRICS_MAX_THREADS 16
+#define METRICS_BUCKETS 256         // Four per power of two covers all of uint64_t
+
+#define LOG_LEVEL_ERROR 0           // Errors only (they go to stderr regardless)
+#define LOG_LEVEL_INFO 1            // Connections, sessions and summaries
+#define LOG_LEVEL_VERBOSE 2         // Every file and chunk as it goes by
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#define LOG_INFO(...) do { if (LOG_LEVEL >= LOG_LEVEL_INFO) printf(__VA_ARGS__); } while (0)
+#define LOG_VERBOSE(...) do { if (LOG_LEVEL >= LOG_LEVEL_VERBOSE) printf(__VA_ARGS__); } while (0)
+
+typedef enum {
+    METRIC_SEND = 0,            // One send of a buffer; items = bytes
+    METRIC_RECV_WAIT,           // Time blocked in recv(); items = bytes
+    METRIC_PARSE,               // Text or frames to ADC counts; items = samples
+    METRIC_FIR,                 // FIR filtering; items = samples
+    METRIC_FFT,                 // One spectrum
+    METRIC_PLOT_FRAME,          // One plot redraw
+    METRIC_WRITE,               // Writing results; items = samples
+    METRIC_QUEUE_DEPTH,         // Gauge: entries queued between two threads
+    METRIC_STAGE_COUNT
+} MetricStage;
+
+typedef struct {
+    const char *name;
+    const char *item;           // Unit of the item count, NULL if per-item figures make no sense
+    int is_time;                // Values are nanoseconds (else plain numbers)
+} MetricStageInfo;
+
+static const MetricStageInfo metric_stage_info[METRIC_STAGE_COUNT] = {
+    { "send", "byte", 1 },
+    { "recv wait", "byte", 1 },
+    { "parse", "sample", 1 },
+    { "fir", "sample", 1 },
+    { "fft", NULL, 1 },
+    { "plot frame", NULL, 1 },
+    { "write", "sample", 1 },
+    { "queue depth", NULL, 0 },
+};
+
+typedef struct {
+    atomic_ullong count;
+    atomic_ullong total;
+    atomic_ullong items;
+    atomic_ullong max;
+    atomic_ullong buckets[METRICS_BUCKETS];
+} MetricStageStats;
+
+typedef struct {
+    _Alignas(64) MetricStageStats stages[METRIC_STAGE_COUNT];
+} MetricsThread;
+
+static MetricsThread metrics_threads[METRICS_MAX_THREADS];
+static atomic_int metrics_block_used[METRICS_MAX_THREADS]; // 1 while a thread records into the block
+static MetricsThread metrics_retired;           // Counts of the threads that have ended
+static atomic_flag metrics_retired_lock = ATOMIC_FLAG_INIT; // Held to fold a block into metrics_retired, and to sum them
+static atomic_int metrics_thread_count;         // Threads recording now
+static atomic_int metrics_threads_lost;         // Threads that found every block taken
+__attribute__((unused)) static atomic_ullong metrics_lost;             // Records from threads without a block
+static _Thread_local MetricsThread *metrics_self;
+static _Thread_local int metrics_self_claimed;   // Tried to claim (NULL metrics_self = pool was full)
+
+static inline uint64_t metrics_now_ns(void) {
+#ifdef _WIN32
+    static LONGLONG freq = 0;
+    LARGE_INTEGER now;
+    if (freq == 0) {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        freq = f.QuadPart;
+    }
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / freq) * 1000000000ull + (uint64_t)(now.QuadPart % freq) * 1000000000ull / (uint64_t)freq;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Bucket of a value: 0..3 exactly, then four per power of two
+static inline int metrics_bucket(uint64_t value) {
+    if (value < 4) return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    return (msb - 1) * 4 + (int)((value >> (msb - 2)) & 3);
+}
+
+// Smallest value in a bucket
+static inline uint64_t metrics_bucket_low(int bucket) {
+    if (bucket < 4) return (uint64_t)bucket;
+    int msb = bucket / 4 + 1;
+    return (uint64_t)(4 + bucket % 4) << (msb - 2);
+}
+
+static inline MetricsThread *metrics_thread(void) {
+    if (!metrics_self_claimed) {
+        metrics_self_claimed = 1;
+        for (int i = 0; i < METRICS_MAX_THREADS && metrics_self == NULL; i++) {
+            int unused = 0;
+            if (atomic_compare_exchange_strong_explicit(&metrics_block_used[i], &unused, 1, memory_order_acquire,
+                                                        memory_order_relaxed)) {
+                metrics_self = &metrics_threads[i];
+            }
+        }
+        atomic_fetch_add_explicit(metrics_self ? &metrics_thread_count : &metrics_threads_lost, 1, memory_order_relaxed);
+    }
+    return metrics_self;
+}
+
+// Single writer per block: a plain load and store, no locked instruction
+static inline void metrics_add(atomic_ullong *counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline void metrics_retired_acquire(void) {
+    while (atomic_flag_test_and_set_explicit(&metrics_retired_lock, memory_order_acquire)) {
+    }
+}
+
+static inline void metrics_retired_release(void) {
+    atomic_flag_clear_explicit(&metrics_retired_lock, memory_order_release);
+}
+
+// Adds one stage's counts into out (out has a single writer)
+static inline void metrics_stage_add(MetricStageStats *out, const MetricStageStats *s) {
+    metrics_add(&out->count, atomic_load_explicit(&s->count, memory_order_relaxed));
+    metrics_add(&out->total, atomic_load_explicit(&s->total, memory_order_relaxed));
+    metrics_add(&out->items, atomic_load_explicit(&s->items, memory_order_relaxed));
+    uint64_t max = atomic_load_explicit(&s->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&out->max, memory_order_relaxed)) atomic_store_explicit(&out->max, max, memory_order_relaxed);
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        metrics_add(&out->buckets[b], atomic_load_explicit(&s->buckets[b], memory_order_relaxed));
+    }
+}
+
+// Call at the end of a thread that may have recorded (a thread per client or per session):
+// its counts join the retired total and its block is free for the next thread to claim.
+static inline void metrics_thread_exit(void) {
+#if METRICS_ENABLED
+    MetricsThread *self = metrics_self;
+    metrics_self = NULL;
+    metrics_self_claimed = 0;
+    if (self == NULL) return;
+    metrics_retired_acquire();
+    for (int stage = 0; stage < METRIC_STAGE_COUNT; stage++) {
+        metrics_stage_add(&metrics_retired.stages[stage], &self->stages[stage]);
+    }
+    memset(self, 0, sizeof(*self)); // Under the lock, so a dump never counts the block twice
+    metrics_retired_release();
+    atomic_fetch_sub_explicit(&metrics_thread_count, 1, memory_order_relaxed);
+    atomic_store_explicit(&metrics_block_used[self - metrics_threads], 0, memory_order_release);
+#endif
+}
+
+// Records one value (ns for timed stages) covering `items` bytes or samples
+static inline void metrics_record(MetricStage stage, uint64_t value, uint64_t items) {
+#if METRICS_ENABLED
+    MetricsThread *self = metrics_thread();
+    if (self == NULL) {
+        atomic_fetch_add_explicit(&metrics_lost, 1, memory_order_relaxed);
+        return;
+    }
+    MetricStageStats *s = &self->stages[stage];
+    metrics_add(&s->count, 1);
+    metrics_add(&s->total, value);
+    metrics_add(&s->items, items);
+    metrics_add(&s->buckets[metrics_bucket(value)], 1);
+    if (value > atomic_load_explicit(&s->max, memory_order_relaxed)) {
+        atomic_store_explicit(&s->max, value, memory_order_relaxed);
+    }
+#else
+    (void)stage, (void)value, (void)items;
+#endif
+}
+
+// Start of a timed section (0 when compiled out)
+static inline uint64_t metrics_begin(void) {
+#if METRICS_ENABLED
+    return metrics_now_ns();
+#else
+    return 0;
+#endif
+}
+
+// Records the time since `begin` and returns now, so sections can be chained
+static inline uint64_t metrics_end(MetricStage stage, uint64_t begin, uint64_t items) {
+#if METRICS_ENABLED
+    uint64_t now = metrics_now_ns();
+    metrics_record(stage, now - begin, items);
+    return now;
+#else
+    (void)stage, (void)begin, (void)items;
+    return 0;
+#endif
+}
+
+// Sum of one stage over every thread, the ended ones included
+static inline void metrics_collect(MetricStage stage, MetricStageStats *out) {
+    memset(out, 0, sizeof(*out));
+    metrics_retired_acquire();
+    metrics_stage_add(out, &metrics_retired.stages[stage]);
+    for (int t = 0; t < METRICS_MAX_THREADS; t++) {
+        metrics_stage_add(out, &metrics_threads[t].stages[stage]);
+    }
+    metrics_retired_release();
+}
+
+// Value below which `fraction` of the records fall (middle of its bucket, at most the max)
+static inline double metrics_percentile(MetricStageStats *s, double fraction) {
+    uint64_t count = atomic_load_explicit(&s->count, memory_order_relaxed);
+    uint64_t rank = (uint64_t)(fraction * count), seen = 0;
+    double max = (double)atomic_load_explicit(&s->max, memory_order_relaxed);
+    for (int b = 0; b < METRICS_BUCKETS; b++) {
+        seen += atomic_load_explicit(&s->buckets[b], memory_order_relaxed);
+        if (seen > rank) {
+            double low = (double)metrics_bucket_low(b);
+            double high = (b + 1 < METRICS_BUCKETS) ? (double)metrics_bucket_low(b + 1) : low;
+            double mid = (b < 4) ? low : (low + high) / 2.0;
+            return (mid < max) ? mid : max;
+        }
+    }
+    return max;
+}
+
+// "850 ns", "12.3 us", "4.56 ms" or "1.23 s" for time stages, the plain number otherwise
+static inline void metrics_format_value(char *out, size_t out_size, double value, int is_time) {
+    if (!is_time) snprintf(out, out_size, "%.1f", value);
+    else if (value < 1e3) snprintf(out, out_size, "%.0f ns", value);
+    else if (value < 1e6) snprintf(out, out_size, "%.1f us", value / 1e3);
+    else if (value < 1e9) snprintf(out, out_size, "%.2f ms", value / 1e6);
+    else snprintf(out, out_size, "%.2f s", value / 1e9);
+}
+
+// Total of all counts, to tell whether anything was recorded since the last dump
+static inline uint64_t metrics_total_count(void) {
+    uint64_t total = 0;
+    metrics_retired_acquire();
+    for (int s = 0; s < METRIC_STAGE_COUNT; s++) {
+        total += atomic_load_explicit(&metrics_retired.stages[s].count, memory_order_relaxed);
+        for (int t = 0; t < METRICS_MAX_THREADS; t++) {
+            total += atomic_load_explicit(&metrics_threads[t].stages[s].count, memory_order_relaxed);
+        }
+    }
+    metrics_retired_release();
+    return total;
+}
+
+// One line per stage that has records: count, mean, p50/p90/p99, max and per-item time,
+// all since start
+static inline void metrics_dump(FILE *out, const char *title) {
+#if METRICS_ENABLED
+    int threads = atomic_load_explicit(&metrics_thread_count, memory_order_relaxed);
+    int lost_threads = atomic_load_explicit(&metrics_threads_lost, memory_order_relaxed);
+    fprintf(out, "[METRICS] %s (%d thread%s recording", title, threads, (threads == 1) ? "" : "s");
+    if (lost_threads > 0) {
+        fprintf(out, ", %llu records lost from %d more", (unsigned long long)atomic_load(&metrics_lost), lost_threads);
+    }
+    fprintf(out, ")\n  %-12s %10s %10s %10s %10s %10s %10s  %s\n", "stage", "count", "mean", "p50", "p90", "p99", "max", "per item");
+    MetricStageStats sum;
+    for (int stage = 0; stage < METRIC_STAGE_COUNT; stage++) {
+        metrics_collect((MetricStage)stage, &sum);
+        uint64_t count = atomic_load_explicit(&sum.count, memory_order_relaxed);
+        if (count == 0) continue;
+        const MetricStageInfo *info = &metric_stage_info[stage];
+        double total = (double)atomic_load_explicit(&sum.total, memory_order_relaxed);
+        double values[5] = { total / count, metrics_percentile(&sum, 0.50), metrics_percentile(&sum, 0.90),
+                             metrics_percentile(&sum, 0.99), (double)atomic_load_explicit(&sum.max, memory_order_relaxed) };
+        char text[5][24];
+        for (int i = 0; i < 5; i++) metrics_format_value(text[i], sizeof(text[i]), values[i], info->is_time);
+        fprintf(out, "  %-12s %10llu %10s %10s %10s %10s %10s", info->name, (unsigned long long)count,
+                text[0], text[1], text[2], text[3], text[4]);
+        uint64_t items = atomic_load_explicit(&sum.items, memory_order_relaxed);
+        if (info->item != NULL && items > 0) {
+            fprintf(out, "  %.2f ns/%s (%llu %ss)", total / items, info->item, (unsigned long long)items, info->item);
+        }
+        fprintf(out, "\n");
+    }
+    fflush(out);
+#else
+    (void)out, (void)title;
+#endif
+}
+
+static volatile int metrics_reporter_running = 0;
+static const char *metrics_reporter_title = "";
+#ifdef _WIN32
+static HANDLE metrics_reporter_thread = NULL;
+#else
+static pthread_t metrics_reporter_thread;
+#endif
+
+#ifdef _WIN32
+__attribute__((unused)) static DWORD WINAPI metrics_reporter_func(LPVOID arg) {
+#else
+__attribute__((unused)) static void *metrics_reporter_func(void *arg) {
+#endif
+    (void)arg;
+    uint64_t last_total = 0;
+    while (metrics_reporter_running) {
+        for (int slept = 0; slept < METRICS_DUMP_MS && metrics_reporter_running; slept += 100) { // Stops within 100 ms
+#ifdef _WIN32
+            Sleep(100);
+#else
+            struct timespec ts = { 0, 100 * 1000000L };
+            nanosleep(&ts, NULL);
+#endif
+        }
+        uint64_t total = metrics_total_count();
+        if (metrics_reporter_running && total != last_total) {
+            metrics_dump(stderr, metrics_reporter_title);
+            last_total = total;
+        }
+    }
+    return 0;
+}
+
+// Dumps every METRICS_DUMP_MS while anything is being recorded. Returns 0, or -1 if the
+// thread couldn't be started (or metrics are compiled out).
+static inline int metrics_start_reporter(const char *title) {
+#if METRICS_ENABLED && METRICS_DUMP_MS > 0
+    metrics_reporter_title = title;
+    metrics_reporter_running = 1;
+#ifdef _WIN32
+    metrics_reporter_thread = CreateThread(NULL, 0, metrics_reporter_func, NULL, 0, NULL);
+    if (metrics_reporter_thread == NULL) {
+        metrics_reporter_running = 0;
+        return -1;
+    }
+#else
+    if (pthread_create(&metrics_reporter_thread, NULL, metrics_reporter_func, NULL) != 0) {
+        metrics_reporter_running = 0;
+        return -1;
+    }
+#endif
+    return 0;
+#else
+    (void)title;
+    return -1;
+#endif
+}
+
+static inline void metrics_stop_reporter(void) {
+    if (!metrics_reporter_running) return;
+    metrics_reporter_running = 0;
+#ifdef _WIN32
+    WaitForSingleObject(metrics_reporter_thread, INFINITE);
+    CloseHandle(metrics_reporter_thread);
+    metrics_reporter_thread = NULL;
+#else
+    pthread_join(metrics_reporter_thread, NULL);
+#endif
+}
+
+#endif // METRICS_H
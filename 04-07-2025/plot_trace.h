@@ -0,0 +1,222 @@
+// Cached, incrementally drawn layers for the GTK client's live plots.
+//
+// PlotFrameCache keeps a plot's background, grid, axes and labels in an offscreen surface
+// that is only redrawn when its size, axis ranges or title change. plot_range_fit() keeps
+// the y range stable (it refits only when data leaves the range, or fills less than
+// PLOT_RANGE_SHRINK of it), so the cached frame survives from one redraw to the next.
+//
+// PlotTrace keeps the polyline of a CircularBuffer's newest values in a transparent
+// surface the size of the plot area. Value g (counted from the buffer's last reset) sits
+// in pixel column floor(g * px_per_value): columns are tied to the values, not the window,
+// so when the window scrolls the surface is shifted by whole columns and only the values
+// appended since the previous redraw are drawn, at the right. Values sharing a column are
+// drawn as one first/min/max/last run, so a redraw costs about one segment per new
+// column however many values arrived. Everything is redrawn only when the size, y range
+// or file changes.
+#ifndef PLOT_TRACE_H
+#define PLOT_TRACE_H
+
+#include <math.h>
+#include <string.h>
+#include <cairo.h>
+
+#include "circular_buffer.h"
+
+#define PLOT_RANGE_SHRINK 0.5 // Refit the y axis once the data spans less than this share of it
+
+typedef struct {
+    cairo_surface_t* surface;
+    int width, height;
+    double x_max, y_min, y_max;
+    char title[300];
+} PlotFrameCache;
+
+typedef struct {
+    cairo_surface_t* surface;   // The polyline, plot area sized, transparent elsewhere
+    cairo_surface_t* scratch;   // Same size; target of the scroll, then swapped in
+    int width, height;
+    double y_min, y_max;
+    unsigned int start;         // Buffer reset mark the surface was drawn for
+    unsigned int first;         // Oldest value shown (buffer index) at the last redraw
+    unsigned int drawn_end;     // Values before this buffer index are on the surface
+    double red, green, blue;
+} PlotTrace;
+
+// Fits [*lo, *hi] to data in [data_lo, data_hi] with `padding` (share of the span) on each
+// side, or around zero if symmetric. Keeps the current range while it still suits the data.
+// A flat or empty series gets +-0.1 around its value. Returns 1 if the range changed.
+static inline int plot_range_fit(double* lo, double* hi, double data_lo, double data_hi, double padding, int symmetric) {
+    if (isnan(data_lo) || isnan(data_hi)) { data_lo = 0.0; data_hi = 0.0; }
+    if (symmetric) {
+        double m = fmax(fabs(data_lo), fabs(data_hi));
+        data_lo = -m;
+        data_hi = m;
+    }
+    double span = data_hi - data_lo;
+    int contained = (*hi > *lo && data_lo >= *lo && data_hi <= *hi);
+    int filled = (span > 1e-9) ? span >= PLOT_RANGE_SHRINK * (*hi - *lo) : *hi - *lo <= 0.2 + 1e-9;
+    if (contained && filled) {
+        return 0;
+    }
+    if (span > 1e-9) {
+        double pad = symmetric ? data_hi * padding : span * padding;
+        *lo = data_lo - pad;
+        *hi = data_hi + pad;
+    } else {
+        *lo = data_lo - 0.1;
+        *hi = data_hi + 0.1;
+    }
+    return 1;
+}
+
+// Smallest and largest non-NaN value of a view (both NAN if there are none)
+static inline void plot_view_extent(const CircularBufferView* view, double* lo, double* hi) {
+    *lo = NAN;
+    *hi = NAN;
+    for (int i = 0; i < view->count; ++i) {
+        double v = circular_buffer_view_at(view, i);
+        if (isnan(v)) continue;
+        if (isnan(*lo) || v < *lo) *lo = v;
+        if (isnan(*hi) || v > *hi) *hi = v;
+    }
+}
+
+// 1 if the frame must be redrawn for this size, range and title (the surface is then ready
+// and the key stored); 0 if cache->surface can be painted as it is.
+static inline int plot_frame_cache_stale(PlotFrameCache* cache, cairo_t* target, int width, int height,
+                                         double x_max, double y_min, double y_max, const char* title) {
+    if (cache->surface && cache->width == width && cache->height == height && cache->x_max == x_max &&
+        cache->y_min == y_min && cache->y_max == y_max && strcmp(cache->title, title) == 0) {
+        return 0;
+    }
+    if (!cache->surface || cache->width != width || cache->height != height) {
+        if (cache->surface) cairo_surface_destroy(cache->surface);
+        cache->surface = cairo_surface_create_similar(cairo_get_target(target), CAIRO_CONTENT_COLOR, width, height);
+        cache->width = width;
+        cache->height = height;
+    }
+    cache->x_max = x_max;
+    cache->y_min = y_min;
+    cache->y_max = y_max;
+    strncpy(cache->title, title, sizeof(cache->title) - 1);
+    cache->title[sizeof(cache->title) - 1] = '\0';
+    return 1;
+}
+
+static inline void plot_frame_cache_free(PlotFrameCache* cache) {
+    if (cache->surface) cairo_surface_destroy(cache->surface);
+    memset(cache, 0, sizeof(*cache));
+}
+
+static inline void plot_trace_init(PlotTrace* trace, double red, double green, double blue) {
+    memset(trace, 0, sizeof(*trace));
+    trace->red = red;
+    trace->green = green;
+    trace->blue = blue;
+}
+
+static inline void plot_trace_free(PlotTrace* trace) {
+    if (trace->surface) cairo_surface_destroy(trace->surface);
+    if (trace->scratch) cairo_surface_destroy(trace->scratch);
+    trace->surface = trace->scratch = NULL;
+}
+
+// Pixel column of value `index` (values since the reset) on a surface whose left edge is value `first`
+static inline int plot_trace_column(double px_per_value, unsigned int index, unsigned int first) {
+    return (int)floor(index * px_per_value) - (int)floor(first * px_per_value);
+}
+
+// Strokes values [from, to) of the view (buffer indices; the view starts at `first`)
+static inline void plot_trace_draw_values(PlotTrace* trace, const CircularBufferView* view, unsigned int start,
+                                          unsigned int first, unsigned int from, unsigned int to, double px_per_value) {
+    cairo_t* cr = cairo_create(trace->surface);
+    cairo_set_source_rgb(cr, trace->red, trace->green, trace->blue);
+    cairo_set_line_width(cr, 1.5);
+    cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+    const double y_scale = trace->height / (trace->y_max - trace->y_min);
+    int pen = 0;            // The path has a current point
+    int column = -1;        // Column being gathered, with its first/min/max/last value
+    double c_first = 0, c_min = 0, c_max = 0, c_last = 0;
+    for (unsigned int g = from; g <= to; ++g) {
+        double v = (g < to) ? circular_buffer_view_at(view, (int)(g - first)) : NAN;
+        int c = (g < to) ? plot_trace_column(px_per_value, g - start, first - start) : -1;
+        if (column >= 0 && (isnan(v) || c != column)) { // Flush the finished column
+            double x = column + 0.5;
+            if (pen) cairo_line_to(cr, x, (trace->y_max - c_first) * y_scale);
+            else cairo_move_to(cr, x, (trace->y_max - c_first) * y_scale);
+            if (c_min < c_max) {
+                cairo_line_to(cr, x, (trace->y_max - c_min) * y_scale);
+                cairo_line_to(cr, x, (trace->y_max - c_max) * y_scale);
+            }
+            cairo_line_to(cr, x, (trace->y_max - c_last) * y_scale);
+            pen = 1;
+            column = -1;
+        }
+        if (isnan(v)) { pen = 0; continue; } // A gap (e.g. the FIR not primed yet) breaks the line
+        if (column < 0) {
+            column = c;
+            c_first = c_min = c_max = v;
+        }
+        if (v < c_min) c_min = v;
+        if (v > c_max) c_max = v;
+        c_last = v;
+    }
+    cairo_stroke(cr);
+    cairo_destroy(cr);
+}
+
+// Brings the surface up to date with the buffer's newest values for a plot area of
+// width x height showing cb->max_size values over [y_min, y_max]
+static inline void plot_trace_update(PlotTrace* trace, cairo_t* target, CircularBuffer* cb,
+                                     int width, int height, double y_min, double y_max) {
+    if (width < 2 || height < 2) return;
+    unsigned int start = atomic_load_explicit(&cb->start, memory_order_acquire);
+    CircularBufferView view;
+    circular_buffer_view(cb, &view);
+    unsigned int first = view.end - (unsigned int)view.count;
+    double px_per_value = (cb->max_size > 1) ? (width - 1.0) / (cb->max_size - 1.0) : 1.0;
+
+    int full = (trace->surface == NULL || trace->width != width || trace->height != height ||
+                trace->y_min != y_min || trace->y_max != y_max || trace->start != start ||
+                first < trace->first || trace->drawn_end < first);
+    if (!full) {
+        int shift = plot_trace_column(px_per_value, first - start, trace->first - start);
+        if (shift >= width) {
+            full = 1;
+        } else if (shift > 0) { // Scroll left by whole columns; the vacated ones come out transparent
+            cairo_t* cr = cairo_create(trace->scratch);
+            cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+            cairo_set_source_surface(cr, trace->surface, -shift, 0);
+            cairo_paint(cr);
+            cairo_destroy(cr);
+            cairo_surface_t* swap = trace->surface;
+            trace->surface = trace->scratch;
+            trace->scratch = swap;
+        }
+    }
+    if (full) {
+        if (!trace->surface || trace->width != width || trace->height != height) {
+            plot_trace_free(trace);
+            trace->surface = cairo_surface_create_similar(cairo_get_target(target), CAIRO_CONTENT_COLOR_ALPHA, width, height);
+            trace->scratch = cairo_surface_create_similar(cairo_get_target(target), CAIRO_CONTENT_COLOR_ALPHA, width, height);
+            trace->width = width;
+            trace->height = height;
+        }
+        cairo_t* cr = cairo_create(trace->surface);
+        cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+        trace->y_min = y_min;
+        trace->y_max = y_max;
+        trace->start = start;
+    }
+    // Redraw from the last value already drawn so the new segment joins the old line
+    unsigned int from = (full || trace->drawn_end == first) ? first : trace->drawn_end - 1;
+    if (view.end > from) {
+        plot_trace_draw_values(trace, &view, start, first, from, view.end, px_per_value);
+    }
+    trace->first = first;
+    trace->drawn_end = view.end;
+}
+
+#endif // PLOT_TRACE_H
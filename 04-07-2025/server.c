@@ -4,17 +4,18 @@
 // Windows-specific networking headers (replaces sys/socket.h, netinet/in.h, arpa/inet.h)
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <mswsock.h> // For TransmitFile (zero-copy file send)
 
 // Standard C Library includes
 #include <pthread.h> // For threading (using pthreads-win32 or similar)
 #include <stdio.h>   // For printf, fopen, fclose, etc.
 #include <stdlib.h>  // For atoi, malloc, free, etc.
 #include <string.h>  // For strcpy, strcmp, strstr, strlen
-#include <dirent.h>  // For directory operations (opendir, readdir)
 #include <sys/stat.h> // For mkdir
 #include <sys/types.h> // For types like mode_t for mkdir
 #include <errno.h>   // For error numbers
 #include <stdbool.h> // For bool type
+#include <stdint.h>  // For uint32_t, uint64_t
 
 #ifdef _WIN32
 #include <direct.h> // For _mkdir on Windows
@@ -22,8 +23,13 @@
 #define access _access // Map POSIX access to Windows _access
 #define F_OK 0 // Define F_OK for access on Windows
 #pragma comment(lib, "Ws2_32.lib") // Link with Winsock library
+#pragma comment(lib, "Mswsock.lib") // Link with TransmitFile
 #endif
 
+#include "recording_catalog.h" // Mapped recordings of FOLDER, indexed once and watched for changes
+#include "replay_pacer.h"     // Streams recordings at the chosen sample interval
+#include "metrics.h"          // Send latency histograms, periodic stats dump, LOG_VERBOSE
+
 // Explicitly define G_TRUE and G_FALSE if they are not picked up from glib.h
 #ifndef G_TRUE
 #define G_TRUE 1
@@ -38,6 +44,7 @@
 #define SERVER_PORT 9999
 #define FOLDER "June23"    // Folder containing your .txt files (create this folder if it doesn't exist)
 #define BUFFER_SIZE 4096   // Buffer size for reading/sending file data
+#define ZERO_COPY_SEND 1   // 1 = TransmitFile straight from the file cache, 0 = ReadFile/send copy loop
 
 // --- Network Protocol Configuration ---
 // These constants must match the client's constants for binary data framing
@@ -60,6 +67,9 @@ uint64_t htonll_custom(uint64_t val) {
 // Forward declaration for the server thread function
 void *send_files_thread_func(void *arg);
 
+RecordingCatalog catalog; // Every .txt file in FOLDER, with an O(1) lookup by frequency
+bool catalog_ready = false;
+
 // Global UI Elements and Server State
 // Structure to hold all application widgets and shared state
 typedef struct {
@@ -72,12 +82,14 @@ typedef struct {
     GtkRadioButton *radio_freq;
     GtkRadioButton *radio_select_file;
     GtkComboBoxText *interval_menu;
+    GtkComboBoxText *speed_menu; // Replay speed for interval mode ("x1".., or "Whole files")
     GtkEntry *freq_entry;
     GtkButton *select_file_button;
     GtkLabel *selected_file_label;
     GtkButton *start_button;
     GtkLabel *label_interval_widget; // Added for explicit access
     GtkLabel *label_freq_widget;     // Added for explicit access
+    GtkLabel *label_speed_widget;
 
     char *selected_file_path; // Dynamically allocated path of the selected file
     bool server_running; // Flag to indicate if the server thread is active
@@ -371,6 +383,8 @@ static void update_mode_controls(void) {
     if (strcmp(app_widgets->current_mode, "interval") == 0) {
         gui_set_widget_sensitive(GTK_WIDGET(app_widgets->interval_menu), TRUE);
         gtk_style_context_remove_class(gtk_widget_get_style_context(GTK_WIDGET(app_widgets->label_interval_widget)), "disabled_label");
+        gui_set_widget_sensitive(GTK_WIDGET(app_widgets->speed_menu), TRUE);
+        gtk_style_context_remove_class(gtk_widget_get_style_context(GTK_WIDGET(app_widgets->label_speed_widget)), "disabled_label");
         
         gui_set_widget_sensitive(GTK_WIDGET(app_widgets->freq_entry), FALSE);
         gtk_style_context_add_class(gtk_widget_get_style_context(GTK_WIDGET(app_widgets->label_freq_widget)), "disabled_label");
@@ -381,6 +395,8 @@ static void update_mode_controls(void) {
     } else if (strcmp(app_widgets->current_mode, "freq") == 0) {
         gui_set_widget_sensitive(GTK_WIDGET(app_widgets->interval_menu), FALSE);
         gtk_style_context_add_class(gtk_widget_get_style_context(GTK_WIDGET(app_widgets->label_interval_widget)), "disabled_label");
+        gui_set_widget_sensitive(GTK_WIDGET(app_widgets->speed_menu), FALSE);
+        gtk_style_context_add_class(gtk_widget_get_style_context(GTK_WIDGET(app_widgets->label_speed_widget)), "disabled_label");
         
         gui_set_widget_sensitive(GTK_WIDGET(app_widgets->freq_entry), TRUE);
         gtk_style_context_remove_class(gtk_widget_get_style_context(GTK_WIDGET(app_widgets->label_freq_widget)), "disabled_label");
@@ -391,6 +407,8 @@ static void update_mode_controls(void) {
     } else if (strcmp(app_widgets->current_mode, "select_file") == 0) {
         gui_set_widget_sensitive(GTK_WIDGET(app_widgets->interval_menu), FALSE);
         gtk_style_context_add_class(gtk_widget_get_style_context(GTK_WIDGET(app_widgets->label_interval_widget)), "disabled_label");
+        gui_set_widget_sensitive(GTK_WIDGET(app_widgets->speed_menu), FALSE);
+        gtk_style_context_add_class(gtk_widget_get_style_context(GTK_WIDGET(app_widgets->label_speed_widget)), "disabled_label");
         
         gui_set_widget_sensitive(GTK_WIDGET(app_widgets->freq_entry), FALSE);
         gtk_style_context_add_class(gtk_widget_get_style_context(GTK_WIDGET(app_widgets->label_freq_widget)), "disabled_label");
@@ -539,17 +557,55 @@ static gboolean on_main_window_destroy(GtkWidget *widget, GdkEvent *event, gpoin
     return G_FALSE;
 }
 
+/**
+ * @brief Sends a whole buffer, looping over partial sends.
+ * @param conn_fd The client socket.
+ * @param buf Data to send.
+ * @param len Number of bytes to send.
+ * @return 0 on success, -1 on socket error.
+ * The whole call is one METRIC_SEND record (waiting on a slow client included).
+ */
+static int send_all(SOCKET conn_fd, const char *buf, size_t len) {
+    uint64_t begin = metrics_begin();
+    size_t total = len;
+    while (len > 0) {
+        int sent = send(conn_fd, buf, (int)len, 0);
+        if (sent == SOCKET_ERROR) return -1;
+        buf += sent;
+        len -= sent;
+    }
+    metrics_end(METRIC_SEND, begin, total);
+    return 0;
+}
+
+/**
+ * @brief Packs filename length, filename and file content length into one header buffer.
+ * @param header Output, at least FILENAME_LENGTH_BYTES + filename_length + FILE_CONTENT_LENGTH_BYTES bytes.
+ * @param name The file name to send.
+ * @param filename_length Length of name in bytes.
+ * @param content_length Length of the content that follows the header.
+ * @return The header length.
+ */
+static size_t pack_file_header(char *header, const char *name, uint32_t filename_length, uint64_t content_length) {
+    uint32_t filename_length_net = htonl(filename_length);
+    uint64_t file_content_length_net = htonll_custom(content_length);
+    memcpy(header, &filename_length_net, FILENAME_LENGTH_BYTES);
+    memcpy(header + FILENAME_LENGTH_BYTES, name, filename_length);
+    memcpy(header + FILENAME_LENGTH_BYTES + filename_length, &file_content_length_net, FILE_CONTENT_LENGTH_BYTES);
+    return FILENAME_LENGTH_BYTES + filename_length + FILE_CONTENT_LENGTH_BYTES;
+}
+
 /**
  * @brief Sends a single file over the provided socket connection using the defined protocol.
+ * The filename length, filename and content length are packed into one header buffer; with
+ * ZERO_COPY_SEND the header and file body then go out in a single TransmitFile call.
  * @param conn_fd The client socket file descriptor.
- * @param filepath The full path to the file to send.
+ * @param filepath The full path to the file to send ("" for control messages with no content).
  * @param file_basename The base name of the file (caller responsible for freeing if dynamically obtained)
  */
 void send_file(SOCKET conn_fd, const char *filepath, const char* file_basename) { // Changed conn_fd to SOCKET
-    FILE *file = NULL;
-    long file_size = 0;
-    char buffer[BUFFER_SIZE];
-    size_t bytes_read;
+    HANDLE file = INVALID_HANDLE_VALUE;
+    uint64_t file_content_length = 0;
     const char *basename_to_use = file_basename ? file_basename : g_path_get_basename(filepath); // Use provided basename or get from path
 
     if (app_widgets->terminate_server_thread) {
@@ -558,69 +614,166 @@ void send_file(SOCKET conn_fd, const char *filepath, const char* file_basename)
         return;
     }
 
-    // --- Send filename length and filename ---
     uint32_t filename_length = strlen(basename_to_use);
-    uint32_t filename_length_net = htonl(filename_length);
-    if (send(conn_fd, (const char*)&filename_length_net, FILENAME_LENGTH_BYTES, 0) < 0) { // Added cast
-        perror("send filename length failed");
-        gui_update_overall_status(g_strdup_printf("Error sending filename length for %s", basename_to_use), "red");
+    if (filename_length > 1024) {
+        gui_update_overall_status(g_strdup_printf("Filename too long, skipping: %.64s...", basename_to_use), "red");
         if (!file_basename) g_free((gpointer)basename_to_use);
         return;
     }
-    if (send(conn_fd, basename_to_use, filename_length, 0) < 0) {
-        perror("send filename failed");
-        gui_update_overall_status(g_strdup_printf("Error sending filename %s", basename_to_use), "red");
-        if (!file_basename) g_free((gpointer)basename_to_use);
-        return;
-    }
-    
-    file = fopen(filepath, "rb");
-    if (!file) {
-        gui_update_overall_status(g_strdup_printf("Error: File not found: %s", basename_to_use), "red");
-        fprintf(stderr, "Error: File not found at %s: %s\n", filepath, strerror(errno));
-        // --- Send 0 content length to indicate no content follows ---
-        uint64_t file_content_length_net = htonll_custom(0);
-        send(conn_fd, (const char*)&file_content_length_net, FILE_CONTENT_LENGTH_BYTES, 0); // Added cast
-        if (!file_basename) g_free((gpointer)basename_to_use);
-        return;
+
+    if (filepath[0] != '\0') {
+        file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        LARGE_INTEGER file_size;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size)) {
+            gui_update_overall_status(g_strdup_printf("Error: File not found: %s", basename_to_use), "red");
+            fprintf(stderr, "Error: File not found at %s: %lu\n", filepath, GetLastError());
+            if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); file = INVALID_HANDLE_VALUE; }
+            // Fall through: header with 0 content length indicates no content follows
+        } else {
+            file_content_length = (uint64_t)file_size.QuadPart;
+        }
     }
 
-    fseek(file, 0, SEEK_END);
-    file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    // --- Send file content length ---
-    uint64_t file_content_length = file_size;
-    uint64_t file_content_length_net = htonll_custom(file_content_length);
-    if (send(conn_fd, (const char*)&file_content_length_net, FILE_CONTENT_LENGTH_BYTES, 0) < 0) { // Added cast
-        perror("send file content length failed");
-        gui_update_overall_status(g_strdup_printf("Error sending content length for %s", basename_to_use), "red");
-        fclose(file);
-        if (!file_basename) g_free((gpointer)basename_to_use);
-        return;
+    char header[FILENAME_LENGTH_BYTES + 1024 + FILE_CONTENT_LENGTH_BYTES];
+    size_t header_length = pack_file_header(header, basename_to_use, filename_length, file_content_length);
+
+    bool send_failed = false;
+    bool read_failed = false;
+    if (file == INVALID_HANDLE_VALUE) {
+        send_failed = (send_all(conn_fd, header, header_length) != 0);
     }
-    
-    // --- Send file data ---
-    while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, file)) > 0) {
-        if (app_widgets->terminate_server_thread) { // Check termination flag during send
-            gui_update_overall_status("Server stopping during file send.", "orange");
-            break;
+#if ZERO_COPY_SEND
+    else if (file_content_length <= 0x7FFFFFFE) { // TransmitFile sends at most 2^31 - 2 bytes per call
+        // Header and file body in one call; the kernel reads the body from the file cache.
+        // Client editions of Windows run at most two TransmitFile calls at once and queue the rest.
+        TRANSMIT_FILE_BUFFERS head_buffers = { header, (DWORD)header_length, NULL, 0 };
+        uint64_t begin = metrics_begin();
+        send_failed = !TransmitFile(conn_fd, file, 0, 0, NULL, &head_buffers, 0);
+        if (!send_failed) metrics_end(METRIC_SEND, begin, header_length + file_content_length);
+    }
+#endif
+    else {
+        // --- Copy loop: header, then file data in BUFFER_SIZE chunks ---
+        // The header has promised file_content_length bytes: a read error or a file that ended
+        // early (or grew) fails the send, and the connection is closed below
+        char buffer[BUFFER_SIZE];
+        uint64_t sent = 0;
+        send_failed = (send_all(conn_fd, header, header_length) != 0);
+        while (!send_failed && sent < file_content_length) {
+            if (app_widgets->terminate_server_thread) { // Check termination flag during send
+                gui_update_overall_status("Server stopping during file send.", "orange");
+                break;
+            }
+            DWORD want = (file_content_length - sent < BUFFER_SIZE) ? (DWORD)(file_content_length - sent) : BUFFER_SIZE;
+            DWORD bytes_read = 0;
+            if (!ReadFile(file, buffer, want, &bytes_read, NULL) || bytes_read == 0) {
+                read_failed = true;
+                send_failed = true;
+                fprintf(stderr, "Read failed for %s after %llu of %llu bytes: %lu\n", basename_to_use,
+                        (unsigned long long)sent, (unsigned long long)file_content_length, GetLastError());
+                gui_update_overall_status(g_strdup_printf("Error reading %s, connection closed", basename_to_use), "red");
+                break;
+            }
+            send_failed = (send_all(conn_fd, buffer, bytes_read) != 0);
+            sent += bytes_read;
         }
-        if (send(conn_fd, buffer, bytes_read, 0) < 0) {
-            perror("send data failed");
-            gui_update_overall_status(g_strdup_printf("Error sending data for %s: %s", basename_to_use, strerror(errno)), "red");
-            break; // Exit loop on send error
+    }
+
+    if (send_failed) {
+        if (!read_failed) {
+            fprintf(stderr, "send failed for %s: %d\n", basename_to_use, WSAGetLastError());
+            gui_update_overall_status(g_strdup_printf("Error sending data for %s (WSA error %d)", basename_to_use, WSAGetLastError()), "red");
         }
+        shutdown(conn_fd, SD_BOTH); // The client can't find the next header in a cut-off stream
     }
 
-    fclose(file);
-    if (!app_widgets->terminate_server_thread) {
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    if (!send_failed && !app_widgets->terminate_server_thread) {
         gui_update_overall_status(g_strdup_printf("Sent: %s", basename_to_use), "#00FF00");
-        printf("Sent file: %s\n", basename_to_use);
+        LOG_VERBOSE("Sent file: %s\n", basename_to_use);
     }
     if (!file_basename) g_free((gpointer)basename_to_use); // Free only if dynamically obtained
 }
 
+/**
+ * @brief Streams a catalog entry's text (after its header) at rate_hz samples per second.
+ * Each tick sends the lines up to the last sample due; stops early if the server is stopping.
+ * @param conn_fd The client socket.
+ * @param entry The catalog entry to send.
+ * @param rate_hz Samples per second.
+ * @return 0 on success, -1 on socket error.
+ */
+static int send_paced_entry(SOCKET conn_fd, const CatalogEntry *entry, double rate_hz) {
+    size_t size = (size_t)entry->size;
+    ReplayPacer pacer;
+    if (replay_pacer_init(&pacer, rate_hz) != 0) return send_all(conn_fd, entry->data, size);
+
+    replay_pacer_start(&pacer);
+    size_t offset = 0;
+    size_t next = 0;
+    int result = 0;
+    while (next < entry->sample_count && result == 0 && !app_widgets->terminate_server_thread) {
+        size_t n = replay_pacer_wait(&pacer, next, entry->sample_count);
+        next += n;
+        size_t end = (next >= entry->sample_count) ? size : catalog_text_offset(entry->data, size, offset, n);
+        result = send_all(conn_fd, entry->data + offset, end - offset);
+        offset = end;
+    }
+    if (result == 0 && offset < size && !app_widgets->terminate_server_thread) {
+        result = send_all(conn_fd, entry->data + offset, size - offset); // A file without samples
+    }
+
+    char stats[256];
+    replay_stats_format(&pacer, stats, sizeof(stats));
+    LOG_VERBOSE("Paced %s: %s\n", entry->name, stats);
+    replay_pacer_free(&pacer);
+    return result;
+}
+
+/**
+ * @brief Sends a recording from its mapped view in the catalog (no open, stat or read).
+ * Unpaced, header and content leave in one gathered write; paced, the content follows
+ * the header sample by sample.
+ * @param conn_fd The client socket.
+ * @param entry The catalog entry to send.
+ * @param rate_hz Samples per second to stream at, 0 to send the file at once.
+ */
+void send_catalog_entry(SOCKET conn_fd, const CatalogEntry *entry, double rate_hz) {
+    if (app_widgets->terminate_server_thread) {
+        gui_update_overall_status(g_strdup_printf("Server stopping, skipping: %s", entry->name), "orange");
+        return;
+    }
+    uint32_t filename_length = strlen(entry->name);
+    if (filename_length > 1024) {
+        gui_update_overall_status(g_strdup_printf("Filename too long, skipping: %.64s...", entry->name), "red");
+        return;
+    }
+
+    char header[FILENAME_LENGTH_BYTES + 1024 + FILE_CONTENT_LENGTH_BYTES];
+    size_t header_length = pack_file_header(header, entry->name, filename_length, entry->size);
+    bool send_failed;
+    if (rate_hz > 0.0) {
+        send_failed = (send_all(conn_fd, header, header_length) != 0 ||
+                       send_paced_entry(conn_fd, entry, rate_hz) != 0);
+    } else if (entry->size <= 0x7FFFFFFF) {
+        WSABUF buffers[2] = { { (ULONG)header_length, header }, { (ULONG)entry->size, (char *)entry->data } };
+        DWORD sent = 0;
+        send_failed = (WSASend(conn_fd, buffers, entry->size > 0 ? 2 : 1, &sent, 0, NULL, NULL) == SOCKET_ERROR);
+    } else {
+        send_failed = (send_all(conn_fd, header, header_length) != 0 ||
+                       send_all(conn_fd, entry->data, (size_t)entry->size) != 0);
+    }
+
+    if (send_failed) {
+        fprintf(stderr, "send failed for %s: %d\n", entry->name, WSAGetLastError());
+        gui_update_overall_status(g_strdup_printf("Error sending data for %s (WSA error %d)", entry->name, WSAGetLastError()), "red");
+    } else if (!app_widgets->terminate_server_thread) {
+        gui_update_overall_status(g_strdup_printf("Sent: %s", entry->name), "#00FF00");
+        LOG_VERBOSE("Sent file: %s\n", entry->name);
+    }
+}
+
 /**
  * @brief The main function for the server thread. Handles socket listening and file sending.
  * @param arg Not used.
@@ -705,6 +858,7 @@ void *send_files_thread_func(void *arg) {
     // --- Send Configuration to Client ---
     char config_msg[256];
     int chosen_interval_ms = 100; // NEW DEFAULT: Send 100ms interval for slower plotting
+    double replay_speedup = 0.0; // 0 = whole files with the interval as the gap between them
 
     if (strcmp(mode_selected, "interval") == 0) {
         const char *interval_str = gtk_combo_box_text_get_active_text(app_widgets->interval_menu);
@@ -716,6 +870,11 @@ void *send_files_thread_func(void *arg) {
                 chosen_interval_ms = 100; // Fallback to 100ms if parsing yields 0 or negative
             }
         }
+        gchar *speed_str = gtk_combo_box_text_get_active_text(app_widgets->speed_menu);
+        if (speed_str && speed_str[0] == 'x') { // "x10" -> 10; "Whole files" stays unpaced
+            replay_speedup = atof(speed_str + 1);
+        }
+        g_free(speed_str);
     } else if (strcmp(mode_selected, "freq") == 0) {
         const char *freq_str = gtk_entry_get_text(app_widgets->freq_entry);
         g_snprintf(config_msg, sizeof(config_msg), "MODE:FREQ,FREQ_HZ:%s", freq_str); // This will overwrite config_msg
@@ -744,97 +903,39 @@ void *send_files_thread_func(void *arg) {
 
     // --- File Sending Logic based on Mode ---
     if (strcmp(mode_selected, "interval") == 0) {
-        // Use chosen_interval_ms for sleeping
+        // Paced, chosen_interval_ms is the time between samples (what the client assumes when it
+        // filters); unpaced, it is the sleep between whole files
         long sleep_us = (long)chosen_interval_ms * 1000; 
+        double rate_hz = (replay_speedup > 0.0) ? 1000.0 / chosen_interval_ms * replay_speedup : 0.0;
 
-        DIR *d;
-        struct dirent *dir;
-        char full_path[PATH_MAX];
-        char **file_list = NULL;
-        int file_count = 0;
-        int capacity = 10; // Initial capacity for file_list
-
-        file_list = g_new(char *, capacity); // Use GLib's allocator
-        if (!file_list) { perror("g_new failed"); goto cleanup_file_list; }
-
-        d = opendir(FOLDER);
-        if (d) {
-            while ((dir = readdir(d)) != NULL) {
-                if (strstr(dir->d_name, ".txt") != NULL) { // Check if it's a .txt file
-                    if (file_count >= capacity) {
-                        capacity *= 2;
-                        file_list = g_realloc(file_list, capacity * sizeof(char *));
-                        if (!file_list) { perror("g_realloc failed"); closedir(d); goto cleanup_file_list; }
-                    }
-                    file_list[file_count] = g_strdup(dir->d_name);
-                    file_count++;
-                }
-            }
-            closedir(d);
-        } else {
+        // The catalog is already sorted by name; files added during the session come next time
+        CatalogSnapshot *snapshot = catalog_ready ? catalog_acquire(&catalog) : NULL;
+        if (snapshot == NULL) {
             gui_update_overall_status(g_strdup_printf("Error: Could not open directory %s", FOLDER), "red");
             // Send special filename to client if folder not found
             send_file(conn_fd, "", "NO_FILES_IN_FOLDER");
             goto cleanup;
         }
-
-        // Sort files alphabetically (basic string comparison)
-        for (int i = 0; i < file_count - 1; i++) {
-            for (int j = i + 1; j < file_count; j++) {
-                if (strcmp(file_list[i], file_list[j]) > 0) {
-                    char *temp = file_list[i];
-                    file_list[i] = file_list[j];
-                    file_list[j] = temp;
-                }
-            }
-        }
-
-        for (int i = 0; i < file_count; i++) {
+        for (int i = 0; i < snapshot->count; i++) {
             if (app_widgets->terminate_server_thread) break; // Check termination flag
-            g_snprintf(full_path, sizeof(full_path), "%s%s%s", FOLDER, G_DIR_SEPARATOR_S, file_list[i]); // Use G_DIR_SEPARATOR_S
-            if (access(full_path, F_OK) == 0) { // Check if file exists
-                send_file(conn_fd, full_path, NULL); // Let send_file get basename
-                if (app_widgets->terminate_server_thread) break;
-                g_usleep(sleep_us); // Sleep for the interval
-            } else {
-                gui_update_overall_status(g_strdup_printf("File not found during interval send: %s", file_list[i]), "red");
-                fprintf(stderr, "File not found during interval send: %s\n", full_path);
-                send_file(conn_fd, "", g_strdup_printf("NO_FILE_FOUND:%s", file_list[i])); // Send specific error filename
-            }
-            g_free(file_list[i]); // Free individual filename string
+            send_catalog_entry(conn_fd, snapshot->entries[i], rate_hz);
+            if (app_widgets->terminate_server_thread) break;
+            if (rate_hz <= 0.0) g_usleep(sleep_us); // Sleep for the interval
         }
-        cleanup_file_list:
-        g_free(file_list); // Free the list array itself
+        catalog_snapshot_release(snapshot);
 
     } else if (strcmp(mode_selected, "freq") == 0) {
         const char *freq_str = gtk_entry_get_text(app_widgets->freq_entry);
-        char search_pattern[64];
-        g_snprintf(search_pattern, sizeof(search_pattern), "hz%s", freq_str); // Example: "50hz.txt"
-
-        DIR *d;
-        struct dirent *dir;
-        char found_file_path[PATH_MAX] = {0};
-        char found_file_name[256] = {0};
-
-        d = opendir(FOLDER);
-        if (d) {
-            while ((dir = readdir(d)) != NULL) {
-                char *lower_d_name = g_ascii_strdown(dir->d_name, -1);
-                // Check if it's a .txt file AND contains the freq pattern
-                if (strstr(dir->d_name, ".txt") != NULL && strstr(lower_d_name, search_pattern) != NULL) {
-                    g_snprintf(found_file_path, sizeof(found_file_path), "%s%s%s", FOLDER, G_DIR_SEPARATOR_S, dir->d_name);
-                    strncpy(found_file_name, dir->d_name, sizeof(found_file_name) - 1);
-                    found_file_name[sizeof(found_file_name) - 1] = '\0';
-                    g_free(lower_d_name);
-                    break;
-                }
-                g_free(lower_d_name);
-            }
-            closedir(d);
-        }
+        char *freq_end;
+        long freq_hz = strtol(freq_str, &freq_end, 10);
+        bool freq_valid = (freq_end != freq_str && *freq_end == '\0' && freq_hz >= 0);
+
+        // O(1) lookup of the exact frequency in the file name ("...hz50.txt" for 50)
+        CatalogSnapshot *snapshot = catalog_ready ? catalog_acquire(&catalog) : NULL;
+        const CatalogEntry *found = freq_valid ? catalog_find_by_freq(snapshot, (int)freq_hz) : NULL;
 
-        if (strlen(found_file_path) > 0) {
-            send_file(conn_fd, found_file_path, NULL); // Use send_file to handle basename
+        if (found) {
+            send_catalog_entry(conn_fd, found, 0.0);
         } else {
             gui_update_overall_status(g_strdup_printf("No file found for %s Hz", freq_str), "orange");
             fprintf(stderr, "No file found for %s Hz\n", freq_str);
@@ -842,6 +943,7 @@ void *send_files_thread_func(void *arg) {
             g_snprintf(specific_error_name, sizeof(specific_error_name), "NO_FILE_FOUND:%sHz", freq_str);
             send_file(conn_fd, "", specific_error_name); // Send specific error filename with no content
         }
+        catalog_snapshot_release(snapshot);
     } else if (strcmp(mode_selected, "select_file") == 0) {
         // Here, we don't need a mutex because app_widgets->selected_file_path is only set/cleared on GUI thread.
         // The server thread reads it *after* button click which is on GUI thread.
@@ -870,6 +972,7 @@ cleanup:
         gui_update_overall_status("Finished sending files. Connection closed.", "#00FF00");
         gui_update_server_status_label("Server Offline");
         printf("Finished sending files. Connection closed.\n");
+        metrics_dump(stderr, "server");
     } else {
         gui_update_overall_status("Server shut down.", "orange");
         gui_update_server_status_label("Server Offline");
@@ -877,6 +980,7 @@ cleanup:
     }
     app_widgets->server_running = false;
     app_widgets->server_thread_id = 0; // Reset thread ID
+    metrics_thread_exit(); // A new server thread starts on each Start
     return NULL;
 }
 
@@ -994,27 +1098,43 @@ static void activate(GtkApplication *app, gpointer user_data) {
     gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->interval_menu), 1, 0, 1, 1);
     gtk_widget_set_hexpand(GTK_WIDGET(app_widgets->interval_menu), TRUE); // Expand horizontally
 
+    // Replay Speed Selection (samples are paced at the interval, times the speed-up)
+    app_widgets->label_speed_widget = GTK_LABEL(gtk_label_new("Replay Speed:"));
+    gtk_label_set_xalign(GTK_LABEL(app_widgets->label_speed_widget), 0.0);
+    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->label_speed_widget), 0, 1, 1, 1);
+
+    app_widgets->speed_menu = GTK_COMBO_BOX_TEXT(gtk_combo_box_text_new());
+    gtk_combo_box_text_append_text(app_widgets->speed_menu, "x1");
+    gtk_combo_box_text_append_text(app_widgets->speed_menu, "x2");
+    gtk_combo_box_text_append_text(app_widgets->speed_menu, "x5");
+    gtk_combo_box_text_append_text(app_widgets->speed_menu, "x10");
+    gtk_combo_box_text_append_text(app_widgets->speed_menu, "x100");
+    gtk_combo_box_text_append_text(app_widgets->speed_menu, "Whole files");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(app_widgets->speed_menu), 0);
+    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->speed_menu), 1, 1, 1, 1);
+    gtk_widget_set_hexpand(GTK_WIDGET(app_widgets->speed_menu), TRUE);
+
     // Frequency Selection
     app_widgets->label_freq_widget = GTK_LABEL(gtk_label_new("Frequency (Hz):"));
     gtk_label_set_xalign(GTK_LABEL(app_widgets->label_freq_widget), 0.0);
-    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->label_freq_widget), 0, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->label_freq_widget), 0, 2, 1, 1);
 
     app_widgets->freq_entry = GTK_ENTRY(gtk_entry_new());
     gtk_entry_set_text(app_widgets->freq_entry, "50");
-    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->freq_entry), 1, 1, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->freq_entry), 1, 2, 1, 1);
     gtk_widget_set_hexpand(GTK_WIDGET(app_widgets->freq_entry), TRUE);
 
     // File Selection Button
     app_widgets->select_file_button = GTK_BUTTON(gtk_button_new_with_label("Select File"));
     gtk_widget_set_name(GTK_WIDGET(app_widgets->select_file_button), "accent_button");
     g_signal_connect(G_OBJECT(app_widgets->select_file_button), "clicked", G_CALLBACK(select_file_clicked), NULL);
-    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->select_file_button), 0, 2, 2, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->select_file_button), 0, 3, 2, 1);
     gtk_widget_set_margin_top(GTK_WIDGET(app_widgets->select_file_button), 10);
     
     app_widgets->selected_file_label = GTK_LABEL(gtk_label_new("No file selected"));
     gtk_widget_set_name(GTK_WIDGET(app_widgets->selected_file_label), "selected_file_display_label");
     gtk_label_set_xalign(GTK_LABEL(app_widgets->selected_file_label), 0.0);
-    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->selected_file_label), 0, 3, 2, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), GTK_WIDGET(app_widgets->selected_file_label), 0, 4, 2, 1);
     gtk_widget_set_margin_bottom(GTK_WIDGET(app_widgets->selected_file_label), 5);
 
 
@@ -1053,6 +1173,14 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    metrics_start_reporter("server");
+
+    // Index the recordings once; the catalog's watcher picks up later changes to the folder
+    catalog_ready = (catalog_open(&catalog, FOLDER) == 0);
+    if (!catalog_ready) {
+        fprintf(stderr, "Could not index folder %s, interval and freq modes will report no files.\n", FOLDER);
+    }
+
     GtkApplication *app;
     int status;
 
@@ -1062,6 +1190,7 @@ int main(int argc, char **argv) {
     g_object_unref(app); // Release the application instance
 
     // Cleanup Winsock after the application exits
+    if (catalog_ready) catalog_close(&catalog);
     WSACleanup();
 
     return status;
@@ -0,0 +1,156 @@
+// Lock-free single-producer/single-consumer ring of ADC samples.
+//
+// The network thread is the only producer and the DSP thread the only consumer; neither
+// ever takes a lock. The capacity is in samples (a power of two), so a burst of large
+// recordings fills the ring gradually instead of overflowing a fixed count of files.
+// What happens when it is full is chosen per push:
+//   RING_OVERFLOW_BLOCK        wait for the consumer (TCP back-pressure, nothing lost)
+//   RING_OVERFLOW_DROP_OLDEST  discard the oldest queued sample to make room
+//   RING_OVERFLOW_DECIMATE     above 3/4 full keep one sample in RING_DECIMATE_FACTOR
+//                              (its step says how many it stands for) until the ring
+//                              drains below 1/4; blocks if it fills anyway
+//
+// head is normally advanced only by the consumer. DROP_OLDEST lets the producer advance
+// it too, so both sides move it with compare-and-swap; the consumer re-reads its slot
+// whenever its CAS loses.
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h> // For Sleep
+#else
+#include <unistd.h>  // For usleep
+#endif
+
+#define RING_DECIMATE_FACTOR 4
+#define RING_WAIT_MS 1          // Back-off while the ring is full or empty
+#define RING_CACHE_LINE 64
+
+typedef enum {
+    RING_OVERFLOW_BLOCK = 0,
+    RING_OVERFLOW_DROP_OLDEST,
+    RING_OVERFLOW_DECIMATE
+} RingOverflowPolicy;
+
+typedef enum {
+    RING_SAMPLE = 0,
+    RING_END_OF_FILE            // Marker after a file's last sample; value is unused
+} RingSampleKind;
+
+typedef struct {
+    double value;               // Raw ADC value
+    uint32_t file_seq;          // Which file the sample belongs to (the consumer watches for changes)
+    uint16_t kind;              // RingSampleKind
+    uint16_t step;              // Input samples this entry stands for (> 1 only when decimating)
+} RingSample;
+
+typedef struct {
+    RingSample* slots;
+    uint32_t mask;              // capacity - 1
+    _Alignas(RING_CACHE_LINE) atomic_uint head;   // Next entry to read
+    _Alignas(RING_CACHE_LINE) atomic_uint tail;   // Next entry to write (producer only)
+    _Alignas(RING_CACHE_LINE) atomic_uint dropped;    // Samples discarded by DROP_OLDEST
+    atomic_uint decimated;      // Samples skipped by DECIMATE
+    int decimating;             // Producer-only decimation state
+    uint16_t skipped;           // Samples skipped since the last kept one
+} SampleRing;
+
+static inline void ring_wait(void) {
+#ifdef _WIN32
+    Sleep(RING_WAIT_MS);
+#else
+    usleep(RING_WAIT_MS * 1000);
+#endif
+}
+
+// capacity is rounded up to a power of two. Returns 0, or -1 if out of memory.
+static inline int sample_ring_init(SampleRing* ring, uint32_t capacity) {
+    uint32_t size = 2;
+    while (size < capacity) size *= 2;
+    ring->slots = (RingSample*)malloc(sizeof(RingSample) * size);
+    if (!ring->slots) return -1;
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->decimated, 0);
+    ring->decimating = 0;
+    ring->skipped = 0;
+    return 0;
+}
+
+static inline void sample_ring_free(SampleRing* ring) {
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+static inline uint32_t sample_ring_capacity(const SampleRing* ring) {
+    return ring->mask + 1;
+}
+
+// Entries currently queued (exact for the consumer, a lower bound for the producer)
+static inline uint32_t sample_ring_count(SampleRing* ring) {
+    return atomic_load_explicit(&ring->tail, memory_order_acquire) -
+           atomic_load_explicit(&ring->head, memory_order_acquire);
+}
+
+// Producer: appends one entry if there is room. Returns 0, or -1 if the ring is full.
+static inline int sample_ring_try_push(SampleRing* ring, const RingSample* sample) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) > ring->mask) return -1;
+    ring->slots[tail & ring->mask] = *sample;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+// Producer: appends one entry under the given overflow policy. Blocking stops (returning -1)
+// as soon as *keep_running is 0. Returns 0 when the entry was queued or deliberately skipped.
+static inline int sample_ring_push(SampleRing* ring, RingSample sample, RingOverflowPolicy policy,
+                                   const volatile int* keep_running) {
+    if (policy == RING_OVERFLOW_DECIMATE && sample.kind == RING_SAMPLE) {
+        uint32_t queued = sample_ring_count(ring);
+        if (!ring->decimating && queued >= sample_ring_capacity(ring) / 4 * 3) ring->decimating = 1;
+        else if (ring->decimating && queued <= sample_ring_capacity(ring) / 4) ring->decimating = 0;
+        if (ring->decimating && ring->skipped + 1 < RING_DECIMATE_FACTOR) {
+            ring->skipped++;
+            atomic_fetch_add_explicit(&ring->decimated, 1, memory_order_relaxed);
+            return 0;
+        }
+        sample.step = (uint16_t)(ring->skipped + 1);
+        ring->skipped = 0;
+    }
+
+    while (sample_ring_try_push(ring, &sample) != 0) {
+        if (policy == RING_OVERFLOW_DROP_OLDEST) {
+            uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &head, head + 1,
+                                                      memory_order_acq_rel, memory_order_acquire)) {
+                atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            }
+            continue; // Lost the race to the consumer: there is room now anyway
+        }
+        if (!*keep_running) return -1;
+        ring_wait();
+    }
+    return 0;
+}
+
+// Consumer: takes the oldest entry. Returns 1, or 0 if the ring is empty.
+static inline int sample_ring_pop(SampleRing* ring, RingSample* out) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    for (;;) {
+        if (head == atomic_load_explicit(&ring->tail, memory_order_acquire)) return 0;
+        *out = ring->slots[head & ring->mask];
+        // On failure head is reloaded: the producer dropped this entry (and may be reusing its slot)
+        if (atomic_compare_exchange_weak_explicit(&ring->head, &head, head + 1,
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            return 1;
+        }
+    }
+}
+
+#endif // SPSC_RING_H
@@ -0,0 +1,217 @@
+// Multi-resolution min/max/mean summaries of a sample stream, built as the samples arrive.
+//
+// A SummaryPyramid folds every value into SUMMARY_LEVELS open buckets: level 0 closes a
+// bucket every SUMMARY_FACTOR samples (1:10), level 1 every SUMMARY_FACTOR level-0 buckets
+// (1:100), level 2 every SUMMARY_FACTOR of those (1:1000). Each level is built from the one
+// below, so a push costs one compare-and-add most of the time and the summaries are exact:
+// the mean of a bucket is the mean of the samples it covers. NaN values (e.g. the FIR
+// output before it is primed) are left out; a bucket with no other values is all NaN.
+//
+// Closed buckets go where the caller wants them, through the mask summary_pyramid_push()
+// returns: into a SummaryLevels (whole-file arrays, saved with the file) and/or a
+// SummaryHistory, the rings the GUI draws a zoomed-out view from. SummaryHistory has one
+// writer and one reader and no lock, like live_view.h: the reader copies the buckets it
+// needs and then checks that the writer hasn't lapped it. Bucket k of a level covers the
+// pyramid's samples [k * ratio, (k + 1) * ratio), so a view ending at sample position p
+// ends at bucket p / ratio whatever the level.
+#ifndef SUMMARY_PYRAMID_H
+#define SUMMARY_PYRAMID_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define SUMMARY_LEVELS 3                // 1:10, 1:100, 1:1000
+#define SUMMARY_FACTOR 10               // Buckets of one level per bucket of the next
+#ifndef SUMMARY_HISTORY_BUCKETS
+#define SUMMARY_HISTORY_BUCKETS 4096    // Buckets kept per level for the GUI (power of two); 1:1000 covers ~23 h at 50 Hz
+#endif
+
+typedef struct {
+    double min, max, mean;
+} SummaryBucket;
+
+// A bucket being filled
+typedef struct {
+    double min, max, sum;
+    unsigned int values;        // Non-NaN values folded in
+    unsigned int samples;       // Samples covered (level 0) or buckets of the level below
+} SummaryAccumulator;
+
+typedef struct {
+    SummaryAccumulator open[SUMMARY_LEVELS];
+    SummaryBucket closed[SUMMARY_LEVELS]; // Last bucket closed at each level (see the push mask)
+} SummaryPyramid;
+
+// One file's closed buckets per level, in storage the caller provides
+typedef struct {
+    SummaryBucket* buckets[SUMMARY_LEVELS];
+    int len[SUMMARY_LEVELS];
+    int capacity[SUMMARY_LEVELS];
+} SummaryLevels;
+
+typedef struct {
+    SummaryBucket* slots[SUMMARY_LEVELS]; // SUMMARY_HISTORY_BUCKETS each, in bucket order
+    atomic_uint written[SUMMARY_LEVELS];  // Buckets published per level
+} SummaryHistory;
+
+// Samples per bucket at a level: 10, 100, 1000
+static inline unsigned int summary_level_ratio(int level) {
+    unsigned int ratio = SUMMARY_FACTOR;
+    while (level-- > 0) ratio *= SUMMARY_FACTOR;
+    return ratio;
+}
+
+// Buckets a level needs for num_samples samples, the last one partly filled
+static inline int summary_level_buckets(int num_samples, int level) {
+    unsigned int ratio = summary_level_ratio(level);
+    return (num_samples > 0) ? (int)(((unsigned int)num_samples + ratio - 1) / ratio) : 0;
+}
+
+// Level to draw span samples from in at most max_points points: -1 if the samples fit as
+// they are, else the finest level that fits (the coarsest if none does)
+static inline int summary_pick_level(unsigned int span, unsigned int max_points) {
+    if (span <= max_points) return -1;
+    for (int level = 0; level < SUMMARY_LEVELS - 1; ++level) {
+        if (span / summary_level_ratio(level) <= max_points) return level;
+    }
+    return SUMMARY_LEVELS - 1;
+}
+
+static inline void summary_accumulator_clear(SummaryAccumulator* acc) {
+    acc->min = NAN;
+    acc->max = NAN;
+    acc->sum = 0.0;
+    acc->values = 0;
+    acc->samples = 0;
+}
+
+static inline void summary_pyramid_reset(SummaryPyramid* pyramid) {
+    memset(pyramid, 0, sizeof(*pyramid));
+    for (int level = 0; level < SUMMARY_LEVELS; ++level) summary_accumulator_clear(&pyramid->open[level]);
+}
+
+// Closes the open bucket of `level` into closed[level], folding it into the level above
+static inline void summary_pyramid_close(SummaryPyramid* pyramid, int level) {
+    SummaryAccumulator* acc = &pyramid->open[level];
+    SummaryBucket* bucket = &pyramid->closed[level];
+    bucket->min = acc->min;
+    bucket->max = acc->max;
+    bucket->mean = (acc->values > 0) ? acc->sum / acc->values : NAN;
+    if (level + 1 < SUMMARY_LEVELS) {
+        SummaryAccumulator* up = &pyramid->open[level + 1];
+        if (acc->values > 0) {
+            if (up->values == 0 || acc->min < up->min) up->min = acc->min;
+            if (up->values == 0 || acc->max > up->max) up->max = acc->max;
+            up->sum += acc->sum;
+            up->values += acc->values;
+        }
+        up->samples++;
+    }
+    summary_accumulator_clear(acc);
+}
+
+// Folds in one value. Returns a mask of the levels whose bucket it closed (bit n = level n;
+// always levels 0 .. k-1), each now in pyramid->closed[].
+static inline int summary_pyramid_push(SummaryPyramid* pyramid, double value) {
+    SummaryAccumulator* acc = &pyramid->open[0];
+    if (!isnan(value)) {
+        if (acc->values == 0 || value < acc->min) acc->min = value;
+        if (acc->values == 0 || value > acc->max) acc->max = value;
+        acc->sum += value;
+        acc->values++;
+    }
+    if (++acc->samples < SUMMARY_FACTOR) return 0;
+    int mask = 0;
+    for (int level = 0; level < SUMMARY_LEVELS && pyramid->open[level].samples >= SUMMARY_FACTOR; ++level) {
+        summary_pyramid_close(pyramid, level);
+        mask |= 1 << level;
+    }
+    return mask;
+}
+
+// Closes the partly filled buckets, e.g. at the end of a file. Returns the mask of the
+// levels closed (those that had an open bucket), as summary_pyramid_push() does.
+static inline int summary_pyramid_flush(SummaryPyramid* pyramid) {
+    int mask = 0;
+    for (int level = 0; level < SUMMARY_LEVELS; ++level) {
+        if (pyramid->open[level].samples == 0) continue;
+        summary_pyramid_close(pyramid, level);
+        mask |= 1 << level;
+    }
+    return mask;
+}
+
+// Appends the buckets in `mask` to the levels. Returns the number left out for lack of room.
+static inline int summary_levels_store(SummaryLevels* levels, const SummaryPyramid* pyramid, int mask) {
+    int dropped = 0;
+    for (int level = 0; level < SUMMARY_LEVELS; ++level) {
+        if (!(mask & (1 << level))) continue;
+        if (levels->len[level] < levels->capacity[level]) {
+            levels->buckets[level][levels->len[level]++] = pyramid->closed[level];
+        } else {
+            dropped++;
+        }
+    }
+    return dropped;
+}
+
+// Returns 0, or -1 if out of memory
+static inline int summary_history_init(SummaryHistory* history) {
+    memset(history, 0, sizeof(*history));
+    for (int level = 0; level < SUMMARY_LEVELS; ++level) {
+        history->slots[level] = (SummaryBucket*)malloc(sizeof(SummaryBucket) * SUMMARY_HISTORY_BUCKETS);
+        if (!history->slots[level]) return -1;
+        atomic_init(&history->written[level], 0);
+    }
+    return 0;
+}
+
+static inline void summary_history_free(SummaryHistory* history) {
+    for (int level = 0; level < SUMMARY_LEVELS; ++level) {
+        free(history->slots[level]);
+        history->slots[level] = NULL;
+    }
+}
+
+// Writer: publishes the buckets in `mask`
+static inline void summary_history_push(SummaryHistory* history, const SummaryPyramid* pyramid, int mask) {
+    for (int level = 0; level < SUMMARY_LEVELS; ++level) {
+        if (!(mask & (1 << level))) continue;
+        unsigned int index = atomic_load_explicit(&history->written[level], memory_order_relaxed);
+        history->slots[level][index & (SUMMARY_HISTORY_BUCKETS - 1)] = pyramid->closed[level];
+        atomic_store_explicit(&history->written[level], index + 1, memory_order_release);
+    }
+}
+
+// Reader: copies the n buckets of `level` starting at bucket `from` (all published) into out.
+// Returns 1 if they were intact, 0 if the writer has reused some of their slots meanwhile.
+static inline int summary_history_read(SummaryHistory* history, int level, unsigned int from, int n, SummaryBucket* out) {
+    if (n <= 0) return 1;
+    if (n > SUMMARY_HISTORY_BUCKETS - 1) return 0;
+    unsigned int written = atomic_load_explicit(&history->written[level], memory_order_acquire);
+    if (written - from > SUMMARY_HISTORY_BUCKETS - 1) return 0;
+    for (int i = 0; i < n; ++i) out[i] = history->slots[level][(from + (unsigned int)i) & (SUMMARY_HISTORY_BUCKETS - 1)];
+    return atomic_load_explicit(&history->written[level], memory_order_acquire) - from <= SUMMARY_HISTORY_BUCKETS - 1;
+}
+
+// Reader: oldest bucket of `level` whose slot the writer won't reuse for another
+// SUMMARY_HISTORY_BUCKETS / 4 buckets
+static inline unsigned int summary_history_oldest(SummaryHistory* history, int level) {
+    unsigned int written = atomic_load_explicit(&history->written[level], memory_order_acquire);
+    unsigned int kept = SUMMARY_HISTORY_BUCKETS / 4 * 3;
+    return (written > kept) ? written - kept : 0;
+}
+
+// Reader: copies the up to n buckets of `level` before bucket `end` (all published), oldest
+// first, into out, stopping at the oldest one kept. Returns the number copied, or -1 if the
+// writer reused their slots meanwhile.
+static inline int summary_history_read_before(SummaryHistory* history, int level, unsigned int end, int n, SummaryBucket* out) {
+    unsigned int oldest = summary_history_oldest(history, level);
+    unsigned int available = ((int)(end - oldest) > 0) ? end - oldest : 0;
+    if ((unsigned int)n > available) n = (int)available;
+    return summary_history_read(history, level, end - (unsigned int)n, n, out) ? n : -1;
+}
+
+#endif // SUMMARY_PYRAMID_H
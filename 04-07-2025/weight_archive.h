@@ -0,0 +1,157 @@
+// Binary column archive for one processed recording (output_data/all_data_<file>.bin).
+// Replaces formatting every weight with fprintf: the values are written as they are in
+// memory, one fwrite per column, so a 70k-sample file costs a few hundred KiB of I/O.
+//
+// Layout (little-endian, the byte order of every host these tools run on):
+//   ArchiveHeader          256 bytes: magic, calibration, sample rate, sizes
+//   ArchiveColumnEntry[]   column_count entries of 64 bytes: name, type, count, offset
+//   column data            each column starts at a multiple of ARCHIVE_ALIGN bytes
+//
+// Every offset is from the start of the file, so a reader can read or mmap the whole file
+// and use the columns in place (archive_find_column() does the bounds checks). Columns of
+// an archive written here: "fir_coefficients", "raw_weight", "filtered_weight", when a
+// spectrum was computed "fft_frequency_hz" and "fft_magnitude", and the min/max/mean
+// summaries of the weight columns, "raw_summary_10" ... "filtered_summary_1000": one
+// min, max, mean triple per 10, 100 or 1000 samples (summary_pyramid.h).
+#ifndef WEIGHT_ARCHIVE_H
+#define WEIGHT_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARCHIVE_MAGIC "LCARCH1"         // 8 bytes with the terminator
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BYTE_ORDER 0x01020304u  // Reads back as 0x04030201 on a host of the other endianness
+#define ARCHIVE_ALIGN 64                // Column data alignment (a cache line; fine for SIMD loads)
+#define ARCHIVE_NAME_BYTES 32
+#define ARCHIVE_MAX_COLUMNS 16
+#define ARCHIVE_WRITE_BUFFER (1 << 20)  // stdio buffer for the header, directory and padding
+
+typedef enum {
+    ARCHIVE_F32 = 1,
+    ARCHIVE_F64 = 2
+} ArchiveType;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // ARCHIVE_BYTE_ORDER as the writer saw it
+    uint32_t header_bytes;      // sizeof(ArchiveHeader)
+    uint32_t column_count;
+    uint64_t sample_count;      // Length of the weight columns
+    double sample_rate_hz;
+    double zero_cal;            // Calibration used for normalize_to_weight()
+    double scale_cal;
+    uint32_t fir_taps;          // Length of the fir_coefficients column
+    uint32_t fft_size;          // FFT window the spectrum columns came from (0 = none)
+    char source_name[192];      // Recording the archive was made from
+} ArchiveHeader;
+
+typedef struct {
+    char name[ARCHIVE_NAME_BYTES];
+    uint32_t type;              // ArchiveType
+    uint32_t element_bytes;     // 4 or 8
+    uint64_t count;             // Values in the column
+    uint64_t offset;            // File offset of the first value (multiple of ARCHIVE_ALIGN)
+    uint64_t reserved;
+} ArchiveColumnEntry;
+
+_Static_assert(sizeof(ArchiveHeader) == 256, "ArchiveHeader is a fixed on-disk layout");
+_Static_assert(sizeof(ArchiveColumnEntry) == 64, "ArchiveColumnEntry is a fixed on-disk layout");
+
+// One column to write; data holds count values of the given type
+typedef struct {
+    const char *name;
+    ArchiveType type;
+    const void *data;
+    uint64_t count;
+} ArchiveColumn;
+
+static inline size_t archive_type_bytes(ArchiveType type) {
+    return (type == ARCHIVE_F32) ? 4 : 8;
+}
+
+static inline uint64_t archive_align(uint64_t offset) {
+    return (offset + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN;
+}
+
+// Fills in everything but the sizes, which the caller sets (sample_count, fir_taps, fft_size)
+static inline void archive_header_init(ArchiveHeader *header, const char *source_name, double sample_rate_hz,
+                                       double zero_cal, double scale_cal) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, ARCHIVE_MAGIC, sizeof(header->magic));
+    header->version = ARCHIVE_VERSION;
+    header->byte_order = ARCHIVE_BYTE_ORDER;
+    header->header_bytes = sizeof(ArchiveHeader);
+    header->sample_rate_hz = sample_rate_hz;
+    header->zero_cal = zero_cal;
+    header->scale_cal = scale_cal;
+    snprintf(header->source_name, sizeof(header->source_name), "%s", source_name);
+}
+
+// Writes header, column directory and columns to path. Returns 0, or -1 (errno set by stdio).
+static inline int archive_write(const char *path, ArchiveHeader *header, const ArchiveColumn *columns, int column_count) {
+    if (column_count < 0 || column_count > ARCHIVE_MAX_COLUMNS) return -1;
+    ArchiveColumnEntry entries[ARCHIVE_MAX_COLUMNS];
+    memset(entries, 0, sizeof(entries));
+    header->column_count = (uint32_t)column_count;
+    uint64_t offset = sizeof(ArchiveHeader) + (uint64_t)column_count * sizeof(ArchiveColumnEntry);
+    for (int c = 0; c < column_count; c++) {
+        snprintf(entries[c].name, sizeof(entries[c].name), "%s", columns[c].name);
+        entries[c].type = (uint32_t)columns[c].type;
+        entries[c].element_bytes = (uint32_t)archive_type_bytes(columns[c].type);
+        entries[c].count = columns[c].count;
+        entries[c].offset = archive_align(offset);
+        offset = entries[c].offset + entries[c].count * entries[c].element_bytes;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return -1;
+    char *buffer = (char *)malloc(ARCHIVE_WRITE_BUFFER);
+    if (buffer) setvbuf(fp, buffer, _IOFBF, ARCHIVE_WRITE_BUFFER);
+
+    static const char zeros[ARCHIVE_ALIGN] = {0};
+    int ok = fwrite(header, sizeof(*header), 1, fp) == 1 &&
+             (column_count == 0 || fwrite(entries, sizeof(ArchiveColumnEntry), (size_t)column_count, fp) == (size_t)column_count);
+    uint64_t written = sizeof(ArchiveHeader) + (uint64_t)column_count * sizeof(ArchiveColumnEntry);
+    for (int c = 0; ok && c < column_count; c++) {
+        size_t pad = (size_t)(entries[c].offset - written);
+        size_t bytes = (size_t)(entries[c].count * entries[c].element_bytes);
+        ok = (pad == 0 || fwrite(zeros, 1, pad, fp) == pad) &&
+             (bytes == 0 || fwrite(columns[c].data, 1, bytes, fp) == bytes); // Large writes bypass the buffer
+        written = entries[c].offset + bytes;
+    }
+    if (fclose(fp) != 0) ok = 0;
+    free(buffer);
+    return ok ? 0 : -1;
+}
+
+// Looks a column up in an archive held in memory (read whole or mmapped). Returns a pointer
+// to its values, or NULL if the archive is malformed, from the other byte order, or has no
+// such column. type_out and count_out may be NULL.
+static inline const void *archive_find_column(const void *archive, size_t archive_bytes, const char *name,
+                                              ArchiveType *type_out, uint64_t *count_out) {
+    const ArchiveHeader *header = (const ArchiveHeader *)archive;
+    if (archive_bytes < sizeof(ArchiveHeader) || memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != ARCHIVE_VERSION || header->byte_order != ARCHIVE_BYTE_ORDER ||
+        header->column_count > ARCHIVE_MAX_COLUMNS ||
+        archive_bytes < header->header_bytes + (uint64_t)header->column_count * sizeof(ArchiveColumnEntry)) {
+        return NULL;
+    }
+    const ArchiveColumnEntry *entries = (const ArchiveColumnEntry *)((const char *)archive + header->header_bytes);
+    for (uint32_t c = 0; c < header->column_count; c++) {
+        if (strncmp(entries[c].name, name, ARCHIVE_NAME_BYTES) != 0) continue;
+        if (entries[c].element_bytes == 0 || entries[c].offset > archive_bytes ||
+            entries[c].count > (archive_bytes - entries[c].offset) / entries[c].element_bytes) {
+            return NULL;
+        }
+        if (type_out) *type_out = (ArchiveType)entries[c].type;
+        if (count_out) *count_out = entries[c].count;
+        return (const char *)archive + entries[c].offset;
+    }
+    return NULL;
+}
+
+#endif // WEIGHT_ARCHIVE_H
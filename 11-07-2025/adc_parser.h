@@ -0,0 +1,223 @@
+// In-place parser for the teraterm load cell log format:
+//
+//   ADC:59289861
+//   MOV:0.027613
+//   FIR:0.027613
+//   +  6257.06 kg
+//
+// Each "ADC:" line starts a record; the MOV:, FIR: and kg lines that follow fill in the
+// rest of it (NAN when a recording doesn't have them, e.g. the 11-07 adc_data files).
+// Parsing works directly on the received buffer (no copy, no NUL terminator needed) and
+// stores the fields as parallel arrays that grow geometrically.
+#ifndef ADC_PARSER_H
+#define ADC_PARSER_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ADC_PARSER_SSE2 1
+#else
+#define ADC_PARSER_SSE2 0
+#endif
+
+#define ADC_PARSER_BYTES_PER_RECORD 16 // Initial capacity guess: about one short ADC line per record
+
+typedef struct {
+    long *adc;          // Raw ADC reading
+    double *mov;        // Firmware moving average (MOV:)
+    double *fir;        // Firmware FIR output (FIR:)
+    double *kg;         // Firmware weight ("+ N kg")
+    size_t count;
+    size_t capacity;
+} AdcRecords;
+
+static inline void adc_records_init(AdcRecords *records) {
+    memset(records, 0, sizeof(*records));
+}
+
+static inline void adc_records_free(AdcRecords *records) {
+    free(records->adc);
+    free(records->mov);
+    free(records->fir);
+    free(records->kg);
+    adc_records_init(records);
+}
+
+// Forgets the records but keeps the arrays, so the next file parses without allocating
+// unless it is larger than any before
+static inline void adc_records_clear(AdcRecords *records) {
+    records->count = 0;
+}
+
+// Makes room for at least capacity records. Returns 0, or -1 if out of memory
+// (the existing records stay valid either way).
+static inline int adc_records_reserve(AdcRecords *records, size_t capacity) {
+    if (capacity <= records->capacity) {
+        return 0;
+    }
+    long *adc = (long *)realloc(records->adc, capacity * sizeof(long));
+    if (adc) records->adc = adc;
+    double *mov = (double *)realloc(records->mov, capacity * sizeof(double));
+    if (mov) records->mov = mov;
+    double *fir = (double *)realloc(records->fir, capacity * sizeof(double));
+    if (fir) records->fir = fir;
+    double *kg = (double *)realloc(records->kg, capacity * sizeof(double));
+    if (kg) records->kg = kg;
+    if (!adc || !mov || !fir || !kg) {
+        return -1;
+    }
+    records->capacity = capacity;
+    return 0;
+}
+
+// Position of the next '\n' in [p, end), or end if there is none
+static inline const char *adc_find_newline(const char *p, const char *end) {
+#if ADC_PARSER_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), newline));
+        if (mask != 0) {
+#if defined(_MSC_VER) && !defined(__clang__)
+            unsigned long bit;
+            _BitScanForward(&bit, (unsigned long)mask);
+            return p + bit;
+#else
+            return p + __builtin_ctz((unsigned)mask);
+#endif
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '\n') {
+        p++;
+    }
+    return p;
+}
+
+// Parses an optionally signed decimal integer. Returns the end of the digits, or p if there are none.
+static inline const char *adc_parse_long(const char *p, const char *end, long *out) {
+    const char *start = p;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    const char *digits = p;
+    unsigned long value = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        value = value * 10 + (unsigned long)(*p - '0');
+        p++;
+    }
+    if (p == digits) {
+        return start;
+    }
+    *out = negative ? -(long)value : (long)value;
+    return p;
+}
+
+// Parses a plain decimal number such as "0.027613" or "-12.5" (as the firmware prints them).
+// Returns the end of the number, or p if there is none.
+static inline const char *adc_parse_decimal(const char *p, const char *end, double *out) {
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+    const char *start = p;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    unsigned long long mantissa = 0;
+    int digits = 0, frac_digits = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        if (digits < 18) { mantissa = mantissa * 10 + (unsigned)(*p - '0'); digits++; }
+        else { frac_digits--; } // Beyond 18 significant digits, just track the magnitude
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && (unsigned)(*p - '0') < 10) {
+            if (digits < 18) { mantissa = mantissa * 10 + (unsigned)(*p - '0'); digits++; frac_digits++; }
+            p++;
+        }
+    }
+    if (digits == 0) {
+        return start;
+    }
+    double value = (double)mantissa;
+    if (frac_digits > 0) value /= pow10[frac_digits];
+    else if (frac_digits < 0) value *= pow(10.0, -frac_digits);
+    *out = negative ? -value : value;
+    return p;
+}
+
+// Parses one line (without its '\n'; a trailing '\r' is fine) into records.
+// Returns 0, or -1 if out of memory.
+static inline int adc_parse_line(const char *line, size_t len, AdcRecords *records) {
+    const char *end = line + len;
+    if (len > 4 && line[3] == ':') {
+        if (memcmp(line, "ADC", 3) == 0) {
+            long value;
+            if (adc_parse_long(line + 4, end, &value) == line + 4) {
+                return 0;
+            }
+            if (records->count == records->capacity &&
+                adc_records_reserve(records, records->capacity ? records->capacity * 2 : 1024) != 0) {
+                return -1;
+            }
+            size_t i = records->count++;
+            records->adc[i] = value;
+            records->mov[i] = NAN;
+            records->fir[i] = NAN;
+            records->kg[i] = NAN;
+            return 0;
+        }
+        if (records->count == 0) {
+            return 0; // MOV:/FIR: before the first ADC: line has nothing to attach to
+        }
+        if (memcmp(line, "MOV", 3) == 0) {
+            adc_parse_decimal(line + 4, end, &records->mov[records->count - 1]);
+        } else if (memcmp(line, "FIR", 3) == 0) {
+            adc_parse_decimal(line + 4, end, &records->fir[records->count - 1]);
+        }
+        return 0;
+    }
+    // Weight line: "+  6257.06 kg" (sign, padding, value, unit)
+    if (records->count > 0 && len > 3 && (line[0] == '+' || line[0] == '-')) {
+        const char *p = line + 1;
+        while (p < end && *p == ' ') p++;
+        double value;
+        const char *num_end = adc_parse_decimal(p, end, &value);
+        if (num_end != p) {
+            while (num_end < end && *num_end == ' ') num_end++;
+            if (end - num_end >= 2 && num_end[0] == 'k' && num_end[1] == 'g') {
+                records->kg[records->count - 1] = (line[0] == '-') ? -value : value;
+            }
+        }
+    }
+    return 0;
+}
+
+// Parses a whole buffer of teraterm text, appending to records. The buffer need not be
+// NUL-terminated. Capacity is reserved up front from the byte count.
+// Returns 0, or -1 if out of memory (records parsed so far are kept).
+static inline int adc_parse_text(const char *text, size_t len, AdcRecords *records) {
+    if (adc_records_reserve(records, records->count + len / ADC_PARSER_BYTES_PER_RECORD + 1) != 0) {
+        return -1;
+    }
+    const char *p = text;
+    const char *end = text + len;
+    while (p < end) {
+        const char *nl = adc_find_newline(p, end);
+        if (adc_parse_line(p, (size_t)(nl - p), records) != 0) {
+            return -1;
+        }
+        p = nl + 1;
+    }
+    return 0;
+}
+
+#endif // ADC_PARSER_H
@@ -0,0 +1,422 @@
+// Binary sample framing for the length-prefixed file protocol.
+// Shared by server.c, client.c and c2.c so all three agree on the wire layout.
+//
+// Negotiation:
+//   1. The server's config string lists what it can send, e.g.
+//      "INTERVAL:20\nMODE:interval\nENCODINGS:text,adc32\n"
+//      (the separators are the literal two characters backslash-n, as the Python tools send them)
+//   2. A client that wants binary answers with a length-prefixed hello
+//      (CONFIG_LENGTH_BYTES big-endian length + text) such as "ENCODING:adc32\n".
+//      Older clients send nothing and keep getting raw text.
+//   3. The server confirms with the control message "ENCODING:adc32" (0 content length).
+//      From then on every file's content is a sequence of fixed-size frames.
+//   4. A client whose connection dropped mid-replay adds "RESUME:<file>:<offset>\n" to the
+//      hello it sends after reconnecting: offset is how many bytes of that file's content it
+//      already has, in the encoding it asks for again. The server answers with the control
+//      message "RESUMED:<file>:<offset>" and carries on from there: the file's header with the
+//      remaining length, its remaining bytes, then the files after it (a file whose offset is
+//      its whole length is skipped). Without that answer (an unknown file, a broadcast, an
+//      older server) the replay starts over. The file name is the file's id within a session.
+//
+// Frame layout (all fields little-endian):
+//   uint32 magic            ADC_FRAME_MAGIC
+//   uint32 sequence         frame number within the file, starting at 0
+//   uint32 sample_rate_mhz  sample rate in millihertz (20 ms interval -> 50000)
+//   uint16 sample_count     time steps in this frame (only the last frame is short)
+//   uint16 channel_count    load cells sampled at each step, 1 .. ADC_MAX_CHANNELS
+//   int32  samples[ADC_FRAME_SAMPLES]  channel by channel: the sample_count samples of
+//                           channel 0, then those of channel 1, and so on
+//                           (sample_count * channel_count <= ADC_FRAME_SAMPLES); the
+//                           unused tail is zero
+// A single load cell is the channel_count 1 case. Because channel 0 comes first, a reader
+// that only knows one channel (adc_frames_decode(), the streaming parser) gets channel 0 of
+// a multi-channel file; adc_channel_frames_decode() gets all of them, one array per channel.
+//
+// "delta" is the compressed alternative (negotiated the same way, "ENCODING:delta"): the
+// frames carry the same ADC_FRAME_SAMPLES samples but only as many bytes as they need.
+//   uint32 magic            ADC_DELTA_MAGIC
+//   uint32 sequence, uint32 sample_rate_mhz, uint16 sample_count   as above
+//   uint16 payload_bytes    bytes following the header
+//   payload                 zigzag varints: the first sample, then each sample minus the
+//                           previous one (mod 2^32). Every frame starts from an absolute
+//                           value, so frames decode on their own.
+// Load cell samples move by a few counts per step, so most take one or two bytes instead of four.
+// Delta frames are single-channel only.
+#ifndef ADC_PROTOCOL_H
+#define ADC_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define ENCODING_NAME_TEXT "text"
+#define ENCODING_NAME_ADC32 "adc32"
+#define ENCODING_NAME_DELTA "delta"
+#define ENCODING_ACK_PREFIX "ENCODING:" // Control message the server sends when it switches encoding
+#define RESUME_REQUEST_PREFIX "RESUME:"  // Hello line "RESUME:<file>:<offset>"
+#define RESUME_ACK_PREFIX "RESUMED:"     // Control message the server sends when it resumes
+
+#define ADC_FRAME_MAGIC 0x31434441u // "ADC1" when read as little-endian bytes
+#define ADC_FRAME_SAMPLES 256
+#define ADC_FRAME_HEADER_BYTES 16
+#define ADC_MAX_CHANNELS 8          // Load cells one frame can carry
+#define ADC_FRAME_BYTES (ADC_FRAME_HEADER_BYTES + ADC_FRAME_SAMPLES * 4)
+#define ADC_DELTA_MAGIC 0x44434441u // "ADCD"
+#define ADC_DELTA_MAX_FRAME_BYTES (ADC_FRAME_HEADER_BYTES + ADC_FRAME_SAMPLES * 5) // A varint is at most 5 bytes
+
+typedef enum {
+    ENCODING_TEXT = 0,  // Raw teraterm text, parsed by the client
+    ENCODING_ADC32,     // Packed int32 ADC samples in ADC_FRAME_BYTES frames
+    ENCODING_DELTA      // Delta + zigzag varint frames
+} WireEncoding;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t sample_rate_mhz;
+    uint16_t sample_count;
+    uint16_t channel_count;
+} AdcFrameHeader;
+
+static inline void put_le16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t get_le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Sample rate implied by the per-sample interval the clients already use (1000 / interval_ms Hz)
+static inline uint32_t sample_rate_mhz_from_interval(int interval_ms) {
+    return (interval_ms > 0) ? (uint32_t)(1000000 / interval_ms) : 0;
+}
+
+// Number of bytes needed to frame sample_count samples
+static inline size_t adc_frames_size(size_t sample_count) {
+    return ((sample_count + ADC_FRAME_SAMPLES - 1) / ADC_FRAME_SAMPLES) * ADC_FRAME_BYTES;
+}
+
+// Bytes of a framed stream that carry its first `samples` samples: the whole frames before
+// them plus the header and samples of the frame they end in. A paced sender cuts the
+// stream here; the zero tail of a short last frame goes out with the end of the stream.
+static inline size_t adc_frames_offset(size_t samples) {
+    size_t whole = samples / ADC_FRAME_SAMPLES, rest = samples % ADC_FRAME_SAMPLES;
+    return whole * ADC_FRAME_BYTES + (rest ? ADC_FRAME_HEADER_BYTES + rest * 4 : 0);
+}
+
+// Time steps one frame holds for channel_count channels
+static inline size_t adc_frame_steps(int channel_count) {
+    return (size_t)(ADC_FRAME_SAMPLES / channel_count);
+}
+
+// Number of bytes needed to frame `steps` time steps of channel_count channels
+static inline size_t adc_channel_frames_size(size_t steps, int channel_count) {
+    size_t per_frame = adc_frame_steps(channel_count);
+    return ((steps + per_frame - 1) / per_frame) * ADC_FRAME_BYTES;
+}
+
+// Writes the ADC_FRAME_HEADER_BYTES header of a frame holding sample_count steps of channel_count channels
+static inline void adc_frame_put_channel_header(uint8_t *p, uint32_t sequence, uint32_t sample_rate_mhz, uint16_t sample_count, uint16_t channel_count) {
+    put_le32(p, ADC_FRAME_MAGIC);
+    put_le32(p + 4, sequence);
+    put_le32(p + 8, sample_rate_mhz);
+    put_le16(p + 12, sample_count);
+    put_le16(p + 14, channel_count);
+}
+
+// Writes the ADC_FRAME_HEADER_BYTES header of a single-channel frame holding sample_count samples
+static inline void adc_frame_put_header(uint8_t *p, uint32_t sequence, uint32_t sample_rate_mhz, uint16_t sample_count) {
+    adc_frame_put_channel_header(p, sequence, sample_rate_mhz, sample_count, 1);
+}
+
+// Packs samples into consecutive frames at out (adc_frames_size(count) bytes). Returns bytes written.
+static inline size_t adc_frames_encode(const int32_t *samples, size_t count, uint32_t sample_rate_mhz, uint8_t *out) {
+    uint8_t *p = out;
+    uint32_t sequence = 0;
+    for (size_t done = 0; done < count; done += ADC_FRAME_SAMPLES, sequence++) {
+        size_t n = count - done;
+        if (n > ADC_FRAME_SAMPLES) n = ADC_FRAME_SAMPLES;
+        adc_frame_put_header(p, sequence, sample_rate_mhz, (uint16_t)n);
+        uint8_t *s = p + ADC_FRAME_HEADER_BYTES;
+        for (size_t i = 0; i < n; i++) {
+            put_le32(s + i * 4, (uint32_t)samples[done + i]);
+        }
+        memset(s + n * 4, 0, (ADC_FRAME_SAMPLES - n) * 4);
+        p += ADC_FRAME_BYTES;
+    }
+    return (size_t)(p - out);
+}
+
+// Packs `steps` time steps of channel_count channels (channels[c][i] = channel c at step i)
+// into consecutive frames at out (adc_channel_frames_size() bytes). Returns bytes written.
+static inline size_t adc_channel_frames_encode(const int32_t *const *channels, int channel_count, size_t steps,
+                                               uint32_t sample_rate_mhz, uint8_t *out) {
+    size_t per_frame = adc_frame_steps(channel_count);
+    uint8_t *p = out;
+    uint32_t sequence = 0;
+    for (size_t done = 0; done < steps; done += per_frame, sequence++) {
+        size_t n = steps - done;
+        if (n > per_frame) n = per_frame;
+        adc_frame_put_channel_header(p, sequence, sample_rate_mhz, (uint16_t)n, (uint16_t)channel_count);
+        uint8_t *s = p + ADC_FRAME_HEADER_BYTES;
+        for (int c = 0; c < channel_count; c++) {
+            for (size_t i = 0; i < n; i++) {
+                put_le32(s + i * 4, (uint32_t)channels[c][done + i]);
+            }
+            s += n * 4;
+        }
+        memset(s, 0, (size_t)(p + ADC_FRAME_BYTES - s));
+        p += ADC_FRAME_BYTES;
+    }
+    return (size_t)(p - out);
+}
+
+// Reads the header of one ADC_FRAME_BYTES frame. Returns 0, or -1 if the frame is malformed.
+static inline int adc_frame_read_header(const uint8_t *frame, AdcFrameHeader *hdr) {
+    hdr->magic = get_le32(frame);
+    hdr->sequence = get_le32(frame + 4);
+    hdr->sample_rate_mhz = get_le32(frame + 8);
+    hdr->sample_count = get_le16(frame + 12);
+    hdr->channel_count = get_le16(frame + 14);
+    if (hdr->magic != ADC_FRAME_MAGIC || hdr->channel_count == 0 || hdr->channel_count > ADC_MAX_CHANNELS ||
+        (uint32_t)hdr->sample_count * hdr->channel_count > ADC_FRAME_SAMPLES) {
+        return -1;
+    }
+    return 0;
+}
+
+// Decodes a buffer of whole frames into out (room for len / ADC_FRAME_BYTES * ADC_FRAME_SAMPLES
+// samples). Returns the number of samples decoded, or -1 on a malformed frame.
+static inline long adc_frames_decode(const uint8_t *buf, size_t len, long *out, uint32_t *sample_rate_mhz_out) {
+    long count = 0;
+    for (size_t off = 0; off + ADC_FRAME_BYTES <= len; off += ADC_FRAME_BYTES) {
+        AdcFrameHeader hdr;
+        if (adc_frame_read_header(buf + off, &hdr) != 0) {
+            return -1;
+        }
+        if (sample_rate_mhz_out) *sample_rate_mhz_out = hdr.sample_rate_mhz;
+        const uint8_t *s = buf + off + ADC_FRAME_HEADER_BYTES;
+        for (uint16_t i = 0; i < hdr.sample_count; i++) {
+            out[count++] = (long)(int32_t)get_le32(s + i * 4);
+        }
+    }
+    return count;
+}
+
+// Channel count of a buffer of frames (that of the first one), or 0 if it doesn't start with a well-formed frame
+static inline int adc_frames_channel_count(const uint8_t *buf, size_t len) {
+    AdcFrameHeader hdr;
+    if (len < ADC_FRAME_BYTES || adc_frame_read_header(buf, &hdr) != 0) return 0;
+    return hdr.channel_count;
+}
+
+// Decodes a buffer of whole frames of channel_count channels into out[0 .. channel_count - 1]
+// (room for len / ADC_FRAME_BYTES * adc_frame_steps(channel_count) samples each). Returns the
+// number of time steps decoded, or -1 on a malformed frame or one with another channel count.
+static inline long adc_channel_frames_decode(const uint8_t *buf, size_t len, int channel_count, long *const *out,
+                                             uint32_t *sample_rate_mhz_out) {
+    long steps = 0;
+    for (size_t off = 0; off + ADC_FRAME_BYTES <= len; off += ADC_FRAME_BYTES) {
+        AdcFrameHeader hdr;
+        if (adc_frame_read_header(buf + off, &hdr) != 0 || hdr.channel_count != channel_count) {
+            return -1;
+        }
+        if (sample_rate_mhz_out) *sample_rate_mhz_out = hdr.sample_rate_mhz;
+        const uint8_t *s = buf + off + ADC_FRAME_HEADER_BYTES;
+        for (int c = 0; c < channel_count; c++) {
+            long *dst = out[c] + steps;
+            for (uint16_t i = 0; i < hdr.sample_count; i++) {
+                dst[i] = (long)(int32_t)get_le32(s + i * 4);
+            }
+            s += hdr.sample_count * 4;
+        }
+        steps += hdr.sample_count;
+    }
+    return steps;
+}
+
+// Encoding named in a hello or acknowledgement ("adc32"), ENCODING_TEXT for anything else
+static inline WireEncoding wire_encoding_from_name(const char *name) {
+    if (strcmp(name, ENCODING_NAME_ADC32) == 0) return ENCODING_ADC32;
+    if (strcmp(name, ENCODING_NAME_DELTA) == 0) return ENCODING_DELTA;
+    return ENCODING_TEXT;
+}
+
+static inline const char *wire_encoding_name(WireEncoding encoding) {
+    return (encoding == ENCODING_ADC32) ? ENCODING_NAME_ADC32 : (encoding == ENCODING_DELTA) ? ENCODING_NAME_DELTA : ENCODING_NAME_TEXT;
+}
+
+// Finds "RESUME:<file>:<offset>" in a hello (the name is everything up to the last ':').
+// Returns 0 with name and *offset set, or -1 if there is no well-formed request.
+static inline int resume_request_parse(const char *hello, char *name, size_t name_size, uint64_t *offset) {
+    const char *p = strstr(hello, RESUME_REQUEST_PREFIX);
+    if (p == NULL) return -1;
+    p += strlen(RESUME_REQUEST_PREFIX);
+    const char *end = strstr(p, "\\n");
+    if (end == NULL) end = p + strlen(p);
+    const char *colon = NULL;
+    for (const char *q = p; q < end; q++) {
+        if (*q == ':') colon = q;
+    }
+    if (colon == NULL || colon == p || (size_t)(colon - p) >= name_size || colon + 1 == end) return -1;
+    uint64_t value = 0;
+    for (const char *q = colon + 1; q < end; q++) {
+        if (*q < '0' || *q > '9') return -1;
+        value = value * 10 + (uint64_t)(*q - '0');
+    }
+    memcpy(name, p, (size_t)(colon - p));
+    name[colon - p] = '\0';
+    *offset = value;
+    return 0;
+}
+
+static inline uint32_t zigzag32(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag32(uint32_t u) {
+    return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+static inline size_t put_varint32(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+// Room for the delta frames of count samples (the exact size is only known after encoding)
+static inline size_t adc_delta_max_size(size_t count) {
+    return ((count + ADC_FRAME_SAMPLES - 1) / ADC_FRAME_SAMPLES) * ADC_DELTA_MAX_FRAME_BYTES;
+}
+
+// Packs samples into delta frames at out (adc_delta_max_size(count) bytes). Returns bytes written.
+static inline size_t adc_delta_encode(const int32_t *samples, size_t count, uint32_t sample_rate_mhz, uint8_t *out) {
+    uint8_t *p = out;
+    uint32_t sequence = 0;
+    for (size_t done = 0; done < count; done += ADC_FRAME_SAMPLES, sequence++) {
+        size_t n = count - done;
+        if (n > ADC_FRAME_SAMPLES) n = ADC_FRAME_SAMPLES;
+        uint8_t *payload = p + ADC_FRAME_HEADER_BYTES;
+        size_t len = 0;
+        uint32_t previous = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint32_t value = (uint32_t)samples[done + i];
+            len += put_varint32(payload + len, zigzag32((int32_t)(value - previous)));
+            previous = value;
+        }
+        put_le32(p, ADC_DELTA_MAGIC);
+        put_le32(p + 4, sequence);
+        put_le32(p + 8, sample_rate_mhz);
+        put_le16(p + 12, (uint16_t)n);
+        put_le16(p + 14, (uint16_t)len);
+        p = payload + len;
+    }
+    return (size_t)(p - out);
+}
+
+// Reads a delta frame header (payload_bytes in hdr->channel_count's place). Returns 0, or -1
+// if it is malformed.
+static inline int adc_delta_read_header(const uint8_t *frame, AdcFrameHeader *hdr, uint16_t *payload_bytes) {
+    hdr->magic = get_le32(frame);
+    hdr->sequence = get_le32(frame + 4);
+    hdr->sample_rate_mhz = get_le32(frame + 8);
+    hdr->sample_count = get_le16(frame + 12);
+    hdr->channel_count = 1;
+    *payload_bytes = get_le16(frame + 14);
+    if (hdr->magic != ADC_DELTA_MAGIC || hdr->sample_count > ADC_FRAME_SAMPLES ||
+        *payload_bytes < hdr->sample_count || *payload_bytes > hdr->sample_count * 5) {
+        return -1;
+    }
+    return 0;
+}
+
+// Samples in a buffer of whole delta frames (from the headers), or -1 if one is malformed
+static inline long adc_delta_count(const uint8_t *buf, size_t len) {
+    long count = 0;
+    size_t off = 0;
+    while (off + ADC_FRAME_HEADER_BYTES <= len) {
+        AdcFrameHeader hdr;
+        uint16_t payload_bytes;
+        if (adc_delta_read_header(buf + off, &hdr, &payload_bytes) != 0) return -1;
+        count += hdr.sample_count;
+        off += ADC_FRAME_HEADER_BYTES + payload_bytes;
+    }
+    return (off == len) ? count : -1;
+}
+
+// Decodes a buffer of whole delta frames into out (room for adc_delta_count() samples).
+// Returns the number of samples decoded, or -1 on a malformed frame.
+static inline long adc_delta_decode(const uint8_t *buf, size_t len, long *out, uint32_t *sample_rate_mhz_out) {
+    long count = 0;
+    size_t off = 0;
+    while (off + ADC_FRAME_HEADER_BYTES <= len) {
+        AdcFrameHeader hdr;
+        uint16_t payload_bytes;
+        if (adc_delta_read_header(buf + off, &hdr, &payload_bytes) != 0 ||
+            off + ADC_FRAME_HEADER_BYTES + payload_bytes > len) {
+            return -1;
+        }
+        if (sample_rate_mhz_out) *sample_rate_mhz_out = hdr.sample_rate_mhz;
+        const uint8_t *p = buf + off + ADC_FRAME_HEADER_BYTES;
+        const uint8_t *end = p + payload_bytes;
+        uint32_t value = 0;
+        for (uint16_t i = 0; i < hdr.sample_count; i++) {
+            uint32_t u = 0;
+            int shift = 0;
+            do {
+                if (p == end || shift > 28) return -1;
+                u |= (uint32_t)(*p & 0x7F) << shift;
+                shift += 7;
+            } while (*p++ & 0x80);
+            value += (uint32_t)unzigzag32(u);
+            out[count++] = (long)(int32_t)value;
+        }
+        if (p != end) return -1;
+        off += ADC_FRAME_HEADER_BYTES + payload_bytes;
+    }
+    return (off == len) ? count : -1;
+}
+
+// Samples in a whole file of either binary encoding (an upper bound for adc32), -1 if malformed
+static inline long adc_binary_sample_count(const uint8_t *buf, size_t len, WireEncoding encoding) {
+    return (encoding == ENCODING_DELTA) ? adc_delta_count(buf, len) : (long)((len / ADC_FRAME_BYTES) * ADC_FRAME_SAMPLES);
+}
+
+// Decodes a whole file of either binary encoding, as adc_frames_decode()
+static inline long adc_binary_decode(const uint8_t *buf, size_t len, WireEncoding encoding, long *out, uint32_t *sample_rate_mhz_out) {
+    return (encoding == ENCODING_DELTA) ? adc_delta_decode(buf, len, out, sample_rate_mhz_out)
+                                        : adc_frames_decode(buf, len, out, sample_rate_mhz_out);
+}
+
+// Bytes of a delta stream that carry the next `samples` samples from offset on. offset is
+// either a frame start (*left == 0) or inside a frame with *left of its samples still to
+// come; *left is updated. Lets a paced sender cut the stream at sample boundaries.
+static inline size_t adc_delta_offset(const uint8_t *buf, size_t len, size_t offset, uint16_t *left, size_t samples) {
+    while (samples > 0 && offset < len) {
+        if (*left == 0) {
+            if (offset + ADC_FRAME_HEADER_BYTES > len) return len;
+            *left = get_le16(buf + offset + 12);
+            offset += ADC_FRAME_HEADER_BYTES;
+            continue;
+        }
+        while (offset < len && (buf[offset] & 0x80)) offset++;
+        offset++;
+        (*left)--;
+        samples--;
+    }
+    return (offset < len) ? offset : len;
+}
+
+#endif // ADC_PROTOCOL_H
@@ -0,0 +1,218 @@
+// Incremental ADC sample extraction for the streaming receive path.
+// The client recv()s a file's content in STREAM_CHUNK_BYTES pieces and feeds each one
+// here as it arrives. Lines ("ADC:<int>") and binary frames may straddle chunk
+// boundaries; the unfinished tail is carried to the next chunk (delta frames are decoded
+// byte by byte, so only their headers are ever carried). Samples are handed
+// to the DSP stage in blocks of STREAM_BLOCK_SAMPLES, so memory use does not depend
+// on the size of the recording.
+#ifndef ADC_STREAM_H
+#define ADC_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adc_protocol.h"
+#include "adc_parser.h"
+
+#define STREAM_CHUNK_BYTES 4096     // Size of one recv() into the fixed receive buffer
+#define STREAM_BLOCK_SAMPLES 64     // Samples per DSP call (about one FIR window)
+#define STREAM_MAX_LINE 64          // Longest text line kept across a chunk boundary
+
+// Called with each full block, and once more with the final partial block
+typedef void (*SampleBlockFn)(const long *samples, int count, void *ctx);
+
+typedef struct {
+    WireEncoding encoding;
+    SampleBlockFn on_block;
+    void *ctx;
+    uint8_t carry[ADC_FRAME_BYTES];     // Unfinished line or frame from the previous chunk
+    size_t carry_len;
+    int carry_overflow;                 // Text line longer than STREAM_MAX_LINE, dropped
+    long block[STREAM_BLOCK_SAMPLES];
+    int block_count;
+    uint64_t sample_count;              // Samples delivered so far
+    uint32_t sample_rate_mhz;           // From the last frame header (binary encodings only)
+    uint16_t delta_left;                // Delta encoding: samples still to come in the current frame
+    uint16_t delta_payload;             // and payload bytes
+    uint32_t delta_value;               // Last sample decoded in the frame
+    uint32_t varint;                    // Varint being assembled, and its next bit position
+    int varint_shift;
+    int malformed;                      // Set on a bad frame; later data is ignored
+} AdcStream;
+
+static inline void adc_stream_init(AdcStream *stream, WireEncoding encoding, SampleBlockFn on_block, void *ctx) {
+    memset(stream, 0, sizeof(*stream));
+    stream->encoding = encoding;
+    stream->on_block = on_block;
+    stream->ctx = ctx;
+}
+
+static inline void adc_stream_push(AdcStream *stream, long sample) {
+    stream->block[stream->block_count++] = sample;
+    stream->sample_count++;
+    if (stream->block_count == STREAM_BLOCK_SAMPLES) {
+        stream->on_block(stream->block, stream->block_count, stream->ctx);
+        stream->block_count = 0;
+    }
+}
+
+// Parses one text line (without its '\n'); only ADC: lines produce samples
+static inline void adc_stream_line(AdcStream *stream, const char *line, size_t len) {
+    long value;
+    if (len > 4 && memcmp(line, "ADC:", 4) == 0 && adc_parse_long(line + 4, line + len, &value) != line + 4) {
+        adc_stream_push(stream, value);
+    }
+}
+
+static inline void adc_stream_frame(AdcStream *stream, const uint8_t *frame) {
+    AdcFrameHeader hdr;
+    if (adc_frame_read_header(frame, &hdr) != 0) {
+        stream->malformed = 1;
+        return;
+    }
+    stream->sample_rate_mhz = hdr.sample_rate_mhz;
+    const uint8_t *s = frame + ADC_FRAME_HEADER_BYTES; // Channel 0 comes first in a multi-channel frame
+    for (uint16_t i = 0; i < hdr.sample_count; i++) {
+        adc_stream_push(stream, (long)(int32_t)get_le32(s + i * 4));
+    }
+}
+
+static inline void adc_stream_feed_text(AdcStream *stream, const char *data, size_t len) {
+    const char *p = data;
+    const char *end = data + len;
+    while (p < end) {
+        const char *nl = adc_find_newline(p, end);
+        if (nl == end) {
+            nl = NULL;
+        }
+        size_t piece = (size_t)((nl ? nl : end) - p);
+        if (stream->carry_len > 0 || stream->carry_overflow || nl == NULL) {
+            // Line started in an earlier chunk, or runs past this one: go through the carry buffer
+            if (stream->carry_len + piece > STREAM_MAX_LINE) {
+                stream->carry_overflow = 1;
+            } else {
+                memcpy(stream->carry + stream->carry_len, p, piece);
+                stream->carry_len += piece;
+            }
+            if (nl == NULL) {
+                return;
+            }
+            if (!stream->carry_overflow) {
+                adc_stream_line(stream, (const char *)stream->carry, stream->carry_len);
+            }
+            stream->carry_len = 0;
+            stream->carry_overflow = 0;
+        } else {
+            adc_stream_line(stream, p, piece);
+        }
+        p = nl + 1;
+    }
+}
+
+static inline void adc_stream_feed_frames(AdcStream *stream, const uint8_t *data, size_t len) {
+    if (stream->carry_len > 0) {
+        size_t need = ADC_FRAME_BYTES - stream->carry_len;
+        size_t take = (len < need) ? len : need;
+        memcpy(stream->carry + stream->carry_len, data, take);
+        stream->carry_len += take;
+        data += take;
+        len -= take;
+        if (stream->carry_len < ADC_FRAME_BYTES) {
+            return;
+        }
+        adc_stream_frame(stream, stream->carry);
+        stream->carry_len = 0;
+    }
+    while (len >= ADC_FRAME_BYTES && !stream->malformed) {
+        adc_stream_frame(stream, data);
+        data += ADC_FRAME_BYTES;
+        len -= ADC_FRAME_BYTES;
+    }
+    if (stream->malformed) {
+        return;
+    }
+    memcpy(stream->carry, data, len);
+    stream->carry_len = len;
+}
+
+static inline void adc_stream_feed_delta(AdcStream *stream, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        if (stream->delta_payload == 0) { // Between frames: gather the next header
+            size_t take = ADC_FRAME_HEADER_BYTES - stream->carry_len;
+            if (take > len) take = len;
+            memcpy(stream->carry + stream->carry_len, data, take);
+            stream->carry_len += take;
+            data += take;
+            len -= take;
+            if (stream->carry_len < ADC_FRAME_HEADER_BYTES) {
+                return;
+            }
+            stream->carry_len = 0;
+            AdcFrameHeader hdr;
+            if (adc_delta_read_header(stream->carry, &hdr, &stream->delta_payload) != 0) {
+                stream->malformed = 1;
+                return;
+            }
+            stream->sample_rate_mhz = hdr.sample_rate_mhz;
+            stream->delta_left = hdr.sample_count;
+            stream->delta_value = 0;
+            continue;
+        }
+        uint8_t b = *data++;
+        len--;
+        stream->delta_payload--;
+        stream->varint |= (uint32_t)(b & 0x7F) << stream->varint_shift;
+        stream->varint_shift += 7;
+        if (!(b & 0x80)) {
+            stream->delta_value += (uint32_t)unzigzag32(stream->varint);
+            adc_stream_push(stream, (long)(int32_t)stream->delta_value);
+            stream->varint = 0;
+            stream->varint_shift = 0;
+            stream->delta_left--;
+        } else if (stream->varint_shift > 28) {
+            stream->malformed = 1;
+            return;
+        }
+        if ((stream->delta_left == 0) != (stream->delta_payload == 0)) { // Payload and sample count disagree
+            stream->malformed = 1;
+            return;
+        }
+    }
+}
+
+// Feeds the next piece of file content, in arrival order
+static inline void adc_stream_feed(AdcStream *stream, const void *data, size_t len) {
+    if (stream->malformed) {
+        return;
+    }
+    if (stream->encoding == ENCODING_ADC32) {
+        adc_stream_feed_frames(stream, (const uint8_t *)data, len);
+    } else if (stream->encoding == ENCODING_DELTA) {
+        adc_stream_feed_delta(stream, (const uint8_t *)data, len);
+    } else {
+        adc_stream_feed_text(stream, (const char *)data, len);
+    }
+}
+
+// Delivers the samples of the partial block now instead of when the block fills. A live
+// source calls this after each read, so no sample waits for the next STREAM_BLOCK_SAMPLES.
+static inline void adc_stream_flush(AdcStream *stream) {
+    if (stream->block_count > 0) {
+        stream->on_block(stream->block, stream->block_count, stream->ctx);
+        stream->block_count = 0;
+    }
+}
+
+// Call once the whole file has been fed: parses a last line without a newline
+// and delivers the final partial block.
+static inline void adc_stream_finish(AdcStream *stream) {
+    if (stream->encoding == ENCODING_TEXT && stream->carry_len > 0 && !stream->carry_overflow) {
+        adc_stream_line(stream, (const char *)stream->carry, stream->carry_len);
+    }
+    stream->carry_len = 0;
+    adc_stream_flush(stream);
+}
+
+#endif // ADC_STREAM_H
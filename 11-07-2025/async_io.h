@@ -0,0 +1,504 @@
+// Completion-based socket I/O: one event loop per thread, any number of sockets on each.
+//
+// A send or receive is started with a caller-owned AsyncOp and finishes later, exactly
+// once, with its done callback running inside async_loop_run() on the loop's thread.
+// Several ops may be outstanding on one socket (the next receive buffers posted while the
+// last one is parsed, a header queued behind the content before it), and each direction
+// of a socket completes in the order its ops were started. A send completes once the whole
+// buffer has gone; a receive as soon as any bytes arrived.
+//
+// On Windows the kernel has a socket's later sends queued behind the one being drained,
+// so the rest of a send that went out only in part can't be resubmitted without landing
+// after them. A short overlapped send therefore fails: the op completes with -1 and every
+// other op on the socket is cancelled (completing with -1 too), and the caller drops the
+// connection as after any send error.
+//
+// Windows uses an I/O completion port: WSASend()/WSARecv() are overlapped, and the kernel
+// fills or drains the caller's buffers directly. Linux uses epoll: when a socket is ready,
+// the loop does the non-blocking send() or recv() for the ops queued on it. Either way the
+// socket itself stays blocking, so ordinary send()/recv() calls work between ops.
+//
+// async_post() completes an op from any thread: it is how another thread (a publisher, a
+// file reader) hands a loop work and wakes it. AsyncRecvStream keeps a chain of chunk
+// receives posted for one length-prefixed payload and hands the chunks out in order.
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>   // For WSASend, WSARecv, WSAGetOverlappedResult
+#include <windows.h>    // For CreateIoCompletionPort, GetQueuedCompletionStatusEx
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#endif
+
+#define ASYNC_BATCH 64                  // Completions taken per wait
+#define ASYNC_STREAM_MAX_BUFFERS 8      // Chunk receives an AsyncRecvStream keeps posted at most
+
+#define ASYNC_SEND 0
+#define ASYNC_RECV 1
+#define ASYNC_POST 2
+
+#ifdef _WIN32
+typedef SOCKET AsyncSocket;
+#else
+typedef int AsyncSocket;
+#endif
+
+typedef struct AsyncOp AsyncOp;
+typedef struct AsyncChannel AsyncChannel;
+typedef struct AsyncLoop AsyncLoop;
+
+// result: bytes sent or received (0 = the peer closed, for a receive), the value given to
+// async_post(), or -1 if the op failed or was cancelled
+typedef void (*AsyncDoneFn)(AsyncOp *op, long result);
+
+struct AsyncOp {
+#ifdef _WIN32
+    OVERLAPPED overlapped;      // First: the completion port hands back its address
+    WSABUF wsabuf;
+#endif
+    int kind;                   // ASYNC_SEND, ASYNC_RECV or ASYNC_POST
+    AsyncChannel *channel;      // NULL for a post
+    char *buf;
+    size_t len;
+    size_t done;                // Bytes of a send gone so far (it is resubmitted until all are)
+    long result;
+    AsyncDoneFn done_fn;
+    void *ctx;                  // For the callback
+    AsyncOp *next;
+};
+
+// A socket attached to a loop. It must outlive its ops: free it only once outstanding is 0
+// (which may be in the done callback of its last op).
+struct AsyncChannel {
+    AsyncLoop *loop;
+    AsyncSocket sock;
+    int outstanding;            // Ops started and not completed yet
+#ifndef _WIN32
+    AsyncOp *send_head, *send_tail;
+    AsyncOp *recv_head, *recv_tail;
+    uint32_t events;            // What epoll watches the socket for
+#endif
+};
+
+struct AsyncLoop {
+#ifdef _WIN32
+    HANDLE port;
+#else
+    int epfd;
+    int wake_fd;                // eventfd that async_post() writes to wake epoll_wait()
+    pthread_mutex_t lock;       // Guards the posted list
+    AsyncOp *posted_head, *posted_tail;     // Completed by other threads
+    AsyncOp *done_head, *done_tail;         // Completed on the loop's thread, callbacks not run yet
+#endif
+};
+
+// Chunks of one payload of known length, received through `count` buffers kept posted
+typedef struct {
+    AsyncChannel *channel;      // Its loop NULL = plain blocking recv() into the first buffer
+    char *buffers;              // count * buffer_size bytes
+    size_t buffer_size;
+    int count;
+    AsyncOp ops[ASYNC_STREAM_MAX_BUFFERS];  // ops[i] receives into buffer i
+    long results[ASYNC_STREAM_MAX_BUFFERS]; // ASYNC_PENDING until ops[i] completes
+    size_t unposted;            // Bytes of the payload no receive has asked for yet
+    int head;                   // Oldest posted buffer, the next chunk handed out
+    int posted;
+    int held;                   // Buffer handed out by the last call (-1 = none), posted again next call
+    int failed;
+} AsyncRecvStream;
+
+#define ASYNC_PENDING (-2L)
+
+#ifdef _WIN32
+
+// Returns 0, or -1 with the reason printed
+static inline int async_loop_init(AsyncLoop *loop) {
+    loop->port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (loop->port == NULL) {
+        fprintf(stderr, "CreateIoCompletionPort failed: %lu\n", GetLastError());
+        return -1;
+    }
+    return 0;
+}
+
+static inline void async_loop_close(AsyncLoop *loop) {
+    CloseHandle(loop->port);
+}
+
+// Attaches a connected socket to the loop (NULL = no loop). Returns 0, or -1 with the
+// reason printed; the channel then has no loop, and only an AsyncRecvStream can use it.
+static inline int async_attach(AsyncLoop *loop, AsyncChannel *channel, AsyncSocket sock) {
+    memset(channel, 0, sizeof(*channel));
+    channel->sock = sock;
+    if (loop == NULL) {
+        return -1;
+    }
+    if (CreateIoCompletionPort((HANDLE)sock, loop->port, (ULONG_PTR)channel, 0) == NULL) {
+        fprintf(stderr, "Error attaching socket to completion port: %lu\n", GetLastError());
+        return -1;
+    }
+    channel->loop = loop;
+    return 0;
+}
+
+// Stops watching the socket (no op may be outstanding). The completion port lets go of
+// it when it is closed.
+static inline void async_detach(AsyncChannel *channel) {
+    (void)channel;
+}
+
+static inline int async_submit(AsyncOp *op) {
+    memset(&op->overlapped, 0, sizeof(op->overlapped));
+    op->wsabuf.buf = op->buf + op->done;
+    op->wsabuf.len = (ULONG)(op->len - op->done);
+    DWORD flags = 0;
+    int rc = (op->kind == ASYNC_SEND) ? WSASend(op->channel->sock, &op->wsabuf, 1, NULL, 0, &op->overlapped, NULL)
+                                      : WSARecv(op->channel->sock, &op->wsabuf, 1, NULL, &flags, &op->overlapped, NULL);
+    return (rc == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING) ? -1 : 0;
+}
+
+// Fails every op outstanding on the channel; they complete with -1
+static inline void async_cancel(AsyncChannel *channel) {
+    CancelIoEx((HANDLE)channel->sock, NULL);
+}
+
+// Completes op with result (>= 0) on the loop's thread. Safe from any thread.
+static inline int async_post(AsyncLoop *loop, AsyncOp *op, long result, AsyncDoneFn done_fn, void *ctx) {
+    memset(&op->overlapped, 0, sizeof(op->overlapped));
+    op->kind = ASYNC_POST;
+    op->channel = NULL;
+    op->done_fn = done_fn;
+    op->ctx = ctx;
+    return PostQueuedCompletionStatus(loop->port, (DWORD)result, 0, &op->overlapped) ? 0 : -1;
+}
+
+#else
+
+static inline int async_loop_init(AsyncLoop *loop) {
+    memset(loop, 0, sizeof(*loop));
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event event = { EPOLLIN, { NULL } }; // data.ptr NULL = the wake descriptor
+    if (loop->wake_fd < 0 || epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wake_fd, &event) != 0) {
+        perror("eventfd for the event loop");
+        if (loop->wake_fd >= 0) close(loop->wake_fd);
+        close(loop->epfd);
+        return -1;
+    }
+    pthread_mutex_init(&loop->lock, NULL);
+    return 0;
+}
+
+static inline void async_loop_close(AsyncLoop *loop) {
+    close(loop->wake_fd);
+    close(loop->epfd);
+    pthread_mutex_destroy(&loop->lock);
+}
+
+static inline int async_attach(AsyncLoop *loop, AsyncChannel *channel, AsyncSocket sock) {
+    memset(channel, 0, sizeof(*channel));
+    channel->sock = sock;
+    if (loop == NULL) {
+        return -1;
+    }
+    struct epoll_event event = { 0, { channel } };
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, sock, &event) != 0) {
+        perror("Error attaching socket to epoll");
+        return -1;
+    }
+    channel->loop = loop;
+    return 0;
+}
+
+// Stops watching the socket (no op may be outstanding); call it before closing the socket
+static inline void async_detach(AsyncChannel *channel) {
+    if (channel->loop) epoll_ctl(channel->loop->epfd, EPOLL_CTL_DEL, channel->sock, NULL);
+}
+
+// Watches the socket for whichever directions have ops queued
+static inline void async_watch(AsyncChannel *channel) {
+    uint32_t events = (channel->recv_head ? EPOLLIN : 0) | (channel->send_head ? EPOLLOUT : 0);
+    if (events != channel->events) {
+        struct epoll_event event = { events, { channel } };
+        epoll_ctl(channel->loop->epfd, EPOLL_CTL_MOD, channel->sock, &event);
+        channel->events = events;
+    }
+}
+
+static inline void async_complete(AsyncLoop *loop, AsyncOp *op, long result) {
+    op->result = result;
+    op->next = NULL;
+    if (loop->done_tail) loop->done_tail->next = op;
+    else loop->done_head = op;
+    loop->done_tail = op;
+}
+
+static inline int async_submit(AsyncOp *op) {
+    AsyncChannel *channel = op->channel;
+    AsyncOp **head = (op->kind == ASYNC_SEND) ? &channel->send_head : &channel->recv_head;
+    AsyncOp **tail = (op->kind == ASYNC_SEND) ? &channel->send_tail : &channel->recv_tail;
+    op->next = NULL;
+    if (*tail) (*tail)->next = op;
+    else *head = op;
+    *tail = op;
+    async_watch(channel);
+    return 0;
+}
+
+static inline void async_cancel(AsyncChannel *channel) {
+    AsyncOp *lists[2] = { channel->send_head, channel->recv_head };
+    channel->send_head = channel->send_tail = NULL;
+    channel->recv_head = channel->recv_tail = NULL;
+    for (int i = 0; i < 2; i++) {
+        for (AsyncOp *op = lists[i], *next; op != NULL; op = next) {
+            next = op->next;
+            async_complete(channel->loop, op, -1);
+        }
+    }
+    async_watch(channel);
+}
+
+static inline int async_post(AsyncLoop *loop, AsyncOp *op, long result, AsyncDoneFn done_fn, void *ctx) {
+    op->kind = ASYNC_POST;
+    op->channel = NULL;
+    op->result = result;
+    op->done_fn = done_fn;
+    op->ctx = ctx;
+    op->next = NULL;
+    pthread_mutex_lock(&loop->lock);
+    if (loop->posted_tail) loop->posted_tail->next = op;
+    else loop->posted_head = op;
+    loop->posted_tail = op;
+    pthread_mutex_unlock(&loop->lock);
+    uint64_t one = 1;
+    return (write(loop->wake_fd, &one, sizeof(one)) == (ssize_t)sizeof(one) || errno == EAGAIN) ? 0 : -1;
+}
+
+// The socket is ready: moves data for the queued ops until it would block
+static inline void async_service(AsyncChannel *channel, uint32_t events) {
+    AsyncLoop *loop = channel->loop;
+    while ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && channel->recv_head != NULL) {
+        AsyncOp *op = channel->recv_head;
+        ssize_t n = recv(channel->sock, op->buf, op->len, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        channel->recv_head = op->next;
+        if (channel->recv_head == NULL) channel->recv_tail = NULL;
+        async_complete(loop, op, (n < 0) ? -1 : (long)n);
+    }
+    while ((events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) && channel->send_head != NULL) {
+        AsyncOp *op = channel->send_head;
+        ssize_t n = send(channel->sock, op->buf + op->done, op->len - op->done, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n > 0) {
+            op->done += (size_t)n;
+            if (op->done < op->len) continue;
+        }
+        channel->send_head = op->next;
+        if (channel->send_head == NULL) channel->send_tail = NULL;
+        async_complete(loop, op, (op->done == op->len) ? (long)op->len : -1);
+    }
+    async_watch(channel);
+}
+
+#endif
+
+static inline int async_start(AsyncChannel *channel, AsyncOp *op, int kind, char *buf, size_t len, AsyncDoneFn done_fn, void *ctx) {
+    op->kind = kind;
+    op->channel = channel;
+    op->buf = buf;
+    op->len = len;
+    op->done = 0;
+    op->result = 0;
+    op->done_fn = done_fn;
+    op->ctx = ctx;
+    if (async_submit(op) != 0) {
+        return -1;
+    }
+    channel->outstanding++;
+    return 0;
+}
+
+// Sends all len bytes of buf, which must stay untouched until the op completes. Returns
+// 0 once started (the op then completes exactly once), -1 if it couldn't be (no callback).
+static inline int async_send(AsyncChannel *channel, AsyncOp *op, const void *buf, size_t len, AsyncDoneFn done_fn, void *ctx) {
+    return async_start(channel, op, ASYNC_SEND, (char *)buf, len, done_fn, ctx);
+}
+
+// Receives up to len bytes into buf. Returns as async_send() does.
+static inline int async_recv(AsyncChannel *channel, AsyncOp *op, void *buf, size_t len, AsyncDoneFn done_fn, void *ctx) {
+    return async_start(channel, op, ASYNC_RECV, (char *)buf, len, done_fn, ctx);
+}
+
+static inline void async_finish(AsyncOp *op, long result) {
+    if (op->channel) op->channel->outstanding--;
+    op->done_fn(op, result);
+}
+
+// Waits up to timeout_ms (-1 = no limit, 0 = just look) for completions and runs their
+// callbacks. Returns how many ran, or -1 if the wait failed.
+static inline int async_loop_run(AsyncLoop *loop, int timeout_ms) {
+    int ran = 0;
+#ifdef _WIN32
+    OVERLAPPED_ENTRY entries[ASYNC_BATCH];
+    ULONG count = 0;
+    if (!GetQueuedCompletionStatusEx(loop->port, entries, ASYNC_BATCH, &count, (timeout_ms < 0) ? INFINITE : (DWORD)timeout_ms,
+                                     FALSE)) {
+        return (GetLastError() == WAIT_TIMEOUT) ? 0 : -1;
+    }
+    for (ULONG i = 0; i < count; i++) {
+        AsyncOp *op = (AsyncOp *)entries[i].lpOverlapped;
+        if (entries[i].lpCompletionKey == 0) {
+            async_finish(op, (long)entries[i].dwNumberOfBytesTransferred);
+            ran++;
+            continue;
+        }
+        DWORD bytes = 0, flags = 0;
+        if (!WSAGetOverlappedResult(op->channel->sock, &op->overlapped, &bytes, FALSE, &flags)) {
+            async_finish(op, -1);
+        } else if (op->kind == ASYNC_SEND) {
+            op->done += bytes;
+            if (op->done < op->len) {
+                async_cancel(op->channel); // Short send: the stream can't be kept in order (see above)
+                async_finish(op, -1);
+            } else {
+                async_finish(op, (long)op->len);
+            }
+        } else {
+            async_finish(op, (long)bytes);
+        }
+        ran++;
+    }
+#else
+    struct epoll_event events[ASYNC_BATCH];
+    int count = epoll_wait(loop->epfd, events, ASYNC_BATCH, loop->done_head ? 0 : timeout_ms);
+    if (count < 0 && errno != EINTR) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.ptr == NULL) {
+            uint64_t wakes;
+            while (read(loop->wake_fd, &wakes, sizeof(wakes)) > 0) {}
+        } else {
+            async_service((AsyncChannel *)events[i].data.ptr, events[i].events);
+        }
+    }
+    pthread_mutex_lock(&loop->lock);
+    if (loop->posted_head) {
+        if (loop->done_tail) loop->done_tail->next = loop->posted_head;
+        else loop->done_head = loop->posted_head;
+        loop->done_tail = loop->posted_tail;
+        loop->posted_head = loop->posted_tail = NULL;
+    }
+    pthread_mutex_unlock(&loop->lock);
+    while (loop->done_head != NULL) {
+        AsyncOp *op = loop->done_head;
+        loop->done_head = op->next;
+        if (loop->done_head == NULL) loop->done_tail = NULL;
+        async_finish(op, op->result);
+        ran++;
+    }
+#endif
+    return ran;
+}
+
+static inline void async_recv_stream_done(AsyncOp *op, long result) {
+    *(long *)op->ctx = result;
+}
+
+static inline void async_recv_stream_post(AsyncRecvStream *rs) {
+    int slot = (rs->head + rs->posted) % rs->count;
+    size_t want = (rs->unposted < rs->buffer_size) ? rs->unposted : rs->buffer_size;
+    rs->results[slot] = ASYNC_PENDING;
+    if (async_recv(rs->channel, &rs->ops[slot], rs->buffers + (size_t)slot * rs->buffer_size, want, async_recv_stream_done,
+                   &rs->results[slot]) != 0) {
+        rs->failed = 1;
+        return;
+    }
+    rs->unposted -= want;
+    rs->posted++;
+}
+
+// Starts receiving the next len bytes on channel through count (1..ASYNC_STREAM_MAX_BUFFERS)
+// buffers of buffer_size bytes each. Receives never ask for more than the payload, so the
+// bytes after it stay in the socket for ordinary recv() calls.
+static inline void async_recv_stream_start(AsyncRecvStream *rs, AsyncChannel *channel, char *buffers, size_t buffer_size, int count,
+                                           size_t len) {
+    rs->channel = channel;
+    rs->buffers = buffers;
+    rs->buffer_size = buffer_size;
+    rs->count = (count < 1) ? 1 : (count > ASYNC_STREAM_MAX_BUFFERS) ? ASYNC_STREAM_MAX_BUFFERS : count;
+    rs->unposted = len;
+    rs->head = 0;
+    rs->posted = 0;
+    rs->held = -1;
+    rs->failed = 0;
+    while (channel->loop != NULL && !rs->failed && rs->posted < rs->count && rs->unposted > 0) {
+        async_recv_stream_post(rs);
+    }
+}
+
+// Waits for the next chunk of the payload, in order. Returns its size with *data pointing
+// at it (valid until the next call), 0 once the whole payload was handed out, or -1 if the
+// connection failed or closed; every receive posted has finished by the time it returns
+// 0 or -1.
+static inline long async_recv_stream_next(AsyncRecvStream *rs, const char **data) {
+    if (rs->channel->loop == NULL) {
+        if (rs->unposted == 0) return 0;
+        size_t want = (rs->unposted < rs->buffer_size) ? rs->unposted : rs->buffer_size;
+        long received = (long)recv(rs->channel->sock, rs->buffers, (int)want, 0);
+        if (received <= 0) return -1;
+        rs->unposted -= (size_t)received;
+        *data = rs->buffers;
+        return received;
+    }
+    if (rs->held >= 0 && !rs->failed && rs->unposted > 0) {
+        async_recv_stream_post(rs); // Into the buffer just given back
+    }
+    rs->held = -1;
+    if (rs->failed && rs->posted > 0) {
+        async_cancel(rs->channel);
+    }
+    while (rs->posted > 0) {
+        while (rs->results[rs->head] == ASYNC_PENDING) {
+            if (async_loop_run(rs->channel->loop, -1) < 0) {
+                rs->failed = 1;
+                async_cancel(rs->channel);
+            }
+        }
+        int slot = rs->head;
+        long received = rs->results[slot];
+        rs->head = (rs->head + 1) % rs->count;
+        rs->posted--;
+        if (rs->failed) {
+            continue;   // Draining after a failure
+        }
+        if (received <= 0) {
+            rs->failed = 1;
+            async_cancel(rs->channel);
+            continue;
+        }
+        rs->unposted += rs->ops[slot].len - (size_t)received; // A short chunk: the rest is asked for again
+        rs->held = slot;
+        *data = rs->buffers + (size_t)slot * rs->buffer_size;
+        return received;
+    }
+    return rs->failed ? -1 : 0;
+}
+
+#endif // ASYNC_IO_H
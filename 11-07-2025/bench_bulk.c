@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <windows.h> // For CreateProcess, TerminateProcess
+
+#include "bulk_stats.h"
+
+// End-to-end throughput benchmark: replays each data folder through server.exe and
+// client.exe in bulk mode (no pacing) and collects the client's BULK_RESULT line, which
+// holds the server's read/send times and the client's recv/parse/filter/write times.
+// Each folder gets its own server process, so catalog indexing isn't part of the timing.
+// With no folders given, every ../<date>/adc_data that exists is used.
+//
+// Usage: bench_bulk [--server server.exe] [--client client.exe] [data_folder ...]
+
+// Configuration
+#define DEFAULT_SERVER "server.exe"
+#define DEFAULT_CLIENT "client.exe"
+#define MAX_FOLDERS 64
+#define START_TIMEOUT_MS 10000  // How long to keep retrying the client while the server starts
+#define RETRY_DELAY_MS 200
+#define LINE_SIZE 1024
+
+typedef struct {
+    char folder[MAX_PATH];
+    BulkStats stats;
+} FolderResult;
+
+// Every ../<name>/adc_data directory, in name order
+int find_default_folders(char folders[][MAX_PATH], int max_folders) {
+    DIR *d = opendir("..");
+    if (d == NULL) {
+        perror("Could not open parent directory");
+        return 0;
+    }
+    int count = 0;
+    struct dirent *dir;
+    while ((dir = readdir(d)) != NULL && count < max_folders) {
+        if (dir->d_name[0] == '.') continue;
+        char path[MAX_PATH];
+        struct stat st;
+        snprintf(path, sizeof(path), "../%s/adc_data", dir->d_name);
+        if (stat(path, &st) == 0 && (st.st_mode & S_IFDIR)) {
+            snprintf(folders[count++], MAX_PATH, "%s", path);
+        }
+    }
+    closedir(d);
+    for (int i = 1; i < count; i++) { // Insertion sort; readdir order isn't defined
+        char key[MAX_PATH];
+        memcpy(key, folders[i], sizeof(key));
+        int j = i - 1;
+        while (j >= 0 && strcmp(folders[j], key) > 0) {
+            memcpy(folders[j + 1], folders[j], MAX_PATH);
+            j--;
+        }
+        memcpy(folders[j + 1], key, MAX_PATH);
+    }
+    return count;
+}
+
+// Starts "server 0 folder" with its output discarded. Returns 0, or -1.
+int start_server(const char *server_exe, const char *folder, PROCESS_INFORMATION *pi) {
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+    HANDLE nul = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &sa, OPEN_EXISTING, 0, NULL);
+    STARTUPINFOA si;
+    memset(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    si.hStdOutput = nul;
+    si.hStdError = nul;
+
+    char command[2 * MAX_PATH + 16];
+    snprintf(command, sizeof(command), "\"%s\" 0 \"%s\"", server_exe, folder);
+    BOOL ok = CreateProcessA(NULL, command, NULL, NULL, TRUE, 0, NULL, NULL, &si, pi);
+    if (nul != INVALID_HANDLE_VALUE) CloseHandle(nul);
+    if (!ok) {
+        fprintf(stderr, "Could not start %s (error %lu)\n", command, GetLastError());
+        return -1;
+    }
+    return 0;
+}
+
+// Runs "client bulk" once. Returns 0 with stats filled in from its BULK_RESULT line, or -1
+// if it exited without one (e.g. the server wasn't listening yet).
+int run_client_once(const char *client_exe, BulkStats *stats) {
+    char command[MAX_PATH + 16];
+    snprintf(command, sizeof(command), "\"%s\" bulk", client_exe);
+    FILE *pipe = _popen(command, "r");
+    if (pipe == NULL) {
+        perror("Could not run client");
+        return -1;
+    }
+    int found = 0;
+    char line[LINE_SIZE];
+    while (fgets(line, sizeof(line), pipe) != NULL) {
+        if (strncmp(line, BULK_RESULT_PREFIX, strlen(BULK_RESULT_PREFIX)) == 0) {
+            memset(stats, 0, sizeof(*stats));
+            found = bulk_stats_parse(stats, line + strlen(BULK_RESULT_PREFIX)) > 0;
+        }
+    }
+    _pclose(pipe);
+    return found ? 0 : -1;
+}
+
+int bench_folder(const char *server_exe, const char *client_exe, const char *folder, BulkStats *stats) {
+    PROCESS_INFORMATION pi;
+    if (start_server(server_exe, folder, &pi) != 0) return -1;
+
+    int result = -1;
+    ULONGLONG give_up = GetTickCount64() + START_TIMEOUT_MS;
+    while (result != 0 && GetTickCount64() < give_up) {
+        if (WaitForSingleObject(pi.hProcess, 0) == WAIT_OBJECT_0) {
+            fprintf(stderr, "Server exited early for %s\n", folder);
+            break;
+        }
+        result = run_client_once(client_exe, stats);
+        if (result != 0) Sleep(RETRY_DELAY_MS);
+    }
+    TerminateProcess(pi.hProcess, 0);
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    const char *server_exe = DEFAULT_SERVER;
+    const char *client_exe = DEFAULT_CLIENT;
+    static char folders[MAX_FOLDERS][MAX_PATH];
+    int folder_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server_exe = argv[++i];
+        } else if (strcmp(argv[i], "--client") == 0 && i + 1 < argc) {
+            client_exe = argv[++i];
+        } else if (folder_count < MAX_FOLDERS) {
+            snprintf(folders[folder_count++], MAX_PATH, "%s", argv[i]);
+        }
+    }
+    if (folder_count == 0) {
+        folder_count = find_default_folders(folders, MAX_FOLDERS);
+    }
+    if (folder_count == 0) {
+        fprintf(stderr, "No data folders to replay.\n");
+        return 1;
+    }
+
+    static FolderResult results[MAX_FOLDERS];
+    int result_count = 0;
+    BulkStats total;
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < folder_count; i++) {
+        printf("Replaying %s...\n", folders[i]);
+        FolderResult *r = &results[result_count];
+        if (bench_folder(server_exe, client_exe, folders[i], &r->stats) != 0) {
+            fprintf(stderr, "No result for %s, skipping it.\n", folders[i]);
+            continue;
+        }
+        snprintf(r->folder, sizeof(r->folder), "%s", folders[i]);
+        bulk_stats_print(stdout, r->folder, &r->stats);
+        bulk_stats_accumulate(&total, &r->stats);
+        result_count++;
+    }
+    if (result_count == 0) {
+        return 1;
+    }
+
+    printf("\n%-28s %6s %10s %12s %8s %10s %14s\n", "folder", "files", "MB", "samples", "wall s", "MB/s", "samples/s");
+    for (int i = 0; i < result_count; i++) {
+        const BulkStats *s = &results[i].stats;
+        double mb = s->bytes / (1024.0 * 1024.0);
+        double wall = (s->wall_s > 0.0) ? s->wall_s : 1e-9;
+        printf("%-28s %6llu %10.2f %12llu %8.3f %10.2f %14.0f\n", results[i].folder, (unsigned long long)s->files, mb,
+               (unsigned long long)s->samples, s->wall_s, mb / wall, s->samples / wall);
+    }
+    printf("\n");
+    bulk_stats_print(stdout, "Corpus total", &total);
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+
+#include "arm_math.h" // CMSIS-DSP, as for c2.c
+#include "adc_parser.h"
+
+#define FIR_NUM_TAPS 51 // c2.c's filter
+#include "fir_engine.h"
+
+// Accuracy and speed of every fir_engine.h path (f32, q31, q31 fast, q15) on the recorded
+// data. Each file is filtered from a clean state, as c2.c's worker pool does; the error is
+// measured against a double-precision run of the same filter on the same DC-removed
+// counts and reported in ADC counts and in kg with c2.c's calibration. The timed passes
+// run without the check.
+//
+// Usage: bench_fir [data_folder] [iterations]
+
+// Configuration
+#define DEFAULT_DATA_FOLDER "../09-07-2025/adc_data"
+#define DEFAULT_ITERATIONS 5
+
+// c2.c's calibration: kg per ADC count
+#define SCALE_CAL 0.00000452466566
+#define KG_PER_COUNT (1.0 / (2147483648.0 * SCALE_CAL))
+
+typedef struct {
+    long *adc;
+    int count;
+} LoadedFile;
+
+int load_folder(const char *folder, LoadedFile **files_out, int *count_out, size_t *samples_out) {
+    DIR *d = opendir(folder);
+    if (d == NULL) {
+        perror("Could not open data directory");
+        return -1;
+    }
+    LoadedFile *files = NULL;
+    int count = 0;
+    size_t samples = 0;
+    struct dirent *dir;
+    while ((dir = readdir(d)) != NULL) {
+        if (strstr(dir->d_name, ".txt") == NULL) {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", folder, dir->d_name);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            continue;
+        }
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        char *text = (char *)malloc((size_t)len + 1);
+        if (text == NULL || fread(text, 1, (size_t)len, f) != (size_t)len) {
+            fclose(f);
+            free(text);
+            continue;
+        }
+        fclose(f);
+        AdcRecords records;
+        adc_records_init(&records);
+        LoadedFile *grown = (LoadedFile *)realloc(files, (count + 1) * sizeof(LoadedFile));
+        if (grown == NULL || adc_parse_text(text, (size_t)len, &records) != 0 || records.count == 0) {
+            free(text);
+            adc_records_free(&records);
+            if (grown) files = grown;
+            continue;
+        }
+        free(text);
+        files = grown;
+        files[count].adc = (long *)malloc(records.count * sizeof(long));
+        if (files[count].adc == NULL) {
+            adc_records_free(&records);
+            continue;
+        }
+        memcpy(files[count].adc, records.adc, records.count * sizeof(long));
+        files[count].count = (int)records.count;
+        samples += records.count;
+        count++;
+        adc_records_free(&records);
+    }
+    closedir(d);
+    *files_out = files;
+    *count_out = count;
+    *samples_out = samples;
+    return 0;
+}
+
+// Filters every file (engine reset before each) into out
+void filter_all(FirEngine *engine, const LoadedFile *files, int file_count, long *out) {
+    for (int i = 0; i < file_count; i++) {
+        fir_engine_reset(engine);
+        fir_engine_process(engine, files[i].adc, out, files[i].count);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *folder = (argc > 1) ? argv[1] : DEFAULT_DATA_FOLDER;
+    int iterations = (argc > 2) ? atoi(argv[2]) : DEFAULT_ITERATIONS;
+    if (iterations < 1) iterations = 1;
+
+    LoadedFile *files = NULL;
+    int file_count = 0;
+    size_t total_samples = 0;
+    if (load_folder(folder, &files, &file_count, &total_samples) != 0 || file_count == 0) {
+        fprintf(stderr, "No ADC samples loaded from %s\n", folder);
+        return 1;
+    }
+    int max_count = 0;
+    for (int i = 0; i < file_count; i++) {
+        if (files[i].count > max_count) max_count = files[i].count;
+    }
+    long *out = (long *)malloc(max_count * sizeof(long));
+    if (out == NULL) {
+        perror("Failed to allocate output buffer");
+        return 1;
+    }
+    printf("Loaded %d files, %lu samples from %s; %d taps, block %d, %d iterations\n", file_count,
+           (unsigned long)total_samples, folder, FIR_NUM_TAPS, FIR_BLOCK_SIZE, iterations);
+
+    float32_t coeffs[FIR_NUM_TAPS];
+    for (int i = 0; i < FIR_NUM_TAPS; i++) {
+        coeffs[i] = 1.0f / (float32_t)FIR_NUM_TAPS; // c2.c's moving average
+    }
+
+    static const FirPath paths[] = { FIR_PATH_F32, FIR_PATH_Q31, FIR_PATH_Q31_FAST, FIR_PATH_Q15 };
+    printf("%-10s %12s %12s %12s %14s %14s\n", "path", "best ms", "Msamples/s", "max counts", "rms counts", "max kg");
+    for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++) {
+        static FirEngine engine; // Static: the state buffers are a few KiB
+        fir_engine_init(&engine, paths[p], coeffs);
+
+        double best = 1e30;
+        for (int it = 0; it < iterations; it++) {
+            double before = engine.busy_s;
+            filter_all(&engine, files, file_count, out);
+            if (engine.busy_s - before < best) best = engine.busy_s - before;
+        }
+
+        fir_engine_enable_check(&engine);
+        filter_all(&engine, files, file_count, out);
+        printf("%-10s %12.2f %12.2f %12.2f %14.3f %14.6f\n", fir_path_name(paths[p]), best * 1000.0,
+               total_samples / best / 1e6, engine.reference.max_error, fir_engine_rms_error(&engine),
+               engine.reference.max_error * KG_PER_COUNT);
+    }
+    printf("(Errors include rounding the output to whole counts: up to 0.5 counts, %.6f kg.)\n", 0.5 * KG_PER_COUNT);
+
+    for (int i = 0; i < file_count; i++) {
+        free(files[i].adc);
+    }
+    free(files);
+    free(out);
+    return 0;
+}
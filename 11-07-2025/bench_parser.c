@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+
+#ifdef _WIN32
+#include <windows.h> // For QueryPerformanceCounter
+#else
+#include <time.h>    // For clock_gettime
+#endif
+
+#include "adc_parser.h"
+
+// Microbenchmark: adc_parse_text() against the strdup/strtok/sscanf/realloc loop
+// that process_data() used before. Reads every .txt file in the data folder into
+// memory once, then times repeated parses of all of them.
+//
+// Usage: bench_parser [data_folder] [iterations]
+
+// Configuration
+#define DEFAULT_DATA_FOLDER "../09-07-2025/adc_data"
+#define DEFAULT_ITERATIONS 5
+
+typedef struct {
+    char *text;
+    size_t len;
+} LoadedFile;
+
+double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+// The previous parse loop from process_data(), kept verbatim for comparison
+long *legacy_parse(const char *file_content, int *count_out) {
+    long *raw_adc_values = NULL;
+    int raw_count = 0;
+    char *content_copy = strdup(file_content);
+    if (content_copy == NULL) {
+        return NULL;
+    }
+    char *line = strtok(content_copy, "\n");
+    while (line != NULL) {
+        if (strstr(line, "ADC:") != NULL) {
+            long adc_val;
+            if (sscanf(line, "ADC:%ld", &adc_val) == 1) {
+                raw_count++;
+                raw_adc_values = (long *)realloc(raw_adc_values, raw_count * sizeof(long));
+                if (raw_adc_values == NULL) {
+                    free(content_copy);
+                    return NULL;
+                }
+                raw_adc_values[raw_count - 1] = adc_val;
+            }
+        }
+        line = strtok(NULL, "\n");
+    }
+    free(content_copy);
+    *count_out = raw_count;
+    return raw_adc_values;
+}
+
+int load_folder(const char *folder, LoadedFile **files_out, int *count_out, size_t *bytes_out) {
+    DIR *d = opendir(folder);
+    if (d == NULL) {
+        perror("Could not open data directory");
+        return -1;
+    }
+    LoadedFile *files = NULL;
+    int count = 0;
+    size_t bytes = 0;
+    struct dirent *dir;
+    while ((dir = readdir(d)) != NULL) {
+        if (strstr(dir->d_name, ".txt") == NULL) {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", folder, dir->d_name);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            continue;
+        }
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        char *text = (char *)malloc((size_t)len + 1);
+        LoadedFile *grown = (LoadedFile *)realloc(files, (count + 1) * sizeof(LoadedFile));
+        if (text == NULL || grown == NULL || fread(text, 1, (size_t)len, f) != (size_t)len) {
+            fclose(f);
+            free(text);
+            if (grown) files = grown;
+            continue;
+        }
+        fclose(f);
+        text[len] = '\0'; // Only the legacy loop needs this
+        files = grown;
+        files[count].text = text;
+        files[count].len = (size_t)len;
+        count++;
+        bytes += (size_t)len;
+    }
+    closedir(d);
+    *files_out = files;
+    *count_out = count;
+    *bytes_out = bytes;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *folder = (argc > 1) ? argv[1] : DEFAULT_DATA_FOLDER;
+    int iterations = (argc > 2) ? atoi(argv[2]) : DEFAULT_ITERATIONS;
+    if (iterations < 1) iterations = 1;
+
+    LoadedFile *files = NULL;
+    int file_count = 0;
+    size_t total_bytes = 0;
+    if (load_folder(folder, &files, &file_count, &total_bytes) != 0 || file_count == 0) {
+        fprintf(stderr, "No .txt files loaded from %s\n", folder);
+        return 1;
+    }
+    printf("Loaded %d files, %.1f MB from %s; %d iterations%s\n", file_count, total_bytes / 1e6, folder,
+           iterations, ADC_PARSER_SSE2 ? " (SSE2 newline scan)" : "");
+
+    // Correctness check: both parsers must agree on every ADC value
+    size_t total_samples = 0, total_kg = 0;
+    for (int i = 0; i < file_count; i++) {
+        int legacy_count = 0;
+        long *legacy = legacy_parse(files[i].text, &legacy_count);
+        AdcRecords records;
+        adc_records_init(&records);
+        if (adc_parse_text(files[i].text, files[i].len, &records) != 0 || (size_t)legacy_count != records.count ||
+            (legacy_count > 0 && memcmp(legacy, records.adc, legacy_count * sizeof(long)) != 0)) {
+            fprintf(stderr, "Parsers disagree on file %d (%d vs %lu samples)\n", i, legacy_count, (unsigned long)records.count);
+            return 1;
+        }
+        for (size_t k = 0; k < records.count; k++) {
+            if (!isnan(records.kg[k])) total_kg++;
+        }
+        total_samples += records.count;
+        free(legacy);
+        adc_records_free(&records);
+    }
+    printf("Both parsers found %lu ADC samples (%lu with firmware kg values)\n",
+           (unsigned long)total_samples, (unsigned long)total_kg);
+
+    double best_legacy = 1e30, best_fast = 1e30;
+    for (int it = 0; it < iterations; it++) {
+        double t0 = now_seconds();
+        for (int i = 0; i < file_count; i++) {
+            int n = 0;
+            free(legacy_parse(files[i].text, &n));
+        }
+        double t1 = now_seconds();
+        for (int i = 0; i < file_count; i++) {
+            AdcRecords records;
+            adc_records_init(&records);
+            adc_parse_text(files[i].text, files[i].len, &records);
+            adc_records_free(&records);
+        }
+        double t2 = now_seconds();
+        if (t1 - t0 < best_legacy) best_legacy = t1 - t0;
+        if (t2 - t1 < best_fast) best_fast = t2 - t1;
+    }
+
+    printf("%-28s %10s %12s %14s\n", "parser", "best ms", "MB/s", "samples/s");
+    printf("%-28s %10.2f %12.1f %14.0f\n", "strtok+sscanf+realloc", best_legacy * 1000.0,
+           total_bytes / 1e6 / best_legacy, total_samples / best_legacy);
+    printf("%-28s %10.2f %12.1f %14.0f\n", "adc_parse_text (all fields)", best_fast * 1000.0,
+           total_bytes / 1e6 / best_fast, total_samples / best_fast);
+    printf("Speedup: %.1fx\n", best_legacy / best_fast);
+
+    for (int i = 0; i < file_count; i++) {
+        free(files[i].text);
+    }
+    free(files);
+    return 0;
+}
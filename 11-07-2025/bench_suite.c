@@ -0,0 +1,668 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <dirent.h>
+#include <unistd.h>     // For close()
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>  // For inet_addr
+
+// Benchmark suite for the Linux DSP chain (file_pipeline.h) on the bundled recordings, one
+// stage at a time and end to end, with output meant for scripts:
+//
+//   read         fread of every file (from the page cache after the warm-up pass)
+//   parse        adc_parse_text()
+//   weights      adc_to_weights() with the fastest kernels this CPU runs
+//   dc           adc_mean() + adc_remove_offset()
+//   fir_ma_f32   fir_engine_process(), c2's FIR_NUM_TAPS moving average, f32 and q31 paths,
+//   fir_ma_q31   each file from a clean filter
+//   fir_lp_f32   the same with designed taps: Hamming windowed-sinc low-pass at
+//   fir_lp_q31   BENCH_CUTOFF_HZ (firwin(FIR_NUM_TAPS, 10 / 25) at 50 Hz)
+//   fft          compute_spectrum() on every FFT_WINDOW_SIZE window of each file
+//   write        write_weight_archive() of every file into the scratch folder (bytes: the archives)
+//   tcp          the whole corpus over a loopback TCP connection, length-prefixed
+//   e2e_disk     read + process_data() (parse, FIR, weights, FFT, archive), per file
+//   e2e_tcp      loopback transfer + process_data(), what c2 bulk does minus the protocol
+//
+// Single-threaded. Files are loaded in name order, every stage gets an untimed warm-up
+// pass, then `iterations` timed passes over the whole corpus.
+//
+// Output: a BENCH_CONFIG line (corpus size and hash, build settings, label), then one BENCH
+// line per stage:
+//   BENCH stage=fir_ma_f32 items=502591 bytes=0 iterations=5 best_s=0.010321 median_s=0.010498 ns_per_item=20.54 mb_per_s=0.00 check=9c1f...
+// items are samples (windows for fft, files for read/tcp), bytes what the stage read or moved.
+// check is a hash of the stage's output: a different value means the output changed. For
+// write and the end-to-end stages that is the archives read back from the scratch folder,
+// with their filtered_weight and fft_magnitude columns hashed once more on their own.
+// --compare puts two such outputs side by side and fails on a slowdown or a changed check.
+//
+// Usage: bench_suite [-n iterations] [-l label] [-o scratch_folder] [data_folder ...]
+//        bench_suite --compare base.txt new.txt [threshold_percent]
+// With no folders given, every ../<date>/adc_data that exists is used.
+
+// Configuration
+#define DEFAULT_ITERATIONS 5
+#define DEFAULT_SCRATCH_FOLDER "bench_output"
+#define DEFAULT_THRESHOLD_PERCENT 10.0  // --compare: best_s this much slower is a regression
+#define BENCH_INTERVAL_MS 20            // Every bundled recording is ms20
+#define BENCH_CUTOFF_HZ 10.0
+#define MAX_FOLDERS 64
+#define MAX_STAGES 32
+#define LINE_SIZE 1024
+
+#include "file_pipeline.h" // The DSP chain under test (CMSIS-DSP, as for c2.c)
+
+typedef struct {
+    char path[512];
+    const char *name;           // Base name, as the server sends it
+    char *text;
+    size_t len;
+    long *adc;                  // Parsed once at load time, the input of the later stages
+    int count;
+    double *raw_weights;        // And what the stages after them need
+    double *filtered_weights;
+    float32_t fft_magnitude[FFT_WINDOW_SIZE / 2];
+    int fft_bins;
+} BenchFile;
+
+typedef struct {
+    BenchFile *files;
+    int file_count;
+    size_t bytes, samples, windows, max_len, max_count;
+    char *buffer;               // max_len bytes: read and receive target
+    long *long_out;             // max_count values
+    double *double_out;
+    char *archive;              // An archive read back for the checks, archive_capacity bytes
+    size_t archive_capacity;
+    size_t archive_bytes;       // Size of the archives the last checked write pass wrote
+    AdcRecords records;
+    FirEngine fir_ma[2], fir_lp[2]; // f32, q31
+    FileWorker worker;          // The end-to-end passes' DSP state
+    int tcp_sock;               // Receiving end of the loopback connection
+    pthread_t tcp_sender;
+} Bench;
+
+typedef struct {
+    const char *name;
+    void (*run)(Bench *b, int variant, uint64_t *check); // check is NULL on the timed passes
+    int variant;
+    int items;                  // 0 = samples, 1 = windows, 2 = files
+    int counts_bytes;           // 1 = the stage reads or moves the corpus bytes, 2 = it writes the archives
+} BenchStage;
+
+// FNV-1a, for the output checks
+static inline uint64_t fnv1a(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+#define FNV_OFFSET 0xcbf29ce484222325ull
+
+int compare_paths(const void *a, const void *b) {
+    return strcmp(((const BenchFile *)a)->path, ((const BenchFile *)b)->path);
+}
+
+// Every ../<name>/adc_data directory (the order doesn't matter: files are sorted later)
+int find_default_folders(char folders[][512], int max_folders) {
+    DIR *d = opendir("..");
+    if (d == NULL) {
+        perror("Could not open parent directory");
+        return 0;
+    }
+    int count = 0;
+    struct dirent *dir;
+    while ((dir = readdir(d)) != NULL && count < max_folders) {
+        if (dir->d_name[0] == '.') continue;
+        char path[512];
+        struct stat st;
+        snprintf(path, sizeof(path), "../%s/adc_data", dir->d_name);
+        if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            snprintf(folders[count++], 512, "%s", path);
+        }
+    }
+    closedir(d);
+    return count;
+}
+
+// Adds the .txt files of a folder (paths only). Returns 0, or -1 if it can't be read.
+int list_folder(Bench *b, const char *folder, int *capacity) {
+    DIR *d = opendir(folder);
+    if (d == NULL) {
+        perror(folder);
+        return -1;
+    }
+    struct dirent *dir;
+    while ((dir = readdir(d)) != NULL) {
+        size_t n = strlen(dir->d_name);
+        if (n < 4 || strcmp(dir->d_name + n - 4, ".txt") != 0) continue;
+        if (b->file_count == *capacity) {
+            int grown_capacity = *capacity ? *capacity * 2 : 64;
+            BenchFile *grown = (BenchFile *)realloc(b->files, (size_t)grown_capacity * sizeof(BenchFile));
+            if (grown == NULL) {
+                closedir(d);
+                return -1;
+            }
+            b->files = grown;
+            *capacity = grown_capacity;
+        }
+        BenchFile *f = &b->files[b->file_count++];
+        memset(f, 0, sizeof(*f));
+        snprintf(f->path, sizeof(f->path), "%s/%s", folder, dir->d_name);
+    }
+    closedir(d);
+    return 0;
+}
+
+int read_file(const char *path, char *buffer, size_t size) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) return -1;
+    size_t got = fread(buffer, 1, size, fp);
+    fclose(fp);
+    return (got == size) ? 0 : -1;
+}
+
+// Reads and parses every listed file and fills in the inputs of the later stages
+int load_corpus(Bench *b) {
+    qsort(b->files, (size_t)b->file_count, sizeof(BenchFile), compare_paths);
+    adc_records_init(&b->records);
+    int kept = 0;
+    for (int i = 0; i < b->file_count; i++) {
+        BenchFile f = b->files[i];
+        struct stat st;
+        if (stat(f.path, &st) != 0 || st.st_size <= 0) continue;
+        f.len = (size_t)st.st_size;
+        f.text = (char *)malloc(f.len);
+        if (f.text == NULL || read_file(f.path, f.text, f.len) != 0 ||
+            adc_parse_text(f.text, f.len, &b->records) != 0 || b->records.count == 0) {
+            free(f.text);
+            adc_records_clear(&b->records);
+            continue;
+        }
+        f.count = (int)b->records.count;
+        f.adc = (long *)malloc((size_t)f.count * sizeof(long));
+        f.raw_weights = (double *)malloc((size_t)f.count * sizeof(double));
+        f.filtered_weights = (double *)malloc((size_t)f.count * sizeof(double));
+        if (f.adc == NULL || f.raw_weights == NULL || f.filtered_weights == NULL) {
+            perror("Failed to allocate the corpus");
+            return -1;
+        }
+        memcpy(f.adc, b->records.adc, (size_t)f.count * sizeof(long));
+        adc_records_clear(&b->records);
+        BenchFile *kept_file = &b->files[kept++];
+        *kept_file = f;
+        const char *slash = strrchr(kept_file->path, '/');
+        kept_file->name = slash ? slash + 1 : kept_file->path;
+        b->bytes += f.len;
+        b->samples += (size_t)f.count;
+        b->windows += (size_t)(f.count / FFT_WINDOW_SIZE);
+        if (f.len > b->max_len) b->max_len = f.len;
+        if ((size_t)f.count > b->max_count) b->max_count = (size_t)f.count;
+    }
+    b->file_count = kept;
+    if (kept == 0) return -1;
+
+    b->buffer = (char *)malloc(b->max_len);
+    b->long_out = (long *)malloc(b->max_count * sizeof(long));
+    b->double_out = (double *)malloc(b->max_count * sizeof(double));
+    if (b->buffer == NULL || b->long_out == NULL || b->double_out == NULL) {
+        perror("Failed to allocate the stage buffers");
+        return -1;
+    }
+    for (int i = 0; i < kept; i++) {
+        BenchFile *f = &b->files[i];
+        fir_engine_reset(&fir_engine);
+        fir_engine_process(&fir_engine, f->adc, b->long_out, f->count);
+        adc_to_weights(&calibration.weight[0], f->adc, f->raw_weights, f->count);
+        adc_to_weights(&calibration.weight[0], b->long_out, f->filtered_weights, f->count);
+        float32_t dominant_hz;
+        f->fft_bins = compute_spectrum(f->raw_weights, f->count, BENCH_INTERVAL_MS, f->fft_magnitude, &dominant_hz);
+    }
+    return 0;
+}
+
+// Windowed-sinc low-pass with a Hamming window and unity DC gain (what scipy's firwin gives)
+void design_lowpass(float32_t *coeffs, double cutoff_hz, double sample_rate_hz) {
+    double fc = cutoff_hz / (sample_rate_hz / 2.0); // Fraction of Nyquist
+    double taps[FIR_NUM_TAPS], sum = 0.0;
+    for (int i = 0; i < FIR_NUM_TAPS; i++) {
+        double m = i - (FIR_NUM_TAPS - 1) / 2.0;
+        double sinc = (m == 0.0) ? 1.0 : sin(PI * fc * m) / (PI * fc * m);
+        double window = 0.54 - 0.46 * cos(2.0 * PI * i / (FIR_NUM_TAPS - 1));
+        taps[i] = fc * sinc * window;
+        sum += taps[i];
+    }
+    for (int i = 0; i < FIR_NUM_TAPS; i++) coeffs[i] = (float32_t)(taps[i] / sum);
+}
+
+void stage_read(Bench *b, int variant, uint64_t *check) {
+    (void)variant;
+    for (int i = 0; i < b->file_count; i++) {
+        if (read_file(b->files[i].path, b->buffer, b->files[i].len) != 0) {
+            fprintf(stderr, "Could not read %s\n", b->files[i].path);
+            exit(1);
+        }
+        if (check) *check = fnv1a(*check, b->buffer, b->files[i].len);
+    }
+}
+
+void stage_parse(Bench *b, int variant, uint64_t *check) {
+    (void)variant;
+    for (int i = 0; i < b->file_count; i++) {
+        adc_records_clear(&b->records);
+        adc_parse_text(b->files[i].text, b->files[i].len, &b->records);
+        if (check) *check = fnv1a(*check, b->records.adc, b->records.count * sizeof(long));
+    }
+}
+
+void stage_weights(Bench *b, int variant, uint64_t *check) {
+    (void)variant;
+    for (int i = 0; i < b->file_count; i++) {
+        adc_to_weights(&calibration.weight[0], b->files[i].adc, b->double_out, b->files[i].count);
+        if (check) *check = fnv1a(*check, b->double_out, (size_t)b->files[i].count * sizeof(double));
+    }
+}
+
+void stage_dc(Bench *b, int variant, uint64_t *check) {
+    (void)variant;
+    for (int i = 0; i < b->file_count; i++) {
+        adc_remove_offset(b->files[i].adc, adc_mean(b->files[i].adc, b->files[i].count), b->double_out, b->files[i].count);
+        if (check) *check = fnv1a(*check, b->double_out, (size_t)b->files[i].count * sizeof(double));
+    }
+}
+
+// variant: 0..1 moving average f32/q31, 2..3 low-pass f32/q31
+void stage_fir(Bench *b, int variant, uint64_t *check) {
+    FirEngine *engine = (variant < 2) ? &b->fir_ma[variant] : &b->fir_lp[variant - 2];
+    for (int i = 0; i < b->file_count; i++) {
+        fir_engine_reset(engine);
+        fir_engine_process(engine, b->files[i].adc, b->long_out, b->files[i].count);
+        if (check) *check = fnv1a(*check, b->long_out, (size_t)b->files[i].count * sizeof(long));
+    }
+}
+
+void stage_fft(Bench *b, int variant, uint64_t *check) {
+    (void)variant;
+    float32_t magnitude[FFT_WINDOW_SIZE / 2];
+    float32_t dominant_hz;
+    for (int i = 0; i < b->file_count; i++) {
+        for (int end = FFT_WINDOW_SIZE; end <= b->files[i].count; end += FFT_WINDOW_SIZE) {
+            int bins = compute_spectrum(b->files[i].raw_weights, end, BENCH_INTERVAL_MS, magnitude, &dominant_hz);
+            if (check) *check = fnv1a(*check, magnitude, (size_t)bins * sizeof(float32_t));
+        }
+    }
+}
+
+// Reads back the archive written for f and hashes it whole, then its filtered_weight and
+// fft_magnitude columns (a missing one hashes as a marker); adds its size to b->archive_bytes
+void check_archive(Bench *b, const BenchFile *f, uint64_t *check) {
+    char path[512];
+    output_file_path(path, sizeof(path), f->name, 0, 1, "bin");
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        *check = fnv1a(*check, "missing", 7);
+        return;
+    }
+    size_t len = (size_t)st.st_size;
+    if (len > b->archive_capacity) {
+        char *grown = (char *)realloc(b->archive, len);
+        if (grown == NULL) {
+            perror("Failed to allocate the archive check buffer");
+            exit(1);
+        }
+        b->archive = grown;
+        b->archive_capacity = len;
+    }
+    if (read_file(path, b->archive, len) != 0) {
+        fprintf(stderr, "Could not read back %s\n", path);
+        exit(1);
+    }
+    b->archive_bytes += len;
+    *check = fnv1a(*check, b->archive, len);
+    static const char *const columns[] = { "filtered_weight", "fft_magnitude" };
+    for (size_t c = 0; c < sizeof(columns) / sizeof(columns[0]); c++) {
+        ArchiveType type;
+        uint64_t count;
+        const void *values = archive_find_column(b->archive, len, columns[c], &type, &count);
+        if (values == NULL) {
+            *check = fnv1a(*check, "no column", 9);
+        } else {
+            *check = fnv1a(*check, values, (size_t)count * archive_type_bytes(type));
+        }
+    }
+}
+
+void stage_write(Bench *b, int variant, uint64_t *check) {
+    (void)variant;
+    if (check) b->archive_bytes = 0;
+    for (int i = 0; i < b->file_count; i++) {
+        BenchFile *f = &b->files[i];
+        write_weight_archive(f->name, 0, 1, BENCH_INTERVAL_MS, f->raw_weights, f->filtered_weights, f->count, f->fft_magnitude, f->fft_bins);
+        if (check) check_archive(b, f, check);
+    }
+}
+
+// Runs a whole file through the pipeline from a clean filter, as reprocess does
+void process_file(Bench *b, BenchFile *f, const char *content, uint64_t *check) {
+    DspContext dsp = { &b->worker.fir, &b->worker.bank, &b->worker.stats, &b->worker.arena, &b->worker.records };
+    fir_engine_reset(dsp.fir);
+    process_data(content, f->len, f->name, BENCH_INTERVAL_MS, &dsp);
+    if (check) check_archive(b, f, check);
+}
+
+void stage_e2e_disk(Bench *b, int variant, uint64_t *check) {
+    (void)variant;
+    for (int i = 0; i < b->file_count; i++) {
+        if (read_file(b->files[i].path, b->buffer, b->files[i].len) != 0) {
+            fprintf(stderr, "Could not read %s\n", b->files[i].path);
+            exit(1);
+        }
+        process_file(b, &b->files[i], b->buffer, check);
+    }
+}
+
+int send_all(int sock, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int recv_all(int sock, char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(sock, data, len, 0);
+        if (n <= 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Loopback sender: every 'g' from the receiver sends the corpus, each file as a 4-byte
+// little-endian length and its bytes; anything else ends the thread
+typedef struct {
+    Bench *bench;
+    int sock;
+} TcpSender;
+
+void *tcp_sender_main(void *arg) {
+    TcpSender *sender = (TcpSender *)arg;
+    Bench *b = sender->bench;
+    char command;
+    while (recv(sender->sock, &command, 1, 0) == 1 && command == 'g') {
+        for (int i = 0; i < b->file_count; i++) {
+            uint8_t header[4];
+            put_le32(header, (uint32_t)b->files[i].len);
+            if (send_all(sender->sock, (const char *)header, sizeof(header)) != 0 ||
+                send_all(sender->sock, b->files[i].text, b->files[i].len) != 0) {
+                break;
+            }
+        }
+    }
+    close(sender->sock);
+    free(sender);
+    return NULL;
+}
+
+// Connects a sender thread to b->tcp_sock over 127.0.0.1. Returns 0, or -1 with the reason printed.
+int start_tcp(Bench *b) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = 0; // Any free port
+    socklen_t addr_len = sizeof(addr);
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0 ||
+        getsockname(listener, (struct sockaddr *)&addr, &addr_len) != 0) {
+        perror("Loopback listener");
+        if (listener >= 0) close(listener);
+        return -1;
+    }
+    b->tcp_sock = socket(AF_INET, SOCK_STREAM, 0);
+    TcpSender *sender = (TcpSender *)malloc(sizeof(TcpSender));
+    if (b->tcp_sock < 0 || sender == NULL || connect(b->tcp_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        (sender->sock = accept(listener, NULL, NULL)) < 0) {
+        perror("Loopback connection");
+        close(listener);
+        free(sender);
+        return -1;
+    }
+    close(listener);
+    sender->bench = b;
+    if (pthread_create(&b->tcp_sender, NULL, tcp_sender_main, sender) != 0) {
+        fprintf(stderr, "Could not start the loopback sender thread.\n");
+        close(sender->sock);
+        free(sender);
+        return -1;
+    }
+    return 0;
+}
+
+// variant 0: receive only; 1: process every file as it arrives
+void stage_tcp(Bench *b, int variant, uint64_t *check) {
+    if (send_all(b->tcp_sock, "g", 1) != 0) {
+        fprintf(stderr, "Loopback sender went away.\n");
+        exit(1);
+    }
+    for (int i = 0; i < b->file_count; i++) {
+        uint8_t header[4];
+        if (recv_all(b->tcp_sock, (char *)header, sizeof(header)) != 0 || get_le32(header) != b->files[i].len ||
+            recv_all(b->tcp_sock, b->buffer, b->files[i].len) != 0) {
+            fprintf(stderr, "Loopback transfer failed.\n");
+            exit(1);
+        }
+        if (variant == 1) {
+            process_file(b, &b->files[i], b->buffer, check);
+        } else if (check) {
+            *check = fnv1a(*check, b->buffer, b->files[i].len);
+        }
+    }
+}
+
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void run_stage(Bench *b, const BenchStage *stage, int iterations, const char *label) {
+    double times[256];
+    if (iterations > 256) iterations = 256;
+    stage->run(b, stage->variant, NULL); // Warm-up: page cache, arenas, branch predictors
+    for (int it = 0; it < iterations; it++) {
+        double start = monotonic_seconds();
+        stage->run(b, stage->variant, NULL);
+        times[it] = monotonic_seconds() - start;
+    }
+    uint64_t check = FNV_OFFSET;
+    stage->run(b, stage->variant, &check);
+    qsort(times, (size_t)iterations, sizeof(double), compare_doubles);
+    double best = times[0];
+    double median = (iterations % 2) ? times[iterations / 2] : (times[iterations / 2 - 1] + times[iterations / 2]) / 2.0;
+    size_t items = (stage->items == 1) ? b->windows : (stage->items == 2) ? (size_t)b->file_count : b->samples;
+    size_t bytes = (stage->counts_bytes == 2) ? b->archive_bytes : stage->counts_bytes ? b->bytes : 0;
+    printf("BENCH stage=%s items=%lu bytes=%lu iterations=%d best_s=%.6f median_s=%.6f ns_per_item=%.2f mb_per_s=%.2f check=%016llx label=%s\n",
+           stage->name, (unsigned long)items, (unsigned long)bytes, iterations, best, median,
+           items ? best * 1e9 / (double)items : 0.0, best > 0.0 ? bytes / best / 1e6 : 0.0, (unsigned long long)check, label);
+    fflush(stdout);
+}
+
+// --compare: a BENCH line's stage, best_s and check
+typedef struct {
+    char stage[64];
+    double best_s;
+    char check[32];
+} BenchResult;
+
+// Reads the BENCH lines of a run, and the corpus hash of its BENCH_CONFIG line into corpus
+int load_results(const char *path, BenchResult *results, int max_results, char *corpus, size_t corpus_size) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    char line[LINE_SIZE];
+    int count = 0;
+    snprintf(corpus, corpus_size, "?");
+    while (fgets(line, sizeof(line), fp) != NULL && count < max_results) {
+        const char *hash = strstr(line, " corpus=");
+        if (strncmp(line, "BENCH_CONFIG ", 13) == 0 && hash != NULL) {
+            size_t n = strcspn(hash + 8, " \r\n");
+            snprintf(corpus, corpus_size, "%.*s", (int)n, hash + 8);
+        }
+        if (strncmp(line, "BENCH ", 6) != 0) continue;
+        BenchResult *r = &results[count];
+        const char *stage = strstr(line, " stage="), *best = strstr(line, " best_s="), *check = strstr(line, " check=");
+        if (stage == NULL || best == NULL || check == NULL ||
+            sscanf(stage, " stage=%63s", r->stage) != 1 || sscanf(best, " best_s=%lf", &r->best_s) != 1 ||
+            sscanf(check, " check=%31s", r->check) != 1) {
+            continue;
+        }
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+// Prints base against new stage by stage. Returns 1 if a stage got slower than the
+// threshold or its check changed, 2 if the runs can't be compared, else 0.
+int compare_results(const char *base_path, const char *new_path, double threshold_percent) {
+    BenchResult base[MAX_STAGES], current[MAX_STAGES];
+    char base_corpus[32], current_corpus[32];
+    int base_count = load_results(base_path, base, MAX_STAGES, base_corpus, sizeof(base_corpus));
+    int current_count = load_results(new_path, current, MAX_STAGES, current_corpus, sizeof(current_corpus));
+    if (base_count < 0 || current_count < 0) return 2;
+    if (strcmp(base_corpus, current_corpus) != 0) {
+        fprintf(stderr, "The runs used different recordings (corpus %s and %s).\n", base_corpus, current_corpus);
+        return 2;
+    }
+    int failed = 0;
+    printf("%-12s %12s %12s %9s  %s\n", "stage", "base ms", "new ms", "change", "");
+    for (int i = 0; i < current_count; i++) {
+        const BenchResult *old = NULL;
+        for (int j = 0; j < base_count; j++) {
+            if (strcmp(base[j].stage, current[i].stage) == 0) old = &base[j];
+        }
+        if (old == NULL) {
+            printf("%-12s %12s %12.3f %9s  new stage\n", current[i].stage, "-", current[i].best_s * 1000.0, "-");
+            continue;
+        }
+        double change = (old->best_s > 0.0) ? (current[i].best_s / old->best_s - 1.0) * 100.0 : 0.0;
+        const char *verdict = "";
+        if (strcmp(old->check, current[i].check) != 0) {
+            verdict = "OUTPUT CHANGED";
+            failed = 1;
+        } else if (change > threshold_percent) {
+            verdict = "REGRESSION";
+            failed = 1;
+        }
+        printf("%-12s %12.3f %12.3f %+8.1f%%  %s\n", current[i].stage, old->best_s * 1000.0, current[i].best_s * 1000.0, change, verdict);
+    }
+    return failed;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 4 && strcmp(argv[1], "--compare") == 0) {
+        return compare_results(argv[2], argv[3], (argc > 4) ? atof(argv[4]) : DEFAULT_THRESHOLD_PERCENT);
+    }
+    int iterations = DEFAULT_ITERATIONS;
+    const char *label = "-";
+    int opt;
+    output_folder = DEFAULT_SCRATCH_FOLDER;
+    while ((opt = getopt(argc, argv, "n:l:o:")) != -1) {
+        switch (opt) {
+        case 'n': iterations = atoi(optarg); break;
+        case 'l': label = optarg; break;
+        case 'o': output_folder = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-n iterations] [-l label] [-o scratch_folder] [data_folder ...]\n"
+                            "       %s --compare base.txt new.txt [threshold_percent]\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if (iterations < 1) iterations = 1;
+
+    static char folders[MAX_FOLDERS][512];
+    int folder_count = 0;
+    for (int i = optind; i < argc && folder_count < MAX_FOLDERS; i++) {
+        snprintf(folders[folder_count++], sizeof(folders[0]), "%s", argv[i]);
+    }
+    if (folder_count == 0) folder_count = find_default_folders(folders, MAX_FOLDERS);
+
+    static Bench b;
+    int capacity = 0;
+    for (int i = 0; i < folder_count; i++) {
+        if (list_folder(&b, folders[i], &capacity) != 0) return 1;
+    }
+    if (init_calibration(NULL) != 0) return 1;
+    init_fir_stage();
+    init_fft_stage();
+    if (load_corpus(&b) != 0) {
+        fprintf(stderr, "No ADC samples loaded.\n");
+        return 1;
+    }
+    ensure_output_folder();
+
+    float32_t lowpass[FIR_NUM_TAPS];
+    design_lowpass(lowpass, BENCH_CUTOFF_HZ, 1000.0 / BENCH_INTERVAL_MS);
+    fir_engine_init(&b.fir_ma[0], FIR_PATH_F32, fir_engine.coeffs_f32);
+    fir_engine_init(&b.fir_ma[1], FIR_PATH_Q31, fir_engine.coeffs_f32);
+    fir_engine_init(&b.fir_lp[0], FIR_PATH_F32, lowpass);
+    fir_engine_init(&b.fir_lp[1], FIR_PATH_Q31, lowpass);
+    file_worker_init(&b.worker);
+    if (start_tcp(&b) != 0) return 1;
+
+    uint64_t corpus = FNV_OFFSET;
+    for (int i = 0; i < b.file_count; i++) corpus = fnv1a(corpus, b.files[i].text, b.files[i].len);
+    printf("BENCH_CONFIG folders=%d files=%d bytes=%lu samples=%lu corpus=%016llx iterations=%d fir_taps=%d fir_block=%d fir_path=%s "
+           "fft_size=%d weight_simd=%s label=%s\n",
+           folder_count, b.file_count, (unsigned long)b.bytes, (unsigned long)b.samples, (unsigned long long)corpus, iterations,
+           FIR_NUM_TAPS, FIR_BLOCK_SIZE, fir_path_name(FIR_PATH), FFT_WINDOW_SIZE, weight_kernels()->name, label);
+    fflush(stdout);
+
+    static const BenchStage stages[] = {
+        { "read", stage_read, 0, 2, 1 },
+        { "parse", stage_parse, 0, 0, 1 },
+        { "weights", stage_weights, 0, 0, 0 },
+        { "dc", stage_dc, 0, 0, 0 },
+        { "fir_ma_f32", stage_fir, 0, 0, 0 },
+        { "fir_ma_q31", stage_fir, 1, 0, 0 },
+        { "fir_lp_f32", stage_fir, 2, 0, 0 },
+        { "fir_lp_q31", stage_fir, 3, 0, 0 },
+        { "fft", stage_fft, 0, 1, 0 },
+        { "write", stage_write, 0, 0, 2 },
+        { "tcp", stage_tcp, 0, 2, 1 },
+        { "e2e_disk", stage_e2e_disk, 0, 0, 1 },
+        { "e2e_tcp", stage_tcp, 1, 0, 1 },
+    };
+    for (size_t s = 0; s < sizeof(stages) / sizeof(stages[0]); s++) {
+        run_stage(&b, &stages[s], iterations, label);
+    }
+
+    send_all(b.tcp_sock, "q", 1);
+    pthread_join(b.tcp_sender, NULL);
+    close(b.tcp_sock);
+    for (int i = 0; i < b.file_count; i++) {
+        free(b.files[i].text);
+        free(b.files[i].adc);
+        free(b.files[i].raw_weights);
+        free(b.files[i].filtered_weights);
+    }
+    free(b.files);
+    free(b.buffer);
+    free(b.long_out);
+    free(b.double_out);
+    free(b.archive);
+    adc_records_free(&b.records);
+    adc_records_free(&b.worker.records);
+    dsp_arena_free(&b.worker.arena);
+    return 0;
+}
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+
+#ifdef _WIN32
+#include <windows.h> // For QueryPerformanceCounter
+#else
+#include <time.h>    // For clock_gettime
+#endif
+
+#include "adc_parser.h"
+#include "weight_kernels.h"
+
+// Microbenchmark: the weight_kernels.h calibration and DC-mean kernels (every SIMD level
+// this CPU runs) against the per-sample normalize_to_weight() division and the float32
+// running mean the clients used before. Parses every .txt file in the data folder once,
+// then times repeated passes over all of their samples, and checks the results.
+//
+// Usage: bench_weights [data_folder] [iterations]
+
+// Configuration
+#define DEFAULT_DATA_FOLDER "../09-07-2025/adc_data"
+#define DEFAULT_ITERATIONS 20
+
+// c2.c's calibration
+#define ZERO_CAL -0.0006981067708
+#define SCALE_CAL 0.00000452466566
+
+typedef struct {
+    long *adc;
+    int count;
+} LoadedFile;
+
+double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+// The previous per-sample conversion, kept verbatim for comparison
+double legacy_normalize_to_weight(long adc_value) {
+    double data_in = (double)adc_value / (double)0x80000000;
+    if (SCALE_CAL == 0) return 0.0; // Avoid division by zero
+    return (data_in - ZERO_CAL) / SCALE_CAL;
+}
+
+// The previous c2.c DC mean: a float32 running sum
+float legacy_mean_f32(const long *adc, int count) {
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++) sum += (float)adc[i];
+    return sum / (float)count;
+}
+
+int load_folder(const char *folder, LoadedFile **files_out, int *count_out, size_t *samples_out) {
+    DIR *d = opendir(folder);
+    if (d == NULL) {
+        perror("Could not open data directory");
+        return -1;
+    }
+    LoadedFile *files = NULL;
+    int count = 0;
+    size_t samples = 0;
+    struct dirent *dir;
+    while ((dir = readdir(d)) != NULL) {
+        if (strstr(dir->d_name, ".txt") == NULL) {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", folder, dir->d_name);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            continue;
+        }
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        char *text = (char *)malloc((size_t)len + 1);
+        if (text == NULL || fread(text, 1, (size_t)len, f) != (size_t)len) {
+            fclose(f);
+            free(text);
+            continue;
+        }
+        fclose(f);
+        AdcRecords records;
+        adc_records_init(&records);
+        LoadedFile *grown = (LoadedFile *)realloc(files, (count + 1) * sizeof(LoadedFile));
+        if (grown == NULL || adc_parse_text(text, (size_t)len, &records) != 0 || records.count == 0) {
+            free(text);
+            adc_records_free(&records);
+            if (grown) files = grown;
+            continue;
+        }
+        free(text);
+        files = grown;
+        files[count].adc = (long *)malloc(records.count * sizeof(long));
+        if (files[count].adc == NULL) {
+            adc_records_free(&records);
+            continue;
+        }
+        memcpy(files[count].adc, records.adc, records.count * sizeof(long));
+        files[count].count = (int)records.count;
+        samples += records.count;
+        count++;
+        adc_records_free(&records);
+    }
+    closedir(d);
+    *files_out = files;
+    *count_out = count;
+    *samples_out = samples;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *folder = (argc > 1) ? argv[1] : DEFAULT_DATA_FOLDER;
+    int iterations = (argc > 2) ? atoi(argv[2]) : DEFAULT_ITERATIONS;
+    if (iterations < 1) iterations = 1;
+
+    LoadedFile *files = NULL;
+    int file_count = 0;
+    size_t total_samples = 0;
+    if (load_folder(folder, &files, &file_count, &total_samples) != 0 || file_count == 0) {
+        fprintf(stderr, "No ADC samples loaded from %s\n", folder);
+        return 1;
+    }
+    int max_count = 0;
+    for (int i = 0; i < file_count; i++) {
+        if (files[i].count > max_count) max_count = files[i].count;
+    }
+    double *reference = (double *)malloc(max_count * sizeof(double));
+    double *weights = (double *)malloc(max_count * sizeof(double));
+    if (reference == NULL || weights == NULL) {
+        perror("Failed to allocate weight buffers");
+        return 1;
+    }
+    printf("Loaded %d files, %lu samples from %s; %d iterations; dispatch picks %s\n", file_count,
+           (unsigned long)total_samples, folder, iterations, weight_kernels()->name);
+
+    // Accuracy: calibration against the division, means against the exact integer mean
+    static const WeightCalibration cal = WEIGHT_CALIBRATION(ZERO_CAL, SCALE_CAL);
+    double max_weight_error = 0.0, max_f32_mean_error = 0.0;
+    for (int i = 0; i < file_count; i++) {
+        int64_t exact_sum = 0;
+        for (int k = 0; k < files[i].count; k++) {
+            reference[k] = legacy_normalize_to_weight(files[i].adc[k]);
+            exact_sum += files[i].adc[k];
+        }
+        double exact_mean = (double)exact_sum / files[i].count;
+        double f32_error = fabs((double)legacy_mean_f32(files[i].adc, files[i].count) - exact_mean);
+        if (f32_error > max_f32_mean_error) max_f32_mean_error = f32_error;
+
+        for (int level = 0; level < WEIGHT_SIMD_COUNT; level++) {
+            const WeightKernels *k = weight_kernels_for((WeightSimd)level);
+            if (k == NULL) continue;
+            k->affine(files[i].adc, files[i].count, cal.scale, cal.offset, weights);
+            for (int s = 0; s < files[i].count; s++) {
+                double error = fabs(weights[s] - reference[s]);
+                if (error > max_weight_error) max_weight_error = error;
+            }
+            if (k->sum(files[i].adc, files[i].count) != exact_sum) {
+                fprintf(stderr, "%s sum disagrees on file %d\n", k->name, i);
+                return 1;
+            }
+        }
+    }
+    printf("Largest weight difference from the division: %.3g kg\n", max_weight_error);
+    printf("Largest float32 running-mean error: %.1f ADC counts (integer mean is exact)\n", max_f32_mean_error);
+
+    double best_legacy_weights = 1e30, best_legacy_mean = 1e30;
+    double best_weights[WEIGHT_SIMD_COUNT], best_mean[WEIGHT_SIMD_COUNT];
+    for (int level = 0; level < WEIGHT_SIMD_COUNT; level++) best_weights[level] = best_mean[level] = 1e30;
+    volatile double sink = 0.0; // Keeps the mean loops from being optimised away
+    for (int it = 0; it < iterations; it++) {
+        double t0 = now_seconds();
+        for (int i = 0; i < file_count; i++) {
+            for (int s = 0; s < files[i].count; s++) weights[s] = legacy_normalize_to_weight(files[i].adc[s]);
+        }
+        double t1 = now_seconds();
+        for (int i = 0; i < file_count; i++) sink += legacy_mean_f32(files[i].adc, files[i].count);
+        double t2 = now_seconds();
+        if (t1 - t0 < best_legacy_weights) best_legacy_weights = t1 - t0;
+        if (t2 - t1 < best_legacy_mean) best_legacy_mean = t2 - t1;
+
+        for (int level = 0; level < WEIGHT_SIMD_COUNT; level++) {
+            const WeightKernels *k = weight_kernels_for((WeightSimd)level);
+            if (k == NULL) continue;
+            double t3 = now_seconds();
+            for (int i = 0; i < file_count; i++) k->affine(files[i].adc, files[i].count, cal.scale, cal.offset, weights);
+            double t4 = now_seconds();
+            for (int i = 0; i < file_count; i++) sink += (double)k->sum(files[i].adc, files[i].count);
+            double t5 = now_seconds();
+            if (t4 - t3 < best_weights[level]) best_weights[level] = t4 - t3;
+            if (t5 - t4 < best_mean[level]) best_mean[level] = t5 - t4;
+        }
+    }
+
+    printf("%-30s %10s %14s %10s\n", "kernel", "best ms", "samples/s", "speedup");
+    printf("%-30s %10.3f %14.0f %10s\n", "weights: division per sample", best_legacy_weights * 1000.0,
+           total_samples / best_legacy_weights, "1.0x");
+    for (int level = 0; level < WEIGHT_SIMD_COUNT; level++) {
+        if (best_weights[level] >= 1e30) continue;
+        char label[64];
+        snprintf(label, sizeof(label), "weights: %s", weight_kernel_table[level].name);
+        printf("%-30s %10.3f %14.0f %9.1fx\n", label, best_weights[level] * 1000.0, total_samples / best_weights[level],
+               best_legacy_weights / best_weights[level]);
+    }
+    printf("%-30s %10.3f %14.0f %10s\n", "mean: float32 running sum", best_legacy_mean * 1000.0,
+           total_samples / best_legacy_mean, "1.0x");
+    for (int level = 0; level < WEIGHT_SIMD_COUNT; level++) {
+        if (best_mean[level] >= 1e30) continue;
+        char label[64];
+        snprintf(label, sizeof(label), "mean: %s int64 sum", weight_kernel_table[level].name);
+        printf("%-30s %10.3f %14.0f %9.1fx\n", label, best_mean[level] * 1000.0, total_samples / best_mean[level],
+               best_legacy_mean / best_mean[level]);
+    }
+
+    for (int i = 0; i < file_count; i++) {
+        free(files[i].adc);
+    }
+    free(files);
+    free(reference);
+    free(weights);
+    return 0;
+}
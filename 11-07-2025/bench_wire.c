@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+
+#ifdef _WIN32
+#include <windows.h> // For QueryPerformanceCounter
+#else
+#include <time.h>    // For clock_gettime
+#endif
+
+#include "adc_parser.h"
+#include "adc_protocol.h"
+
+// Microbenchmark: the three wire encodings on real recordings. Reads every .txt file in
+// the data folder, encodes its ADC samples as adc32 and delta frames, checks that both
+// decode back to the same samples and that a paced replay resumed mid-stream cuts them
+// where an uninterrupted one does, then prints the size of each encoding and the best
+// encode/decode throughput over the iterations (text is "decoded" by adc_parse_text).
+//
+// Usage: bench_wire [data_folder] [iterations]
+
+// Configuration
+#define DEFAULT_DATA_FOLDER "../09-07-2025/adc_data"
+#define DEFAULT_ITERATIONS 5
+#define BENCH_SAMPLE_RATE_MHZ 10000 // 100 ms between samples, as recorded
+#define RESUME_POINTS 64            // Resume offsets checked per file and encoding
+#define RESUME_TICK_SAMPLES 7       // Samples per pacer tick in the resume check
+
+typedef struct {
+    char *text;
+    size_t len;
+    int32_t *samples;
+    size_t count;
+    uint8_t *frames;        // adc32 encoding
+    size_t frames_len;
+    uint8_t *delta;         // delta encoding
+    size_t delta_len;
+} LoadedFile;
+
+double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+int load_folder(const char *folder, LoadedFile **files_out, int *count_out, size_t *bytes_out) {
+    DIR *d = opendir(folder);
+    if (d == NULL) {
+        perror("Could not open data directory");
+        return -1;
+    }
+    LoadedFile *files = NULL;
+    int count = 0;
+    size_t bytes = 0;
+    struct dirent *dir;
+    while ((dir = readdir(d)) != NULL) {
+        if (strstr(dir->d_name, ".txt") == NULL) {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", folder, dir->d_name);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL) {
+            continue;
+        }
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        char *text = (char *)malloc((size_t)len + 1);
+        LoadedFile *grown = (LoadedFile *)realloc(files, (count + 1) * sizeof(LoadedFile));
+        if (text == NULL || grown == NULL || fread(text, 1, (size_t)len, f) != (size_t)len) {
+            fclose(f);
+            free(text);
+            if (grown) files = grown;
+            continue;
+        }
+        fclose(f);
+        text[len] = '\0';
+        files = grown;
+        memset(&files[count], 0, sizeof(LoadedFile));
+        files[count].text = text;
+        files[count].len = (size_t)len;
+        count++;
+        bytes += (size_t)len;
+    }
+    closedir(d);
+    *files_out = files;
+    *count_out = count;
+    *bytes_out = bytes;
+    return 0;
+}
+
+// Parses the file and fills in both binary encodings. Returns 0, or -1 if out of memory.
+int prepare_file(LoadedFile *file) {
+    AdcRecords records;
+    adc_records_init(&records);
+    if (adc_parse_text(file->text, file->len, &records) != 0) {
+        adc_records_free(&records);
+        return -1;
+    }
+    file->count = records.count;
+    file->samples = (int32_t *)malloc((records.count + 1) * sizeof(int32_t));
+    file->frames = (uint8_t *)malloc(adc_frames_size(records.count) + 1);
+    file->delta = (uint8_t *)malloc(adc_delta_max_size(records.count) + 1);
+    if (file->samples == NULL || file->frames == NULL || file->delta == NULL) {
+        adc_records_free(&records);
+        return -1;
+    }
+    for (size_t k = 0; k < records.count; k++) {
+        file->samples[k] = (int32_t)records.adc[k];
+    }
+    adc_records_free(&records);
+    file->frames_len = adc_frames_encode(file->samples, file->count, BENCH_SAMPLE_RATE_MHZ, file->frames);
+    file->delta_len = adc_delta_encode(file->samples, file->count, BENCH_SAMPLE_RATE_MHZ, file->delta);
+    return 0;
+}
+
+// Both binary encodings must give back exactly the parsed samples
+int check_file(const LoadedFile *file, long *scratch) {
+    const uint8_t *content[2] = { file->frames, file->delta };
+    size_t len[2] = { file->frames_len, file->delta_len };
+    WireEncoding encoding[2] = { ENCODING_ADC32, ENCODING_DELTA };
+    for (int e = 0; e < 2; e++) {
+        uint32_t rate = 0;
+        long got = adc_binary_decode(content[e], len[e], encoding[e], scratch, &rate);
+        if (got != (long)file->count || (file->count > 0 && rate != BENCH_SAMPLE_RATE_MHZ)) {
+            return -1;
+        }
+        for (size_t k = 0; k < file->count; k++) {
+            if (scratch[k] != (long)file->samples[k]) return -1;
+        }
+    }
+    return 0;
+}
+
+// Cut point after `samples` more samples from offset, as send_paced_content() takes it
+size_t sample_end(WireEncoding encoding, const uint8_t *content, size_t len, size_t offset, uint16_t *left, size_t next,
+                  size_t samples) {
+    return (encoding == ENCODING_DELTA) ? adc_delta_offset(content, len, offset, left, samples) : adc_frames_offset(next);
+}
+
+// A paced replay resumed at byte `start` (server.c send_paced_content(): probe each next sample
+// on a copy of the frame state, skip the ones wholly before start, then tick) must cut the
+// stream at the same sample boundaries as one that was never interrupted. ends is scratch for
+// the uninterrupted cut points, count + 1 entries.
+int check_resume(const uint8_t *content, size_t len, WireEncoding encoding, size_t count, size_t *ends) {
+    if (count < 2) return 0;
+    size_t offset = 0;
+    uint16_t left = 0;
+    ends[0] = 0;
+    for (size_t k = 1; k <= count; k++) {
+        offset = (k >= count) ? len : sample_end(encoding, content, len, offset, &left, k, 1);
+        ends[k] = offset;
+    }
+    size_t stride = (count + RESUME_POINTS - 1) / RESUME_POINTS;
+    for (size_t r = 1; r < count; r += stride) {
+        for (int mid = 0; mid < 2; mid++) {     // Resume exactly at a sample boundary, then one byte into the sample after it
+            size_t start = ends[r] + (size_t)mid;
+            size_t resumed = r;                 // Samples wholly before start (a 1-byte delta sample can be)
+            while (resumed + 1 < count && ends[resumed + 1] <= start) resumed++;
+            size_t next = 0;
+            uint16_t delta_left = 0;
+            offset = 0;
+            while (next < count) {
+                uint16_t probe = delta_left;
+                size_t end = (next + 1 >= count) ? len : sample_end(encoding, content, len, offset, &probe, next + 1, 1);
+                if (end > start) break;
+                offset = end;
+                delta_left = probe;
+                next++;
+            }
+            if (next != resumed || offset != ends[resumed]) return -1;
+            while (next < count) {
+                size_t n = (count - next < RESUME_TICK_SAMPLES) ? count - next : RESUME_TICK_SAMPLES;
+                next += n;
+                size_t end = (next >= count) ? len : sample_end(encoding, content, len, offset, &delta_left, next, n);
+                if (end != ends[next]) return -1;
+                offset = end;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *folder = (argc > 1) ? argv[1] : DEFAULT_DATA_FOLDER;
+    int iterations = (argc > 2) ? atoi(argv[2]) : DEFAULT_ITERATIONS;
+    if (iterations < 1) iterations = 1;
+
+    LoadedFile *files = NULL;
+    int file_count = 0;
+    size_t text_bytes = 0;
+    if (load_folder(folder, &files, &file_count, &text_bytes) != 0 || file_count == 0) {
+        fprintf(stderr, "No .txt files loaded from %s\n", folder);
+        return 1;
+    }
+
+    size_t total_samples = 0, frames_bytes = 0, delta_bytes = 0, max_count = 0;
+    for (int i = 0; i < file_count; i++) {
+        if (prepare_file(&files[i]) != 0) {
+            fprintf(stderr, "Out of memory preparing file %d\n", i);
+            return 1;
+        }
+        total_samples += files[i].count;
+        frames_bytes += files[i].frames_len;
+        delta_bytes += files[i].delta_len;
+        if (files[i].count > max_count) max_count = files[i].count;
+    }
+    long *scratch = (long *)malloc((max_count + 1) * sizeof(long));
+    size_t *ends = (size_t *)malloc((max_count + 1) * sizeof(size_t));
+    if (scratch == NULL || ends == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < file_count; i++) {
+        if (check_file(&files[i], scratch) != 0) {
+            fprintf(stderr, "Round trip failed on file %d (%lu samples)\n", i, (unsigned long)files[i].count);
+            return 1;
+        }
+        if (check_resume(files[i].frames, files[i].frames_len, ENCODING_ADC32, files[i].count, ends) != 0 ||
+            check_resume(files[i].delta, files[i].delta_len, ENCODING_DELTA, files[i].count, ends) != 0) {
+            fprintf(stderr, "Resumed replay cuts differently on file %d (%lu samples)\n", i, (unsigned long)files[i].count);
+            return 1;
+        }
+    }
+    printf("Loaded %d files, %lu ADC samples from %s; %d iterations; both binary encodings round-trip and resume\n",
+           file_count, (unsigned long)total_samples, folder, iterations);
+
+    double best_encode[3] = { 0, 1e30, 1e30 }, best_decode[3] = { 1e30, 1e30, 1e30 };
+    for (int it = 0; it < iterations; it++) {
+        double t0 = now_seconds();
+        for (int i = 0; i < file_count; i++) {
+            adc_frames_encode(files[i].samples, files[i].count, BENCH_SAMPLE_RATE_MHZ, files[i].frames);
+        }
+        double t1 = now_seconds();
+        for (int i = 0; i < file_count; i++) {
+            adc_delta_encode(files[i].samples, files[i].count, BENCH_SAMPLE_RATE_MHZ, files[i].delta);
+        }
+        double t2 = now_seconds();
+        for (int i = 0; i < file_count; i++) {
+            AdcRecords records;
+            adc_records_init(&records);
+            adc_parse_text(files[i].text, files[i].len, &records);
+            adc_records_free(&records);
+        }
+        double t3 = now_seconds();
+        uint32_t rate;
+        for (int i = 0; i < file_count; i++) {
+            adc_frames_decode(files[i].frames, files[i].frames_len, scratch, &rate);
+        }
+        double t4 = now_seconds();
+        for (int i = 0; i < file_count; i++) {
+            adc_delta_decode(files[i].delta, files[i].delta_len, scratch, &rate);
+        }
+        double t5 = now_seconds();
+        if (t1 - t0 < best_encode[1]) best_encode[1] = t1 - t0;
+        if (t2 - t1 < best_encode[2]) best_encode[2] = t2 - t1;
+        if (t3 - t2 < best_decode[0]) best_decode[0] = t3 - t2;
+        if (t4 - t3 < best_decode[1]) best_decode[1] = t4 - t3;
+        if (t5 - t4 < best_decode[2]) best_decode[2] = t5 - t4;
+    }
+
+    // Throughput in samples per second, so the three rows compare directly
+    const char *names[3] = { ENCODING_NAME_TEXT, ENCODING_NAME_ADC32, ENCODING_NAME_DELTA };
+    size_t sizes[3] = { text_bytes, frames_bytes, delta_bytes };
+    printf("%-10s %14s %10s %10s %16s %16s\n", "encoding", "bytes", "vs text", "B/sample", "encode Msample/s", "decode Msample/s");
+    for (int e = 0; e < 3; e++) {
+        char encode_rate[32];
+        if (e == 0) {
+            snprintf(encode_rate, sizeof(encode_rate), "-");
+        } else {
+            snprintf(encode_rate, sizeof(encode_rate), "%.1f", total_samples / 1e6 / best_encode[e]);
+        }
+        printf("%-10s %14lu %9.2fx %10.2f %16s %16.1f\n", names[e], (unsigned long)sizes[e],
+               (double)text_bytes / (double)sizes[e], (double)sizes[e] / (double)total_samples, encode_rate,
+               total_samples / 1e6 / best_decode[e]);
+    }
+
+    for (int i = 0; i < file_count; i++) {
+        free(files[i].text);
+        free(files[i].samples);
+        free(files[i].frames);
+        free(files[i].delta);
+    }
+    free(files);
+    free(scratch);
+    free(ends);
+    return 0;
+}
@@ -0,0 +1,282 @@
+// Broadcast hub: one publisher, any number of subscribers, every byte prepared once.
+//
+// The publisher (the live serial source, or the server's broadcast replay of the catalog)
+// puts its data out as segments: named files whose content is prepared once per wire
+// encoding, in buffers of their final length that fill as samples come in. Segments are
+// reference counted. The hub holds the BROADCAST_SEGMENTS newest; a subscriber holds the
+// one it is sending and sends straight from the shared buffer, with no copy and no
+// encoding of its own, so each extra subscriber costs its send() calls and nothing more.
+//
+// The publisher never waits for a subscriber. Each subscriber reads through its own
+// cursor, and one that falls BROADCAST_MAX_LAG segments behind the newest is slow and gets
+// the hub's policy. BROADCAST_SLOW_DROP lets it finish the segment it is in (its file
+// header promised the length) and then jumps it to the newest segment, counting the ones
+// it missed. BROADCAST_SLOW_DISCONNECT ends its subscription.
+//
+// An optional tap sees every sample as it is published, e.g. for UDP multicast, and an
+// optional notify hook runs whenever there is something new, for subscribers that are
+// served from an event loop (broadcast_next() with timeout 0) instead of waiting in it.
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>    // For CRITICAL_SECTION, CONDITION_VARIABLE
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "adc_protocol.h" // WireEncoding
+
+#define BROADCAST_SEGMENTS 8        // Newest segments kept by the hub
+#define BROADCAST_MAX_LAG 4         // A subscriber this many segments behind is slow (< BROADCAST_SEGMENTS)
+#define BROADCAST_ENCODINGS 2       // ENCODING_TEXT and ENCODING_ADC32
+
+#define BROADCAST_SLOW_DROP 0       // Slow subscribers skip to the newest segment
+#define BROADCAST_SLOW_DISCONNECT 1 // Slow subscribers are dropped
+
+typedef struct BroadcastSegment BroadcastSegment;
+
+struct BroadcastSegment {
+    atomic_int refs;                // The hub's slot plus one per subscriber sending it
+    uint64_t seq;                   // Set by broadcast_publish(), from 1
+    char name[256];                 // File name sent in the header
+    size_t length[BROADCAST_ENCODINGS];             // Content length per WireEncoding, fixed up front
+    const uint8_t *content[BROADCAST_ENCODINGS];
+    atomic_size_t ready[BROADCAST_ENCODINGS];       // Bytes of content published so far
+    atomic_int cut;                 // The publisher stopped before filling it
+    void (*free_fn)(BroadcastSegment *segment);     // Called when the last reference goes
+};
+
+typedef void (*BroadcastTapFn)(const int32_t *samples, int count, uint32_t sample_rate_mhz, void *ctx);
+typedef void (*BroadcastNotifyFn)(void *ctx);
+
+typedef struct {
+    BroadcastSegment *ring[BROADCAST_SEGMENTS]; // Segment seq sits at seq % BROADCAST_SEGMENTS
+    atomic_ullong newest;           // Seq of the newest segment, 0 before the first
+    atomic_int stopped;             // The publisher is done
+    int slow_policy;
+    BroadcastTapFn tap;             // Optional, set before publishing starts
+    void *tap_ctx;
+    BroadcastNotifyFn notify;       // Optional, set before publishing starts; called outside the lock
+    void *notify_ctx;
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE changed;
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+#endif
+} Broadcast;
+
+typedef struct {
+    WireEncoding encoding;
+    BroadcastSegment *segment;      // Being sent, with a reference held; NULL between segments
+    uint64_t next;                  // Seq of the segment to send next, 0 = whichever is newest
+    size_t sent;                    // Bytes of the segment's content sent
+    uint64_t dropped;               // Segments skipped while slow
+} BroadcastSubscriber;
+
+typedef enum {
+    BROADCAST_IDLE,                 // Nothing new within the timeout
+    BROADCAST_BEGIN,                // The subscriber's segment starts: send its file header
+    BROADCAST_DATA,                 // Send the returned bytes of the current segment
+    BROADCAST_SLOW,                 // Too far behind, under BROADCAST_SLOW_DISCONNECT
+    BROADCAST_CUT,                  // The current segment will never complete
+    BROADCAST_STOPPED               // The publisher is done and everything was sent
+} BroadcastEvent;
+
+#ifdef _WIN32
+#define BROADCAST_LOCK(b) EnterCriticalSection(&(b)->lock)
+#define BROADCAST_UNLOCK(b) LeaveCriticalSection(&(b)->lock)
+#define BROADCAST_WAKE_ALL(b) WakeAllConditionVariable(&(b)->changed)
+#else
+#define BROADCAST_LOCK(b) pthread_mutex_lock(&(b)->lock)
+#define BROADCAST_UNLOCK(b) pthread_mutex_unlock(&(b)->lock)
+#define BROADCAST_WAKE_ALL(b) pthread_cond_broadcast(&(b)->changed)
+#endif
+
+// Waits (with the lock held) until woken or timeout_ms have passed; 0 doesn't wait
+static inline void broadcast_wait(Broadcast *hub, int timeout_ms) {
+    if (timeout_ms <= 0) {
+        return;
+    }
+#ifdef _WIN32
+    SleepConditionVariableCS(&hub->changed, &hub->lock, (DWORD)timeout_ms);
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&hub->changed, &hub->lock, &deadline);
+#endif
+}
+
+static inline void broadcast_wake(Broadcast *hub) {
+    BROADCAST_LOCK(hub);
+    BROADCAST_WAKE_ALL(hub);
+    BROADCAST_UNLOCK(hub);
+    if (hub->notify) hub->notify(hub->notify_ctx);
+}
+
+static inline void broadcast_segment_release(BroadcastSegment *segment) {
+    if (segment != NULL && atomic_fetch_sub(&segment->refs, 1) == 1) {
+        segment->free_fn(segment);
+    }
+}
+
+// free_fn for segments allocated in one block with malloc/calloc
+static inline void broadcast_segment_free(BroadcastSegment *segment) {
+    free(segment);
+}
+
+static inline void broadcast_init(Broadcast *hub, int slow_policy) {
+    memset(hub, 0, sizeof(*hub));
+    hub->slow_policy = slow_policy;
+#ifdef _WIN32
+    InitializeCriticalSection(&hub->lock);
+    InitializeConditionVariable(&hub->changed);
+#else
+    pthread_mutex_init(&hub->lock, NULL);
+    pthread_cond_init(&hub->changed, NULL);
+#endif
+}
+
+// Drops the hub's segments; subscribers must have ended first
+static inline void broadcast_destroy(Broadcast *hub) {
+    for (int i = 0; i < BROADCAST_SEGMENTS; i++) {
+        broadcast_segment_release(hub->ring[i]);
+        hub->ring[i] = NULL;
+    }
+#ifdef _WIN32
+    DeleteCriticalSection(&hub->lock);
+#else
+    pthread_mutex_destroy(&hub->lock);
+    pthread_cond_destroy(&hub->changed);
+#endif
+}
+
+// Publisher: makes segment the newest. The hub takes over the caller's reference (refs
+// starts at 1); the publisher may keep filling it, since only a newer publish evicts it.
+static inline void broadcast_publish(Broadcast *hub, BroadcastSegment *segment) {
+    BROADCAST_LOCK(hub);
+    uint64_t seq = atomic_load(&hub->newest) + 1;
+    segment->seq = seq;
+    BroadcastSegment *evicted = hub->ring[seq % BROADCAST_SEGMENTS];
+    hub->ring[seq % BROADCAST_SEGMENTS] = segment;
+    atomic_store(&hub->newest, seq);
+    BROADCAST_WAKE_ALL(hub);
+    BROADCAST_UNLOCK(hub);
+    broadcast_segment_release(evicted);
+    if (hub->notify) hub->notify(hub->notify_ctx);
+}
+
+// Publisher: the first text_ready / adc32_ready bytes of the segment's content are final
+static inline void broadcast_advance(Broadcast *hub, BroadcastSegment *segment, size_t text_ready, size_t adc32_ready) {
+    atomic_store_explicit(&segment->ready[ENCODING_TEXT], text_ready, memory_order_release);
+    atomic_store_explicit(&segment->ready[ENCODING_ADC32], adc32_ready, memory_order_release);
+    broadcast_wake(hub);
+}
+
+// Publisher: passes samples to the tap, if there is one
+static inline void broadcast_samples(Broadcast *hub, const int32_t *samples, int count, uint32_t sample_rate_mhz) {
+    if (hub->tap && count > 0) {
+        hub->tap(samples, count, sample_rate_mhz, hub->tap_ctx);
+    }
+}
+
+// Publisher: no more data. A segment that isn't full yet (may be NULL) is cut, and the
+// subscribers sending it get BROADCAST_CUT.
+static inline void broadcast_stop(Broadcast *hub, BroadcastSegment *unfinished) {
+    if (unfinished) atomic_store(&unfinished->cut, 1);
+    atomic_store(&hub->stopped, 1);
+    broadcast_wake(hub);
+}
+
+// A new subscriber starts at the beginning of the newest segment
+static inline void broadcast_subscribe(BroadcastSubscriber *sub, WireEncoding encoding) {
+    memset(sub, 0, sizeof(*sub));
+    sub->encoding = encoding;
+}
+
+static inline void broadcast_unsubscribe(BroadcastSubscriber *sub) {
+    broadcast_segment_release(sub->segment);
+    sub->segment = NULL;
+}
+
+// Waits up to timeout_ms for the subscriber's next piece of work. On BROADCAST_BEGIN,
+// sub->segment is the new segment; on BROADCAST_DATA, *data and *len are the bytes to send
+// (valid while the segment is held, i.e. until the next call).
+static inline BroadcastEvent broadcast_next(Broadcast *hub, BroadcastSubscriber *sub, const uint8_t **data, size_t *len, int timeout_ms) {
+    BroadcastSegment *segment = sub->segment;
+    if (segment != NULL && sub->sent == segment->length[sub->encoding]) {
+        sub->next = segment->seq + 1;
+        sub->segment = NULL;
+        broadcast_segment_release(segment);
+        segment = NULL;
+    }
+
+    if (segment != NULL) {
+        if (hub->slow_policy == BROADCAST_SLOW_DISCONNECT && atomic_load(&hub->newest) - segment->seq >= BROADCAST_MAX_LAG) {
+            return BROADCAST_SLOW;
+        }
+        atomic_size_t *ready_at = &segment->ready[sub->encoding];
+        size_t ready = atomic_load_explicit(ready_at, memory_order_acquire);
+        if (ready == sub->sent && !atomic_load(&segment->cut)) {
+            BROADCAST_LOCK(hub);
+            ready = atomic_load_explicit(ready_at, memory_order_acquire);
+            if (ready == sub->sent && !atomic_load(&segment->cut)) {
+                broadcast_wait(hub, timeout_ms);
+                ready = atomic_load_explicit(ready_at, memory_order_acquire);
+            }
+            BROADCAST_UNLOCK(hub);
+        }
+        if (ready > sub->sent) {
+            *data = segment->content[sub->encoding] + sub->sent;
+            *len = ready - sub->sent;
+            sub->sent = ready;
+            return BROADCAST_DATA;
+        }
+        return atomic_load(&segment->cut) ? BROADCAST_CUT : BROADCAST_IDLE;
+    }
+
+    // Between segments
+    BROADCAST_LOCK(hub);
+    uint64_t newest = atomic_load(&hub->newest);
+    if ((newest == 0 || newest < sub->next) && !atomic_load(&hub->stopped)) {
+        broadcast_wait(hub, timeout_ms);
+        newest = atomic_load(&hub->newest);
+    }
+    if (newest == 0 || newest < sub->next) {
+        BROADCAST_UNLOCK(hub);
+        return atomic_load(&hub->stopped) ? BROADCAST_STOPPED : BROADCAST_IDLE;
+    }
+    if (sub->next == 0) {
+        sub->next = newest;
+    } else if (newest - sub->next >= BROADCAST_MAX_LAG) {
+        if (hub->slow_policy == BROADCAST_SLOW_DISCONNECT) {
+            BROADCAST_UNLOCK(hub);
+            return BROADCAST_SLOW;
+        }
+        sub->dropped += newest - sub->next;
+        sub->next = newest;
+    }
+    segment = hub->ring[sub->next % BROADCAST_SEGMENTS];
+    atomic_fetch_add(&segment->refs, 1);
+    BROADCAST_UNLOCK(hub);
+    sub->segment = segment;
+    sub->sent = 0;
+    return BROADCAST_BEGIN;
+}
+
+#endif // BROADCAST_H
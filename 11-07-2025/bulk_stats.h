@@ -0,0 +1,154 @@
+// Bulk replay ("as fast as possible") negotiation and per-stage timing.
+//
+// A client that wants the whole corpus without pacing adds "MODE:bulk" to its hello (the
+// server lists the modes it supports as "MODES:interval,bulk" in its config). The server
+// confirms with the control message "MODE:bulk", sends every file back to back while a
+// reader thread prepares the next one, and ends with
+//   BULK_STATS:files=20,bytes=5176135,samples=269685,wall_s=0.412,read_s=0.020,send_s=0.388
+// (a zero-length control message) just before END_OF_TRANSMISSION.
+//
+// Stages: read (server: page in the mapped file or encode its frames), send (server: time
+// in send calls, including waiting on a slow client), recv, parse, filter and write (client).
+// Server and client stages overlap, so their shares of the wall time don't add up to 100%.
+#ifndef BULK_STATS_H
+#define BULK_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h> // For QueryPerformanceCounter
+#else
+#include <time.h>    // For clock_gettime
+#endif
+
+#define BULK_MODE_NAME "bulk"
+#define BULK_MODE_REQUEST "MODE:" BULK_MODE_NAME // In the client's hello, echoed back by the server
+#define BULK_STATS_PREFIX "BULK_STATS:"         // Server's stage times, a control message
+#define BULK_RESULT_PREFIX "BULK_RESULT "       // The client's summary line, read by bench_bulk
+
+typedef enum {
+    BULK_STAGE_READ = 0,
+    BULK_STAGE_SEND,
+    BULK_STAGE_RECV,
+    BULK_STAGE_PARSE,
+    BULK_STAGE_FILTER,
+    BULK_STAGE_WRITE,
+    BULK_STAGE_COUNT
+} BulkStage;
+
+static const char *const bulk_stage_names[BULK_STAGE_COUNT] = { "read", "send", "recv", "parse", "filter", "write" };
+
+typedef struct {
+    double stage_s[BULK_STAGE_COUNT];
+    uint64_t files;
+    uint64_t bytes;             // File content bytes (headers not included)
+    uint64_t samples;
+    double wall_s;
+} BulkStats;
+
+static inline double bulk_now(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+// Adds the time since start to a stage and returns now, so stages can be chained:
+//   t = bulk_stage_end(&stats, BULK_STAGE_RECV, t);
+static inline double bulk_stage_end(BulkStats *stats, BulkStage stage, double start) {
+    double now = bulk_now();
+    stats->stage_s[stage] += now - start;
+    return now;
+}
+
+// Client time booked to filter and write so far. A parse that runs the DSP callback inside
+// it subtracts the growth of this from its own time.
+static inline double bulk_dsp_s(const BulkStats *stats) {
+    return stats->stage_s[BULK_STAGE_FILTER] + stats->stage_s[BULK_STAGE_WRITE];
+}
+
+// "files=..,bytes=..,samples=..,wall_s=..,<stage>_s=.." with the given separator; only
+// stages that took any time are listed. Returns the length snprintf reports.
+static inline int bulk_stats_format(const BulkStats *stats, char sep, char *out, size_t out_size) {
+    int len = snprintf(out, out_size, "files=%llu%cbytes=%llu%csamples=%llu%cwall_s=%.6f",
+                       (unsigned long long)stats->files, sep, (unsigned long long)stats->bytes, sep,
+                       (unsigned long long)stats->samples, sep, stats->wall_s);
+    for (int s = 0; s < BULK_STAGE_COUNT; s++) {
+        if (stats->stage_s[s] <= 0.0 || len < 0 || (size_t)len >= out_size) continue;
+        len += snprintf(out + len, out_size - (size_t)len, "%c%s_s=%.6f", sep, bulk_stage_names[s], stats->stage_s[s]);
+    }
+    return len;
+}
+
+// Reads what bulk_stats_format() wrote (either separator); unknown keys are skipped and
+// missing ones stay as they were. Returns the number of keys recognised.
+static inline int bulk_stats_parse(BulkStats *stats, const char *text) {
+    int recognised = 0;
+    const char *p = text;
+    while (*p) {
+        while (*p == ',' || *p == ' ') p++;
+        const char *eq = strchr(p, '=');
+        if (eq == NULL) break;
+        size_t key_len = (size_t)(eq - p);
+        const char *value = eq + 1;
+        if (key_len == 5 && memcmp(p, "files", 5) == 0) {
+            stats->files = strtoull(value, NULL, 10), recognised++;
+        } else if (key_len == 5 && memcmp(p, "bytes", 5) == 0) {
+            stats->bytes = strtoull(value, NULL, 10), recognised++;
+        } else if (key_len == 7 && memcmp(p, "samples", 7) == 0) {
+            stats->samples = strtoull(value, NULL, 10), recognised++;
+        } else if (key_len == 6 && memcmp(p, "wall_s", 6) == 0) {
+            stats->wall_s = strtod(value, NULL), recognised++;
+        } else {
+            for (int s = 0; s < BULK_STAGE_COUNT; s++) {
+                size_t name_len = strlen(bulk_stage_names[s]);
+                if (key_len == name_len + 2 && memcmp(p, bulk_stage_names[s], name_len) == 0 &&
+                    memcmp(p + name_len, "_s", 2) == 0) {
+                    stats->stage_s[s] = strtod(value, NULL);
+                    recognised++;
+                }
+            }
+        }
+        p = value + strcspn(value, ", ");
+    }
+    return recognised;
+}
+
+// Sums b into a (for totals over several runs)
+static inline void bulk_stats_accumulate(BulkStats *a, const BulkStats *b) {
+    for (int s = 0; s < BULK_STAGE_COUNT; s++) a->stage_s[s] += b->stage_s[s];
+    a->files += b->files;
+    a->bytes += b->bytes;
+    a->samples += b->samples;
+    a->wall_s += b->wall_s;
+}
+
+// Human-readable breakdown: end-to-end rates, then each stage's time, share and rate
+static inline void bulk_stats_print(FILE *out, const char *title, const BulkStats *stats) {
+    double wall = (stats->wall_s > 0.0) ? stats->wall_s : 1e-9;
+    double mb = stats->bytes / (1024.0 * 1024.0);
+    fprintf(out, "%s: %llu files, %.2f MB, %llu samples in %.3f s\n", title, (unsigned long long)stats->files, mb,
+            (unsigned long long)stats->samples, stats->wall_s);
+    fprintf(out, "  end to end: %.2f MB/s, %.0f samples/s\n", mb / wall, stats->samples / wall);
+    fprintf(out, "  %-7s %10s %8s %10s %14s\n", "stage", "seconds", "% wall", "MB/s", "samples/s");
+    for (int s = 0; s < BULK_STAGE_COUNT; s++) {
+        double t = stats->stage_s[s];
+        if (t <= 0.0) {
+            fprintf(out, "  %-7s %10s\n", bulk_stage_names[s], "-");
+            continue;
+        }
+        fprintf(out, "  %-7s %10.4f %8.1f %10.2f %14.0f\n", bulk_stage_names[s], t, 100.0 * t / wall, mb / t,
+                stats->samples / t);
+    }
+}
+
+#endif // BULK_STATS_H
@@ -17,6 +17,17 @@
 // are in GCC's search path.
 #include "arm_math.h" // Main CMSIS-DSP header
 
+#include "adc_protocol.h" // Binary sample frames (negotiated with the server)
+#include "adc_parser.h"   // In-place teraterm text parser
+#include "adc_stream.h"   // Chunked parsing for the streaming receive path
+#include "weight_archive.h" // Binary column output, whole-file and streamed
+#include "bulk_stats.h"     // MODE:bulk request and per-stage timing
+#include "worker_pool.h"    // Whole-file DSP on a pool of worker threads
+#include "weight_kernels.h" // Vectorised calibration and DC mean
+#include "dsp_arena.h"      // Per-file DSP buffers, reset between files
+#include "metrics.h"        // Stage latency histograms, periodic stats dump, LOG_VERBOSE
+#include "async_io.h"       // Several chunk receives posted at once on the streaming path
+
 
 // Configuration
 #define SERVER_IP "127.0.0.1"
@@ -27,30 +38,79 @@
 #define FILENAME_LENGTH_BYTES 4
 #define FILE_CONTENT_LENGTH_BYTES 8
 #define CONFIG_LENGTH_BYTES 4
-
-// Calibration constants (UPDATED as per Python client request)
-#define ZERO_CAL -0.0006981067708 
-#define SCALE_CAL 0.00000452466566
-
-// FIR Filter Order (Number of taps for CMSIS-DSP FIR)
-#define FIR_NUM_TAPS 51 
-
-// Global CMSIS-DSP FIR instance and state buffer
-// This filter instance and its state persist across calls to process_data
-// if you were processing chunks of a larger stream.
-// For processing an entire file at once, the state buffer size should be
-// (numTaps + blockSize - 1). Max blockSize will be raw_count.
-arm_fir_instance_f32 S_fir;
-// Allocate state buffer for the maximum possible block size + taps
-// Assuming raw_count won't exceed BUFFER_SIZE from socket recv_all.
-float32_t firState_f32[FIR_NUM_TAPS + BUFFER_SIZE - 1]; 
+#define PREFERRED_ENCODING ENCODING_NAME_ADC32 // Ask for binary frames; ENCODING_NAME_DELTA compresses them (slow links), ENCODING_NAME_TEXT keeps raw text
+#define STREAMING_RECEIVE 1 // 1 = filter samples as chunks arrive (bounded memory), 0 = receive whole file first
+#define REQUEST_BULK 0      // 1 = ask for MODE:bulk (no pacing) and print a stage breakdown; "c2 bulk" does the same
+#define WORKER_THREADS 0    // Whole-file path: 0 = one worker per logical processor, 1 = process on the receive thread
+#define MAX_INFLIGHT_BYTES (64u << 20) // Received file content held by queued and running worker jobs
+#define STREAM_RECV_BUFFERS 4 // Streaming path: chunk receives kept posted while one is parsed (see async_io.h); 1 = one at a time
+#define RECONNECT_ATTEMPTS 5 // Reconnects in a row after the server drops mid-replay, each resuming where it stopped; 0 = exit
+#define RECONNECT_DELAY_MS 500 // Wait before the first reconnect; doubles after each failed one
+
+// Calibration, FIR, FFT and output settings: see file_pipeline.h (shared with reprocess)
+#include "file_pipeline.h" // Whole-file DSP chain: process_data(), process_frames(), process_samples()
+
+// Per-file output state for the streaming receive path (filtering itself is in fir_engine)
+typedef struct {
+    FILE *file;                 // stream_<file>.csv (WRITE_TEXT_EXPORT), else NULL
+    ArchiveStream archive;      // all_data_<file>.bin (WRITE_BINARY_ARCHIVE), appended block by block
+    int interval_ms;
+    long index;                 // Sample number within the file
+    double start_s;             // When the file's content started arriving
+    double first_output_s;      // When the first filtered sample was written (0 = not yet)
+    double recent_weights[FFT_WINDOW_SIZE]; // Last raw weights (ring, position index % FFT_WINDOW_SIZE)
+    uint64_t block_ns;          // Time spent in filter_stream_block(), taken out of the parse figure
+} StreamFilter;
+
+// The file being received. It outlives a dropped connection: the next session asks the
+// server to RESUME it at `received` (see adc_protocol.h), and the rest of its bytes go into
+// the same buffer, or through the same stream and filter, as if nothing had happened.
+typedef struct {
+    char filename[256];         // "" = none yet
+    size_t content_len;         // Whole content, as first announced
+    size_t received;            // Bytes of it so far
+    WireEncoding encoding;
+    int streamed;               // Came in on the streaming path
+    int complete;               // All received (received == content_len)
+    char *content;              // Whole-file path: the buffer being filled
+    int streaming;              // Streaming path: output open, filter and stream live
+    StreamFilter filter;
+    AdcStream stream;
+} IncomingFile;
+
+// How a session ended
+#define SESSION_ENDED 0         // A control message ended the replay (or the client can't go on)
+#define SESSION_DROPPED 1       // The connection broke after the config: reconnect and resume
+#define SESSION_NO_CONFIG 2     // The connection broke before the config arrived
+
+// One received file handed to the pool; the job owns both buffers
+typedef struct {
+    char *filename;
+    char *content;
+    size_t content_len;
+    WireEncoding encoding;
+    int interval_ms;
+} FileJob;
 
 
 // Function prototypes
+int connect_to_server(void);
+int run_session(int client_sock, DspContext *session_dsp);
+int incoming_start(IncomingFile *in, const char *filename, size_t content_len, WireEncoding encoding, int streamed);
+void incoming_abandon(IncomingFile *in);
+int receive_file_content(int sockfd, IncomingFile *in, size_t len);
 ssize_t recv_all(int sockfd, void *buf, size_t len);
-void process_data(const char *file_content, const char *filename, int interval_ms);
-double normalize_to_weight(long adc_value);
-float32_t calculate_mean_f32(float32_t *data, int count); // Mean for float32_t data
+int start_file_workers(WorkerPool *pool);
+int submit_file_job(WorkerPool *pool, char *filename, char *content, size_t content_len, WireEncoding encoding, int interval_ms);
+void run_file_job(void *arg, int worker);
+void finish_file_workers(WorkerPool *pool);
+int send_encoding_hello(int sockfd, const char *encoding, int bulk, const IncomingFile *resume);
+int stream_file_content(AsyncChannel *channel, IncomingFile *in, size_t len, int interval_ms);
+void open_stream_output(const char *filename, StreamFilter *filter);
+int stream_spectrum(const StreamFilter *filter, float32_t *magnitude_out, float32_t *dominant_hz_out);
+int close_stream_output(const char *filename, StreamFilter *filter, const float32_t *fft_magnitude, int fft_bins);
+void filter_stream_block(const long *samples, int count, void *ctx);
+void report_bulk_stats(void);
 
 
 // Helper for be64toh (big-endian 64-bit to host) if not directly available
@@ -63,57 +123,164 @@ static inline uint64_t be64toh_custom(uint64_t big_endian_val) {
 #define be64toh(x) (x) 
 #endif
 
+// Stage times of this session, booked whatever the mode; printed when bulk replay was requested
+BulkStats bulk_stats;
+BulkStats server_bulk_stats;    // From the server's BULK_STATS message (read and send)
+int bulk_requested = REQUEST_BULK;
+const char *preferred_encoding = PREFERRED_ENCODING;
+
+FileWorker *file_workers = NULL;  // One per pool worker, while the pool runs
+WorkerPool file_pool;
+int pool_workers = -1;          // Workers in file_pool; -1 until the first session's config decides
+IncomingFile incoming;          // Outlives a dropped connection, for the RESUME request
+double session_start = 0.0;     // When the first config arrived
+AsyncLoop recv_loop;            // Completes the streaming path's chunk receives
+int recv_loop_ready = 0;        // 0 = it couldn't be set up: chunks are received one at a time
+AsyncChannel recv_channel;      // The session's socket on recv_loop
+
+int main(int argc, char *argv[]) {
+    // Usage: c2 [bulk] [text|adc32|delta]
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], BULK_MODE_NAME) == 0) {
+            bulk_requested = 1;
+        } else if (strcmp(argv[i], ENCODING_NAME_TEXT) == 0 || wire_encoding_from_name(argv[i]) != ENCODING_TEXT) {
+            preferred_encoding = argv[i];
+        }
+    }
+    metrics_start_reporter("c2");
+    recv_loop_ready = (async_loop_init(&recv_loop) == 0);
+    if (init_calibration(NULL) != 0) {
+        return EXIT_FAILURE;
+    }
+    init_fir_stage();
+    init_fft_stage();
+
+    DspArena session_arena;
+    AdcRecords session_records;
+    dsp_arena_init(&session_arena);
+    adc_records_init(&session_records);
+    DspContext session_dsp = { &fir_engine, &fir_bank, &bulk_stats, &session_arena, &session_records };
+
+    // A dropped connection is retried up to RECONNECT_ATTEMPTS times in a row, waiting
+    // RECONNECT_DELAY_MS and doubling; every new session resumes where the last one stopped
+    int connected = 0;
+    int failures = 0;
+    int delay_ms = RECONNECT_DELAY_MS;
+    while (1) {
+        int client_sock = connect_to_server();
+        if (client_sock < 0 && !connected) {
+            exit(EXIT_FAILURE);
+        }
+        int result = SESSION_NO_CONFIG;
+        if (client_sock >= 0) {
+            connected = 1;
+            async_attach(recv_loop_ready ? &recv_loop : NULL, &recv_channel, client_sock);
+            result = run_session(client_sock, &session_dsp);
+            async_detach(&recv_channel);
+            close(client_sock);
+        }
+        if (result == SESSION_ENDED) {
+            break;
+        }
+        if (result == SESSION_DROPPED) {
+            failures = 0; // The connection worked for a while: a fresh round of attempts
+            delay_ms = RECONNECT_DELAY_MS;
+        }
+        if (failures >= RECONNECT_ATTEMPTS) {
+            if (RECONNECT_ATTEMPTS > 0) printf("Giving up after %d reconnect attempts.\n", RECONNECT_ATTEMPTS);
+            break;
+        }
+        failures++;
+        if (incoming.filename[0] != '\0') {
+            printf("Reconnecting in %d ms (attempt %d of %d) to resume %s at byte %lu...\n", delay_ms, failures,
+                   RECONNECT_ATTEMPTS, incoming.filename, (unsigned long)incoming.received);
+        } else {
+            printf("Reconnecting in %d ms (attempt %d of %d)...\n", delay_ms, failures, RECONNECT_ATTEMPTS);
+        }
+        usleep((useconds_t)delay_ms * 1000);
+        delay_ms *= 2;
+    }
+    incoming_abandon(&incoming);
+    if (recv_loop_ready) {
+        async_loop_close(&recv_loop);
+    }
 
-int main() {
-    int client_sock;
-    struct sockaddr_in server_addr;
+    if (pool_workers > 0) {
+        finish_file_workers(&file_pool);
+    }
+    if (session_arena.high_water > 0) {
+        printf("DSP buffers: %lu KiB at most per file, %lu heap calls in all.\n",
+               (unsigned long)(session_arena.high_water >> 10), session_arena.heap_calls);
+    }
+    dsp_arena_free(&session_arena);
+    adc_records_free(&session_records);
+    metrics_stop_reporter();
+    metrics_dump(stderr, "c2");
+    printf("Connection closed.\n");
+    bulk_stats.wall_s = bulk_now() - session_start;
+    if (bulk_requested) {
+        report_bulk_stats();
+    }
+    return 0;
+}
 
+// Creates the socket and connects. Returns it, or -1 with the reason printed.
+int connect_to_server(void) {
     // 1. Create socket
-    client_sock = socket(AF_INET, SOCK_STREAM, 0);
+    int client_sock = socket(AF_INET, SOCK_STREAM, 0);
     if (client_sock < 0) {
         perror("Error creating socket");
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     // 2. Connect to server
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(SERVER_PORT);
-    if (inet_pton(AF_INET, SERVER_IP, &server_addr.sin_addr) <= 0) { 
+    if (inet_pton(AF_INET, SERVER_IP, &server_addr.sin_addr) <= 0) {
         perror("Invalid address/ Address not supported");
         close(client_sock);
-        exit(EXIT_FAILURE);
+        return -1;
     }
 
     if (connect(client_sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         perror("Error connecting to server");
         close(client_sock);
-        exit(EXIT_FAILURE);
+        return -1;
     }
     printf("Connected to server.\n");
+    return client_sock;
+}
 
+// One connection: the config, the hello (asking to RESUME the file the last connection
+// stopped in, if there was one), then files until a control message ends the replay.
+// Returns SESSION_ENDED, SESSION_DROPPED if the connection broke, or SESSION_NO_CONFIG if
+// it broke before the config arrived.
+int run_session(int client_sock, DspContext *session_dsp) {
     // --- Phase 1: Receive Initial Configuration ---
     uint32_t net_config_len;
     if (recv_all(client_sock, &net_config_len, CONFIG_LENGTH_BYTES) <= 0) {
         printf("Server disconnected while receiving config length.\n");
-        close(client_sock);
-        exit(EXIT_FAILURE);
+        return SESSION_NO_CONFIG;
     }
     size_t config_len = ntohl(net_config_len); // Convert from network byte order
 
     char *config_data = (char *)malloc(config_len + 1);
     if (config_data == NULL) {
         perror("Failed to allocate memory for config data");
-        close(client_sock);
         exit(EXIT_FAILURE);
     }
     if (recv_all(client_sock, config_data, config_len) <= 0) {
         printf("Server disconnected while receiving config data.\n");
         free(config_data);
-        close(client_sock);
-        exit(EXIT_FAILURE);
+        return SESSION_NO_CONFIG;
     }
     config_data[config_len] = '\0'; // Null-terminate the string
     printf("Received config: %s\n", config_data);
+    if (session_start == 0.0) {
+        session_start = bulk_now();
+    }
 
     // Parse interval and mode (simplified parsing for C)
     int interval_ms = 20; // Default
@@ -124,40 +291,94 @@ int main() {
     }
     char *mode_ptr = strstr(config_data, "MODE:");
     if (mode_ptr) {
-        sscanf(mode_ptr, "MODE:%s", mode);
+        sscanf(mode_ptr, "MODE:%49[^\\\n]", mode); // Stop at the literal "\n" separator
     }
     printf("Set interval: %d ms, Mode: %s\n", interval_ms, mode);
+
+    // Ask for binary frames and bulk replay if the server offers them; older servers list neither.
+    // A server that doesn't offer the preferred encoding is asked for adc32, then text. A resumed
+    // file's offset counts bytes of the encoding it was coming in, so that one is asked for again.
+    char *encodings_ptr = strstr(config_data, "ENCODINGS:");
+    char *modes_ptr = strstr(config_data, "MODES:");
+    int want_resume = incoming.filename[0] != '\0';
+    const char *encoding_name = want_resume ? wire_encoding_name(incoming.encoding) : preferred_encoding;
+    if (encodings_ptr == NULL || strstr(encodings_ptr, encoding_name) == NULL) {
+        encoding_name = (encodings_ptr != NULL && strstr(encodings_ptr, ENCODING_NAME_ADC32) != NULL) ? ENCODING_NAME_ADC32
+                        : ENCODING_NAME_TEXT;
+    }
+    int want_frames = strcmp(encoding_name, ENCODING_NAME_TEXT) != 0;
+    int want_bulk = bulk_requested && modes_ptr != NULL && strstr(modes_ptr, BULK_MODE_NAME) != NULL;
+    if (bulk_requested && !want_bulk) {
+        printf("Server does not offer bulk replay; timing the paced replay instead.\n");
+    }
+    if (want_frames || want_bulk || want_resume) {
+        if (send_encoding_hello(client_sock, encoding_name, want_bulk, want_resume ? &incoming : NULL) != 0) {
+            perror("Error sending encoding hello");
+        }
+    }
     free(config_data);
 
+    // Bulk files arrive back to back with no pacing, so they are received whole and
+    // processed on the worker pool instead of being filtered on the receive thread
+    int stream_files = STREAMING_RECEIVE && !want_bulk;
+    if (pool_workers < 0) {
+        pool_workers = stream_files ? 0 : start_file_workers(&file_pool);
+    }
+
     // --- Phase 2: Receive File Data ---
+    WireEncoding encoding = ENCODING_TEXT; // Switches only when the server acknowledges the hello
+    int resumed = 0;                       // The server answered the RESUME request
     while (1) {
         uint32_t net_filename_len;
         if (recv_all(client_sock, &net_filename_len, FILENAME_LENGTH_BYTES) <= 0) {
             printf("Server disconnected or no more files (filename length).\n");
-            break;
+            return SESSION_DROPPED;
         }
         size_t filename_len = ntohl(net_filename_len);
 
         char *filename = (char *)malloc(filename_len + 1);
         if (filename == NULL) {
             perror("Failed to allocate memory for filename");
-            break;
+            return SESSION_ENDED;
         }
         if (recv_all(client_sock, filename, filename_len) <= 0) {
             printf("Server disconnected while receiving filename.\n");
             free(filename);
-            break;
+            return SESSION_DROPPED;
         }
         filename[filename_len] = '\0';
-        printf("Received file name: %s\n", filename);
+        LOG_VERBOSE("Received file name: %s\n", filename);
 
         uint64_t net_file_content_len;
         if (recv_all(client_sock, &net_file_content_len, FILE_CONTENT_LENGTH_BYTES) <= 0) {
             printf("Server disconnected while receiving file content length.\n");
             free(filename);
-            break;
+            return SESSION_DROPPED;
+        }
+        size_t file_content_len = be64toh(net_file_content_len);
+
+        if (strncmp(filename, ENCODING_ACK_PREFIX, strlen(ENCODING_ACK_PREFIX)) == 0) {
+            encoding = wire_encoding_from_name(filename + strlen(ENCODING_ACK_PREFIX));
+            printf("Server switched encoding: %s\n", filename + strlen(ENCODING_ACK_PREFIX));
+            free(filename);
+            continue;
+        }
+        if (strcmp(filename, BULK_MODE_REQUEST) == 0) {
+            printf("Server switched to bulk replay.\n");
+            free(filename);
+            continue;
+        }
+        if (strncmp(filename, BULK_STATS_PREFIX, strlen(BULK_STATS_PREFIX)) == 0) {
+            bulk_stats_parse(&server_bulk_stats, filename + strlen(BULK_STATS_PREFIX));
+            free(filename);
+            continue;
+        }
+        if (strncmp(filename, RESUME_ACK_PREFIX, strlen(RESUME_ACK_PREFIX)) == 0) {
+            printf("Server resumed at %s.\n", filename + strlen(RESUME_ACK_PREFIX));
+            resumed = 1;
+            free(filename);
+            continue;
         }
-        size_t file_content_len = be64toh(net_file_content_len); 
 
         // Handle control messages
         if (strcmp(filename, "END_OF_TRANSMISSION") == 0 ||
@@ -166,217 +387,440 @@ int main() {
             strcmp(filename, "NO_FILES_IN_FOLDER") == 0) {
             printf("Received control message: %s. Stopping file reception.\n", filename);
             free(filename);
-            break; // Exit loop for control messages
+            return SESSION_ENDED;
         }
 
-        printf("Expecting file content of length: %lu bytes for %s\n", (unsigned long)file_content_len, filename);
+        LOG_VERBOSE("Expecting file content of length: %lu bytes for %s\n", (unsigned long)file_content_len, filename);
+
+        // After a RESUMED answer, the first file is the rest of the one that was cut off.
+        // Anything else is a new file, and a cut-off file the server didn't resume is dropped.
+        int continues = resumed && !incoming.complete && incoming.streamed == stream_files &&
+                        incoming.encoding == encoding && strcmp(filename, incoming.filename) == 0 &&
+                        incoming.received + file_content_len == incoming.content_len;
+        resumed = 0;
+        if (!continues) {
+            incoming_abandon(&incoming);
+            if (incoming_start(&incoming, filename, file_content_len, encoding, stream_files) != 0) {
+                free(filename);
+                return SESSION_ENDED;
+            }
+        }
 
-        char *file_content = (char *)malloc(file_content_len + 1);
-        if (file_content == NULL) {
-            perror("Failed to allocate memory for file content");
+        if (stream_files) {
+            if (stream_file_content(&recv_channel, &incoming, file_content_len, interval_ms) != 0) {
+                printf("Server disconnected while receiving file content for %s.\n", filename);
+                free(filename);
+                return SESSION_DROPPED;
+            }
             free(filename);
-            break;
+            continue;
         }
-        if (recv_all(client_sock, file_content, file_content_len) <= 0) {
+
+        if (receive_file_content(client_sock, &incoming, file_content_len) != 0) {
             printf("Server disconnected while receiving file content for %s.\n", filename);
             free(filename);
-            free(file_content);
-            break;
+            return SESSION_DROPPED;
+        }
+        char *file_content = incoming.content; // Complete: the file now goes to the DSP stage
+        incoming.content = NULL;
+        incoming.complete = 1;
+        file_content[incoming.content_len] = '\0';
+        bulk_stats.files++;
+        bulk_stats.bytes += incoming.content_len;
+
+        if (pool_workers > 0 &&
+            submit_file_job(&file_pool, filename, file_content, incoming.content_len, encoding, interval_ms) == 0) {
+            continue; // The job frees filename and file_content
         }
-        file_content[file_content_len] = '\0'; 
 
         // Process data
-        process_data(file_content, filename, interval_ms);
+        if (encoding != ENCODING_TEXT) {
+            process_frames(file_content, incoming.content_len, encoding, filename, interval_ms, session_dsp);
+        } else {
+            process_data(file_content, incoming.content_len, filename, interval_ms, session_dsp);
+        }
 
         free(filename);
         free(file_content);
     }
+}
 
-    printf("Connection closed.\n");
-    close(client_sock);
+// Starts receiving a new file of content_len bytes in encoding: opens its stream output on
+// the streaming path, allocates its buffer on the whole-file path. Returns 0, or -1.
+int incoming_start(IncomingFile *in, const char *filename, size_t content_len, WireEncoding encoding, int streamed) {
+    memset(in, 0, sizeof(*in));
+    snprintf(in->filename, sizeof(in->filename), "%s", filename);
+    in->content_len = content_len;
+    in->encoding = encoding;
+    in->streamed = streamed;
+    if (!streamed) {
+        in->content = (char *)malloc(content_len + 1);
+        if (in->content == NULL) {
+            perror("Failed to allocate memory for file content");
+            return -1;
+        }
+    }
     return 0;
 }
 
-// Helper function to ensure all bytes are received
+// Gives up on a file that was cut off and not resumed: its stream output keeps the samples
+// that arrived, a whole-file buffer is dropped. Nothing to do for a complete file.
+void incoming_abandon(IncomingFile *in) {
+    if (in->filename[0] == '\0' || in->complete) {
+        return;
+    }
+    printf("%s cut off after %lu of %lu bytes.\n", in->filename, (unsigned long)in->received, (unsigned long)in->content_len);
+    if (in->streaming) {
+        adc_stream_finish(&in->stream);
+        float32_t magnitude[FFT_WINDOW_SIZE / 2];
+        float32_t dominant_hz;
+        int fft_bins = stream_spectrum(&in->filter, magnitude, &dominant_hz);
+        close_stream_output(in->filename, &in->filter, magnitude, fft_bins);
+        in->streaming = 0;
+    }
+    free(in->content);
+    in->content = NULL;
+    in->filename[0] = '\0';
+}
+
+// Whole-file path: receives the next len bytes of in's content into its buffer, counting
+// them as they arrive so a dropped connection resumes at the last byte. Returns 0, or -1.
+int receive_file_content(int sockfd, IncomingFile *in, size_t len) {
+    double t = bulk_now();
+    size_t end = in->received + len;
+    while (in->received < end) {
+        uint64_t begin = metrics_begin();
+        ssize_t received = recv(sockfd, in->content + in->received, end - in->received, 0);
+        if (received <= 0) {
+            bulk_stage_end(&bulk_stats, BULK_STAGE_RECV, t);
+            return -1;
+        }
+        metrics_end(METRIC_RECV_WAIT, begin, (uint64_t)received);
+        in->received += (size_t)received;
+    }
+    bulk_stage_end(&bulk_stats, BULK_STAGE_RECV, t);
+    return 0;
+}
+
+// Helper function to ensure all bytes are received (each recv() is one METRIC_RECV_WAIT record)
 ssize_t recv_all(int sockfd, void *buf, size_t len) {
     size_t total_received = 0;
     ssize_t bytes_received;
     while (total_received < len) {
+        uint64_t begin = metrics_begin();
         bytes_received = recv(sockfd, (char *)buf + total_received, len - total_received, 0);
         if (bytes_received <= 0) {
             return bytes_received; // Error or connection closed
         }
+        metrics_end(METRIC_RECV_WAIT, begin, (uint64_t)bytes_received);
         total_received += bytes_received;
     }
     return total_received;
 }
 
-// Processes the received data (FIR filter using CMSIS-DSP)
-void process_data(const char *file_content, const char *filename, int interval_ms) {
-    printf("Processing data for %s (interval: %dms)...\n", filename, interval_ms);
-
-    // Parse ADC values
-    long *raw_adc_values_long = NULL; // Store raw long values from parsing
-    int raw_count = 0;
-    char *content_copy = strdup(file_content); // strdup is standard on Linux
-    if (content_copy == NULL) {
-        perror("strdup failed");
-        return;
+// Sends the length-prefixed hello that answers the server's ENCODINGS (and MODES) lists,
+// with a RESUME line for the file a dropped connection stopped in (resume may be NULL)
+int send_encoding_hello(int sockfd, const char *encoding, int bulk, const IncomingFile *resume) {
+    char hello[64 + sizeof(resume->filename)];
+    int hello_len = snprintf(hello, sizeof(hello), "%s%s\\n%s", ENCODING_ACK_PREFIX, encoding,
+                             bulk ? BULK_MODE_REQUEST "\\n" : "");
+    if (resume != NULL) {
+        hello_len += snprintf(hello + hello_len, sizeof(hello) - (size_t)hello_len, "%s%s:%lu\\n", RESUME_REQUEST_PREFIX,
+                              resume->filename, (unsigned long)resume->received);
     }
-
-    char *line = strtok(content_copy, "\n");
-    while (line != NULL) {
-        if (strstr(line, "ADC:") != NULL) { // Look only for ADC lines
-            long adc_val;
-            // Scan for long integer
-            if (sscanf(line, "ADC:%ld", &adc_val) == 1) {
-                raw_count++;
-                raw_adc_values_long = (long *)realloc(raw_adc_values_long, raw_count * sizeof(long));
-                if (raw_adc_values_long == NULL) {
-                    perror("realloc failed for raw_adc_values_long");
-                    free(content_copy);
-                    return;
-                }
-                raw_adc_values_long[raw_count - 1] = adc_val;
-            }
-        }
-        line = strtok(NULL, "\n");
+    char message[CONFIG_LENGTH_BYTES + sizeof(hello)];
+    uint32_t net_hello_len = htonl((uint32_t)hello_len);
+    memcpy(message, &net_hello_len, CONFIG_LENGTH_BYTES);
+    memcpy(message + CONFIG_LENGTH_BYTES, hello, hello_len);
+    if (send(sockfd, message, CONFIG_LENGTH_BYTES + hello_len, 0) != CONFIG_LENGTH_BYTES + hello_len) {
+        return -1;
     }
-    free(content_copy);
+    return 0;
+}
 
-    if (raw_count == 0) {
-        printf("No valid ADC values found in %s.\n", filename);
-        return;
+// Starts the whole-file worker pool (WORKER_THREADS, 0 = one per logical processor), each
+// worker with its own FIR stage. Returns the number of workers, or 0 to process on the
+// receive thread.
+int start_file_workers(WorkerPool *pool) {
+    int count = (WORKER_THREADS > 0) ? WORKER_THREADS : worker_pool_cpu_count();
+    if (count > WORKER_POOL_MAX_THREADS) count = WORKER_POOL_MAX_THREADS;
+    if (count <= 1) {
+        return 0;
     }
-
-    printf("Found %d ADC values.\n", raw_count);
-
-    // Allocate memory for processing and output
-    float32_t *raw_adc_values_f32 = (float32_t *)malloc(raw_count * sizeof(float32_t));
-    float32_t *dc_removed_f32 = (float32_t *)malloc(raw_count * sizeof(float32_t));
-    float32_t *filtered_f32 = (float32_t *)malloc(raw_count * sizeof(float32_t));
-    double *raw_weights = (double *)malloc(raw_count * sizeof(double));
-    double *filtered_weights = (double *)malloc(raw_count * sizeof(double));
-
-    if (raw_adc_values_f32 == NULL || dc_removed_f32 == NULL || filtered_f32 == NULL || raw_weights == NULL || filtered_weights == NULL) {
-        perror("Failed to allocate memory for DSP arrays");
-        free(raw_adc_values_long);
-        free(raw_adc_values_f32);
-        free(dc_removed_f32);
-        free(filtered_f32);
-        free(raw_weights);
-        free(filtered_weights);
-        return;
+    file_workers = (FileWorker *)calloc((size_t)count, sizeof(FileWorker));
+    if (file_workers == NULL) {
+        perror("Failed to allocate worker state, processing on the receive thread");
+        return 0;
     }
-
-    // Convert raw long ADC values to float32_t for CMSIS-DSP operations
-    for (int i = 0; i < raw_count; i++) {
-        raw_adc_values_f32[i] = (float32_t)raw_adc_values_long[i];
+    for (int i = 0; i < count; i++) {
+        file_worker_init(&file_workers[i]);
     }
-    
-    // Calculate stable DC offset for the *entire* file for consistent re-offsetting
-    float32_t stable_dc_offset = calculate_mean_f32(raw_adc_values_f32, raw_count);
-
-    // Remove DC offset for FIR input
-    for (int i = 0; i < raw_count; i++) {
-        dc_removed_f32[i] = raw_adc_values_f32[i] - stable_dc_offset;
-        raw_weights[i] = normalize_to_weight(raw_adc_values_long[i]); // Raw weights for output
+    int started = worker_pool_start(pool, count, MAX_INFLIGHT_BYTES, run_file_job);
+    if (started < 0) {
+        fprintf(stderr, "Could not start worker threads, processing on the receive thread.\n");
+        worker_pool_finish(pool);
+        free(file_workers);
+        file_workers = NULL;
+        return 0;
     }
+    printf("Processing files on %d worker threads (up to %u MiB in flight).\n", started, MAX_INFLIGHT_BYTES >> 20);
+    return started;
+}
 
-    // --- FIR Filtering using CMSIS-DSP ---
-    printf("Applying FIR filter using CMSIS-DSP (Order: %d)...\n", FIR_NUM_TAPS);
-
-    // Hardcoded FIR coefficients for a simple low-pass filter (similar to firwin output)
-    // For a 50Hz sampling rate and 10Hz cutoff, these might be values from firwin(51, 10/25).
-    // This is a simplified rectangular window (moving average) for demonstration with CMSIS-DSP.
-    float32_t firCoeffs_f32[FIR_NUM_TAPS]; 
-    for (int i = 0; i < FIR_NUM_TAPS; i++) {
-        firCoeffs_f32[i] = 1.0f / (float32_t)FIR_NUM_TAPS; // Simple moving average
+// Hands a received file to the pool, waiting while MAX_INFLIGHT_BYTES are queued or being
+// processed. Returns 0 (the job now owns filename and content), or -1.
+int submit_file_job(WorkerPool *pool, char *filename, char *content, size_t content_len, WireEncoding encoding, int interval_ms) {
+    FileJob *job = (FileJob *)malloc(sizeof(FileJob));
+    if (job == NULL) {
+        return -1;
     }
-
-    // Initialize FIR instance (raw_count is used as blockSize here, processing the whole file)
-    arm_fir_init_f32(&S_fir, FIR_NUM_TAPS, firCoeffs_f32, firState_f32, raw_count);
-
-    // Apply FIR filter using CMSIS-DSP
-    arm_fir_f32(&S_fir, dc_removed_f32, filtered_f32, raw_count);
-    
-    // Re-add the stable DC offset and normalize to weights for filtered output
-    for (int i = 0; i < raw_count; i++) {
-        double re_offset_val = filtered_f32[i] + stable_dc_offset;
-        filtered_weights[i] = normalize_to_weight((long)re_offset_val); // Cast to long for normalize_to_weight
+    job->filename = filename;
+    job->content = content;
+    job->content_len = content_len;
+    job->encoding = encoding;
+    job->interval_ms = interval_ms;
+    if (worker_pool_submit(pool, job, content_len) != 0) {
+        free(job);
+        return -1;
     }
-    printf("FIR filtering complete.\n");
-
-    // --- FFT (Placeholder) ---
-    printf("Note: FFT calculation is a placeholder in this C version.\n");
-
+    metrics_record(METRIC_QUEUE_DEPTH, (uint64_t)pool->submit_depth, 0); // Queued or running, this one included
+    return 0;
+}
 
-    // Output processed data to a file
-    char output_filepath[256];
-    snprintf(output_filepath, sizeof(output_filepath), "output_data/all_data_%s.txt", filename);
+// Worker side of submit_file_job(). Every file starts from a clean filter, so the output
+// doesn't depend on which worker ran it or in what order.
+void run_file_job(void *arg, int worker) {
+    FileJob *job = (FileJob *)arg;
+    FileWorker *state = &file_workers[worker];
+    DspContext dsp = { &state->fir, &state->bank, &state->stats, &state->arena, &state->records };
+    fir_engine_reset(&state->fir);
+    fir_bank_reset(&state->bank);
+    if (job->encoding != ENCODING_TEXT) {
+        process_frames(job->content, job->content_len, job->encoding, job->filename, job->interval_ms, &dsp);
+    } else {
+        process_data(job->content, job->content_len, job->filename, job->interval_ms, &dsp);
+    }
+    free(job->filename);
+    free(job->content);
+    free(job);
+}
 
-    struct stat st = {0};
-    if (stat("output_data", &st) == -1) {
-        mkdir("output_data", 0700); // Use mkdir on Linux
-        printf("Created output folder: output_data\n");
+// Waits for the queued files and folds the workers' stage times into the session's
+// (summed over workers, so with N busy workers they can reach N times the wall time)
+void finish_file_workers(WorkerPool *pool) {
+    worker_pool_finish(pool);
+    size_t arena_bytes = 0;
+    unsigned long heap_calls = 0;
+    for (int i = 0; i < pool->worker_count; i++) {
+        bulk_stats_accumulate(&bulk_stats, &file_workers[i].stats);
+        arena_bytes += dsp_arena_capacity(&file_workers[i].arena);
+        heap_calls += file_workers[i].arena.heap_calls;
+        dsp_arena_free(&file_workers[i].arena);
+        adc_records_free(&file_workers[i].records);
     }
+    printf("Worker pool: %llu files on %d threads, receive waited for the memory budget %llu times.\n",
+           (unsigned long long)pool->jobs_done, pool->worker_count, (unsigned long long)pool->submit_waits);
+    printf("Worker DSP buffers: %lu KiB held, %lu heap calls in all.\n", (unsigned long)(arena_bytes >> 10), heap_calls);
+    free(file_workers);
+    file_workers = NULL;
+}
 
-    FILE *output_file = fopen(output_filepath, "w");
-    if (output_file == NULL) {
-        perror("Error opening output file");
+// Receives the next len bytes of a file's content in fixed-size chunks and filters samples
+// as they arrive, with STREAM_RECV_BUFFERS chunks posted on the channel so the next ones
+// arrive while one is filtered. Memory use is those chunks plus one block, whatever the file size,
+// and the first filtered block is written after STREAM_BLOCK_SAMPLES samples instead of
+// after the whole file. If the connection drops, the stream stays open in `in` (unfinished
+// lines, frames and blocks included) for the resumed rest. Returns 0, or -1 if it dropped.
+int stream_file_content(AsyncChannel *channel, IncomingFile *in, size_t len, int interval_ms) {
+    const char *filename = in->filename;
+    StreamFilter *filter = &in->filter;
+    AdcStream *stream = &in->stream;
+    if (in->streaming) {
+        LOG_VERBOSE("Resuming %s at byte %lu...\n", filename, (unsigned long)in->received);
     } else {
-        fprintf(output_file, "Raw Weights (first 10): [");
-        for (int i = 0; i < fmin(10, raw_count); i++) {
-            fprintf(output_file, "%.4f%s", raw_weights[i], (i == fmin(10, raw_count) - 1) ? "" : ", ");
-        }
-        fprintf(output_file, "]\n");
-        fprintf(output_file, "Raw Weights (total %d samples): [", raw_count);
-        for (int i = 0; i < raw_count; i++) {
-            fprintf(output_file, "%.4f%s", raw_weights[i], (i == raw_count - 1) ? "" : ", "); 
-        }
-        fprintf(output_file, "]\n\n");
+        LOG_VERBOSE("Streaming data for %s (interval: %dms), FIR order %d...\n", filename, interval_ms, FIR_NUM_TAPS);
+        start_file_filtering(&fir_engine);
+        ensure_output_folder();
+        filter->interval_ms = interval_ms;
+        open_stream_output(filename, filter);
+        filter->start_s = monotonic_seconds();
+        adc_stream_init(stream, in->encoding, filter_stream_block, filter);
+        in->streaming = 1;
+    }
 
-        fprintf(output_file, "Filtered Weights (first 10): [");
-        for (int i = 0; i < fmin(10, raw_count); i++) {
-            fprintf(output_file, "%.4f%s", filtered_weights[i], (i == fmin(10, raw_count) - 1) ? "" : ", ");
+    char chunks[STREAM_RECV_BUFFERS][STREAM_CHUNK_BYTES];
+    AsyncRecvStream chunk_stream;
+    async_recv_stream_start(&chunk_stream, channel, &chunks[0][0], STREAM_CHUNK_BYTES, STREAM_RECV_BUFFERS, len);
+    while (1) {
+        double t = bulk_now();
+        uint64_t begin = metrics_begin();
+        const char *chunk;
+        long received = async_recv_stream_next(&chunk_stream, &chunk);
+        if (received < 0) {
+            return -1;
         }
-        fprintf(output_file, "]\n");
-        fprintf(output_file, "Filtered Weights (total %d samples): [", raw_count);
-        for (int i = 0; i < raw_count; i++) {
-            fprintf(output_file, "%.4f%s", filtered_weights[i], (i == raw_count - 1) ? "" : ", ");
+        if (received == 0) {
+            break;
         }
-        fprintf(output_file, "]\n\n");
-
-        fprintf(output_file, "FIR Coefficients: Moving Average (Order %d)\n\n", FIR_NUM_TAPS);
-        fprintf(output_file, "FFT Frequencies: N/A (placeholder)\n\n");
-        fprintf(output_file, "FFT Magnitudes: N/A (placeholder)\n\n");
+        begin = metrics_end(METRIC_RECV_WAIT, begin, (uint64_t)received);
+        t = bulk_stage_end(&bulk_stats, BULK_STAGE_RECV, t);
+        // filter_stream_block() runs inside the feed and books its own filter and write time
+        double dsp_before = bulk_dsp_s(&bulk_stats);
+        uint64_t block_before = filter->block_ns;
+        size_t samples_before = stream->sample_count;
+        adc_stream_feed(stream, chunk, (size_t)received);
+        bulk_stage_end(&bulk_stats, BULK_STAGE_PARSE, t);
+        bulk_stats.stage_s[BULK_STAGE_PARSE] -= bulk_dsp_s(&bulk_stats) - dsp_before;
+        metrics_end(METRIC_PARSE, begin + (filter->block_ns - block_before), stream->sample_count - samples_before);
+        in->received += (size_t)received;
+    }
+    in->streaming = 0;
+    in->complete = 1;
+    double t = bulk_now();
+    double dsp_before = bulk_dsp_s(&bulk_stats);
+    adc_stream_finish(stream);
+    bulk_stage_end(&bulk_stats, BULK_STAGE_PARSE, t);
+    bulk_stats.stage_s[BULK_STAGE_PARSE] -= bulk_dsp_s(&bulk_stats) - dsp_before;
+    bulk_stats.files++;
+    bulk_stats.bytes += in->content_len;
+    bulk_stats.samples += stream->sample_count;
+
+    if (stream->malformed) {
+        fprintf(stderr, "Malformed ADC frame in %s, output truncated.\n", filename);
+    }
+    if (LOG_LEVEL >= LOG_LEVEL_VERBOSE) fir_engine_report(&fir_engine);
+
+    t = bulk_now();
+    float32_t magnitude[FFT_WINDOW_SIZE / 2];
+    float32_t dominant_hz;
+    int fft_bins = stream_spectrum(filter, magnitude, &dominant_hz);
+    if (fft_bins > 0) {
+        LOG_VERBOSE("Dominant frequency over the last %d samples: %.3f Hz\n", FFT_WINDOW_SIZE, dominant_hz);
+    }
+    t = bulk_stage_end(&bulk_stats, BULK_STAGE_FILTER, t);
+    if (filter->file || filter->archive.file) {
+        int result = close_stream_output(filename, filter, magnitude, fft_bins);
+        bulk_stage_end(&bulk_stats, BULK_STAGE_WRITE, t);
+        if (result == 0) {
+            LOG_VERBOSE("Successfully wrote %lu samples of %s (first sample after %.1f ms, file took %.1f ms)\n",
+                   (unsigned long)stream->sample_count, filename,
+                   filter->first_output_s > 0 ? (filter->first_output_s - filter->start_s) * 1000.0 : 0.0,
+                   (monotonic_seconds() - filter->start_s) * 1000.0);
+        }
+    }
+    return 0;
+}
 
-        fclose(output_file);
-        printf("Successfully wrote data to %s\n", output_filepath);
+// Opens the streaming path's outputs for a new file: the archive (WRITE_BINARY_ARCHIVE; a
+// multi-channel stream is filtered as its channel 0) and the per-sample CSV (WRITE_TEXT_EXPORT).
+// One that can't be opened is reported and skipped.
+void open_stream_output(const char *filename, StreamFilter *filter) {
+    char output_filepath[512];
+#if WRITE_BINARY_ARCHIVE
+    static const char *const columns[] = { "raw_weight", "filtered_weight" };
+    output_file_path(output_filepath, sizeof(output_filepath), filename, 0, 1, "bin");
+    if (archive_stream_open(&filter->archive, output_filepath, columns, 2) != 0) {
+        perror("Error opening output archive"); // Keep reading so the connection stays in sync
+    }
+#endif
+#if WRITE_TEXT_EXPORT
+    snprintf(output_filepath, sizeof(output_filepath), "%s/stream_%s.csv", output_folder, filename);
+    filter->file = fopen(output_filepath, "w");
+    if (filter->file == NULL) {
+        perror("Error opening output file");
+    } else {
+        fprintf(filter->file, "sample,adc,raw_weight,filtered_weight\n");
     }
+#endif
+}
 
-    // Free allocated memory
-    free(raw_adc_values_long);
-    free(raw_adc_values_f32);
-    free(dc_removed_f32);
-    free(filtered_f32);
-    free(raw_weights);
-    free(filtered_weights);
+// Spectrum of the file's last FFT_WINDOW_SIZE raw weights, from the ring in time order, as
+// compute_spectrum() (0 bins if fewer arrived)
+int stream_spectrum(const StreamFilter *filter, float32_t *magnitude_out, float32_t *dominant_hz_out) {
+    if (filter->index < FFT_WINDOW_SIZE) {
+        return 0;
+    }
+    double recent[FFT_WINDOW_SIZE];
+    for (int i = 0; i < FFT_WINDOW_SIZE; i++) {
+        recent[i] = filter->recent_weights[(filter->index + i) % FFT_WINDOW_SIZE];
+    }
+    return compute_spectrum(recent, FFT_WINDOW_SIZE, filter->interval_ms, magnitude_out, dominant_hz_out);
 }
 
-// Normalizes an ADC value to a weight
-double normalize_to_weight(long adc_value) {
-    double data_in = (double)adc_value / (double)0x80000000;
-    if (SCALE_CAL == 0) return 0.0; // Avoid division by zero
-    return (data_in - ZERO_CAL) / SCALE_CAL;
+// Closes the streaming path's outputs. The archive gets the FIR coefficients and spectrum
+// columns, then its header and directory now that the sample count is known. Returns 0, or
+// -1 if the archive couldn't be completed.
+int close_stream_output(const char *filename, StreamFilter *filter, const float32_t *fft_magnitude, int fft_bins) {
+    int result = 0;
+    if (filter->file) {
+        fclose(filter->file);
+        filter->file = NULL;
+    }
+    if (filter->archive.file) {
+        float32_t fft_frequency[FFT_WINDOW_SIZE / 2];
+        spectrum_frequencies(fft_frequency, fft_bins, filter->interval_ms);
+        ArchiveHeader header;
+        archive_header_init(&header, filename, filter->interval_ms > 0 ? 1000.0 / filter->interval_ms : 0.0,
+                            calibration.zero_cal[0], calibration.scale_cal[0]);
+        header.fir_taps = FIR_NUM_TAPS;
+        header.fft_size = (fft_bins > 0) ? FFT_WINDOW_SIZE : 0;
+        ArchiveColumn columns[] = {
+            { "fir_coefficients", ARCHIVE_F32, fir_engine.coeffs_f32, FIR_NUM_TAPS },
+            { "fft_frequency_hz", ARCHIVE_F32, fft_frequency, (uint64_t)fft_bins },
+            { "fft_magnitude", ARCHIVE_F32, fft_magnitude, (uint64_t)fft_bins },
+        };
+        result = archive_stream_finish(&filter->archive, &header, columns, (fft_bins > 0) ? 3 : 1);
+        if (result != 0) perror("Error writing output archive");
+    }
+    return result;
 }
 
-// Calculates the mean of a float32_t array
-float32_t calculate_mean_f32(float32_t *data, int count) {
-    if (count == 0) return 0.0f;
-    float32_t sum = 0.0f;
+// DSP stage for one block of streamed samples: FIR (with DC removal) then weights
+void filter_stream_block(const long *samples, int count, void *ctx) {
+    StreamFilter *filter = (StreamFilter *)ctx;
+    double t = bulk_now();
+    uint64_t start = metrics_begin();
+    long filtered[STREAM_BLOCK_SAMPLES];
+    fir_engine_process(&fir_engine, samples, filtered, count);
+    uint64_t begin = metrics_end(METRIC_FIR, start, (uint64_t)count);
+
+    double raw_weights[STREAM_BLOCK_SAMPLES];
+    double filtered_weights[STREAM_BLOCK_SAMPLES];
+    adc_to_weights(&calibration.weight[0], samples, raw_weights, count); // A multi-channel stream arrives as its channel 0
+    adc_to_weights(&calibration.weight[0], filtered, filtered_weights, count);
     for (int i = 0; i < count; i++) {
-        sum += data[i];
+        filter->recent_weights[(filter->index + i) % FFT_WINDOW_SIZE] = raw_weights[i];
     }
-    return sum / (float32_t)count;
-}
\ No newline at end of file
+    t = bulk_stage_end(&bulk_stats, BULK_STAGE_FILTER, t);
+    if (filter->file == NULL && filter->archive.file == NULL) {
+        filter->index += count;
+        filter->block_ns += metrics_begin() - start;
+        return;
+    }
+    begin = metrics_begin();
+    const double *columns[2] = { raw_weights, filtered_weights };
+    archive_stream_append(&filter->archive, columns, (size_t)count);
+    if (filter->file) {
+        for (int i = 0; i < count; i++) {
+            fprintf(filter->file, "%ld,%ld,%.4f,%.4f\n", filter->index + i, samples[i], raw_weights[i], filtered_weights[i]);
+        }
+    }
+    filter->index += count;
+    bulk_stage_end(&bulk_stats, BULK_STAGE_WRITE, t);
+    filter->block_ns += metrics_end(METRIC_WRITE, begin, (uint64_t)count) - start;
+    if (filter->first_output_s == 0) {
+        filter->first_output_s = monotonic_seconds();
+    }
+}
+
+// Prints the stage breakdown of a bulk replay: read and send from the server's BULK_STATS,
+// the rest measured here. The BULK_RESULT line is what bench_bulk collects.
+void report_bulk_stats(void) {
+    BulkStats stats = bulk_stats;
+    stats.stage_s[BULK_STAGE_READ] = server_bulk_stats.stage_s[BULK_STAGE_READ];
+    stats.stage_s[BULK_STAGE_SEND] = server_bulk_stats.stage_s[BULK_STAGE_SEND];
+    bulk_stats_print(stdout, "Bulk replay", &stats);
+    char line[512];
+    bulk_stats_format(&stats, ' ', line, sizeof(line));
+    printf("%s%s\n", BULK_RESULT_PREFIX, line);
+}
@@ -0,0 +1,88 @@
+// Per-channel calibration for rigs with several load cells, read at start-up instead of
+// compiled in.
+//
+// Every channel starts out with the defaults the caller passes (ZERO_CAL / SCALE_CAL); a
+// table file then overrides the channels it lists, one per line:
+//
+//   # channel  zero_cal          scale_cal
+//   0          -0.0006981067708  0.00000452466566
+//   1          -0.0007120000000  0.00000451900000
+//
+// '#' starts a comment, blank lines are skipped. Each entry is kept both as the two
+// constants (written into the archive headers) and in the folded scale/offset form the
+// weight kernels take (weight_kernels.h), so per-sample cost doesn't depend on where the
+// constants came from.
+#ifndef CHANNEL_CALIBRATION_H
+#define CHANNEL_CALIBRATION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adc_protocol.h"   // ADC_MAX_CHANNELS
+#include "weight_kernels.h" // WeightCalibration
+
+#define CALIBRATION_MAX_LINE 256
+
+typedef struct {
+    double zero_cal[ADC_MAX_CHANNELS];
+    double scale_cal[ADC_MAX_CHANNELS];
+    WeightCalibration weight[ADC_MAX_CHANNELS]; // Folded form of the two above
+} ChannelCalibration;
+
+static inline void channel_calibration_set(ChannelCalibration *cal, int channel, double zero_cal, double scale_cal) {
+    WeightCalibration weight = WEIGHT_CALIBRATION(zero_cal, scale_cal);
+    cal->zero_cal[channel] = zero_cal;
+    cal->scale_cal[channel] = scale_cal;
+    cal->weight[channel] = weight;
+}
+
+// Gives every channel the same constants
+static inline void channel_calibration_fill(ChannelCalibration *cal, double zero_cal, double scale_cal) {
+    for (int c = 0; c < ADC_MAX_CHANNELS; c++) channel_calibration_set(cal, c, zero_cal, scale_cal);
+}
+
+// Applies the table at path. Returns the number of channels it set, or -1 with the reason
+// printed (then no channel is changed).
+static inline int channel_calibration_load(ChannelCalibration *cal, const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+    ChannelCalibration loaded = *cal;
+    char line[CALIBRATION_MAX_LINE];
+    int line_number = 0, set = 0, ok = 1;
+    while (ok && fgets(line, sizeof(line), fp) != NULL) {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        char *p = line;
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+        if (*p == '\0') continue;
+        char *end, *next;
+        long channel = strtol(p, &end, 10);
+        int fields = (end != p);
+        double zero_cal = strtod(end, &next);
+        fields += (next != end);
+        double scale_cal = strtod(next, &end);
+        fields += (end != next);
+        while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n') end++;
+        if (fields != 3 || *end != '\0') {
+            fprintf(stderr, "%s:%d: expected \"<channel> <zero_cal> <scale_cal>\"\n", path, line_number);
+            ok = 0;
+        } else if (channel < 0 || channel >= ADC_MAX_CHANNELS) {
+            fprintf(stderr, "%s:%d: channel %ld is not in 0..%d\n", path, line_number, channel, ADC_MAX_CHANNELS - 1);
+            ok = 0;
+        } else {
+            channel_calibration_set(&loaded, (int)channel, zero_cal, scale_cal);
+            set++;
+        }
+    }
+    fclose(fp);
+    if (!ok) return -1;
+    *cal = loaded;
+    return set;
+}
+
+#endif // CHANNEL_CALIBRATION_H
@@ -15,6 +15,17 @@
 
 #include <math.h> // For fmin
 
+#include "adc_protocol.h" // Binary sample frames (negotiated with the server)
+#include "adc_parser.h"   // In-place teraterm text parser
+#include "adc_stream.h"   // Chunked parsing for the streaming receive path
+#include "weight_archive.h" // Binary column output, whole-file and streamed
+#include "bulk_stats.h"     // MODE:bulk request and per-stage timing
+#include "worker_pool.h"    // Whole-file DSP on a pool of worker threads
+#include "weight_kernels.h" // Vectorised calibration and DC mean
+#include "dsp_arena.h"      // Per-file DSP buffers, reset between files
+#include "metrics.h"        // Stage latency histograms, periodic stats dump, LOG_VERBOSE
+#include "async_io.h"       // Several chunk receives posted at once on the streaming path
+
 // Need to link with Ws2_32.lib (-lws2_32)
 
 // Configuration
@@ -26,15 +37,103 @@
 #define FILENAME_LENGTH_BYTES 4
 #define FILE_CONTENT_LENGTH_BYTES 8
 #define CONFIG_LENGTH_BYTES 4
+#define PREFERRED_ENCODING ENCODING_NAME_ADC32 // Ask for binary frames; ENCODING_NAME_DELTA compresses them (slow links), ENCODING_NAME_TEXT keeps raw text
+#define STREAMING_RECEIVE 1 // 1 = process samples as chunks arrive (bounded memory), 0 = receive whole file first
+#define WRITE_BINARY_ARCHIVE 1 // Results as output_data/all_data_<file>.bin (see weight_archive.h), streamed or whole-file
+#define WRITE_TEXT_EXPORT 0    // 1 = also write the old text output: all_data_<file>.txt, or stream_<file>.csv when streaming
+#define REQUEST_BULK 0      // 1 = ask for MODE:bulk (no pacing) and print a stage breakdown; "client.exe bulk" does the same
+#define WORKER_THREADS 0    // Whole-file path: 0 = one worker per logical processor, 1 = process on the receive thread
+#define MAX_INFLIGHT_BYTES (64u << 20) // Received file content held by queued and running worker jobs
+#define STREAM_RECV_BUFFERS 4 // Streaming path: chunk receives kept posted while one is parsed (see async_io.h); 1 = one at a time
+#define RECONNECT_ATTEMPTS 5 // Reconnects in a row after the server drops mid-replay, each resuming where it stopped; 0 = exit
+#define RECONNECT_DELAY_MS 500 // Wait before the first reconnect; doubles after each failed one
 
 // Calibration constants (from Python client)
 #define ZERO_CAL 0.01823035255075
 #define SCALE_CAL 0.00000451794631
 
+static const WeightCalibration weight_cal = WEIGHT_CALIBRATION(ZERO_CAL, SCALE_CAL);
+
+// Per-file output state for the streaming receive path
+typedef struct {
+    FILE *file;                 // stream_<file>.csv (WRITE_TEXT_EXPORT), else NULL
+    ArchiveStream archive;      // all_data_<file>.bin (WRITE_BINARY_ARCHIVE), appended block by block
+    int interval_ms;
+    long index;                 // Sample number within the file
+    ULONGLONG start_ms;         // When the file's content started arriving
+    ULONGLONG first_output_ms;  // When the first processed sample was written (0 = not yet)
+    uint64_t block_ns;          // Time spent in write_stream_block(), taken out of the parse figure
+} StreamOutput;
+
+// The file being received. It outlives a dropped connection: the next session asks the
+// server to RESUME it at `received` (see adc_protocol.h), and the rest of its bytes go into
+// the same buffer, or through the same stream and output, as if nothing had happened.
+typedef struct {
+    char filename[256];         // "" = none yet
+    size_t content_len;         // Whole content, as first announced
+    size_t received;            // Bytes of it so far
+    WireEncoding encoding;
+    int streamed;               // Came in on the streaming path
+    int complete;               // All received (received == content_len)
+    char *content;              // Whole-file path: the buffer being filled
+    int streaming;              // Streaming path: output open and stream live
+    StreamOutput output;
+    AdcStream stream;
+} IncomingFile;
+
+// How a session ended
+#define SESSION_ENDED 0         // A control message ended the replay (or the client can't go on)
+#define SESSION_DROPPED 1       // The connection broke after the config: reconnect and resume
+#define SESSION_NO_CONFIG 2     // The connection broke before the config arrived
+
+// State a whole file is processed with: the session's on the receive thread, or one pool
+// worker's own, so concurrent files never share counters or buffers
+typedef struct {
+    BulkStats *stats;
+    DspArena *arena;            // Decoded samples and weights; reset after each file
+    AdcRecords *records;        // Parsed text records, cleared (not freed) between files
+} DspContext;
+
+// A pool worker's private state
+typedef struct {
+    BulkStats stats;            // Parse, filter and write time and samples; merged at the end
+    DspArena arena;
+    AdcRecords records;
+} FileWorker;
+
+// One received file handed to the pool; the job owns both buffers
+typedef struct {
+    char *filename;
+    char *content;
+    size_t content_len;
+    WireEncoding encoding;
+    int interval_ms;
+} FileJob;
+
 // Function prototypes
+SOCKET connect_to_server(void);
+int run_session(SOCKET client_sock, DspContext *session_dsp);
+int incoming_start(IncomingFile *in, const char *filename, size_t content_len, WireEncoding encoding, int streamed);
+void incoming_abandon(IncomingFile *in);
+int receive_file_content(SOCKET sockfd, IncomingFile *in, size_t len);
 ssize_t recv_all(SOCKET sockfd, void *buf, size_t len);
-void process_data(const char *file_content, const char *filename, int interval_ms);
+void process_data(const char *file_content, size_t file_content_len, const char *filename, int interval_ms, DspContext *dsp);
+void process_frames(const char *file_content, size_t file_content_len, WireEncoding encoding, const char *filename, int interval_ms, DspContext *dsp);
+void process_samples(const long *raw_adc_values, int raw_count, const char *filename, int interval_ms, DspContext *dsp);
+int start_file_workers(WorkerPool *pool);
+int submit_file_job(WorkerPool *pool, char *filename, char *content, size_t content_len, WireEncoding encoding, int interval_ms);
+void run_file_job(void *arg, int worker);
+void finish_file_workers(WorkerPool *pool);
+int send_encoding_hello(SOCKET sockfd, const char *encoding, int bulk, const IncomingFile *resume);
+int stream_file_content(AsyncChannel *channel, IncomingFile *in, size_t len, int interval_ms);
+void open_stream_output(const char *filename, StreamOutput *output);
+int close_stream_output(const char *filename, StreamOutput *output);
+void write_stream_block(const long *samples, int count, void *ctx);
+void write_weight_archive(const char *filename, int interval_ms, const double *raw_weights, const double *filtered_weights,
+                          int raw_count);
+void write_text_export(const char *filename, const double *raw_weights, const double *filtered_weights, int raw_count);
 double normalize_to_weight(long adc_value);
+void report_bulk_stats(void);
 double calculate_mean(double *data, int count);
 void remove_dc_offset_simple(double *data, int count);
 
@@ -48,11 +147,34 @@ static inline uint64_t be64toh_custom(uint64_t big_endian_val) {
 #define be64toh be64toh_custom
 #endif
 
-
-int main() {
+// Stage times of this session, booked whatever the mode; printed when bulk replay was requested
+BulkStats bulk_stats;
+BulkStats server_bulk_stats;    // From the server's BULK_STATS message (read and send)
+int bulk_requested = REQUEST_BULK;
+const char *preferred_encoding = PREFERRED_ENCODING;
+
+FileWorker *file_workers = NULL;  // One per pool worker, while the pool runs
+WorkerPool file_pool;
+int pool_workers = -1;          // Workers in file_pool; -1 until the first session's config decides
+IncomingFile incoming;          // Outlives a dropped connection, for the RESUME request
+double session_start = 0.0;     // When the first config arrived
+AsyncLoop recv_loop;            // Completes the streaming path's chunk receives
+int recv_loop_ready = 0;        // 0 = it couldn't be set up: chunks are received one at a time
+AsyncChannel recv_channel;      // The session's socket on recv_loop
+
+int main(int argc, char *argv[]) {
     WSADATA wsaData;
-    SOCKET client_sock;
-    struct sockaddr_in server_addr;
+
+    // Usage: client [bulk] [text|adc32|delta]
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], BULK_MODE_NAME) == 0) {
+            bulk_requested = 1;
+        } else if (strcmp(argv[i], ENCODING_NAME_TEXT) == 0 || wire_encoding_from_name(argv[i]) != ENCODING_TEXT) {
+            preferred_encoding = argv[i];
+        }
+    }
+    metrics_start_reporter("client");
+    recv_loop_ready = (async_loop_init(&recv_loop) == 0);
 
     // Initialize Winsock
     if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0) {
@@ -60,61 +182,137 @@ int main() {
         return 1;
     }
 
+    DspArena session_arena;
+    AdcRecords session_records;
+    dsp_arena_init(&session_arena);
+    adc_records_init(&session_records);
+    DspContext session_dsp = { &bulk_stats, &session_arena, &session_records };
+
+    // A dropped connection is retried up to RECONNECT_ATTEMPTS times in a row, waiting
+    // RECONNECT_DELAY_MS and doubling; every new session resumes where the last one stopped
+    int connected = 0;
+    int failures = 0;
+    int delay_ms = RECONNECT_DELAY_MS;
+    while (1) {
+        SOCKET client_sock = connect_to_server();
+        if (client_sock == INVALID_SOCKET && !connected) {
+            WSACleanup();
+            exit(EXIT_FAILURE);
+        }
+        int result = SESSION_NO_CONFIG;
+        if (client_sock != INVALID_SOCKET) {
+            connected = 1;
+            async_attach(recv_loop_ready ? &recv_loop : NULL, &recv_channel, client_sock);
+            result = run_session(client_sock, &session_dsp);
+            async_detach(&recv_channel);
+            closesocket(client_sock);
+        }
+        if (result == SESSION_ENDED) {
+            break;
+        }
+        if (result == SESSION_DROPPED) {
+            failures = 0; // The connection worked for a while: a fresh round of attempts
+            delay_ms = RECONNECT_DELAY_MS;
+        }
+        if (failures >= RECONNECT_ATTEMPTS) {
+            if (RECONNECT_ATTEMPTS > 0) printf("Giving up after %d reconnect attempts.\n", RECONNECT_ATTEMPTS);
+            break;
+        }
+        failures++;
+        if (incoming.filename[0] != '\0') {
+            printf("Reconnecting in %d ms (attempt %d of %d) to resume %s at byte %lu...\n", delay_ms, failures,
+                   RECONNECT_ATTEMPTS, incoming.filename, (unsigned long)incoming.received);
+        } else {
+            printf("Reconnecting in %d ms (attempt %d of %d)...\n", delay_ms, failures, RECONNECT_ATTEMPTS);
+        }
+        Sleep((DWORD)delay_ms);
+        delay_ms *= 2;
+    }
+    incoming_abandon(&incoming);
+    if (recv_loop_ready) {
+        async_loop_close(&recv_loop);
+    }
+
+    if (pool_workers > 0) {
+        finish_file_workers(&file_pool);
+    }
+    if (session_arena.high_water > 0) {
+        printf("DSP buffers: %lu KiB at most per file, %lu heap calls in all.\n",
+               (unsigned long)(session_arena.high_water >> 10), session_arena.heap_calls);
+    }
+    dsp_arena_free(&session_arena);
+    adc_records_free(&session_records);
+    metrics_stop_reporter();
+    metrics_dump(stderr, "client");
+    printf("Connection closed.\n");
+    bulk_stats.wall_s = bulk_now() - session_start;
+    if (bulk_requested) {
+        report_bulk_stats();
+    }
+    WSACleanup(); // Clean up Winsock
+    return 0;
+}
+
+// Creates the socket and connects. Returns it, or INVALID_SOCKET with the reason printed.
+SOCKET connect_to_server(void) {
     // 1. Create socket
-    client_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    SOCKET client_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (client_sock == INVALID_SOCKET) {
         fprintf(stderr, "Error creating socket: %d\n", WSAGetLastError());
-        WSACleanup();
-        exit(EXIT_FAILURE);
+        return INVALID_SOCKET;
     }
 
     // 2. Connect to server
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(SERVER_PORT);
-    
+
     // Use inet_addr to convert IP string to binary form (more robust for MinGW)
-    server_addr.sin_addr.s_addr = inet_addr(SERVER_IP); 
+    server_addr.sin_addr.s_addr = inet_addr(SERVER_IP);
     if (server_addr.sin_addr.s_addr == INADDR_NONE && strcmp(SERVER_IP, "255.255.255.255") != 0) {
         fprintf(stderr, "Error: Invalid server IP address: %s\n", SERVER_IP);
         closesocket(client_sock);
-        WSACleanup();
-        exit(EXIT_FAILURE);
+        return INVALID_SOCKET;
     }
 
     if (connect(client_sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) == SOCKET_ERROR) {
         fprintf(stderr, "Error connecting to server: %d\n", WSAGetLastError());
         closesocket(client_sock);
-        WSACleanup();
-        exit(EXIT_FAILURE);
+        return INVALID_SOCKET;
     }
     printf("Connected to server.\n");
+    return client_sock;
+}
 
+// One connection: the config, the hello (asking to RESUME the file the last connection
+// stopped in, if there was one), then files until a control message ends the replay.
+// Returns SESSION_ENDED, SESSION_DROPPED if the connection broke, or SESSION_NO_CONFIG if
+// it broke before the config arrived.
+int run_session(SOCKET client_sock, DspContext *session_dsp) {
     // --- Phase 1: Receive Initial Configuration ---
     uint32_t net_config_len;
     if (recv_all(client_sock, &net_config_len, CONFIG_LENGTH_BYTES) <= 0) {
         printf("Server disconnected while receiving config length.\n");
-        closesocket(client_sock);
-        WSACleanup();
-        exit(EXIT_FAILURE);
+        return SESSION_NO_CONFIG;
     }
     size_t config_len = ntohl(net_config_len); // Convert from network byte order
 
     char *config_data = (char *)malloc(config_len + 1);
     if (config_data == NULL) {
         perror("Failed to allocate memory for config data");
-        closesocket(client_sock);
-        WSACleanup();
         exit(EXIT_FAILURE);
     }
     if (recv_all(client_sock, config_data, config_len) <= 0) {
         printf("Server disconnected while receiving config data.\n");
         free(config_data);
-        closesocket(client_sock);
-        WSACleanup();
-        exit(EXIT_FAILURE);
+        return SESSION_NO_CONFIG;
     }
     config_data[config_len] = '\0'; // Null-terminate the string
     printf("Received config: %s\n", config_data);
+    if (session_start == 0.0) {
+        session_start = bulk_now();
+    }
 
     // Parse interval and mode (simplified parsing for C)
     int interval_ms = 20; // Default
@@ -125,40 +323,94 @@ int main() {
     }
     char *mode_ptr = strstr(config_data, "MODE:");
     if (mode_ptr) {
-        sscanf(mode_ptr, "MODE:%s", mode);
+        sscanf(mode_ptr, "MODE:%49[^\\\n]", mode); // Stop at the literal "\n" separator
     }
     printf("Set interval: %d ms, Mode: %s\n", interval_ms, mode);
+
+    // Ask for binary frames and bulk replay if the server offers them; older servers list neither.
+    // A server that doesn't offer the preferred encoding is asked for adc32, then text. A resumed
+    // file's offset counts bytes of the encoding it was coming in, so that one is asked for again.
+    char *encodings_ptr = strstr(config_data, "ENCODINGS:");
+    char *modes_ptr = strstr(config_data, "MODES:");
+    int want_resume = incoming.filename[0] != '\0';
+    const char *encoding_name = want_resume ? wire_encoding_name(incoming.encoding) : preferred_encoding;
+    if (encodings_ptr == NULL || strstr(encodings_ptr, encoding_name) == NULL) {
+        encoding_name = (encodings_ptr != NULL && strstr(encodings_ptr, ENCODING_NAME_ADC32) != NULL) ? ENCODING_NAME_ADC32
+                        : ENCODING_NAME_TEXT;
+    }
+    int want_frames = strcmp(encoding_name, ENCODING_NAME_TEXT) != 0;
+    int want_bulk = bulk_requested && modes_ptr != NULL && strstr(modes_ptr, BULK_MODE_NAME) != NULL;
+    if (bulk_requested && !want_bulk) {
+        printf("Server does not offer bulk replay; timing the paced replay instead.\n");
+    }
+    if (want_frames || want_bulk || want_resume) {
+        if (send_encoding_hello(client_sock, encoding_name, want_bulk, want_resume ? &incoming : NULL) != 0) {
+            fprintf(stderr, "Error sending encoding hello: %d\n", WSAGetLastError());
+        }
+    }
     free(config_data);
 
+    // Bulk files arrive back to back with no pacing, so they are received whole and
+    // processed on the worker pool instead of on the receive thread
+    int stream_files = STREAMING_RECEIVE && !want_bulk;
+    if (pool_workers < 0) {
+        pool_workers = stream_files ? 0 : start_file_workers(&file_pool);
+    }
+
     // --- Phase 2: Receive File Data ---
+    WireEncoding encoding = ENCODING_TEXT; // Switches only when the server acknowledges the hello
+    int resumed = 0;                       // The server answered the RESUME request
     while (1) {
         uint32_t net_filename_len;
         if (recv_all(client_sock, &net_filename_len, FILENAME_LENGTH_BYTES) <= 0) {
             printf("Server disconnected or no more files (filename length).\n");
-            break;
+            return SESSION_DROPPED;
         }
         size_t filename_len = ntohl(net_filename_len);
 
         char *filename = (char *)malloc(filename_len + 1);
         if (filename == NULL) {
             perror("Failed to allocate memory for filename");
-            break;
+            return SESSION_ENDED;
         }
         if (recv_all(client_sock, filename, filename_len) <= 0) {
             printf("Server disconnected while receiving filename.\n");
             free(filename);
-            break;
+            return SESSION_DROPPED;
         }
         filename[filename_len] = '\0';
-        printf("Received file name: %s\n", filename);
+        LOG_VERBOSE("Received file name: %s\n", filename);
 
         uint64_t net_file_content_len;
         if (recv_all(client_sock, &net_file_content_len, FILE_CONTENT_LENGTH_BYTES) <= 0) {
             printf("Server disconnected while receiving file content length.\n");
             free(filename);
-            break;
+            return SESSION_DROPPED;
+        }
+        size_t file_content_len = be64toh(net_file_content_len);
+
+        if (strncmp(filename, ENCODING_ACK_PREFIX, strlen(ENCODING_ACK_PREFIX)) == 0) {
+            encoding = wire_encoding_from_name(filename + strlen(ENCODING_ACK_PREFIX));
+            printf("Server switched encoding: %s\n", filename + strlen(ENCODING_ACK_PREFIX));
+            free(filename);
+            continue;
+        }
+        if (strcmp(filename, BULK_MODE_REQUEST) == 0) {
+            printf("Server switched to bulk replay.\n");
+            free(filename);
+            continue;
+        }
+        if (strncmp(filename, BULK_STATS_PREFIX, strlen(BULK_STATS_PREFIX)) == 0) {
+            bulk_stats_parse(&server_bulk_stats, filename + strlen(BULK_STATS_PREFIX));
+            free(filename);
+            continue;
+        }
+        if (strncmp(filename, RESUME_ACK_PREFIX, strlen(RESUME_ACK_PREFIX)) == 0) {
+            printf("Server resumed at %s.\n", filename + strlen(RESUME_ACK_PREFIX));
+            resumed = 1;
+            free(filename);
+            continue;
         }
-        size_t file_content_len = be64toh(net_file_content_len); 
 
         // Handle control messages
         if (strcmp(filename, "END_OF_TRANSMISSION") == 0 ||
@@ -167,120 +419,471 @@ int main() {
             strcmp(filename, "NO_FILES_IN_FOLDER") == 0) {
             printf("Received control message: %s. Stopping file reception.\n", filename);
             free(filename);
-            break; // Exit loop for control messages
+            return SESSION_ENDED;
         }
 
-        // Corrected printf format for size_t
-        printf("Expecting file content of length: %lu bytes for %s\n", (unsigned long)file_content_len, filename);
+        LOG_VERBOSE("Expecting file content of length: %lu bytes for %s\n", (unsigned long)file_content_len, filename);
+
+        // After a RESUMED answer, the first file is the rest of the one that was cut off.
+        // Anything else is a new file, and a cut-off file the server didn't resume is dropped.
+        int continues = resumed && !incoming.complete && incoming.streamed == stream_files &&
+                        incoming.encoding == encoding && strcmp(filename, incoming.filename) == 0 &&
+                        incoming.received + file_content_len == incoming.content_len;
+        resumed = 0;
+        if (!continues) {
+            incoming_abandon(&incoming);
+            if (incoming_start(&incoming, filename, file_content_len, encoding, stream_files) != 0) {
+                free(filename);
+                return SESSION_ENDED;
+            }
+        }
 
-        char *file_content = (char *)malloc(file_content_len + 1);
-        if (file_content == NULL) {
-            perror("Failed to allocate memory for file content");
+        if (stream_files) {
+            if (stream_file_content(&recv_channel, &incoming, file_content_len, interval_ms) != 0) {
+                printf("Server disconnected while receiving file content for %s.\n", filename);
+                free(filename);
+                return SESSION_DROPPED;
+            }
             free(filename);
-            break;
+            continue;
         }
-        if (recv_all(client_sock, file_content, file_content_len) <= 0) {
+
+        if (receive_file_content(client_sock, &incoming, file_content_len) != 0) {
             printf("Server disconnected while receiving file content for %s.\n", filename);
             free(filename);
-            free(file_content);
-            break;
+            return SESSION_DROPPED;
+        }
+        char *file_content = incoming.content; // Complete: the file now goes to the DSP stage
+        incoming.content = NULL;
+        incoming.complete = 1;
+        file_content[incoming.content_len] = '\0';
+        bulk_stats.files++;
+        bulk_stats.bytes += incoming.content_len;
+
+        if (pool_workers > 0 &&
+            submit_file_job(&file_pool, filename, file_content, incoming.content_len, encoding, interval_ms) == 0) {
+            continue; // The job frees filename and file_content
         }
-        file_content[file_content_len] = '\0'; 
 
         // Process data (simplified in C)
-        process_data(file_content, filename, interval_ms);
+        if (encoding != ENCODING_TEXT) {
+            process_frames(file_content, incoming.content_len, encoding, filename, interval_ms, session_dsp);
+        } else {
+            process_data(file_content, incoming.content_len, filename, interval_ms, session_dsp);
+        }
 
         free(filename);
         free(file_content);
     }
+}
 
-    printf("Connection closed.\n");
-    closesocket(client_sock);
-    WSACleanup(); // Clean up Winsock
+// Starts receiving a new file of content_len bytes in encoding: opens its stream output on
+// the streaming path, allocates its buffer on the whole-file path. Returns 0, or -1.
+int incoming_start(IncomingFile *in, const char *filename, size_t content_len, WireEncoding encoding, int streamed) {
+    memset(in, 0, sizeof(*in));
+    snprintf(in->filename, sizeof(in->filename), "%s", filename);
+    in->content_len = content_len;
+    in->encoding = encoding;
+    in->streamed = streamed;
+    if (!streamed) {
+        in->content = (char *)malloc(content_len + 1);
+        if (in->content == NULL) {
+            perror("Failed to allocate memory for file content");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Gives up on a file that was cut off and not resumed: its stream output keeps the samples
+// that arrived, a whole-file buffer is dropped. Nothing to do for a complete file.
+void incoming_abandon(IncomingFile *in) {
+    if (in->filename[0] == '\0' || in->complete) {
+        return;
+    }
+    printf("%s cut off after %lu of %lu bytes.\n", in->filename, (unsigned long)in->received, (unsigned long)in->content_len);
+    if (in->streaming) {
+        adc_stream_finish(&in->stream);
+        close_stream_output(in->filename, &in->output);
+        in->streaming = 0;
+    }
+    free(in->content);
+    in->content = NULL;
+    in->filename[0] = '\0';
+}
+
+// Whole-file path: receives the next len bytes of in's content into its buffer, counting
+// them as they arrive so a dropped connection resumes at the last byte. Returns 0, or -1.
+int receive_file_content(SOCKET sockfd, IncomingFile *in, size_t len) {
+    double t = bulk_now();
+    size_t end = in->received + len;
+    while (in->received < end) {
+        uint64_t begin = metrics_begin();
+        int received = recv(sockfd, in->content + in->received, (int)(end - in->received), 0);
+        if (received <= 0) {
+            bulk_stage_end(&bulk_stats, BULK_STAGE_RECV, t);
+            return -1;
+        }
+        metrics_end(METRIC_RECV_WAIT, begin, (uint64_t)received);
+        in->received += (size_t)received;
+    }
+    bulk_stage_end(&bulk_stats, BULK_STAGE_RECV, t);
     return 0;
 }
 
-// Helper function to ensure all bytes are received
+// Helper function to ensure all bytes are received (each recv() is one METRIC_RECV_WAIT record)
 ssize_t recv_all(SOCKET sockfd, void *buf, size_t len) {
     size_t total_received = 0;
     ssize_t bytes_received;
     while (total_received < len) {
+        uint64_t begin = metrics_begin();
         bytes_received = recv(sockfd, (char *)buf + total_received, len - total_received, 0);
         if (bytes_received <= 0) {
             return bytes_received; // Error or connection closed
         }
+        metrics_end(METRIC_RECV_WAIT, begin, (uint64_t)bytes_received);
         total_received += bytes_received;
     }
     return total_received;
 }
 
-// Processes the received data (simplified DSP and output)
-void process_data(const char *file_content, const char *filename, int interval_ms) {
-    printf("Processing data for %s (interval: %dms)...\n", filename, interval_ms);
-
-    // Parse ADC values
-    long *raw_adc_values = NULL;
-    int raw_count = 0;
-    char *content_copy = _strdup(file_content); // Use _strdup on Windows
-    if (content_copy == NULL) {
-        perror("_strdup failed");
-        return;
+// Sends the length-prefixed hello that answers the server's ENCODINGS (and MODES) lists,
+// with a RESUME line for the file a dropped connection stopped in (resume may be NULL)
+int send_encoding_hello(SOCKET sockfd, const char *encoding, int bulk, const IncomingFile *resume) {
+    char hello[64 + sizeof(resume->filename)];
+    int hello_len = snprintf(hello, sizeof(hello), "%s%s\\n%s", ENCODING_ACK_PREFIX, encoding,
+                             bulk ? BULK_MODE_REQUEST "\\n" : "");
+    if (resume != NULL) {
+        hello_len += snprintf(hello + hello_len, sizeof(hello) - (size_t)hello_len, "%s%s:%lu\\n", RESUME_REQUEST_PREFIX,
+                              resume->filename, (unsigned long)resume->received);
+    }
+    char message[CONFIG_LENGTH_BYTES + sizeof(hello)];
+    uint32_t net_hello_len = htonl((uint32_t)hello_len);
+    memcpy(message, &net_hello_len, CONFIG_LENGTH_BYTES);
+    memcpy(message + CONFIG_LENGTH_BYTES, hello, hello_len);
+    if (send(sockfd, message, CONFIG_LENGTH_BYTES + hello_len, 0) != CONFIG_LENGTH_BYTES + hello_len) {
+        return -1;
+    }
+    return 0;
+}
+
+// Receives the next len bytes of a file's content in fixed-size chunks and processes samples
+// as they arrive. STREAM_RECV_BUFFERS chunks stay posted on the channel, so the next ones
+// arrive while one is parsed. Memory use is those chunks plus one block, whatever the file size.
+// If the connection drops, the stream stays open in `in` (unfinished lines, frames and
+// blocks included) for the resumed rest. Returns 0, or -1 if it dropped.
+int stream_file_content(AsyncChannel *channel, IncomingFile *in, size_t len, int interval_ms) {
+    const char *filename = in->filename;
+    StreamOutput *output = &in->output;
+    AdcStream *stream = &in->stream;
+    if (in->streaming) {
+        LOG_VERBOSE("Resuming %s at byte %lu...\n", filename, (unsigned long)in->received);
+    } else {
+        LOG_VERBOSE("Streaming data for %s (interval: %dms)...\n", filename, interval_ms);
+        struct stat st = {0};
+        if (stat("output_data", &st) == -1) {
+            _mkdir("output_data"); // Use _mkdir on Windows
+            printf("Created output folder: output_data\n");
+        }
+        output->interval_ms = interval_ms;
+        open_stream_output(filename, output);
+        output->start_ms = GetTickCount64();
+        adc_stream_init(stream, in->encoding, write_stream_block, output);
+        in->streaming = 1;
     }
 
-    char *line = strtok(content_copy, "\n");
-    while (line != NULL) {
-        if (strstr(line, "ADC:") != NULL) {
-            long adc_val;
-            if (sscanf(line, "ADC:%ld", &adc_val) == 1) {
-                raw_count++;
-                raw_adc_values = (long *)realloc(raw_adc_values, raw_count * sizeof(long));
-                if (raw_adc_values == NULL) {
-                    perror("realloc failed");
-                    free(content_copy);
-                    return;
-                }
-                raw_adc_values[raw_count - 1] = adc_val;
-            }
+    char chunks[STREAM_RECV_BUFFERS][STREAM_CHUNK_BYTES];
+    AsyncRecvStream chunk_stream;
+    async_recv_stream_start(&chunk_stream, channel, &chunks[0][0], STREAM_CHUNK_BYTES, STREAM_RECV_BUFFERS, len);
+    while (1) {
+        double t = bulk_now();
+        uint64_t begin = metrics_begin();
+        const char *chunk;
+        long received = async_recv_stream_next(&chunk_stream, &chunk);
+        if (received < 0) {
+            return -1;
+        }
+        if (received == 0) {
+            break;
+        }
+        begin = metrics_end(METRIC_RECV_WAIT, begin, (uint64_t)received);
+        t = bulk_stage_end(&bulk_stats, BULK_STAGE_RECV, t);
+        // write_stream_block() runs inside the feed and books its own filter and write time
+        double dsp_before = bulk_dsp_s(&bulk_stats);
+        uint64_t block_before = output->block_ns;
+        size_t samples_before = stream->sample_count;
+        adc_stream_feed(stream, chunk, (size_t)received);
+        bulk_stage_end(&bulk_stats, BULK_STAGE_PARSE, t);
+        bulk_stats.stage_s[BULK_STAGE_PARSE] -= bulk_dsp_s(&bulk_stats) - dsp_before;
+        metrics_end(METRIC_PARSE, begin + (output->block_ns - block_before), stream->sample_count - samples_before);
+        in->received += (size_t)received;
+    }
+    in->streaming = 0;
+    in->complete = 1;
+    double t = bulk_now();
+    double dsp_before = bulk_dsp_s(&bulk_stats);
+    adc_stream_finish(stream);
+    bulk_stage_end(&bulk_stats, BULK_STAGE_PARSE, t);
+    bulk_stats.stage_s[BULK_STAGE_PARSE] -= bulk_dsp_s(&bulk_stats) - dsp_before;
+    bulk_stats.files++;
+    bulk_stats.bytes += in->content_len;
+    bulk_stats.samples += stream->sample_count;
+
+    if (stream->malformed) {
+        fprintf(stderr, "Malformed ADC frame in %s, output truncated.\n", filename);
+    }
+    if (output->file || output->archive.file) {
+        t = bulk_now();
+        int result = close_stream_output(filename, output);
+        bulk_stage_end(&bulk_stats, BULK_STAGE_WRITE, t);
+        if (result == 0) {
+            LOG_VERBOSE("Successfully wrote %lu samples of %s (first sample after %llu ms, file took %llu ms)\n",
+                   (unsigned long)stream->sample_count, filename,
+                   (unsigned long long)(output->first_output_ms ? output->first_output_ms - output->start_ms : 0),
+                   (unsigned long long)(GetTickCount64() - output->start_ms));
+        }
+    }
+    return 0;
+}
+
+// Starts the whole-file worker pool (WORKER_THREADS, 0 = one per logical processor).
+// Returns the number of workers, or 0 to process on the receive thread.
+int start_file_workers(WorkerPool *pool) {
+    int count = (WORKER_THREADS > 0) ? WORKER_THREADS : worker_pool_cpu_count();
+    if (count > WORKER_POOL_MAX_THREADS) count = WORKER_POOL_MAX_THREADS;
+    if (count <= 1) {
+        return 0;
+    }
+    file_workers = (FileWorker *)calloc((size_t)count, sizeof(FileWorker));
+    if (file_workers == NULL) {
+        perror("Failed to allocate worker state, processing on the receive thread");
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        dsp_arena_init(&file_workers[i].arena);
+        adc_records_init(&file_workers[i].records);
+    }
+    int started = worker_pool_start(pool, count, MAX_INFLIGHT_BYTES, run_file_job);
+    if (started < 0) {
+        fprintf(stderr, "Could not start worker threads, processing on the receive thread.\n");
+        worker_pool_finish(pool);
+        free(file_workers);
+        file_workers = NULL;
+        return 0;
+    }
+    printf("Processing files on %d worker threads (up to %u MiB in flight).\n", started, MAX_INFLIGHT_BYTES >> 20);
+    return started;
+}
+
+// Hands a received file to the pool, waiting while MAX_INFLIGHT_BYTES are queued or being
+// processed. Returns 0 (the job now owns filename and content), or -1.
+int submit_file_job(WorkerPool *pool, char *filename, char *content, size_t content_len, WireEncoding encoding, int interval_ms) {
+    FileJob *job = (FileJob *)malloc(sizeof(FileJob));
+    if (job == NULL) {
+        return -1;
+    }
+    job->filename = filename;
+    job->content = content;
+    job->content_len = content_len;
+    job->encoding = encoding;
+    job->interval_ms = interval_ms;
+    if (worker_pool_submit(pool, job, content_len) != 0) {
+        free(job);
+        return -1;
+    }
+    metrics_record(METRIC_QUEUE_DEPTH, (uint64_t)pool->submit_depth, 0); // Queued or running, this one included
+    return 0;
+}
+
+// Worker side of submit_file_job()
+void run_file_job(void *arg, int worker) {
+    FileJob *job = (FileJob *)arg;
+    FileWorker *state = &file_workers[worker];
+    DspContext dsp = { &state->stats, &state->arena, &state->records };
+    if (job->encoding != ENCODING_TEXT) {
+        process_frames(job->content, job->content_len, job->encoding, job->filename, job->interval_ms, &dsp);
+    } else {
+        process_data(job->content, job->content_len, job->filename, job->interval_ms, &dsp);
+    }
+    free(job->filename);
+    free(job->content);
+    free(job);
+}
+
+// Waits for the queued files and folds the workers' stage times into the session's
+// (summed over workers, so with N busy workers they can reach N times the wall time)
+void finish_file_workers(WorkerPool *pool) {
+    worker_pool_finish(pool);
+    size_t arena_bytes = 0;
+    unsigned long heap_calls = 0;
+    for (int i = 0; i < pool->worker_count; i++) {
+        bulk_stats_accumulate(&bulk_stats, &file_workers[i].stats);
+        arena_bytes += dsp_arena_capacity(&file_workers[i].arena);
+        heap_calls += file_workers[i].arena.heap_calls;
+        dsp_arena_free(&file_workers[i].arena);
+        adc_records_free(&file_workers[i].records);
+    }
+    printf("Worker pool: %llu files on %d threads, receive waited for the memory budget %llu times.\n",
+           (unsigned long long)pool->jobs_done, pool->worker_count, (unsigned long long)pool->submit_waits);
+    printf("Worker DSP buffers: %lu KiB held, %lu heap calls in all.\n", (unsigned long)(arena_bytes >> 10), heap_calls);
+    free(file_workers);
+    file_workers = NULL;
+}
+
+// Opens the streaming path's outputs for a new file: the archive (WRITE_BINARY_ARCHIVE) and
+// the per-sample CSV (WRITE_TEXT_EXPORT). One that can't be opened is reported and skipped.
+void open_stream_output(const char *filename, StreamOutput *output) {
+    char output_filepath[256 + 32];
+#if WRITE_BINARY_ARCHIVE
+    static const char *const columns[] = { "raw_weight", "filtered_weight" };
+    snprintf(output_filepath, sizeof(output_filepath), "output_data/all_data_%s.bin", filename);
+    if (archive_stream_open(&output->archive, output_filepath, columns, 2) != 0) {
+        perror("Error opening output archive"); // Keep reading so the connection stays in sync
+    }
+#endif
+#if WRITE_TEXT_EXPORT
+    snprintf(output_filepath, sizeof(output_filepath), "output_data/stream_%s.csv", filename);
+    output->file = fopen(output_filepath, "w");
+    if (output->file == NULL) {
+        perror("Error opening output file");
+    } else {
+        fprintf(output->file, "sample,adc,raw_weight,filtered_weight\n");
+    }
+#endif
+}
+
+// Closes the streaming path's outputs; the archive gets its header and directory now that
+// the sample count is known. Returns 0, or -1 if the archive couldn't be completed.
+int close_stream_output(const char *filename, StreamOutput *output) {
+    int result = 0;
+    if (output->file) {
+        fclose(output->file);
+        output->file = NULL;
+    }
+    if (output->archive.file) {
+        ArchiveHeader header;
+        archive_header_init(&header, filename, output->interval_ms > 0 ? 1000.0 / output->interval_ms : 0.0, ZERO_CAL, SCALE_CAL);
+        result = archive_stream_finish(&output->archive, &header, NULL, 0);
+        if (result != 0) perror("Error writing output archive");
+    }
+    return result;
+}
+
+// DSP stage for one block of streamed samples.
+// FIR filtering is still a placeholder here, so filtered weights equal raw weights.
+void write_stream_block(const long *samples, int count, void *ctx) {
+    StreamOutput *output = (StreamOutput *)ctx;
+    if (output->file == NULL && output->archive.file == NULL) {
+        output->index += count;
+        return;
+    }
+    double t = bulk_now();
+    uint64_t begin = metrics_begin(), start = begin;
+    double raw_weights[STREAM_BLOCK_SAMPLES];
+    adc_to_weights(&weight_cal, samples, raw_weights, count);
+    t = bulk_stage_end(&bulk_stats, BULK_STAGE_FILTER, t);
+    begin = metrics_end(METRIC_FIR, begin, (uint64_t)count);
+    const double *filtered_weights = raw_weights; // No actual filtering in this stub
+    const double *columns[2] = { raw_weights, filtered_weights };
+    archive_stream_append(&output->archive, columns, (size_t)count);
+    if (output->file) {
+        for (int i = 0; i < count; i++) {
+            fprintf(output->file, "%ld,%ld,%.4f,%.4f\n", output->index + i, samples[i], raw_weights[i], filtered_weights[i]);
         }
-        line = strtok(NULL, "\n");
     }
-    free(content_copy);
+    output->index += count;
+    bulk_stage_end(&bulk_stats, BULK_STAGE_WRITE, t);
+    output->block_ns += metrics_end(METRIC_WRITE, begin, (uint64_t)count) - start;
+    if (output->first_output_ms == 0) {
+        output->first_output_ms = GetTickCount64();
+    }
+}
+
+// Decodes a file sent as binary ADC frames (adc32 or delta); no text parsing needed
+void process_frames(const char *file_content, size_t file_content_len, WireEncoding encoding, const char *filename, int interval_ms, DspContext *dsp) {
+    long max_samples = adc_binary_sample_count((const uint8_t *)file_content, file_content_len, encoding);
+    if (max_samples < 0) {
+        fprintf(stderr, "Malformed ADC frame in %s, skipping file.\n", filename);
+        return;
+    }
+    long *raw_adc_values = (long *)dsp_arena_alloc(dsp->arena, (size_t)max_samples * sizeof(long));
+    if (raw_adc_values == NULL) {
+        perror("Failed to allocate memory for decoded samples");
+        return;
+    }
+    uint32_t sample_rate_mhz = 0;
+    double t = bulk_now();
+    uint64_t begin = metrics_begin();
+    long raw_count = adc_binary_decode((const uint8_t *)file_content, file_content_len, encoding, raw_adc_values, &sample_rate_mhz);
+    bulk_stage_end(dsp->stats, BULK_STAGE_PARSE, t);
+    if (raw_count < 0) {
+        fprintf(stderr, "Malformed ADC frame in %s, skipping file.\n", filename);
+    } else {
+        metrics_end(METRIC_PARSE, begin, (uint64_t)raw_count);
+        LOG_VERBOSE("Decoded %ld samples from %lu bytes of frames (%.3f Hz).\n", raw_count,
+               (unsigned long)file_content_len, sample_rate_mhz / 1000.0);
+        process_samples(raw_adc_values, (int)raw_count, filename, interval_ms, dsp);
+    }
+    dsp_arena_reset(dsp->arena);
+}
+
+// Processes the received data (simplified DSP and output)
+void process_data(const char *file_content, size_t file_content_len, const char *filename, int interval_ms, DspContext *dsp) {
+    // Parse the teraterm text in place (ADC: plus the firmware's MOV:/FIR:/kg lines)
+    AdcRecords *records = dsp->records;
+    adc_records_clear(records);
+    double t = bulk_now();
+    uint64_t begin = metrics_begin();
+    if (adc_parse_text(file_content, file_content_len, records) != 0) {
+        perror("Failed to allocate memory for parsed records");
+        return;
+    }
+    bulk_stage_end(dsp->stats, BULK_STAGE_PARSE, t);
+    metrics_end(METRIC_PARSE, begin, records->count);
+    size_t firmware_kg_count = 0;
+    for (size_t i = 0; i < records->count; i++) {
+        if (!isnan(records->kg[i])) firmware_kg_count++;
+    }
+    if (firmware_kg_count > 0) {
+        LOG_VERBOSE("Parsed %lu records, %lu with firmware MOV/FIR/kg lines.\n",
+               (unsigned long)records->count, (unsigned long)firmware_kg_count);
+    }
 
+    process_samples(records->adc, (int)records->count, filename, interval_ms, dsp);
+    dsp_arena_reset(dsp->arena);
+}
+
+// Runs the DSP stage and writes the output file for one recording's ADC samples
+void process_samples(const long *raw_adc_values, int raw_count, const char *filename, int interval_ms, DspContext *dsp) {
+    LOG_VERBOSE("Processing data for %s (interval: %dms)...\n", filename, interval_ms);
     if (raw_count == 0) {
         printf("No valid ADC values found in %s.\n", filename);
         return;
     }
 
-    printf("Found %d ADC values.\n", raw_count);
+    LOG_VERBOSE("Found %d ADC values.\n", raw_count);
+    dsp->stats->samples += (uint64_t)raw_count;
+    double t = bulk_now();
+    uint64_t begin = metrics_begin();
 
     // --- Simplified DSP Operations in C ---
     // For full DSP (FFT, FIR), you would integrate a C DSP library here (e.g., FFTW, or implement algorithms manually).
     // This example only shows basic DC offset removal and normalization.
 
-    double *raw_weights = (double *)malloc(raw_count * sizeof(double));
-    double *filtered_weights = (double *)malloc(raw_count * sizeof(double));
-    double *dc_removed_values = (double *)malloc(raw_count * sizeof(double));
+    // From the context's arena, released when the file is done
+    double *raw_weights = (double *)dsp_arena_alloc(dsp->arena, raw_count * sizeof(double));
+    double *filtered_weights = (double *)dsp_arena_alloc(dsp->arena, raw_count * sizeof(double));
+    double *dc_removed_values = (double *)dsp_arena_alloc(dsp->arena, raw_count * sizeof(double));
 
     if (raw_weights == NULL || filtered_weights == NULL || dc_removed_values == NULL) {
         perror("Failed to allocate memory for DSP arrays");
-        free(raw_adc_values);
-        free(raw_weights);
-        free(filtered_weights);
-        free(dc_removed_values);
         return;
     }
 
-    // Convert raw ADC to double and store for DC removal
-    for (int i = 0; i < raw_count; i++) {
-        dc_removed_values[i] = (double)raw_adc_values[i];
-    }
-
-    // Simple DC offset removal
-    double mean_val = calculate_mean(dc_removed_values, raw_count);
-    for (int i = 0; i < raw_count; i++) {
-        dc_removed_values[i] -= mean_val; // Now centered around zero
-        raw_weights[i] = normalize_to_weight(raw_adc_values[i]); // Raw weights for comparison
-    }
+    // Simple DC offset removal (exact integer mean)
+    double mean_val = adc_mean(raw_adc_values, raw_count);
+    adc_remove_offset(raw_adc_values, mean_val, dc_removed_values, raw_count); // Now centered around zero
+    adc_to_weights(&weight_cal, raw_adc_values, raw_weights, raw_count); // Raw weights for comparison
 
     // --- FIR Filtering (Placeholder) ---
     // In a real C application, you'd design and apply your FIR filter here.
@@ -290,24 +893,57 @@ void process_data(const char *file_content, const char *filename, int interval_m
     for (int i = 0; i < raw_count; i++) {
         filtered_weights[i] = raw_weights[i]; // No actual filtering in this stub
     }
-    printf("Note: FIR filtering is a placeholder in this C version.\n");
+    LOG_VERBOSE("Note: FIR filtering is a placeholder in this C version.\n");
 
 
     // --- FFT (Placeholder) ---
     // For FFT, you would use a library like FFTW or implement a Cooley-Tukey algorithm.
     // This is just a placeholder to acknowledge the step.
-    printf("Note: FFT calculation is a placeholder in this C version.\n");
+    LOG_VERBOSE("Note: FFT calculation is a placeholder in this C version.\n");
+    t = bulk_stage_end(dsp->stats, BULK_STAGE_FILTER, t);
+    begin = metrics_end(METRIC_FIR, begin, (uint64_t)raw_count); // Calibration and DC removal until the FIR is real
 
 
-    // Output processed data to a file
-    char output_filepath[256];
-    snprintf(output_filepath, sizeof(output_filepath), "output_data/all_data_%s.txt", filename);
-
     struct stat st = {0};
     if (stat("output_data", &st) == -1) {
         _mkdir("output_data"); // Use _mkdir on Windows
         printf("Created output folder: output_data\n");
     }
+#if WRITE_BINARY_ARCHIVE
+    write_weight_archive(filename, interval_ms, raw_weights, filtered_weights, raw_count);
+#endif
+#if WRITE_TEXT_EXPORT
+    write_text_export(filename, raw_weights, filtered_weights, raw_count);
+#endif
+    bulk_stage_end(dsp->stats, BULK_STAGE_WRITE, t);
+    metrics_end(METRIC_WRITE, begin, (uint64_t)raw_count);
+}
+
+// Writes one recording's weights as a binary column archive (no FIR or FFT stage here yet,
+// so there are no coefficient or spectrum columns)
+void write_weight_archive(const char *filename, int interval_ms, const double *raw_weights, const double *filtered_weights,
+                          int raw_count) {
+    char output_filepath[256];
+    snprintf(output_filepath, sizeof(output_filepath), "output_data/all_data_%s.bin", filename);
+
+    ArchiveHeader header;
+    archive_header_init(&header, filename, interval_ms > 0 ? 1000.0 / interval_ms : 0.0, ZERO_CAL, SCALE_CAL);
+    header.sample_count = (uint64_t)raw_count;
+    ArchiveColumn columns[] = {
+        { "raw_weight", ARCHIVE_F64, raw_weights, (uint64_t)raw_count },
+        { "filtered_weight", ARCHIVE_F64, filtered_weights, (uint64_t)raw_count },
+    };
+    if (archive_write(output_filepath, &header, columns, 2) != 0) {
+        perror("Error writing output archive");
+    } else {
+        LOG_VERBOSE("Successfully wrote data to %s\n", output_filepath);
+    }
+}
+
+// The original text dump of the same results (WRITE_TEXT_EXPORT)
+void write_text_export(const char *filename, const double *raw_weights, const double *filtered_weights, int raw_count) {
+    char output_filepath[256];
+    snprintf(output_filepath, sizeof(output_filepath), "output_data/all_data_%s.txt", filename);
 
     FILE *output_file = fopen(output_filepath, "w");
     if (output_file == NULL) {
@@ -340,20 +976,25 @@ void process_data(const char *file_content, const char *filename, int interval_m
         fprintf(output_file, "FFT Magnitudes: N/A (placeholder)\n\n");
 
         fclose(output_file);
-        printf("Successfully wrote data to %s\n", output_filepath);
+        LOG_VERBOSE("Successfully wrote data to %s\n", output_filepath);
     }
+}
 
-    free(raw_adc_values);
-    free(raw_weights);
-    free(filtered_weights);
-    free(dc_removed_values);
+// Prints the stage breakdown of a bulk replay: read and send from the server's BULK_STATS,
+// the rest measured here. The BULK_RESULT line is what bench_bulk collects.
+void report_bulk_stats(void) {
+    BulkStats stats = bulk_stats;
+    stats.stage_s[BULK_STAGE_READ] = server_bulk_stats.stage_s[BULK_STAGE_READ];
+    stats.stage_s[BULK_STAGE_SEND] = server_bulk_stats.stage_s[BULK_STAGE_SEND];
+    bulk_stats_print(stdout, "Bulk replay", &stats);
+    char line[512];
+    bulk_stats_format(&stats, ' ', line, sizeof(line));
+    printf("%s%s\n", BULK_RESULT_PREFIX, line);
 }
 
 // Normalizes an ADC value to a weight
 double normalize_to_weight(long adc_value) {
-    double data_in = (double)adc_value / (double)0x80000000;
-    if (SCALE_CAL == 0) return 0.0; // Avoid division by zero
-    return (data_in - ZERO_CAL) / SCALE_CAL;
+    return weight_from_adc(&weight_cal, adc_value); // Calibration precomputed, no division
 }
 
 // Calculates the mean of a double array
@@ -0,0 +1,150 @@
+// Per-session bump allocator for the clients' per-file buffers.
+//
+// Everything one file needs while it is processed (decoded samples, filter output, weights,
+// save arrays) is carved out of the arena, and all of it is released at once with
+// dsp_arena_reset() when the file is done. When a file needs more than the arena holds,
+// another chunk at least twice the size of the newest is added; the next reset replaces the
+// chunks with a single one as large as all of them, so once the arena has seen the largest
+// file, processing makes no heap calls at all.
+//
+// Allocations are DSP_ARENA_ALIGN-byte aligned (a cache line; enough for any SIMD load).
+// The most recent allocation can be grown in place with dsp_arena_grow(), which makes
+// doubling arrays cheap. Not thread safe: one arena per thread.
+#ifndef DSP_ARENA_H
+#define DSP_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DSP_ARENA_ALIGN 64
+#define DSP_ARENA_MIN_CHUNK ((size_t)64 << 10) // First chunk: 64 KiB
+
+typedef struct DspArenaChunk {
+    struct DspArenaChunk *older;
+    char *next;                 // First free byte (aligned)
+    char *end;
+    size_t size;                // Usable bytes
+} DspArenaChunk;
+
+typedef struct {
+    DspArenaChunk *chunks;      // Newest first; allocations come from the newest
+    char *last;                 // Most recent allocation, the one dsp_arena_grow() can extend
+    size_t in_use;              // Bytes handed out since the last reset (rounded to DSP_ARENA_ALIGN)
+    size_t high_water;          // Largest in_use so far
+    unsigned long heap_calls;   // malloc() and free() calls made, to check the steady state
+} DspArena;
+
+static inline void dsp_arena_init(DspArena *arena) {
+    memset(arena, 0, sizeof(*arena));
+}
+
+static inline size_t dsp_arena_round(size_t bytes) {
+    return (bytes + DSP_ARENA_ALIGN - 1) & ~(size_t)(DSP_ARENA_ALIGN - 1);
+}
+
+// Adds a chunk of at least min_size usable bytes. Returns it, or NULL if out of memory.
+static inline DspArenaChunk *dsp_arena_add_chunk(DspArena *arena, size_t min_size) {
+    size_t size = arena->chunks ? 2 * arena->chunks->size : DSP_ARENA_MIN_CHUNK;
+    if (size < min_size) size = min_size;
+    DspArenaChunk *chunk = (DspArenaChunk *)malloc(sizeof(DspArenaChunk) + DSP_ARENA_ALIGN + size);
+    arena->heap_calls++;
+    if (chunk == NULL) {
+        return NULL;
+    }
+    uintptr_t base = ((uintptr_t)(chunk + 1) + DSP_ARENA_ALIGN - 1) & ~(uintptr_t)(DSP_ARENA_ALIGN - 1);
+    chunk->older = arena->chunks;
+    chunk->next = (char *)base;
+    chunk->end = chunk->next + size;
+    chunk->size = size;
+    arena->chunks = chunk;
+    return chunk;
+}
+
+// bytes of uninitialised memory, valid until the next reset. Returns NULL if out of memory.
+static inline void *dsp_arena_alloc(DspArena *arena, size_t bytes) {
+    size_t rounded = dsp_arena_round(bytes ? bytes : 1);
+    DspArenaChunk *chunk = arena->chunks;
+    if (chunk == NULL || (size_t)(chunk->end - chunk->next) < rounded) {
+        chunk = dsp_arena_add_chunk(arena, rounded);
+        if (chunk == NULL) {
+            return NULL;
+        }
+    }
+    char *p = chunk->next;
+    chunk->next += rounded;
+    arena->last = p;
+    arena->in_use += rounded;
+    if (arena->in_use > arena->high_water) arena->high_water = arena->in_use;
+    return p;
+}
+
+// Resizes ptr (from this arena, old_bytes long) to new_bytes, in place when it is the most
+// recent allocation and there is room, otherwise by copying to a new allocation (the old
+// space is reclaimed at the next reset). Returns the new pointer, or NULL if out of memory
+// (ptr stays valid). ptr may be NULL.
+static inline void *dsp_arena_grow(DspArena *arena, void *ptr, size_t old_bytes, size_t new_bytes) {
+    if (ptr == NULL) {
+        return dsp_arena_alloc(arena, new_bytes);
+    }
+    size_t old_rounded = dsp_arena_round(old_bytes ? old_bytes : 1);
+    size_t new_rounded = dsp_arena_round(new_bytes ? new_bytes : 1);
+    if (new_rounded <= old_rounded) {
+        return ptr;
+    }
+    DspArenaChunk *chunk = arena->chunks;
+    if ((char *)ptr == arena->last && chunk->next == arena->last + old_rounded &&
+        (size_t)(chunk->end - arena->last) >= new_rounded) {
+        chunk->next = arena->last + new_rounded;
+        arena->in_use += new_rounded - old_rounded;
+        if (arena->in_use > arena->high_water) arena->high_water = arena->in_use;
+        return ptr;
+    }
+    void *moved = dsp_arena_alloc(arena, new_bytes);
+    if (moved != NULL) {
+        memcpy(moved, ptr, old_bytes);
+    }
+    return moved;
+}
+
+// Releases every allocation. If the last file needed more than one chunk, they are merged
+// into one so the next file of that size fits without growing.
+static inline void dsp_arena_reset(DspArena *arena) {
+    DspArenaChunk *chunk = arena->chunks;
+    if (chunk != NULL && chunk->older != NULL) {
+        size_t total = 0;
+        while (chunk != NULL) {
+            DspArenaChunk *older = chunk->older;
+            total += chunk->size;
+            free(chunk);
+            arena->heap_calls++;
+            chunk = older;
+        }
+        arena->chunks = NULL;
+        dsp_arena_add_chunk(arena, total); // On failure the next alloc simply retries
+    } else if (chunk != NULL) {
+        chunk->next = chunk->end - chunk->size;
+    }
+    arena->last = NULL;
+    arena->in_use = 0;
+}
+
+static inline void dsp_arena_free(DspArena *arena) {
+    DspArenaChunk *chunk = arena->chunks;
+    while (chunk != NULL) {
+        DspArenaChunk *older = chunk->older;
+        free(chunk);
+        chunk = older;
+    }
+    dsp_arena_init(arena);
+}
+
+// Bytes the arena currently holds (all chunks)
+static inline size_t dsp_arena_capacity(const DspArena *arena) {
+    size_t total = 0;
+    for (const DspArenaChunk *chunk = arena->chunks; chunk != NULL; chunk = chunk->older) total += chunk->size;
+    return total;
+}
+
+#endif // DSP_ARENA_H
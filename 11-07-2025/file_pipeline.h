@@ -0,0 +1,525 @@
+// Whole-file DSP chain of the Linux clients: c2 runs it on files received from the
+// server, reprocess on recordings read straight from disk.
+//
+//   text or binary ADC frames -> samples -> FIR (fir_engine.h, DC removed and re-added)
+//   -> weights (weight_kernels.h) -> spectrum of the last FFT_WINDOW_SIZE raw weights
+//   -> OUTPUT_FOLDER/all_data_<file>.bin (weight_archive.h)
+//
+// A multi-channel file (adc32 frames with channel_count > 1) is decoded into one array per
+// load cell, filtered by the context's FirBank and calibrated with each channel's own
+// constants; every channel gets its own outputs, all_data_<file>.ch<n>.bin.
+//
+// Calibration, filter and output settings live here so both front ends produce the same
+// files; each can override them with -D, and the calibration per channel at start-up with
+// a table (init_calibration()). A DspContext carries the per-thread state (FIR history,
+// stage counters, arena, parsed records), so files processed at the same time on different
+// threads share nothing but the read-only calibration, coefficient and FFT tables.
+//
+// Needs the CMSIS-DSP headers and library (arm_math.h), like the tools that include it.
+#ifndef FILE_PIPELINE_H
+#define FILE_PIPELINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/stat.h>   // For stat(), mkdir
+
+#include "arm_math.h"       // Main CMSIS-DSP header
+#include "adc_protocol.h"   // Binary sample frames
+#include "adc_parser.h"     // In-place teraterm text parser
+#include "weight_archive.h" // Binary column output for process_samples()
+#include "bulk_stats.h"     // Per-stage timing
+#include "weight_kernels.h" // Vectorised calibration and DC mean
+#include "channel_calibration.h" // Per-channel calibration table
+#include "dsp_arena.h"      // Per-file DSP buffers, reset between files
+#include "metrics.h"        // Stage latency histograms, LOG_VERBOSE
+
+// Calibration constants (UPDATED as per Python client request)
+#ifndef ZERO_CAL
+#define ZERO_CAL -0.0006981067708
+#endif
+#ifndef SCALE_CAL
+#define SCALE_CAL 0.00000452466566
+#endif
+
+#ifndef CALIBRATION_FILE
+#define CALIBRATION_FILE "calibration.txt" // Per-channel table applied at start-up if it exists
+#endif
+
+static ChannelCalibration calibration; // ZERO_CAL / SCALE_CAL, then the table (init_calibration())
+
+// FIR Filter Order (Number of taps for CMSIS-DSP FIR)
+#ifndef FIR_NUM_TAPS
+#define FIR_NUM_TAPS 51
+#endif
+#ifndef FIR_PATH
+#define FIR_PATH FIR_PATH_F32   // FIR_PATH_F32, FIR_PATH_Q31 (raw ADC is already q31; integer end to end, as on the MCU), FIR_PATH_Q31_FAST or FIR_PATH_Q15
+#endif
+#ifndef FIR_ACCURACY_CHECK
+#define FIR_ACCURACY_CHECK 0    // 1 = also run a double-precision FIR and report FIR_PATH's error against it
+#endif
+#ifndef FIR_RESET_PER_FILE
+#define FIR_RESET_PER_FILE 0    // 0 = filter history carries over from one file to the next (pool workers start every file clean)
+#endif
+
+#include "fir_engine.h" // Block-based CMSIS-DSP FIR stage (needs FIR_NUM_TAPS)
+
+_Static_assert(FIR_BANK_CHANNELS >= ADC_MAX_CHANNELS, "a FirBank must cover every channel a frame can carry");
+
+// Spectrum of each file's last FFT_WINDOW_SIZE samples (arm_rfft_fast_f32: 32..4096, power of two)
+#ifndef FFT_WINDOW_SIZE
+#define FFT_WINDOW_SIZE 256
+#endif
+
+// Output files
+#ifndef OUTPUT_FOLDER
+#define OUTPUT_FOLDER "output_data" // Default; reprocess -o picks another
+#endif
+#ifndef WRITE_BINARY_ARCHIVE
+#define WRITE_BINARY_ARCHIVE 1 // Results as <output folder>/all_data_<file>.bin (see weight_archive.h), streamed or whole-file
+#endif
+#ifndef WRITE_TEXT_EXPORT
+#define WRITE_TEXT_EXPORT 0    // 1 = also write the old text output: all_data_<file>.txt, or c2's stream_<file>.csv when streaming
+#endif
+
+// One FIR stage for the whole session, shared by the whole-file and streaming paths.
+// Blocks are at most FIR_BLOCK_SIZE samples, so the state buffers stay fixed-size.
+static FirEngine fir_engine;
+static FirBank fir_bank; // The same for multi-channel files, one engine per channel
+
+// Real FFT stage, set up once by init_fft_stage(): CMSIS twiddle tables plus a Hann window
+static arm_rfft_fast_instance_f32 fft_instance;
+static float32_t fft_hann[FFT_WINDOW_SIZE];
+static float32_t fft_window_gain; // Sum of fft_hann, for amplitude scaling
+
+static const char *output_folder = OUTPUT_FOLDER; // Where every output file goes
+
+// DSP state a whole file is processed with: the session's on the receive thread, or one
+// pool worker's own, so concurrent files never share filter history, counters or buffers
+typedef struct {
+    FirEngine *fir;
+    FirBank *bank;              // Multi-channel files
+    BulkStats *stats;
+    DspArena *arena;            // Decoded samples, filter output and weights; reset after each file
+    AdcRecords *records;        // Parsed text records, cleared (not freed) between files
+} DspContext;
+
+// A pool worker's private state
+typedef struct {
+    FirEngine fir;
+    FirBank bank;
+    BulkStats stats;            // Parse, filter and write time and samples; merged at the end
+    DspArena arena;
+    AdcRecords records;
+} FileWorker;
+
+// Normalizes an ADC value of channel 0 to a weight
+static inline double normalize_to_weight(long adc_value) {
+    return weight_from_adc(&calibration.weight[0], adc_value); // Calibration precomputed, no division
+}
+
+// Gives every channel ZERO_CAL / SCALE_CAL, then applies the table at path, or
+// CALIBRATION_FILE if path is NULL and there is one. Returns 0, or -1 if the table was unusable.
+static inline int init_calibration(const char *path) {
+    channel_calibration_fill(&calibration, ZERO_CAL, SCALE_CAL);
+    struct stat st;
+    if (path == NULL) {
+        if (stat(CALIBRATION_FILE, &st) != 0) return 0;
+        path = CALIBRATION_FILE;
+    }
+    int set = channel_calibration_load(&calibration, path);
+    if (set < 0) return -1;
+    printf("Calibration for %d channel(s) from %s.\n", set, path);
+    return 0;
+}
+
+// Creates the output folder if it isn't there yet
+static inline void ensure_output_folder(void) {
+    struct stat st = {0};
+    if (stat(output_folder, &st) == -1 && mkdir(output_folder, 0700) == 0) { // Use mkdir on Linux
+        printf("Created output folder: %s\n", output_folder);
+    }
+}
+
+// Sets up the session's FIR stage with the moving-average coefficients
+static inline void init_fir_stage(void) {
+    // Hardcoded FIR coefficients for a simple low-pass filter (similar to firwin output)
+    // For a 50Hz sampling rate and 10Hz cutoff, these might be values from firwin(51, 10/25).
+    // This is a simplified rectangular window (moving average) for demonstration with CMSIS-DSP.
+    float32_t firCoeffs_f32[FIR_NUM_TAPS];
+    for (int i = 0; i < FIR_NUM_TAPS; i++) {
+        firCoeffs_f32[i] = 1.0f / (float32_t)FIR_NUM_TAPS; // Simple moving average
+    }
+    fir_engine_init(&fir_engine, FIR_PATH, firCoeffs_f32);
+#if FIR_ACCURACY_CHECK
+    fir_engine_enable_check(&fir_engine);
+#endif
+    fir_bank_init(&fir_bank, FIR_PATH, firCoeffs_f32, FIR_ACCURACY_CHECK);
+}
+
+// Sets up a pool worker's state with the session's coefficients (after init_fir_stage())
+static inline void file_worker_init(FileWorker *worker) {
+    fir_engine_init(&worker->fir, FIR_PATH, fir_engine.coeffs_f32);
+    if (fir_engine.check) fir_engine_enable_check(&worker->fir);
+    fir_bank_init(&worker->bank, FIR_PATH, fir_engine.coeffs_f32, fir_engine.check);
+    dsp_arena_init(&worker->arena);
+    adc_records_init(&worker->records);
+}
+
+// Builds the FFT twiddle tables and window once for the whole session
+static inline void init_fft_stage(void) {
+    if (arm_rfft_fast_init_f32(&fft_instance, FFT_WINDOW_SIZE) != ARM_MATH_SUCCESS) {
+        fprintf(stderr, "arm_rfft_fast_init_f32 does not support %d points.\n", FFT_WINDOW_SIZE);
+        exit(EXIT_FAILURE);
+    }
+    fft_window_gain = 0.0f;
+    for (int i = 0; i < FFT_WINDOW_SIZE; i++) {
+        fft_hann[i] = 0.5f - 0.5f * cosf(2.0f * PI * i / FFT_WINDOW_SIZE); // Periodic Hann
+        fft_window_gain += fft_hann[i];
+    }
+}
+
+// Amplitude spectrum (FFT_WINDOW_SIZE / 2 bins, bin k at k * fs / FFT_WINDOW_SIZE) of the
+// last FFT_WINDOW_SIZE weights, with their mean removed. Returns the number of bins, or 0
+// if there are fewer samples than that.
+static inline int compute_spectrum(const double *weights, int count, int interval_ms, float32_t *magnitude_out, float32_t *dominant_hz_out) {
+    if (count < FFT_WINDOW_SIZE || interval_ms <= 0) {
+        return 0;
+    }
+    uint64_t begin = metrics_begin();
+    const double *window = weights + (count - FFT_WINDOW_SIZE);
+    double mean = 0.0;
+    for (int i = 0; i < FFT_WINDOW_SIZE; i++) mean += window[i];
+    mean /= FFT_WINDOW_SIZE;
+
+    float32_t in[FFT_WINDOW_SIZE], out[FFT_WINDOW_SIZE];
+    for (int i = 0; i < FFT_WINDOW_SIZE; i++) {
+        in[i] = (float32_t)(window[i] - mean) * fft_hann[i];
+    }
+    arm_rfft_fast_f32(&fft_instance, in, out, 0);
+    out[1] = 0.0f; // Packed Nyquist term; bin 0 stays DC only
+    arm_cmplx_mag_f32(out, magnitude_out, FFT_WINDOW_SIZE / 2);
+
+    int peak = 1;
+    for (int k = 1; k < FFT_WINDOW_SIZE / 2; k++) {
+        magnitude_out[k] *= 2.0f / fft_window_gain;
+        if (magnitude_out[k] > magnitude_out[peak]) peak = k;
+    }
+    magnitude_out[0] /= fft_window_gain;
+    *dominant_hz_out = peak * (1000.0f / interval_ms) / FFT_WINDOW_SIZE;
+    metrics_end(METRIC_FFT, begin, 0);
+    return FFT_WINDOW_SIZE / 2;
+}
+
+// Called before each file's samples; clears the filter history only if configured to
+static inline void start_file_filtering(FirEngine *engine) {
+#if FIR_RESET_PER_FILE
+    fir_engine_reset(engine);
+#else
+    (void)engine;
+#endif
+}
+
+static inline void start_file_bank_filtering(FirBank *bank) {
+#if FIR_RESET_PER_FILE
+    fir_bank_reset(bank);
+#else
+    (void)bank;
+#endif
+}
+
+// <output folder>/all_data_<file>.<extension>, or all_data_<file>.ch<n>.<extension> for
+// channel n of a multi-channel file
+static inline void output_file_path(char *path, size_t size, const char *filename, int channel, int channel_count, const char *extension) {
+    if (channel_count > 1) {
+        snprintf(path, size, "%s/all_data_%s.ch%d.%s", output_folder, filename, channel, extension);
+    } else {
+        snprintf(path, size, "%s/all_data_%s.%s", output_folder, filename, extension);
+    }
+}
+
+// Frequency of each of the first fft_bins bins of compute_spectrum()'s output
+static inline void spectrum_frequencies(float32_t *frequency_out, int fft_bins, int interval_ms) {
+    for (int k = 0; k < fft_bins; k++) {
+        frequency_out[k] = k * (1000.0f / interval_ms) / FFT_WINDOW_SIZE;
+    }
+}
+
+// Writes one recording's (or one of its channels') weights, FIR coefficients and spectrum as a binary column archive
+static inline void write_weight_archive(const char *filename, int channel, int channel_count, int interval_ms, const double *raw_weights,
+                                        const double *filtered_weights, int raw_count, const float32_t *fft_magnitude, int fft_bins) {
+    char output_filepath[512];
+    output_file_path(output_filepath, sizeof(output_filepath), filename, channel, channel_count, "bin");
+
+    float32_t fft_frequency[FFT_WINDOW_SIZE / 2];
+    spectrum_frequencies(fft_frequency, fft_bins, interval_ms);
+
+    ArchiveHeader header;
+    archive_header_init(&header, filename, interval_ms > 0 ? 1000.0 / interval_ms : 0.0, calibration.zero_cal[channel], calibration.scale_cal[channel]);
+    header.sample_count = (uint64_t)raw_count;
+    header.fir_taps = FIR_NUM_TAPS;
+    header.fft_size = (fft_bins > 0) ? FFT_WINDOW_SIZE : 0;
+    ArchiveColumn columns[] = {
+        { "fir_coefficients", ARCHIVE_F32, fir_engine.coeffs_f32, FIR_NUM_TAPS },
+        { "raw_weight", ARCHIVE_F64, raw_weights, (uint64_t)raw_count },
+        { "filtered_weight", ARCHIVE_F64, filtered_weights, (uint64_t)raw_count },
+        { "fft_frequency_hz", ARCHIVE_F32, fft_frequency, (uint64_t)fft_bins },
+        { "fft_magnitude", ARCHIVE_F32, fft_magnitude, (uint64_t)fft_bins },
+    };
+    int column_count = (fft_bins > 0) ? 5 : 3;
+    if (archive_write(output_filepath, &header, columns, column_count) != 0) {
+        perror("Error writing output archive");
+    } else {
+        LOG_VERBOSE("Successfully wrote data to %s\n", output_filepath);
+    }
+}
+
+// The original text dump of the same results (WRITE_TEXT_EXPORT)
+static inline void write_text_export(const char *filename, int channel, int channel_count, int interval_ms, const double *raw_weights,
+                                     const double *filtered_weights, int raw_count, const float32_t *fft_magnitude, int fft_bins,
+                                     float32_t dominant_hz) {
+    char output_filepath[512];
+    output_file_path(output_filepath, sizeof(output_filepath), filename, channel, channel_count, "txt");
+
+    FILE *output_file = fopen(output_filepath, "w");
+    if (output_file == NULL) {
+        perror("Error opening output file");
+    } else {
+        fprintf(output_file, "Raw Weights (first 10): [");
+        for (int i = 0; i < fmin(10, raw_count); i++) {
+            fprintf(output_file, "%.4f%s", raw_weights[i], (i == fmin(10, raw_count) - 1) ? "" : ", ");
+        }
+        fprintf(output_file, "]\n");
+        fprintf(output_file, "Raw Weights (total %d samples): [", raw_count);
+        for (int i = 0; i < raw_count; i++) {
+            fprintf(output_file, "%.4f%s", raw_weights[i], (i == raw_count - 1) ? "" : ", "); 
+        }
+        fprintf(output_file, "]\n\n");
+
+        fprintf(output_file, "Filtered Weights (first 10): [");
+        for (int i = 0; i < fmin(10, raw_count); i++) {
+            fprintf(output_file, "%.4f%s", filtered_weights[i], (i == fmin(10, raw_count) - 1) ? "" : ", ");
+        }
+        fprintf(output_file, "]\n");
+        fprintf(output_file, "Filtered Weights (total %d samples): [", raw_count);
+        for (int i = 0; i < raw_count; i++) {
+            fprintf(output_file, "%.4f%s", filtered_weights[i], (i == raw_count - 1) ? "" : ", ");
+        }
+        fprintf(output_file, "]\n\n");
+
+        fprintf(output_file, "FIR Coefficients: Moving Average (Order %d)\n\n", FIR_NUM_TAPS);
+        if (fft_bins > 0) {
+            fprintf(output_file, "FFT Frequencies (last %d samples, Hann window): [", FFT_WINDOW_SIZE);
+            for (int k = 0; k < fft_bins; k++) {
+                fprintf(output_file, "%.4f%s", k * (1000.0 / interval_ms) / FFT_WINDOW_SIZE, (k == fft_bins - 1) ? "" : ", ");
+            }
+            fprintf(output_file, "]\n\n");
+            fprintf(output_file, "FFT Magnitudes (dominant %.4f Hz): [", dominant_hz);
+            for (int k = 0; k < fft_bins; k++) {
+                fprintf(output_file, "%.6f%s", fft_magnitude[k], (k == fft_bins - 1) ? "" : ", ");
+            }
+            fprintf(output_file, "]\n\n");
+        } else {
+            fprintf(output_file, "FFT Frequencies: N/A (fewer than %d samples)\n\n", FFT_WINDOW_SIZE);
+            fprintf(output_file, "FFT Magnitudes: N/A (fewer than %d samples)\n\n", FFT_WINDOW_SIZE);
+        }
+
+        fclose(output_file);
+        LOG_VERBOSE("Successfully wrote data to %s\n", output_filepath);
+    }
+}
+
+// Weights, spectrum and output files of one channel whose samples are filtered; t is when
+// its filter stage started. Returns the time the output was written.
+static inline double finish_channel(const long *raw_adc, const long *filtered_adc, int raw_count, const char *filename,
+                                    int channel, int channel_count, int interval_ms, DspContext *dsp, double t) {
+    double *raw_weights = (double *)dsp_arena_alloc(dsp->arena, raw_count * sizeof(double));
+    double *filtered_weights = (double *)dsp_arena_alloc(dsp->arena, raw_count * sizeof(double));
+    if (raw_weights == NULL || filtered_weights == NULL) {
+        perror("Failed to allocate memory for DSP arrays");
+        return t;
+    }
+
+    // Normalize raw and filtered ADC values to weights
+    const WeightCalibration *cal = &calibration.weight[channel];
+    adc_to_weights(cal, raw_adc, raw_weights, raw_count); // Raw weights for output
+    adc_to_weights(cal, filtered_adc, filtered_weights, raw_count);
+
+    // --- FFT of the last FFT_WINDOW_SIZE raw weights (CMSIS-DSP real FFT) ---
+    float32_t fft_magnitude[FFT_WINDOW_SIZE / 2];
+    float32_t dominant_hz = 0.0f;
+    int fft_bins = compute_spectrum(raw_weights, raw_count, interval_ms, fft_magnitude, &dominant_hz);
+    if (fft_bins > 0) {
+        LOG_VERBOSE("Dominant frequency over the last %d samples: %.3f Hz\n", FFT_WINDOW_SIZE, dominant_hz);
+    }
+    t = bulk_stage_end(dsp->stats, BULK_STAGE_FILTER, t);
+    uint64_t begin = metrics_begin();
+
+    ensure_output_folder();
+#if WRITE_BINARY_ARCHIVE
+    write_weight_archive(filename, channel, channel_count, interval_ms, raw_weights, filtered_weights, raw_count, fft_magnitude, fft_bins);
+#endif
+#if WRITE_TEXT_EXPORT
+    write_text_export(filename, channel, channel_count, interval_ms, raw_weights, filtered_weights, raw_count, fft_magnitude, fft_bins,
+                      dominant_hz);
+#endif
+    t = bulk_stage_end(dsp->stats, BULK_STAGE_WRITE, t);
+    metrics_end(METRIC_WRITE, begin, (uint64_t)raw_count);
+    return t;
+}
+
+// Runs the CMSIS-DSP stage and writes the output file for one recording's ADC samples
+static inline void process_samples(const long *raw_adc_values_long, int raw_count, const char *filename, int interval_ms, DspContext *dsp) {
+    LOG_VERBOSE("Processing data for %s (interval: %dms)...\n", filename, interval_ms);
+    if (raw_count == 0) {
+        printf("No valid ADC values found in %s.\n", filename);
+        return;
+    }
+
+    LOG_VERBOSE("Found %d ADC values.\n", raw_count);
+    dsp->stats->samples += (uint64_t)raw_count;
+    double t = bulk_now();
+
+    // Filter output, from the context's arena (released when the file is done)
+    long *filtered_adc = (long *)dsp_arena_alloc(dsp->arena, raw_count * sizeof(long));
+    if (filtered_adc == NULL) {
+        perror("Failed to allocate memory for DSP arrays");
+        return;
+    }
+
+    // --- FIR Filtering using CMSIS-DSP ---
+    // The engine removes and re-adds the DC offset and runs in FIR_BLOCK_SIZE blocks,
+    // so file length is no longer limited by the state buffer.
+    LOG_VERBOSE("Applying FIR filter using CMSIS-DSP (Order: %d, %s)...\n", FIR_NUM_TAPS, fir_path_name(FIR_PATH));
+    start_file_filtering(dsp->fir);
+    uint64_t begin = metrics_begin();
+    fir_engine_process(dsp->fir, raw_adc_values_long, filtered_adc, raw_count);
+    metrics_end(METRIC_FIR, begin, (uint64_t)raw_count);
+    LOG_VERBOSE("FIR filtering complete.\n");
+    if (LOG_LEVEL >= LOG_LEVEL_VERBOSE) fir_engine_report(dsp->fir);
+
+    finish_channel(raw_adc_values_long, filtered_adc, raw_count, filename, 0, 1, interval_ms, dsp, t);
+}
+
+// The same for every channel of a multi-channel file (raw_adc[c] holds channel c's
+// `steps` samples): all channels through the FIR bank together, then each one's outputs
+static inline void process_channels(const long *const *raw_adc, int channel_count, int steps, const char *filename, int interval_ms, DspContext *dsp) {
+    LOG_VERBOSE("Processing %d channels of %s (interval: %dms)...\n", channel_count, filename, interval_ms);
+    if (steps == 0) {
+        printf("No valid ADC values found in %s.\n", filename);
+        return;
+    }
+    uint64_t total = (uint64_t)steps * (uint64_t)channel_count;
+    dsp->stats->samples += total;
+    double t = bulk_now();
+
+    long *filtered_adc[ADC_MAX_CHANNELS];
+    for (int c = 0; c < channel_count; c++) {
+        filtered_adc[c] = (long *)dsp_arena_alloc(dsp->arena, steps * sizeof(long));
+        if (filtered_adc[c] == NULL) {
+            perror("Failed to allocate memory for DSP arrays");
+            return;
+        }
+    }
+
+    start_file_bank_filtering(dsp->bank);
+    uint64_t begin = metrics_begin();
+    fir_bank_process(dsp->bank, channel_count, raw_adc, filtered_adc, steps);
+    metrics_end(METRIC_FIR, begin, total);
+    if (LOG_LEVEL >= LOG_LEVEL_VERBOSE) fir_engine_report(&dsp->bank->engines[0]);
+
+    for (int c = 0; c < channel_count; c++) {
+        t = finish_channel(raw_adc[c], filtered_adc[c], steps, filename, c, channel_count, interval_ms, dsp, t);
+    }
+}
+
+// Decodes a file of adc32 frames with channel_count > 1 into one array per channel
+static inline void process_channel_frames(const char *file_content, size_t file_content_len, int channel_count, const char *filename, int interval_ms, DspContext *dsp) {
+    size_t capacity = file_content_len / ADC_FRAME_BYTES * adc_frame_steps(channel_count);
+    long *raw_adc[ADC_MAX_CHANNELS];
+    for (int c = 0; c < channel_count; c++) {
+        raw_adc[c] = (long *)dsp_arena_alloc(dsp->arena, capacity * sizeof(long));
+        if (raw_adc[c] == NULL) {
+            perror("Failed to allocate memory for decoded samples");
+            return;
+        }
+    }
+    uint32_t sample_rate_mhz = 0;
+    double t = bulk_now();
+    uint64_t begin = metrics_begin();
+    long steps = adc_channel_frames_decode((const uint8_t *)file_content, file_content_len, channel_count, raw_adc, &sample_rate_mhz);
+    bulk_stage_end(dsp->stats, BULK_STAGE_PARSE, t);
+    if (steps < 0) {
+        fprintf(stderr, "Malformed ADC frame in %s, skipping file.\n", filename);
+        return;
+    }
+    metrics_end(METRIC_PARSE, begin, (uint64_t)steps * (uint64_t)channel_count);
+    LOG_VERBOSE("Decoded %ld steps of %d channels from %lu bytes of frames (%.3f Hz).\n", steps, channel_count,
+                (unsigned long)file_content_len, sample_rate_mhz / 1000.0);
+    process_channels((const long *const *)raw_adc, channel_count, (int)steps, filename, interval_ms, dsp);
+}
+
+// Decodes a file sent as binary ADC frames (adc32 or delta); no text parsing needed. Multi-channel
+// files go to process_channel_frames().
+static inline void process_frames(const char *file_content, size_t file_content_len, WireEncoding encoding, const char *filename, int interval_ms, DspContext *dsp) {
+    int channel_count = (encoding == ENCODING_ADC32) ? adc_frames_channel_count((const uint8_t *)file_content, file_content_len) : 1;
+    if (channel_count > 1) {
+        process_channel_frames(file_content, file_content_len, channel_count, filename, interval_ms, dsp);
+        dsp_arena_reset(dsp->arena);
+        return;
+    }
+    long max_samples = adc_binary_sample_count((const uint8_t *)file_content, file_content_len, encoding);
+    if (max_samples < 0) {
+        fprintf(stderr, "Malformed ADC frame in %s, skipping file.\n", filename);
+        return;
+    }
+    long *raw_adc_values_long = (long *)dsp_arena_alloc(dsp->arena, (size_t)max_samples * sizeof(long));
+    if (raw_adc_values_long == NULL) {
+        perror("Failed to allocate memory for decoded samples");
+        return;
+    }
+    uint32_t sample_rate_mhz = 0;
+    double t = bulk_now();
+    uint64_t begin = metrics_begin();
+    long raw_count = adc_binary_decode((const uint8_t *)file_content, file_content_len, encoding, raw_adc_values_long, &sample_rate_mhz);
+    bulk_stage_end(dsp->stats, BULK_STAGE_PARSE, t);
+    if (raw_count < 0) {
+        fprintf(stderr, "Malformed ADC frame in %s, skipping file.\n", filename);
+    } else {
+        metrics_end(METRIC_PARSE, begin, (uint64_t)raw_count);
+        LOG_VERBOSE("Decoded %ld samples from %lu bytes of frames (%.3f Hz).\n", raw_count,
+               (unsigned long)file_content_len, sample_rate_mhz / 1000.0);
+        process_samples(raw_adc_values_long, (int)raw_count, filename, interval_ms, dsp);
+    }
+    dsp_arena_reset(dsp->arena);
+}
+
+// Processes the received data (FIR filter using CMSIS-DSP)
+static inline void process_data(const char *file_content, size_t file_content_len, const char *filename, int interval_ms, DspContext *dsp) {
+    // Parse the teraterm text in place (ADC: plus the firmware's MOV:/FIR:/kg lines)
+    AdcRecords *records = dsp->records;
+    adc_records_clear(records);
+    double t = bulk_now();
+    uint64_t begin = metrics_begin();
+    if (adc_parse_text(file_content, file_content_len, records) != 0) {
+        perror("Failed to allocate memory for parsed records");
+        return;
+    }
+    bulk_stage_end(dsp->stats, BULK_STAGE_PARSE, t);
+    metrics_end(METRIC_PARSE, begin, records->count);
+    size_t firmware_kg_count = 0;
+    for (size_t i = 0; i < records->count; i++) {
+        if (!isnan(records->kg[i])) firmware_kg_count++;
+    }
+    if (firmware_kg_count > 0) {
+        LOG_VERBOSE("Parsed %lu records, %lu with firmware MOV/FIR/kg lines.\n",
+               (unsigned long)records->count, (unsigned long)firmware_kg_count);
+    }
+
+    process_samples(records->adc, (int)records->count, filename, interval_ms, dsp);
+    dsp_arena_reset(dsp->arena);
+}
+
+#endif // FILE_PIPELINE_H
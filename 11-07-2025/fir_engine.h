@@ -0,0 +1,254 @@
+// Persistent block-based FIR stage on top of CMSIS-DSP (used by c2.c).
+//
+// Samples go in as raw ADC counts and come out as filtered ADC counts, so callers keep
+// using normalize_to_weight() on the result. Internally the input is split into blocks
+// of at most FIR_BLOCK_SIZE samples; the CMSIS state buffer holds the last
+// numTaps - 1 samples, so history carries across blocks (and across files unless the
+// caller resets the engine).
+//
+// Four arithmetic paths, chosen with fir_engine_init():
+//   FIR_PATH_F32       DC-removed counts as float32 (float has 24 bits of mantissa)
+//   FIR_PATH_Q31       DC-removed counts used directly as q31 (the ADC already delivers
+//                      32-bit two's complement, i.e. value / 2^31); 64-bit accumulator
+//   FIR_PATH_Q31_FAST  The same through arm_fir_fast_q31: 32-bit accumulator, each product
+//                      truncated to 2.30, fewer cycles per tap on Cortex-M (fine for
+//                      unity-gain taps like the moving average; larger gains can overflow)
+//   FIR_PATH_Q15       DC-removed counts shifted right by FIR_Q15_SHIFT into q15
+// The q31 paths never leave integers: DC removal, filtering and the DC restore are all
+// on counts, and the caller converts to kg only at output. That is the pipeline that
+// runs unchanged on the MCU.
+//
+// The DC reference is the mean of the first block after a reset. With unity-gain
+// coefficients it only shapes the start-up transient.
+//
+// A FirBank is one engine per load cell with the same coefficients. fir_bank_process()
+// filters every channel of a stretch of samples one FIR_BLOCK_SIZE block at a time, all
+// channels per block, so the coefficients and the channels' states stay in cache rather
+// than one channel's whole file going through before the next starts; the block kernel
+// is CMSIS's as for a single engine. Each channel keeps its own history and DC reference,
+// so channel c comes out exactly as from an engine fed channel c alone.
+//
+// fir_engine_enable_check() also runs a double-precision copy of the filter on the same
+// DC-removed counts and keeps the largest and RMS difference of the path's output from it
+// (in ADC counts; it includes the rounding of the output to whole counts).
+#ifndef FIR_ENGINE_H
+#define FIR_ENGINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>       // For clock_gettime
+
+#include "arm_math.h"
+
+#ifndef FIR_NUM_TAPS
+#define FIR_NUM_TAPS 51
+#endif
+#define FIR_BLOCK_SIZE 256              // Samples per arm_fir_*() call
+#define FIR_Q15_SHIFT 8                 // q15 keeps DC-removed counts / 2^8 (range +-2^23 counts)
+#define FIR_Q15_TAPS (FIR_NUM_TAPS + (FIR_NUM_TAPS & 1)) // arm_fir_q15 needs an even tap count
+#define FIR_BANK_CHANNELS 8             // Engines in a FirBank (ADC_MAX_CHANNELS)
+
+typedef enum {
+    FIR_PATH_F32 = 0,
+    FIR_PATH_Q31,
+    FIR_PATH_Q15,
+    FIR_PATH_Q31_FAST
+} FirPath;
+
+// Double-precision copy of the filter for fir_engine_enable_check()
+typedef struct {
+    double coeffs[FIR_NUM_TAPS];
+    double history[FIR_NUM_TAPS];       // Ring of the last DC-removed inputs
+    int pos;                            // Where the next input goes
+    uint64_t samples;
+    double max_error;                   // Largest |path output - double output|, in counts
+    double sq_error_sum;
+} FirReference;
+
+typedef struct {
+    FirPath path;
+    arm_fir_instance_f32 fir_f32;
+    arm_fir_instance_q31 fir_q31;
+    arm_fir_instance_q15 fir_q15;
+    float32_t coeffs_f32[FIR_NUM_TAPS];
+    q31_t coeffs_q31[FIR_NUM_TAPS];
+    q15_t coeffs_q15[FIR_Q15_TAPS];     // Zero-padded to an even length
+    float32_t state_f32[FIR_NUM_TAPS + FIR_BLOCK_SIZE - 1];
+    q31_t state_q31[FIR_NUM_TAPS + FIR_BLOCK_SIZE - 1];
+    q15_t state_q15[FIR_Q15_TAPS + FIR_BLOCK_SIZE];
+    int dc_ready;
+    long dc_offset;                     // ADC counts removed before filtering, added back after
+    uint64_t samples;                   // Samples filtered since init (resets don't clear it)
+    double busy_s;                      // Time spent filtering (the accuracy check not included)
+    int check;                          // Compare against reference (fir_engine_enable_check())
+    FirReference reference;
+} FirEngine;
+
+typedef struct {
+    FirEngine engines[FIR_BANK_CHANNELS];
+} FirBank;
+
+static inline double monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline const char *fir_path_name(FirPath path) {
+    return (path == FIR_PATH_Q31) ? "q31" : (path == FIR_PATH_Q31_FAST) ? "q31 fast" : (path == FIR_PATH_Q15) ? "q15" : "f32";
+}
+
+static inline q31_t fir_saturate_q31(int64_t v) {
+    return (v > INT32_MAX) ? INT32_MAX : (v < INT32_MIN) ? INT32_MIN : (q31_t)v;
+}
+
+static inline q15_t fir_saturate_q15(int64_t v) {
+    return (v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : (q15_t)v;
+}
+
+// Clears the filter history and the DC reference; coefficients are kept
+static inline void fir_engine_reset(FirEngine *engine) {
+    arm_fir_init_f32(&engine->fir_f32, FIR_NUM_TAPS, engine->coeffs_f32, engine->state_f32, FIR_BLOCK_SIZE);
+    arm_fir_init_q31(&engine->fir_q31, FIR_NUM_TAPS, engine->coeffs_q31, engine->state_q31, FIR_BLOCK_SIZE);
+    arm_fir_init_q15(&engine->fir_q15, FIR_Q15_TAPS, engine->coeffs_q15, engine->state_q15, FIR_BLOCK_SIZE);
+    engine->dc_ready = 0;
+    engine->dc_offset = 0;
+    memset(engine->reference.history, 0, sizeof(engine->reference.history)); // Same start as the CMSIS state
+    engine->reference.pos = 0;
+}
+
+// coeffs: FIR_NUM_TAPS floating-point taps, each in [-1, 1)
+static inline void fir_engine_init(FirEngine *engine, FirPath path, const float32_t *coeffs) {
+    memset(engine, 0, sizeof(*engine));
+    engine->path = path;
+    for (int i = 0; i < FIR_NUM_TAPS; i++) {
+        engine->coeffs_f32[i] = coeffs[i];
+        engine->coeffs_q31[i] = fir_saturate_q31((int64_t)(coeffs[i] * 2147483648.0));
+        engine->coeffs_q15[i] = fir_saturate_q15((int64_t)(coeffs[i] * 32768.0));
+        engine->reference.coeffs[i] = coeffs[i];
+    }
+    fir_engine_reset(engine);
+}
+
+// Starts comparing every output against the double-precision filter (and clears the error
+// figures); costs about as much again as the filter itself
+static inline void fir_engine_enable_check(FirEngine *engine) {
+    FirReference *ref = &engine->reference;
+    engine->check = 1;
+    ref->samples = 0;
+    ref->max_error = 0.0;
+    ref->sq_error_sum = 0.0;
+}
+
+static inline void fir_reference_block(FirEngine *engine, const long *adc, const long *out, int count) {
+    FirReference *ref = &engine->reference;
+    for (int i = 0; i < count; i++) {
+        ref->history[ref->pos] = (double)adc[i] - (double)engine->dc_offset;
+        double acc = 0.0;
+        int h = ref->pos;
+        for (int k = 0; k < FIR_NUM_TAPS; k++) {
+            acc += ref->coeffs[k] * ref->history[h];
+            h = (h == 0) ? FIR_NUM_TAPS - 1 : h - 1;
+        }
+        ref->pos = (ref->pos + 1 == FIR_NUM_TAPS) ? 0 : ref->pos + 1;
+        double error = fabs((double)out[i] - (acc + (double)engine->dc_offset));
+        if (error > ref->max_error) ref->max_error = error;
+        ref->sq_error_sum += error * error;
+    }
+    ref->samples += (uint64_t)count;
+}
+
+// RMS difference from the double filter so far, in counts (0 if the check is off)
+static inline double fir_engine_rms_error(const FirEngine *engine) {
+    const FirReference *ref = &engine->reference;
+    return ref->samples ? sqrt(ref->sq_error_sum / (double)ref->samples) : 0.0;
+}
+
+static inline void fir_engine_block(FirEngine *engine, const long *adc, long *out, int count) {
+    if (engine->path == FIR_PATH_Q31 || engine->path == FIR_PATH_Q31_FAST) {
+        q31_t in[FIR_BLOCK_SIZE], filtered[FIR_BLOCK_SIZE];
+        for (int i = 0; i < count; i++) in[i] = fir_saturate_q31((int64_t)adc[i] - engine->dc_offset);
+        if (engine->path == FIR_PATH_Q31_FAST) {
+            arm_fir_fast_q31(&engine->fir_q31, in, filtered, (uint32_t)count);
+        } else {
+            arm_fir_q31(&engine->fir_q31, in, filtered, (uint32_t)count);
+        }
+        for (int i = 0; i < count; i++) out[i] = (long)filtered[i] + engine->dc_offset;
+    } else if (engine->path == FIR_PATH_Q15) {
+        q15_t in[FIR_BLOCK_SIZE], filtered[FIR_BLOCK_SIZE];
+        for (int i = 0; i < count; i++) in[i] = fir_saturate_q15(((int64_t)adc[i] - engine->dc_offset) >> FIR_Q15_SHIFT);
+        arm_fir_q15(&engine->fir_q15, in, filtered, (uint32_t)count);
+        for (int i = 0; i < count; i++) out[i] = ((long)filtered[i] << FIR_Q15_SHIFT) + engine->dc_offset;
+    } else {
+        float32_t in[FIR_BLOCK_SIZE], filtered[FIR_BLOCK_SIZE];
+        for (int i = 0; i < count; i++) in[i] = (float32_t)(adc[i] - engine->dc_offset);
+        arm_fir_f32(&engine->fir_f32, in, filtered, (uint32_t)count);
+        for (int i = 0; i < count; i++) out[i] = (long)lrintf(filtered[i]) + engine->dc_offset;
+    }
+}
+
+// Filters count samples (any count; split into FIR_BLOCK_SIZE blocks). out may equal adc.
+static inline void fir_engine_process(FirEngine *engine, const long *adc, long *out, int count) {
+    double start = monotonic_seconds();
+    if (!engine->dc_ready && count > 0) {
+        int n = (count < FIR_BLOCK_SIZE) ? count : FIR_BLOCK_SIZE;
+        int64_t sum = 0;
+        for (int i = 0; i < n; i++) sum += adc[i];
+        engine->dc_offset = (long)(sum / n);
+        engine->dc_ready = 1;
+    }
+    for (int done = 0; done < count; done += FIR_BLOCK_SIZE) {
+        int n = count - done;
+        if (n > FIR_BLOCK_SIZE) n = FIR_BLOCK_SIZE;
+        if (!engine->check) {
+            fir_engine_block(engine, adc + done, out + done, n);
+            continue;
+        }
+        long input[FIR_BLOCK_SIZE];
+        memcpy(input, adc + done, n * sizeof(long)); // out may overwrite adc
+        fir_engine_block(engine, input, out + done, n);
+        double check_start = monotonic_seconds();
+        fir_reference_block(engine, input, out + done, n);
+        start += monotonic_seconds() - check_start; // Keep the check out of busy_s
+    }
+    engine->samples += (uint64_t)count;
+    engine->busy_s += monotonic_seconds() - start;
+}
+
+// Every channel's engine gets the coefficients, and the accuracy check if check is set
+static inline void fir_bank_init(FirBank *bank, FirPath path, const float32_t *coeffs, int check) {
+    for (int c = 0; c < FIR_BANK_CHANNELS; c++) {
+        fir_engine_init(&bank->engines[c], path, coeffs);
+        if (check) fir_engine_enable_check(&bank->engines[c]);
+    }
+}
+
+static inline void fir_bank_reset(FirBank *bank) {
+    for (int c = 0; c < FIR_BANK_CHANNELS; c++) fir_engine_reset(&bank->engines[c]);
+}
+
+// Filters count samples of each of the first channels channels (adc[c] into out[c]; out[c]
+// may equal adc[c]), block by block across all of them
+static inline void fir_bank_process(FirBank *bank, int channels, const long *const *adc, long *const *out, int count) {
+    for (int done = 0; done < count; done += FIR_BLOCK_SIZE) {
+        int n = count - done;
+        if (n > FIR_BLOCK_SIZE) n = FIR_BLOCK_SIZE;
+        for (int c = 0; c < channels; c++) {
+            fir_engine_process(&bank->engines[c], adc[c] + done, out[c] + done, n);
+        }
+    }
+}
+
+static inline void fir_engine_report(const FirEngine *engine) {
+    printf("FIR %s, %d taps, block %d: %llu samples in %.2f ms (%.2f Msamples/s)\n",
+           fir_path_name(engine->path), FIR_NUM_TAPS, FIR_BLOCK_SIZE, (unsigned long long)engine->samples,
+           engine->busy_s * 1000.0, (engine->busy_s > 0.0) ? engine->samples / engine->busy_s / 1e6 : 0.0);
+    if (engine->check) {
+        printf("FIR %s vs double: max error %.2f counts, rms %.3f counts over %llu samples\n", fir_path_name(engine->path),
+               engine->reference.max_error, fir_engine_rms_error(engine), (unsigned long long)engine->reference.samples);
+    }
+}
+
+#endif // FIR_ENGINE_H
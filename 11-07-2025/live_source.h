@@ -0,0 +1,234 @@
+// Live acquisition for the server: the load cell's serial output instead of adc_data files.
+//
+// A reader thread takes whatever serial_read() returns (serial_port.h), parses it on the
+// spot with the streaming parser (adc_stream.h, flushed after every read so no sample waits
+// for a block to fill) and publishes the samples to a broadcast hub (broadcast.h), which
+// fans them out to every client. The samples go out as segments of LIVE_SEGMENT_SAMPLES
+// named live_<port>_<n>.txt, encoded once for both wire encodings as they arrive: text as
+// fixed-width "ADC:%011d" lines (so the length is known before the samples are), adc32 as
+// the usual frames. The hub's clients read them like files of a paced replay.
+//
+// If the port fails (an unplugged USB adapter), the thread closes it and keeps trying to
+// reopen it, at growing intervals up to LIVE_REOPEN_MAX_MS; clients just see a pause.
+#ifndef LIVE_SOURCE_H
+#define LIVE_SOURCE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>    // For CreateThread
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "serial_port.h"
+#include "adc_stream.h"
+#include "broadcast.h"
+#include "metrics.h"
+
+#define LIVE_SEGMENT_SAMPLES 4096   // Samples per segment (a multiple of ADC_FRAME_SAMPLES)
+#define LIVE_TEXT_LINE_BYTES 16     // "ADC:%011d\n"
+#define LIVE_REOPEN_MS 500          // First retry after the port failed; doubles up to the next
+#define LIVE_REOPEN_MAX_MS 10000
+
+typedef struct {
+    char port_name[64];
+    char label[64];             // Port name as used in segment names ("COM3", "ttyUSB0")
+    int baud;
+    uint32_t sample_rate_mhz;   // For the adc32 frame headers
+    SerialPort port;
+    AdcStream parser;
+    Broadcast *hub;
+    BroadcastSegment *segment;  // Being filled (owned by the hub), NULL until the next sample
+    size_t filled;              // Samples in it
+    unsigned int segments;      // Segments started
+    atomic_int running;         // Cleared by live_source_stop()
+    uint64_t bytes_read;        // Acquisition thread only
+    uint64_t reopens;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+} LiveSource;
+
+static inline void live_source_sleep_ms(int ms) {
+#ifdef _WIN32
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Content of a live segment: the text lines, then the adc32 frames, after the header
+static inline uint8_t *live_segment_text(BroadcastSegment *segment) {
+    return (uint8_t *)(segment + 1);
+}
+
+static inline uint8_t *live_segment_frames(BroadcastSegment *segment) {
+    return live_segment_text(segment) + (size_t)LIVE_SEGMENT_SAMPLES * LIVE_TEXT_LINE_BYTES;
+}
+
+// Allocates the next segment and publishes it (empty) to the hub. Returns 0, or -1 if out of memory.
+static inline int live_source_next_segment(LiveSource *src) {
+    size_t text_len = (size_t)LIVE_SEGMENT_SAMPLES * LIVE_TEXT_LINE_BYTES;
+    size_t frames_len = adc_frames_size(LIVE_SEGMENT_SAMPLES);
+    BroadcastSegment *segment = (BroadcastSegment *)calloc(1, sizeof(BroadcastSegment) + text_len + frames_len);
+    if (segment == NULL) {
+        perror("malloc for live segment");
+        return -1;
+    }
+    atomic_init(&segment->refs, 1);
+    snprintf(segment->name, sizeof(segment->name), "live_%s_%06u.txt", src->label, ++src->segments);
+    segment->length[ENCODING_TEXT] = text_len;
+    segment->length[ENCODING_ADC32] = frames_len;
+    segment->content[ENCODING_TEXT] = live_segment_text(segment);
+    segment->content[ENCODING_ADC32] = live_segment_frames(segment);
+    segment->free_fn = broadcast_segment_free;
+    broadcast_publish(src->hub, segment);
+    src->segment = segment;
+    src->filled = 0;
+    return 0;
+}
+
+// Parser callback: encodes a block of samples into the current segment(s) and publishes them
+static inline void live_source_publish(const long *samples, int count, void *ctx) {
+    LiveSource *src = (LiveSource *)ctx;
+    int32_t tapped[ADC_FRAME_SAMPLES];
+    int tapped_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (src->segment == NULL && live_source_next_segment(src) != 0) {
+            return;
+        }
+        BroadcastSegment *segment = src->segment;
+        int32_t value = (int32_t)samples[i];
+        char line[LIVE_TEXT_LINE_BYTES + 1];
+        snprintf(line, sizeof(line), "ADC:%011ld\n", (long)value);
+        memcpy(live_segment_text(segment) + src->filled * LIVE_TEXT_LINE_BYTES, line, LIVE_TEXT_LINE_BYTES);
+        uint8_t *frame = live_segment_frames(segment) + (src->filled / ADC_FRAME_SAMPLES) * ADC_FRAME_BYTES;
+        size_t in_frame = src->filled % ADC_FRAME_SAMPLES;
+        if (in_frame == 0) {
+            adc_frame_put_header(frame, (uint32_t)(src->filled / ADC_FRAME_SAMPLES), src->sample_rate_mhz, ADC_FRAME_SAMPLES);
+        }
+        put_le32(frame + ADC_FRAME_HEADER_BYTES + in_frame * 4, (uint32_t)value);
+        src->filled++;
+        tapped[tapped_count++] = value;
+        if (tapped_count == ADC_FRAME_SAMPLES) {
+            broadcast_samples(src->hub, tapped, tapped_count, src->sample_rate_mhz);
+            tapped_count = 0;
+        }
+        if (src->filled == LIVE_SEGMENT_SAMPLES) {
+            broadcast_advance(src->hub, segment, segment->length[ENCODING_TEXT], segment->length[ENCODING_ADC32]);
+            src->segment = NULL; // The hub keeps it until newer segments push it out
+        }
+    }
+    broadcast_samples(src->hub, tapped, tapped_count, src->sample_rate_mhz);
+    if (src->segment != NULL) {
+        broadcast_advance(src->hub, src->segment, src->filled * LIVE_TEXT_LINE_BYTES, adc_frames_offset(src->filled));
+    }
+}
+
+static inline void live_source_main(LiveSource *src) {
+    int reopen_ms = LIVE_REOPEN_MS;
+    while (atomic_load(&src->running)) {
+        if (!src->port.is_open) {
+            if (serial_open(&src->port, src->port_name, src->baud) != 0) {
+                live_source_sleep_ms(reopen_ms);
+                if (reopen_ms < LIVE_REOPEN_MAX_MS) reopen_ms *= 2;
+                continue;
+            }
+            reopen_ms = LIVE_REOPEN_MS;
+            src->reopens++;
+            printf("Live input: %s reopened.\n", src->port_name);
+            adc_stream_init(&src->parser, ENCODING_TEXT, live_source_publish, src); // Drop the line cut off by the failure
+        }
+        const char *data;
+        long got = serial_read(&src->port, &data);
+        if (got < 0) {
+            fprintf(stderr, "Live input: reading %s failed, reopening it.\n", src->port_name);
+            serial_close(&src->port);
+            continue;
+        }
+        if (got == 0) {
+            continue;
+        }
+        src->bytes_read += (uint64_t)got;
+        uint64_t begin = metrics_begin();
+        uint64_t before = src->parser.sample_count;
+        adc_stream_feed(&src->parser, data, (size_t)got);
+        adc_stream_flush(&src->parser);
+        metrics_end(METRIC_PARSE, begin, src->parser.sample_count - before);
+    }
+    serial_close(&src->port);
+    broadcast_stop(src->hub, src->segment);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI live_source_thread(LPVOID param) {
+    live_source_main((LiveSource *)param);
+    return 0;
+}
+#else
+static void *live_source_thread(void *param) {
+    live_source_main((LiveSource *)param);
+    return NULL;
+}
+#endif
+
+// Opens the port (so a wrong name fails here, not in the background) and starts the
+// acquisition thread, publishing to hub with frame headers for a sample every interval_ms.
+// Returns 0, or -1 with the reason printed.
+static inline int live_source_start(LiveSource *src, const char *port_name, int baud, int interval_ms, Broadcast *hub) {
+    memset(src, 0, sizeof(*src));
+    snprintf(src->port_name, sizeof(src->port_name), "%s", port_name);
+    const char *base = port_name;
+    for (const char *p = port_name; *p; p++) {
+        if (*p == '/' || *p == '\\') base = p + 1;
+    }
+    size_t n = 0;
+    for (; base[n] && n < sizeof(src->label) - 1; n++) {
+        char c = base[n];
+        src->label[n] = ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) ? c : '_';
+    }
+    src->label[n] = '\0';
+    src->baud = baud;
+    src->sample_rate_mhz = sample_rate_mhz_from_interval(interval_ms);
+    src->hub = hub;
+    if (serial_open(&src->port, port_name, baud) != 0) {
+        return -1;
+    }
+    adc_stream_init(&src->parser, ENCODING_TEXT, live_source_publish, src);
+    atomic_store(&src->running, 1);
+#ifdef _WIN32
+    src->thread = CreateThread(NULL, 0, live_source_thread, src, 0, NULL);
+    int started = (src->thread != NULL);
+#else
+    int started = (pthread_create(&src->thread, NULL, live_source_thread, src) == 0);
+#endif
+    if (!started) {
+        fprintf(stderr, "Could not start the live input thread.\n");
+        atomic_store(&src->running, 0);
+        serial_close(&src->port);
+        return -1;
+    }
+    return 0;
+}
+
+// Stops the acquisition thread; the hub is stopped, cutting the segment being filled
+static inline void live_source_stop(LiveSource *src) {
+    if (!atomic_exchange(&src->running, 0)) return;
+#ifdef _WIN32
+    WaitForSingleObject(src->thread, INFINITE);
+    CloseHandle(src->thread);
+#else
+    pthread_join(src->thread, NULL);
+#endif
+}
+
+#endif // LIVE_SOURCE_H
@@ -0,0 +1,430 @@
+// In-memory catalog of the recordings in the server's data folder.
+//
+// catalog_open() maps every .txt file once and notes its name, size, the frequency and
+// sample interval in its name ("...ms<N>hz<N>.txt") and its ADC: samples. Sessions then serve from the mapped views
+// and never open, stat or parse a recording again. A watcher thread
+// (ReadDirectoryChangesW) rescans the folder's metadata when it changes; files whose size
+// and write time are unchanged keep their entry, so only new or modified files are read.
+//
+// The catalog is published as an immutable, reference-counted snapshot. A session takes
+// one with catalog_acquire() and keeps serving from it while the watcher swaps in a newer
+// one; the old snapshot and any entries only it used are freed when the last session
+// releases it.
+//
+// Views are mapped with full sharing, so other programs can still write new recordings
+// or delete old ones. Windows refuses to truncate a file while it is mapped, though:
+// replace a recording by writing a new file rather than rewriting it in place.
+#ifndef RECORDING_CATALOG_H
+#define RECORDING_CATALOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>      // For tolower, isdigit
+#include <windows.h>    // For file mapping, FindFirstFile, ReadDirectoryChangesW, SRWLOCK
+
+#define CATALOG_MAX_FREQ_HZ 1000    // Frequencies up to this have an O(1) lookup slot
+#define CATALOG_SETTLE_MS 250       // Quiet time after a change notification before rescanning
+#define CATALOG_NOTIFY_BYTES 4096   // ReadDirectoryChangesW buffer
+
+typedef struct {
+    volatile LONG refs;         // Snapshots holding the entry
+    char name[MAX_PATH];        // File name within the folder
+    char path[MAX_PATH];        // Folder + name, for path-based fallbacks
+    uint64_t size;
+    uint64_t write_time;        // FILETIME of the last write, to spot modified files
+    int freq_hz;                // From the "hz<N>.txt" name suffix, -1 if there is none
+    int interval_ms;            // Sample interval from "ms<N>" in the name, -1 if there is none
+    HANDLE mapping;
+    const char *data;           // The whole file, mapped read-only (NULL when size is 0)
+    int32_t *samples;           // ADC: values, parsed once when the entry is built
+    size_t sample_count;
+} CatalogEntry;
+
+typedef struct {
+    volatile LONG refs;         // The catalog's own reference plus one per session
+    CatalogEntry **entries;     // Sorted by name
+    int count;
+    int by_freq[CATALOG_MAX_FREQ_HZ + 1]; // Index of the first entry with that frequency, -1 = none
+    uint64_t total_bytes;
+    uint64_t total_samples;
+    unsigned long generation;   // Increases with every rescan that changed something
+} CatalogSnapshot;
+
+typedef struct {
+    char folder[MAX_PATH];
+    SRWLOCK lock;               // Guards the current pointer (not the snapshot contents)
+    CatalogSnapshot *current;
+    HANDLE watch_thread;
+    HANDLE stop_event;
+} RecordingCatalog;
+
+// 1 if the line [p, line_end) is an "ADC:<int>" sample (stored in *value), 0 otherwise.
+// The digits are parsed by hand and never past line_end (the mapped view has no terminator):
+// an optional sign, then digits right after "ADC:", as adc_parse_long() takes them. Values
+// beyond the int32 range saturate.
+static inline int catalog_adc_line(const char *p, const char *line_end, int32_t *value) {
+    if (line_end - p <= 4 || memcmp(p, "ADC:", 4) != 0) return 0;
+    const char *q = p + 4;
+    int negative = 0;
+    if (*q == '-' || *q == '+') {
+        negative = (*q == '-');
+        q++;
+    }
+    const char *digits = q;
+    uint64_t magnitude = 0;
+    while (q < line_end && (unsigned)(*q - '0') < 10) {
+        if (magnitude <= (uint64_t)INT32_MAX + 1) magnitude = magnitude * 10 + (uint64_t)(*q - '0'); // Past the range it only saturates
+        q++;
+    }
+    if (q == digits) return 0;
+    uint64_t limit = negative ? (uint64_t)INT32_MAX + 1 : (uint64_t)INT32_MAX;
+    if (magnitude > limit) magnitude = limit;
+    *value = (int32_t)(negative ? -(int64_t)magnitude : (int64_t)magnitude);
+    return 1;
+}
+
+// Pulls the ADC values out of teraterm text ("ADC:<int>" lines, MOV:/FIR:/kg lines ignored).
+// Returns the number of samples stored.
+static inline size_t catalog_parse_adc(const char *text, size_t len, int32_t *samples, size_t max_samples) {
+    size_t count = 0;
+    const char *p = text;
+    const char *end = text + len;
+    while (p < end && count < max_samples) {
+        const char *line_end = memchr(p, '\n', (size_t)(end - p));
+        if (line_end == NULL) {
+            line_end = end;
+        }
+        if (catalog_adc_line(p, line_end, &samples[count])) {
+            count++;
+        }
+        p = line_end + 1;
+    }
+    return count;
+}
+
+// Offset just past the next `samples` sample lines of text from offset on (the lines
+// catalog_parse_adc() counts, plus anything in between), or len if the text ends first.
+// Lets a paced sender cut the raw text at sample boundaries.
+static inline size_t catalog_text_offset(const char *text, size_t len, size_t offset, size_t samples) {
+    const char *p = text + offset;
+    const char *end = text + len;
+    int32_t value;
+    while (p < end && samples > 0) {
+        const char *line_end = memchr(p, '\n', (size_t)(end - p));
+        if (line_end == NULL) {
+            return len;
+        }
+        if (catalog_adc_line(p, line_end, &value)) {
+            samples--;
+        }
+        p = line_end + 1;
+    }
+    return (size_t)(p - text);
+}
+
+// "535g20250502pm427ms20hz50.txt" -> 50. Looks at the last "hz" (any case) directly
+// followed by digits and ".txt"; returns -1 if there is none.
+static inline int catalog_parse_freq(const char *name) {
+    int freq = -1;
+    for (const char *p = name; p[0] && p[1]; p++) {
+        if (tolower((unsigned char)p[0]) != 'h' || tolower((unsigned char)p[1]) != 'z' ||
+            !isdigit((unsigned char)p[2])) {
+            continue;
+        }
+        const char *q = p + 2;
+        long value = 0;
+        while (isdigit((unsigned char)*q) && value <= 1000000) value = value * 10 + (*q++ - '0');
+        if (_stricmp(q, ".txt") == 0) freq = (int)value;
+    }
+    return freq;
+}
+
+// "535g20250502pm427ms20hz50.txt" -> 20, the teraterm sample interval. Looks at the last
+// "ms" (any case) directly followed by digits; returns -1 if there is none.
+static inline int catalog_parse_interval_ms(const char *name) {
+    int interval = -1;
+    for (const char *p = name; p[0] && p[1]; p++) {
+        if (tolower((unsigned char)p[0]) != 'm' || tolower((unsigned char)p[1]) != 's' ||
+            !isdigit((unsigned char)p[2])) {
+            continue;
+        }
+        long value = 0;
+        for (const char *q = p + 2; isdigit((unsigned char)*q) && value <= 1000000; q++) value = value * 10 + (*q - '0');
+        if (value > 0) interval = (int)value;
+    }
+    return interval;
+}
+
+static inline void catalog_entry_release(CatalogEntry *entry) {
+    if (entry == NULL || InterlockedDecrement(&entry->refs) > 0) return;
+    if (entry->data) UnmapViewOfFile(entry->data);
+    if (entry->mapping) CloseHandle(entry->mapping);
+    free(entry->samples);
+    free(entry);
+}
+
+// Maps and parses one recording. Returns NULL (after a message) if it can't be read yet.
+static inline CatalogEntry *catalog_entry_build(const char *folder, const WIN32_FIND_DATAA *found) {
+    CatalogEntry *entry = (CatalogEntry *)calloc(1, sizeof(CatalogEntry));
+    if (entry == NULL) return NULL;
+    entry->refs = 1;
+    snprintf(entry->name, sizeof(entry->name), "%s", found->cFileName);
+    snprintf(entry->path, sizeof(entry->path), "%s/%s", folder, found->cFileName);
+    entry->size = ((uint64_t)found->nFileSizeHigh << 32) | found->nFileSizeLow;
+    entry->write_time = ((uint64_t)found->ftLastWriteTime.dwHighDateTime << 32) | found->ftLastWriteTime.dwLowDateTime;
+    entry->freq_hz = catalog_parse_freq(entry->name);
+    entry->interval_ms = catalog_parse_interval_ms(entry->name);
+
+    if (entry->size > 0) {
+        if (entry->size > (uint64_t)SIZE_MAX / 2) {
+            fprintf(stderr, "Catalog: %s is too large to map, skipping.\n", entry->path);
+            free(entry);
+            return NULL;
+        }
+        HANDLE file = CreateFileA(entry->path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            fprintf(stderr, "Catalog: cannot open %s (error %lu), will retry on the next change.\n", entry->path, GetLastError());
+            free(entry);
+            return NULL;
+        }
+        entry->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(file); // The mapping keeps the file open
+        entry->data = entry->mapping ? (const char *)MapViewOfFile(entry->mapping, FILE_MAP_READ, 0, 0, (SIZE_T)entry->size) : NULL;
+        if (entry->data == NULL) {
+            fprintf(stderr, "Catalog: cannot map %s (error %lu), will retry on the next change.\n", entry->path, GetLastError());
+            if (entry->mapping) CloseHandle(entry->mapping);
+            free(entry);
+            return NULL;
+        }
+    }
+
+    // Every sample needs at least "ADC:0\n", so this bound is never exceeded
+    size_t max_samples = (size_t)(entry->size / 6) + 1;
+    entry->samples = (int32_t *)malloc(max_samples * sizeof(int32_t));
+    if (entry->samples == NULL) {
+        fprintf(stderr, "Catalog: out of memory parsing %s.\n", entry->path);
+        entry->refs = 1;
+        catalog_entry_release(entry);
+        return NULL;
+    }
+    entry->sample_count = entry->data ? catalog_parse_adc(entry->data, (size_t)entry->size, entry->samples, max_samples) : 0;
+    return entry;
+}
+
+static inline void catalog_snapshot_release(CatalogSnapshot *snapshot) {
+    if (snapshot == NULL || InterlockedDecrement(&snapshot->refs) > 0) return;
+    for (int i = 0; i < snapshot->count; i++) catalog_entry_release(snapshot->entries[i]);
+    free(snapshot->entries);
+    free(snapshot);
+}
+
+static inline int catalog_entry_compare(const void *a, const void *b) {
+    return strcmp((*(CatalogEntry *const *)a)->name, (*(CatalogEntry *const *)b)->name);
+}
+
+// Entry in a sorted snapshot by name, or NULL
+static inline CatalogEntry *catalog_find_by_name(const CatalogSnapshot *snapshot, const char *name) {
+    int lo = 0, hi = snapshot ? snapshot->count - 1 : -1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(snapshot->entries[mid]->name, name);
+        if (cmp == 0) return snapshot->entries[mid];
+        if (cmp < 0) lo = mid + 1; else hi = mid - 1;
+    }
+    return NULL;
+}
+
+// First recording (by name) whose name carries freq_hz, or NULL
+static inline CatalogEntry *catalog_find_by_freq(const CatalogSnapshot *snapshot, int freq_hz) {
+    if (snapshot == NULL || freq_hz < 0) return NULL;
+    if (freq_hz <= CATALOG_MAX_FREQ_HZ) {
+        int index = snapshot->by_freq[freq_hz];
+        return (index >= 0) ? snapshot->entries[index] : NULL;
+    }
+    for (int i = 0; i < snapshot->count; i++) {
+        if (snapshot->entries[i]->freq_hz == freq_hz) return snapshot->entries[i];
+    }
+    return NULL;
+}
+
+// Builds a snapshot of the folder, reusing the entries of previous (may be NULL) for files
+// that haven't changed. Returns NULL if the folder can't be listed; *changed says whether
+// the result differs from previous.
+static inline CatalogSnapshot *catalog_scan(const char *folder, const CatalogSnapshot *previous, int *changed) {
+    char pattern[MAX_PATH];
+    snprintf(pattern, sizeof(pattern), "%s/*.txt", folder);
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA(pattern, &found);
+    if (find == INVALID_HANDLE_VALUE && GetLastError() != ERROR_FILE_NOT_FOUND) {
+        return NULL;
+    }
+
+    CatalogSnapshot *snapshot = (CatalogSnapshot *)calloc(1, sizeof(CatalogSnapshot));
+    if (snapshot == NULL) {
+        if (find != INVALID_HANDLE_VALUE) FindClose(find);
+        return NULL;
+    }
+    snapshot->refs = 1;
+    int capacity = 0;
+    int reused = 0;
+    *changed = 0;
+    while (find != INVALID_HANDLE_VALUE) {
+        if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            uint64_t size = ((uint64_t)found.nFileSizeHigh << 32) | found.nFileSizeLow;
+            uint64_t write_time = ((uint64_t)found.ftLastWriteTime.dwHighDateTime << 32) | found.ftLastWriteTime.dwLowDateTime;
+            CatalogEntry *entry = catalog_find_by_name(previous, found.cFileName);
+            if (entry && entry->size == size && entry->write_time == write_time) {
+                InterlockedIncrement(&entry->refs);
+                reused++;
+            } else {
+                entry = catalog_entry_build(folder, &found);
+                *changed = 1;
+            }
+            if (entry && snapshot->count == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                CatalogEntry **grown = (CatalogEntry **)realloc(snapshot->entries, capacity * sizeof(CatalogEntry *));
+                if (grown == NULL) {
+                    catalog_entry_release(entry);
+                    entry = NULL;
+                } else {
+                    snapshot->entries = grown;
+                }
+            }
+            if (entry) {
+                snapshot->entries[snapshot->count++] = entry;
+                snapshot->total_bytes += entry->size;
+                snapshot->total_samples += entry->sample_count;
+            }
+        }
+        if (!FindNextFileA(find, &found)) {
+            FindClose(find);
+            find = INVALID_HANDLE_VALUE;
+        }
+    }
+    if (previous == NULL || reused != previous->count) *changed = 1; // Something was added or removed
+
+    qsort(snapshot->entries, snapshot->count, sizeof(CatalogEntry *), catalog_entry_compare);
+    for (int f = 0; f <= CATALOG_MAX_FREQ_HZ; f++) snapshot->by_freq[f] = -1;
+    for (int i = snapshot->count - 1; i >= 0; i--) { // Backwards, so the first name wins
+        int freq = snapshot->entries[i]->freq_hz;
+        if (freq >= 0 && freq <= CATALOG_MAX_FREQ_HZ) snapshot->by_freq[freq] = i;
+    }
+    snapshot->generation = previous ? previous->generation + (*changed ? 1 : 0) : 1;
+    return snapshot;
+}
+
+// The current snapshot; pass it to catalog_snapshot_release() when done. Never NULL after
+// a successful catalog_open().
+static inline CatalogSnapshot *catalog_acquire(RecordingCatalog *catalog) {
+    AcquireSRWLockShared(&catalog->lock);
+    CatalogSnapshot *snapshot = catalog->current;
+    if (snapshot) InterlockedIncrement(&snapshot->refs);
+    ReleaseSRWLockShared(&catalog->lock);
+    return snapshot;
+}
+
+// Rescans the folder and publishes the result if anything changed. Returns 0, or -1 if the
+// folder couldn't be listed (the current snapshot stays).
+static inline int catalog_refresh(RecordingCatalog *catalog) {
+    ULONGLONG start_ms = GetTickCount64();
+    CatalogSnapshot *previous = catalog_acquire(catalog);
+    int changed = 0;
+    CatalogSnapshot *snapshot = catalog_scan(catalog->folder, previous, &changed);
+    catalog_snapshot_release(previous);
+    if (snapshot == NULL) {
+        fprintf(stderr, "Catalog: cannot list %s (error %lu).\n", catalog->folder, GetLastError());
+        return -1;
+    }
+    if (!changed) {
+        catalog_snapshot_release(snapshot);
+        return 0;
+    }
+
+    AcquireSRWLockExclusive(&catalog->lock);
+    CatalogSnapshot *old = catalog->current;
+    catalog->current = snapshot;
+    ReleaseSRWLockExclusive(&catalog->lock);
+    catalog_snapshot_release(old);
+
+    printf("Catalog %s: %d recordings, %.1f MiB mapped, %llu samples (generation %lu, %llu ms)\n",
+           catalog->folder, snapshot->count, snapshot->total_bytes / (1024.0 * 1024.0),
+           (unsigned long long)snapshot->total_samples, snapshot->generation,
+           (unsigned long long)(GetTickCount64() - start_ms));
+    return 0;
+}
+
+static DWORD WINAPI catalog_watch_thread(LPVOID param) {
+    RecordingCatalog *catalog = (RecordingCatalog *)param;
+    HANDLE dir = CreateFileA(catalog->folder, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (dir == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Catalog: cannot watch %s (error %lu), changes need a restart.\n", catalog->folder, GetLastError());
+        return 1;
+    }
+    OVERLAPPED overlapped = {0};
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    DWORD notify[CATALOG_NOTIFY_BYTES / sizeof(DWORD)]; // DWORD-aligned, as the API requires
+    HANDLE waits[2] = { overlapped.hEvent, catalog->stop_event };
+    const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+    while (overlapped.hEvent) {
+        ResetEvent(overlapped.hEvent);
+        if (!ReadDirectoryChangesW(dir, notify, sizeof(notify), FALSE, filter, NULL, &overlapped, NULL)) {
+            fprintf(stderr, "Catalog: ReadDirectoryChangesW failed (error %lu), changes need a restart.\n", GetLastError());
+            break;
+        }
+        if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+            CancelIo(dir);
+            DWORD ignored;
+            GetOverlappedResult(dir, &overlapped, &ignored, TRUE);
+            break;
+        }
+        // The buffer's contents (or its overflow) only tell us to look again: copies and
+        // editors produce bursts of events, so wait for the folder to settle and rescan once.
+        if (WaitForSingleObject(catalog->stop_event, CATALOG_SETTLE_MS) == WAIT_OBJECT_0) break;
+        catalog_refresh(catalog);
+    }
+    if (overlapped.hEvent) CloseHandle(overlapped.hEvent);
+    CloseHandle(dir);
+    return 0;
+}
+
+// Indexes folder and starts watching it. Returns 0, or -1 if the folder can't be listed.
+static inline int catalog_open(RecordingCatalog *catalog, const char *folder) {
+    memset(catalog, 0, sizeof(*catalog));
+    snprintf(catalog->folder, sizeof(catalog->folder), "%s", folder);
+    InitializeSRWLock(&catalog->lock);
+    if (catalog_refresh(catalog) != 0) return -1;
+    catalog->stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (catalog->stop_event) {
+        catalog->watch_thread = CreateThread(NULL, 0, catalog_watch_thread, catalog, 0, NULL);
+    }
+    if (catalog->watch_thread == NULL) {
+        fprintf(stderr, "Catalog: no watcher thread (error %lu), changes need a restart.\n", GetLastError());
+    }
+    return 0;
+}
+
+// Stops the watcher and drops the catalog's snapshot (sessions still holding one keep it)
+static inline void catalog_close(RecordingCatalog *catalog) {
+    if (catalog->watch_thread) {
+        SetEvent(catalog->stop_event);
+        WaitForSingleObject(catalog->watch_thread, INFINITE);
+        CloseHandle(catalog->watch_thread);
+        catalog->watch_thread = NULL;
+    }
+    if (catalog->stop_event) {
+        CloseHandle(catalog->stop_event);
+        catalog->stop_event = NULL;
+    }
+    AcquireSRWLockExclusive(&catalog->lock);
+    CatalogSnapshot *snapshot = catalog->current;
+    catalog->current = NULL;
+    ReleaseSRWLockExclusive(&catalog->lock);
+    catalog_snapshot_release(snapshot);
+}
+
+#endif // RECORDING_CATALOG_H
@@ -0,0 +1,159 @@
+// Sample-accurate replay pacing for the servers.
+//
+// A recording is streamed at its sample rate (times a speed-up factor) instead of being
+// sent whole with a fixed gap between files. Deadlines are absolute: sample i is due at
+// start + i / rate on the QueryPerformanceCounter clock, so rounding and late wake-ups
+// never add up to drift. Each wait sleeps on a high-resolution waitable timer (Windows 10
+// 1803 and later; plain Sleep before that) until REPLAY_SPIN_US before the deadline and
+// spins the rest, which puts wake-ups within microseconds of the deadline instead of the
+// 1-16 ms that Sleep(interval_ms) gives.
+//
+// Rates faster than one sample per REPLAY_MIN_TICK_US are sent in batches (every tick sends
+// the samples due by then), so a x100 replay doesn't cost one send() per sample. If the
+// sender falls more than REPLAY_RESYNC_MS behind (the client stopped reading and TCP
+// pushed back), the schedule moves forward instead of bursting the backlog out; such
+// resyncs are counted in the stats along with how late every tick was.
+#ifndef REPLAY_PACER_H
+#define REPLAY_PACER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <windows.h>    // For QueryPerformanceCounter, waitable timers
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002 // Missing from older MinGW headers
+#endif
+
+#define REPLAY_SPIN_US 1000         // Spin (rather than sleep) this close to a deadline
+#define REPLAY_MIN_TICK_US 1000     // Shortest time between two sends
+#define REPLAY_RESYNC_MS 250        // Further behind than this, the schedule is moved forward
+#define REPLAY_LATE_US 1000         // A tick this late counts as late in the stats
+
+typedef struct {
+    uint64_t samples;           // Samples paced
+    uint64_t ticks;             // Sends (one per batch)
+    uint64_t late_ticks;        // Ticks more than REPLAY_LATE_US past their deadline
+    uint64_t resyncs;           // Times the schedule was moved forward
+    double lateness_sum_us;     // Over all ticks, for the mean and standard deviation
+    double lateness_sq_sum_us;
+    double lateness_max_us;
+    double elapsed_s;           // From the first sample's deadline to the last tick
+} ReplayStats;
+
+typedef struct {
+    double rate_hz;             // Samples per second, speed-up included
+    LONGLONG qpc_freq;
+    LONGLONG start;             // QPC time sample 0 is (or was moved to be) due
+    double ticks_per_sample;    // QPC ticks between samples
+    size_t batch;               // Samples per tick at this rate
+    HANDLE timer;               // High-resolution waitable timer, NULL to use Sleep
+    ReplayStats stats;
+} ReplayPacer;
+
+static inline LONGLONG replay_now(void) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+// rate_hz is the rate to send at (the recording's rate times the speed-up).
+// Returns 0, or -1 if the rate isn't positive.
+static inline int replay_pacer_init(ReplayPacer *pacer, double rate_hz) {
+    memset(pacer, 0, sizeof(*pacer));
+    if (!(rate_hz > 0.0)) return -1;
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    pacer->rate_hz = rate_hz;
+    pacer->qpc_freq = freq.QuadPart;
+    pacer->ticks_per_sample = (double)freq.QuadPart / rate_hz;
+    pacer->batch = (size_t)ceil(rate_hz * REPLAY_MIN_TICK_US / 1e6);
+    if (pacer->batch < 1) pacer->batch = 1;
+    pacer->timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    return 0;
+}
+
+static inline void replay_pacer_free(ReplayPacer *pacer) {
+    if (pacer->timer) CloseHandle(pacer->timer);
+    pacer->timer = NULL;
+}
+
+// Makes sample 0 due now and clears the stats
+static inline void replay_pacer_start(ReplayPacer *pacer) {
+    memset(&pacer->stats, 0, sizeof(pacer->stats));
+    pacer->start = replay_now();
+}
+
+// Makes sample `first` due now, for a replay resumed part way through a recording. The
+// samples before it count as sent, so the stats still show the recording's rate.
+static inline void replay_pacer_start_at(ReplayPacer *pacer, size_t first) {
+    replay_pacer_start(pacer);
+    pacer->start -= (LONGLONG)((double)first * pacer->ticks_per_sample);
+    pacer->stats.samples = first;
+}
+
+static inline LONGLONG replay_deadline(const ReplayPacer *pacer, size_t sample) {
+    return pacer->start + (LONGLONG)((double)sample * pacer->ticks_per_sample);
+}
+
+// Sleeps until REPLAY_SPIN_US before the deadline, then spins up to it
+static inline void replay_sleep_until(ReplayPacer *pacer, LONGLONG deadline) {
+    LONGLONG sleep_ticks = deadline - replay_now() - pacer->qpc_freq * REPLAY_SPIN_US / 1000000;
+    if (sleep_ticks > 0) {
+        LARGE_INTEGER due;
+        due.QuadPart = -(sleep_ticks * 10000000 / pacer->qpc_freq); // Relative, in 100 ns units
+        if (pacer->timer == NULL || !SetWaitableTimer(pacer->timer, &due, 0, NULL, NULL, FALSE) ||
+            WaitForSingleObject(pacer->timer, INFINITE) != WAIT_OBJECT_0) {
+            Sleep((DWORD)(sleep_ticks * 1000 / pacer->qpc_freq));
+        }
+    }
+    while (replay_now() < deadline) YieldProcessor();
+}
+
+// Waits until sample `next` of `count` is due and returns how many samples to send now:
+// a batch, or everything that is due when the sender is running behind (never 0 while
+// next < count).
+static inline size_t replay_pacer_wait(ReplayPacer *pacer, size_t next, size_t count) {
+    LONGLONG deadline = replay_deadline(pacer, next);
+    replay_sleep_until(pacer, deadline);
+    LONGLONG now = replay_now();
+
+    double late_us = (double)(now - deadline) * 1e6 / (double)pacer->qpc_freq;
+    ReplayStats *stats = &pacer->stats;
+    stats->ticks++;
+    stats->lateness_sum_us += late_us;
+    stats->lateness_sq_sum_us += late_us * late_us;
+    if (late_us > stats->lateness_max_us) stats->lateness_max_us = late_us;
+    if (late_us > REPLAY_LATE_US) stats->late_ticks++;
+    if (late_us > REPLAY_RESYNC_MS * 1000.0) {
+        pacer->start += now - deadline; // Sample `next` is due now; the rest follow at the rate
+        stats->resyncs++;
+    }
+
+    size_t due = (size_t)((double)(now - pacer->start) / pacer->ticks_per_sample) + 1;
+    size_t n = (due > next + pacer->batch) ? due - next : pacer->batch;
+    if (n > count - next) n = count - next;
+    stats->samples += n;
+    stats->elapsed_s = (double)(now - pacer->start) / (double)pacer->qpc_freq;
+    return n;
+}
+
+// One line of stats, e.g. "10036 samples in 200.7 s (50.00 Hz of 50.00), late mean 4.1 us ..."
+static inline void replay_stats_format(const ReplayPacer *pacer, char *out, size_t out_size) {
+    const ReplayStats *stats = &pacer->stats;
+    double ticks = stats->ticks ? (double)stats->ticks : 1.0;
+    double mean = stats->lateness_sum_us / ticks;
+    double variance = stats->lateness_sq_sum_us / ticks - mean * mean;
+    // The last tick's samples are only due at the end of their interval
+    double span_s = stats->elapsed_s + (double)pacer->batch / pacer->rate_hz;
+    snprintf(out, out_size,
+             "%llu samples in %.1f s (%.2f Hz of %.2f), late mean %.1f us, sd %.1f us, max %.1f us, "
+             "%llu of %llu ticks > %d us, %llu resyncs",
+             (unsigned long long)stats->samples, stats->elapsed_s, stats->samples / span_s, pacer->rate_hz,
+             mean, sqrt(variance > 0.0 ? variance : 0.0), stats->lateness_max_us,
+             (unsigned long long)stats->late_ticks, (unsigned long long)stats->ticks, REPLAY_LATE_US,
+             (unsigned long long)stats->resyncs);
+}
+
+#endif // REPLAY_PACER_H
@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>     // For close()
+#include <fcntl.h>      // For open()
+#include <dirent.h>     // For opendir, readdir
+#include <glob.h>       // For glob()
+#include <ctype.h>      // For tolower, isdigit
+#include <sys/mman.h>   // For mmap, madvise
+#include <sys/stat.h>   // For stat, fstat
+
+// Offline reprocessor: the same DSP chain c2 runs on received files (file_pipeline.h),
+// run directly on recordings on disk. No server, no socket, no pacing: every file is
+// mapped read-only, parsed in place and written as output_folder/all_data_<file>.bin,
+// byte for byte what "c2 bulk" writes for it with a worker pool (each file starts from a
+// clean filter, so the output doesn't depend on the order or the thread).
+//
+// Files are processed in parallel on a worker pool, largest first, so a long recording
+// doesn't end up last on one thread. Mapped views count against MAX_MAPPED_BYTES, so a
+// huge archive doesn't map everything at once.
+//
+// Usage: reprocess [-o output_folder] [-j threads] [-i interval_ms] [-c calibration] path ...
+//   path         a recording, a folder (its .txt files) or a glob, e.g. "09-07-2025/adc_data/*.txt"
+//                (quoted, glob() expands it; unquoted, the shell does)
+//   -o folder    output folder (default OUTPUT_FOLDER, as c2)
+//   -j threads   workers, 0 = one per logical processor (default), 1 = no pool
+//   -i ms        sample interval for every file; by default the "ms<N>" in the name, else
+//                DEFAULT_INTERVAL_MS (what the server's config sends c2)
+//   -c table     per-channel calibration (see channel_calibration.h); by default
+//                CALIBRATION_FILE if there is one, as for c2
+// Text recordings and files of adc32 or delta frames (see adc_protocol.h) are told apart
+// by their first bytes; multi-channel frames give one output per channel. Prints the stage breakdown and a BULK_RESULT line like "c2 bulk".
+
+// Configuration
+#define DEFAULT_INTERVAL_MS 20
+#define DEFAULT_THREADS 0
+#define MAX_MAPPED_BYTES (256u << 20) // Mapped views of the files being processed or queued
+
+#include "file_pipeline.h" // Whole-file DSP chain shared with c2
+#include "worker_pool.h"   // Files processed on a pool of worker threads
+
+// One recording to reprocess
+typedef struct {
+    char *path;
+    const char *name;           // Base name: the output is all_data_<name>.bin, as from the server
+    size_t size;
+    int interval_ms;
+} ReprocessJob;
+
+typedef struct {
+    ReprocessJob *jobs;
+    int count;
+    int capacity;
+} JobList;
+
+FileWorker *workers = NULL; // One per pool worker (or just one without a pool)
+int forced_interval_ms = 0; // -i; 0 = from each file's name
+int failed_files = 0;       // Workers add with __atomic builtins
+
+// "535g20250502pm427ms20hz50.txt" -> 20, as catalog_parse_interval_ms() reads it on the
+// server (recording_catalog.h is Windows only): the last "ms" (any case) directly followed
+// by digits; -1 if there is none.
+int interval_from_name(const char *name) {
+    int interval = -1;
+    for (const char *p = name; p[0] && p[1]; p++) {
+        if (tolower((unsigned char)p[0]) != 'm' || tolower((unsigned char)p[1]) != 's' ||
+            !isdigit((unsigned char)p[2])) {
+            continue;
+        }
+        long value = 0;
+        for (const char *q = p + 2; isdigit((unsigned char)*q) && value <= 1000000; q++) value = value * 10 + (*q - '0');
+        if (value > 0) interval = (int)value;
+    }
+    return interval;
+}
+
+// Adds one file. Returns 0, or -1 if out of memory.
+int add_job(JobList *list, const char *path, size_t size) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        ReprocessJob *grown = (ReprocessJob *)realloc(list->jobs, (size_t)capacity * sizeof(ReprocessJob));
+        if (grown == NULL) return -1;
+        list->jobs = grown;
+        list->capacity = capacity;
+    }
+    ReprocessJob *job = &list->jobs[list->count];
+    job->path = strdup(path);
+    if (job->path == NULL) return -1;
+    const char *slash = strrchr(job->path, '/');
+    job->name = slash ? slash + 1 : job->path;
+    job->size = size;
+    int from_name = interval_from_name(job->name);
+    job->interval_ms = forced_interval_ms > 0 ? forced_interval_ms : from_name > 0 ? from_name : DEFAULT_INTERVAL_MS;
+    list->count++;
+    return 0;
+}
+
+// Adds a file, or a folder's .txt files. Returns the number of files added, or -1.
+int add_path(JobList *list, const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return add_job(list, path, (size_t)st.st_size) == 0 ? 1 : -1;
+    }
+    DIR *d = opendir(path);
+    if (d == NULL) {
+        perror(path);
+        return -1;
+    }
+    int added = 0;
+    struct dirent *dir;
+    while ((dir = readdir(d)) != NULL) {
+        size_t len = strlen(dir->d_name);
+        if (len < 4 || strcmp(dir->d_name + len - 4, ".txt") != 0) continue;
+        char file_path[1024];
+        snprintf(file_path, sizeof(file_path), "%s/%s", path, dir->d_name);
+        if (stat(file_path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        if (add_job(list, file_path, (size_t)st.st_size) != 0) {
+            added = -1;
+            break;
+        }
+        added++;
+    }
+    closedir(d);
+    return added;
+}
+
+// Largest first
+int job_compare(const void *a, const void *b) {
+    size_t sa = ((const ReprocessJob *)a)->size, sb = ((const ReprocessJob *)b)->size;
+    return (sa < sb) - (sa > sb);
+}
+
+// Maps one recording, runs it through the pipeline and unmaps it. Returns 0, or -1.
+int reprocess_file(const ReprocessJob *job, FileWorker *state) {
+    DspContext dsp = { &state->fir, &state->bank, &state->stats, &state->arena, &state->records };
+    double t = bulk_now();
+    int fd = open(job->path, O_RDONLY);
+    if (fd < 0) {
+        perror(job->path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(job->path);
+        close(fd);
+        return -1;
+    }
+    size_t len = (size_t)st.st_size;
+    const char *content = "";
+    void *view = NULL;
+    if (len > 0) {
+        view = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            perror(job->path);
+            close(fd);
+            return -1;
+        }
+        madvise(view, len, MADV_SEQUENTIAL);
+        content = (const char *)view;
+    }
+    close(fd); // The mapping keeps the file
+    bulk_stage_end(dsp.stats, BULK_STAGE_READ, t); // Page faults are booked to parse
+
+    uint32_t magic = 0;
+    if (len >= sizeof(magic)) memcpy(&magic, content, sizeof(magic));
+    dsp.stats->files++;
+    dsp.stats->bytes += len;
+    fir_engine_reset(dsp.fir); // Every file from a clean filter, as c2's pool workers do
+    fir_bank_reset(dsp.bank);
+    if (magic == ADC_FRAME_MAGIC || magic == ADC_DELTA_MAGIC) {
+        process_frames(content, len, magic == ADC_FRAME_MAGIC ? ENCODING_ADC32 : ENCODING_DELTA, job->name, job->interval_ms, &dsp);
+    } else {
+        process_data(content, len, job->name, job->interval_ms, &dsp);
+    }
+    if (view) munmap(view, len);
+    return 0;
+}
+
+// Worker side: arg is a ReprocessJob of the list, which outlives the pool
+void run_reprocess_job(void *arg, int worker) {
+    if (reprocess_file((const ReprocessJob *)arg, &workers[worker]) != 0) {
+        __atomic_add_fetch(&failed_files, 1, __ATOMIC_RELAXED);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int threads = DEFAULT_THREADS;
+    const char *calibration_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:j:i:c:")) != -1) {
+        switch (opt) {
+        case 'o': output_folder = optarg; break;
+        case 'j': threads = atoi(optarg); break;
+        case 'i': forced_interval_ms = atoi(optarg); break;
+        case 'c': calibration_path = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-o output_folder] [-j threads] [-i interval_ms] [-c calibration] path|folder|glob ...\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-o output_folder] [-j threads] [-i interval_ms] [-c calibration] path|folder|glob ...\n", argv[0]);
+        return 2;
+    }
+
+    JobList list = { NULL, 0, 0 };
+    for (int i = optind; i < argc; i++) {
+        glob_t matches;
+        int result = glob(argv[i], 0, NULL, &matches);
+        if (result == GLOB_NOMATCH) {
+            fprintf(stderr, "No such file or folder: %s\n", argv[i]);
+            failed_files++;
+            continue;
+        }
+        if (result != 0) {
+            fprintf(stderr, "Could not expand %s\n", argv[i]);
+            return 1;
+        }
+        for (size_t m = 0; m < matches.gl_pathc; m++) {
+            if (add_path(&list, matches.gl_pathv[m]) < 0) failed_files++;
+        }
+        globfree(&matches);
+    }
+    if (list.count == 0) {
+        fprintf(stderr, "No recordings to reprocess.\n");
+        return 1;
+    }
+    qsort(list.jobs, (size_t)list.count, sizeof(ReprocessJob), job_compare);
+
+    if (init_calibration(calibration_path) != 0) {
+        return 1;
+    }
+    metrics_start_reporter("reprocess");
+    init_fir_stage();
+    init_fft_stage();
+    ensure_output_folder(); // Before the workers, which would all try at once
+
+    int count = (threads > 0) ? threads : worker_pool_cpu_count();
+    if (count > WORKER_POOL_MAX_THREADS) count = WORKER_POOL_MAX_THREADS;
+    if (count > list.count) count = list.count;
+    workers = (FileWorker *)calloc((size_t)count, sizeof(FileWorker));
+    if (workers == NULL) {
+        perror("Failed to allocate worker state");
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        file_worker_init(&workers[i]);
+    }
+
+    double start = bulk_now();
+    WorkerPool pool;
+    int started = (count > 1) ? worker_pool_start(&pool, count, MAX_MAPPED_BYTES, run_reprocess_job) : 0;
+    if (started > 0) {
+        printf("Reprocessing %d files on %d worker threads.\n", list.count, started);
+        for (int i = 0; i < list.count; i++) {
+            if (worker_pool_submit(&pool, &list.jobs[i], list.jobs[i].size) != 0) {
+                fprintf(stderr, "Could not queue %s\n", list.jobs[i].path);
+                __atomic_add_fetch(&failed_files, 1, __ATOMIC_RELAXED);
+            }
+        }
+        worker_pool_finish(&pool);
+    } else {
+        if (count > 1) {
+            worker_pool_finish(&pool);
+            fprintf(stderr, "Could not start worker threads, processing on this thread.\n");
+        }
+        printf("Reprocessing %d files.\n", list.count);
+        for (int i = 0; i < list.count; i++) {
+            if (reprocess_file(&list.jobs[i], &workers[0]) != 0) failed_files++;
+        }
+    }
+
+    BulkStats stats;
+    memset(&stats, 0, sizeof(stats));
+    size_t arena_bytes = 0;
+    for (int i = 0; i < count; i++) {
+        bulk_stats_accumulate(&stats, &workers[i].stats);
+        arena_bytes += dsp_arena_capacity(&workers[i].arena);
+        dsp_arena_free(&workers[i].arena);
+        adc_records_free(&workers[i].records);
+    }
+    stats.wall_s = bulk_now() - start; // Stage times are summed over workers and can exceed it
+    metrics_stop_reporter();
+    metrics_dump(stderr, "reprocess");
+    printf("Processed %llu files into %s (DSP buffers: %lu KiB held).\n", (unsigned long long)stats.files, output_folder,
+           (unsigned long)(arena_bytes >> 10));
+    bulk_stats_print(stdout, "Reprocess", &stats);
+    char line[512];
+    bulk_stats_format(&stats, ' ', line, sizeof(line));
+    printf("%s%s\n", BULK_RESULT_PREFIX, line);
+
+    for (int i = 0; i < list.count; i++) free(list.jobs[i].path);
+    free(list.jobs);
+    free(workers);
+    if (failed_files > 0) {
+        fprintf(stderr, "%d files or paths could not be reprocessed.\n", failed_files);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+// Raw serial port input for the server's live acquisition (see live_source.h).
+//
+// The load cell board prints the same teraterm lines that adc_data was captured from
+// (ADC:<counts>, plus MOV:/FIR:/kg lines on some firmware). serial_read() returns whatever
+// has arrived, as soon as anything has: it waits at most SERIAL_READ_TIMEOUT_MS for the
+// first byte and never for a buffer to fill, so a sample reaches the parser within a byte
+// time of leaving the board. Reads are SERIAL_READ_BYTES long, so a burst (the board
+// printing faster than it is read, or a driver handing over a full USB packet) is one call.
+//
+// Windows: the port is opened for overlapped I/O and two read buffers take turns, like a
+// DMA double buffer: while the caller parses one, a read into the other is already
+// queued with the driver, whose own receive queue is set to SERIAL_DRIVER_QUEUE_BYTES.
+// Linux: termios in raw mode, poll() for the first byte, then one large read().
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>    // For CreateFile, overlapped ReadFile, DCB, COMMTIMEOUTS
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+#define SERIAL_READ_BYTES (64 << 10)        // One read; also what the driver may deliver at once
+#define SERIAL_DRIVER_QUEUE_BYTES (64 << 10) // Windows driver receive queue (a request, drivers may cap it)
+#define SERIAL_READ_TIMEOUT_MS 100          // Longest wait for a first byte, so a stop request is noticed
+
+typedef struct {
+#ifdef _WIN32
+    HANDLE handle;
+    OVERLAPPED overlapped[2];
+    int queued[2];              // A read into buffer[i] is with the driver
+    int current;                // Buffer whose read completes next (reads complete in queue order)
+    int returned;               // Buffer handed to the caller by the last serial_read(), or -1
+#else
+    int fd;
+#endif
+    char buffer[2][SERIAL_READ_BYTES];
+    int is_open;
+} SerialPort;
+
+#ifndef _WIN32
+static inline speed_t serial_speed(int baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+    default: return 0;
+    }
+}
+#endif
+
+#ifdef _WIN32
+// Queues an overlapped read into buffer[i]. Returns 0, or -1 if the port failed.
+static inline int serial_queue_read(SerialPort *port, int i) {
+    ResetEvent(port->overlapped[i].hEvent);
+    if (!ReadFile(port->handle, port->buffer[i], SERIAL_READ_BYTES, NULL, &port->overlapped[i]) &&
+        GetLastError() != ERROR_IO_PENDING) {
+        return -1;
+    }
+    port->queued[i] = 1; // Also when it completed at once: the result is collected the same way
+    return 0;
+}
+#endif
+
+static inline void serial_close(SerialPort *port) {
+    if (!port->is_open) return;
+#ifdef _WIN32
+    CancelIo(port->handle);
+    for (int i = 0; i < 2; i++) {
+        DWORD got;
+        if (port->queued[i]) GetOverlappedResult(port->handle, &port->overlapped[i], &got, TRUE);
+        if (port->overlapped[i].hEvent) CloseHandle(port->overlapped[i].hEvent);
+    }
+    CloseHandle(port->handle);
+#else
+    close(port->fd);
+#endif
+    port->is_open = 0;
+}
+
+// Opens name ("COM3", "\\\\.\\COM12", "/dev/ttyUSB0") at baud, 8N1, no flow control.
+// Returns 0, or -1 with the reason printed.
+static inline int serial_open(SerialPort *port, const char *name, int baud) {
+    memset(port, 0, sizeof(*port));
+#ifdef _WIN32
+    char path[64];
+    snprintf(path, sizeof(path), (strncmp(name, "\\\\.\\", 4) == 0) ? "%s" : "\\\\.\\%s", name); // COM10 and up need the prefix
+    port->handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+    if (port->handle == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Could not open serial port %s: %lu\n", name, GetLastError());
+        return -1;
+    }
+    SetupComm(port->handle, SERIAL_DRIVER_QUEUE_BYTES, 4096);
+    DCB dcb;
+    memset(&dcb, 0, sizeof(dcb));
+    dcb.DCBlength = sizeof(dcb);
+    GetCommState(port->handle, &dcb);
+    dcb.BaudRate = (DWORD)baud;
+    dcb.ByteSize = 8;
+    dcb.Parity = NOPARITY;
+    dcb.StopBits = ONESTOPBIT;
+    dcb.fBinary = TRUE;
+    dcb.fParity = FALSE;
+    dcb.fOutxCtsFlow = FALSE;
+    dcb.fOutxDsrFlow = FALSE;
+    dcb.fDtrControl = DTR_CONTROL_ENABLE; // Many USB serial bridges send nothing until DTR is up
+    dcb.fRtsControl = RTS_CONTROL_ENABLE;
+    dcb.fOutX = FALSE;
+    dcb.fInX = FALSE;
+    // Return as soon as any byte is there, or after SERIAL_READ_TIMEOUT_MS with none
+    COMMTIMEOUTS timeouts = { MAXDWORD, MAXDWORD, SERIAL_READ_TIMEOUT_MS, 0, 0 };
+    if (!SetCommState(port->handle, &dcb) || !SetCommTimeouts(port->handle, &timeouts)) {
+        fprintf(stderr, "Could not configure serial port %s at %d baud: %lu\n", name, baud, GetLastError());
+        CloseHandle(port->handle);
+        return -1;
+    }
+    PurgeComm(port->handle, PURGE_RXCLEAR); // Start at live data, not whatever queued up before
+    for (int i = 0; i < 2; i++) {
+        port->overlapped[i].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+    port->is_open = 1;
+    port->returned = -1;
+    if (port->overlapped[0].hEvent == NULL || port->overlapped[1].hEvent == NULL ||
+        serial_queue_read(port, 0) != 0 || serial_queue_read(port, 1) != 0) {
+        fprintf(stderr, "Could not start reading serial port %s: %lu\n", name, GetLastError());
+        serial_close(port);
+        return -1;
+    }
+#else
+    speed_t speed = serial_speed(baud);
+    if (speed == 0) {
+        fprintf(stderr, "Unsupported baud rate %d\n", baud);
+        return -1;
+    }
+    port->fd = open(name, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (port->fd < 0) {
+        perror("Could not open serial port");
+        return -1;
+    }
+    struct termios tio;
+    if (tcgetattr(port->fd, &tio) != 0) {
+        perror("Could not read serial port settings");
+        close(port->fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;  // read() returns what is there; poll() does the waiting
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(port->fd, TCSANOW, &tio) != 0) {
+        perror("Could not configure serial port");
+        close(port->fd);
+        return -1;
+    }
+    tcflush(port->fd, TCIFLUSH);
+    port->is_open = 1;
+#endif
+    return 0;
+}
+
+// Waits for input and returns its length, with *data pointing at it (valid until the next
+// call). Returns 0 if nothing arrived within SERIAL_READ_TIMEOUT_MS, -1 if the port failed
+// (e.g. the USB adapter was unplugged).
+static inline long serial_read(SerialPort *port, const char **data) {
+#ifdef _WIN32
+    // The caller is done with the previous buffer: back to the driver, behind the read in flight
+    if (port->returned >= 0) {
+        if (serial_queue_read(port, port->returned) != 0) return -1;
+        port->returned = -1;
+    }
+    int i = port->current;
+    DWORD got = 0;
+    if (!GetOverlappedResult(port->handle, &port->overlapped[i], &got, TRUE)) {
+        return -1;
+    }
+    port->queued[i] = 0;
+    port->current = 1 - i;
+    port->returned = i;
+    *data = port->buffer[i];
+    return (long)got;
+#else
+    struct pollfd pfd = { port->fd, POLLIN, 0 };
+    int ready = poll(&pfd, 1, SERIAL_READ_TIMEOUT_MS);
+    if (ready < 0) {
+        return -1;
+    }
+    if (ready == 0) {
+        return 0;
+    }
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        return -1;
+    }
+    ssize_t got = read(port->fd, port->buffer[0], SERIAL_READ_BYTES);
+    if (got < 0) {
+        return -1;
+    }
+    *data = port->buffer[0];
+    return (long)got;
+#endif
+}
+
+#endif // SERIAL_PORT_H
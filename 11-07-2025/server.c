@@ -11,34 +11,186 @@
 #include <winsock2.h>   // For Winsock functions (SOCKET, WSADATA, etc.)
 #include <ws2tcpip.h>   // For InetNtop (if available), sockaddr_in, etc.
 #include <windows.h>    // For Sleep() function, MAKEWORD
+#include <mswsock.h>    // For TransmitFile (zero-copy file send)
 
 // Needed for _mkdir on Windows, and stat
 #include <sys/stat.h>
 #include <direct.h>     // For _mkdir
 
-// POSIX-like header for directory listing (since you have it)
-#include <dirent.h> 
+#include "adc_protocol.h" // Binary sample frames (negotiated per client)
+#include "recording_catalog.h" // Mapped, pre-parsed recordings with a folder watcher
+#include "replay_pacer.h"     // Streams each recording at its sample rate
+#include "bulk_stats.h"       // MODE:bulk negotiation and stage timing
+#include "metrics.h"          // Send latency histograms, periodic stats dump, LOG_VERBOSE
+#include "broadcast.h"        // Live and broadcast modes: one publisher, shared segments for every client
+#include "live_source.h"      // Live mode: the load cell's serial output
+#include "async_io.h"         // Completion-port sends for the live/broadcast fan-out
 
-// Need to link with Ws2_32.lib (-lws2_32)
+// Need to link with Ws2_32.lib (-lws2_32) and Mswsock.lib (-lmswsock)
 
 // Configuration
 #define SERVER_IP "0.0.0.0" // Listen on all interfaces
 #define SERVER_PORT 9999
 #define BUFFER_SIZE 4096
-#define DATA_FOLDER "adc_data"
+#define DATA_FOLDER "adc_data" // Default; argv[2] overrides
+#define MAX_CLIENTS 8       // Maximum number of clients served at the same time
+#define LISTEN_BACKLOG SOMAXCONN // Pending connections wait here while all client slots are busy
+#define ZERO_COPY_SEND 0    // 1 = TransmitFile by path (opens the file per send, unpaced replays only), 0 = send from the catalog's mapped view
+#define REPLAY_SPEEDUP 1.0  // Replay speed (1 = the recorded rate, 10 = ten times faster); 0 = whole files with an INTERVAL gap. argv[1] overrides
+#define NEGOTIATION_TIMEOUT_MS 500 // How long to wait for a client's encoding hello before falling back to text
+#define BULK_SLOTS 2        // Bulk replay: files prepared ahead of the one being sent (plus that one)
+#define LIVE_BAUD_RATE 115200 // Live mode default; argv[3] overrides
+#define LIVE_INTERVAL_MS 20 // Sample interval the board prints at (sent in the config and frame headers)
+#define BROADCAST_WAIT_MS 200 // Longest wait for broadcast data before checking again
+#define SLOW_CLIENT_POLICY BROADCAST_SLOW_DROP // Or BROADCAST_SLOW_DISCONNECT (see broadcast.h)
+#define MULTICAST_GROUP ""  // e.g. "239.255.0.99": live/broadcast samples also go out as UDP adc32 frames; "" = off
+#define MULTICAST_PORT 9998
+#define MULTICAST_TTL 1     // Hops; 1 keeps the datagrams on the local network
+#define FANOUT_LOOPS 0      // Live/broadcast modes: event loops sending to the clients; 0 = one per logical processor, -1 = a thread per client
+#define FANOUT_MAX_CLIENTS 64 // Live/broadcast client limit while the loops run (they need no thread per client)
+#define FANOUT_SENDS_PER_CLIENT 4 // Sends a loop keeps outstanding per client; the rest waits in the hub
 
 // Define constants for length-prefixing (same as Python)
 #define FILENAME_LENGTH_BYTES 4
 #define FILE_CONTENT_LENGTH_BYTES 8
 #define CONFIG_LENGTH_BYTES 4
+#define MAX_HEADER_SIZE (FILENAME_LENGTH_BYTES + 256 + FILE_CONTENT_LENGTH_BYTES)
+
+// Per-client state, owned by the thread that serves the connection
+typedef struct {
+    SOCKET sock;
+    int id;                     // Sequential connection number (for log messages)
+    char ip[INET_ADDRSTRLEN];
+    int port;
+    uint64_t bytes_sent;        // Total bytes written to this client (headers included)
+    int files_sent;
+    ULONGLONG start_ms;         // GetTickCount64() when the connection was accepted
+    WireEncoding encoding;      // ENCODING_TEXT unless the client asked for binary frames
+    uint64_t text_bytes;        // Size of the recordings sent, as text (for the compression ratio)
+    int bulk;                   // Client asked for MODE:bulk: no pacing, no gaps, stage stats at the end
+    char resume_name[256];      // RESUME: in the hello: the file to carry on with ("" = from the start)
+    uint64_t resume_offset;     // and how many bytes of its content the client already has
+} ClientSession;
+
+// One prepared file in a bulk replay
+typedef struct {
+    const CatalogEntry *entry;
+    char header[MAX_HEADER_SIZE];
+    size_t header_len;          // 0 = name too long, skip the file
+    const char *content;        // Mapped view, or frames
+    size_t content_len;
+    uint8_t *owned;             // Frames buffer to free once sent (NULL for a mapped view)
+} BulkSlot;
+
+// Bulk replay of one snapshot: the reader thread fills slots while the session thread sends them
+typedef struct {
+    ClientSession *session;
+    const CatalogSnapshot *snapshot;
+    int interval_ms;
+    int first;                  // Index of the first file to send (a resumed session starts mid-snapshot)
+    uint64_t first_offset;      // Bytes of that file's content the client already has
+    BulkSlot slots[BULK_SLOTS];     // File i goes through slots[i % BULK_SLOTS]
+    HANDLE filled;              // Semaphore: slots ready to send
+    HANDLE emptied;             // Semaphore: slots free to prepare
+    volatile LONG stop;         // The sender gave up; the reader stops preparing
+    volatile LONG prepared;     // Files the reader has finished (the sender's queue depth is this minus sent)
+    double read_s;              // Reader thread time spent preparing
+} BulkPipeline;
+
+typedef struct FanoutClient FanoutClient;
+
+// One send outstanding to a fan-out client: a file header, or bytes of a hub segment
+typedef struct {
+    AsyncOp op;
+    FanoutClient *client;
+    BroadcastSegment *segment;  // Reference held while its bytes are in flight (NULL for a header)
+    char header[MAX_HEADER_SIZE];
+    uint64_t begin;             // metrics_begin() when the send started
+    int busy;
+} FanoutSend;
+
+// A live or broadcast client served by a fan-out loop instead of a thread of its own
+struct FanoutClient {
+    ClientSession *session;
+    AsyncChannel channel;
+    BroadcastSubscriber sub;
+    FanoutSend sends[FANOUT_SENDS_PER_CLIENT];
+    int in_flight;
+    int started;                // A segment was begun (as in send_broadcast())
+    int ending;                 // Nothing more to send; the session ends once in_flight is 0
+    int result;                 // As send_broadcast() returns it
+    FanoutClient *next;
+};
+
+// One event loop thread and the fan-out clients it serves
+typedef struct {
+    AsyncLoop loop;
+    AsyncOp wake;               // Posted when the hub has news or a client was handed over
+    volatile LONG wake_posted;
+    CRITICAL_SECTION lock;      // Guards handed_over
+    FanoutClient *handed_over;  // From session threads, not attached yet
+    FanoutClient *clients;      // Loop thread only
+} FanoutLoop;
 
 // Function prototypes
 // Note: SOCKET is a Windows-specific type for sockets
 void send_length_prefixed_data(SOCKET sockfd, const char *filename, const char *file_content, size_t content_len, int is_file);
-void handle_client(SOCKET client_sock);
-void send_config(SOCKET client_sock, int interval_ms, const char *mode);
-void send_file_by_path(SOCKET client_sock, const char *filepath);
-void send_control_message(SOCKET client_sock, const char *message);
+DWORD WINAPI client_thread_func(LPVOID lpParam);
+int handle_client(ClientSession *session);
+void end_client_session(ClientSession *session);
+int send_all(ClientSession *session, const void *buf, size_t len);
+size_t build_file_header(char *out, size_t out_size, const char *name, uint64_t content_len);
+int send_file_content(ClientSession *session, HANDLE file, const char *header, size_t header_len, uint64_t file_content_len);
+int send_config(ClientSession *session, int interval_ms, const char *mode);
+int send_file_by_path(ClientSession *session, const char *filepath);
+int send_control_message(ClientSession *session, const char *message);
+int negotiate_encoding(ClientSession *session);
+int send_mapped_file(ClientSession *session, const CatalogEntry *entry, double rate_hz, uint64_t offset);
+int send_file_frames(ClientSession *session, const CatalogEntry *entry, int interval_ms, double rate_hz, uint64_t offset);
+int send_paced_content(ClientSession *session, const CatalogEntry *entry, const char *content, size_t content_len, double rate_hz,
+                       size_t start);
+size_t content_sample_end(WireEncoding encoding, const char *content, size_t content_len, size_t offset, uint16_t *delta_left,
+                          size_t next, size_t samples);
+double replay_rate_hz(const CatalogEntry *entry, int interval_ms);
+int resume_position(ClientSession *session, const CatalogSnapshot *snapshot, int *first, uint64_t *first_offset);
+int send_files_bulk(ClientSession *session, const CatalogSnapshot *snapshot, int interval_ms, int first, uint64_t first_offset);
+int send_broadcast(ClientSession *session);
+int fanout_start(int count);
+void fanout_notify(void *ctx);
+void fanout_wake(FanoutLoop *fanout);
+void fanout_woken(AsyncOp *op, long result);
+int fanout_hand_over(ClientSession *session);
+DWORD WINAPI fanout_thread(LPVOID param);
+int fanout_pump(FanoutClient *client);
+int fanout_send(FanoutClient *client, BroadcastSegment *segment, const void *data, size_t len);
+void fanout_sent(AsyncOp *op, long result);
+void fanout_finish(FanoutClient *client);
+int broadcast_replay_file(CatalogEntry *entry, int interval_ms);
+DWORD WINAPI broadcast_replay_thread(LPVOID param);
+void multicast_samples(const int32_t *samples, int count, uint32_t sample_rate_mhz, void *ctx);
+int multicast_open(const char *group);
+DWORD WINAPI bulk_reader_thread(LPVOID lpParam);
+int bulk_prepare_slot(BulkSlot *slot, const CatalogEntry *entry, WireEncoding encoding, int interval_ms, uint64_t offset);
+void report_client_throughput(const ClientSession *session);
+
+// Connection slots: the accept loop takes one before accepting, the client thread gives it back
+HANDLE client_slots = NULL;
+volatile LONG active_clients = 0;
+int max_clients = MAX_CLIENTS;  // FANOUT_MAX_CLIENTS while the fan-out loops serve the clients
+
+RecordingCatalog catalog; // Every .txt file in data_folder, indexed once at startup
+double replay_speedup = REPLAY_SPEEDUP;
+const char *data_folder = DATA_FOLDER;
+int live_mode = 0;          // "server live <port>": serve the serial input instead of data_folder
+int broadcast_mode = 0;     // Sessions subscribe to the hub (live mode, or "server broadcast")
+Broadcast hub;
+LiveSource live_source;
+SOCKET multicast_sock = INVALID_SOCKET;
+struct sockaddr_in multicast_addr;
+uint32_t multicast_sequence = 0;
+FanoutLoop *fanout_loops = NULL;    // Live/broadcast modes, see FANOUT_LOOPS
+volatile LONG fanout_loop_count = 0;
+volatile LONG fanout_next = 0;      // Loop the next client is handed to, round robin
 
 // Helper for htobe64 (host to big-endian 64-bit) for MinGW
 #ifndef htobe64
@@ -49,17 +201,67 @@ static inline uint64_t htobe64_custom(uint64_t host_val) {
 #endif
 
 
-int main() {
+int main(int argc, char *argv[]) {
     WSADATA wsaData;
     SOCKET server_sock, client_sock;
     struct sockaddr_in server_addr, client_addr;
     int client_addr_len = sizeof(client_addr);
 
+    // Usage: server [speedup] [data_folder]
+    //        server broadcast [speedup] [data_folder]
+    //        server live <port> [baud]
+    broadcast_init(&hub, SLOW_CLIENT_POLICY);
+    if (argc > 1 && strcmp(argv[1], "live") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s live <port> [baud]\n", argv[0]);
+            return 1;
+        }
+        int baud = (argc > 3) ? atoi(argv[3]) : LIVE_BAUD_RATE;
+        if (baud <= 0) {
+            fprintf(stderr, "Invalid baud rate '%s'\n", argv[3]);
+            return 1;
+        }
+        if (live_source_start(&live_source, argv[2], baud, LIVE_INTERVAL_MS, &hub) != 0) {
+            return 1;
+        }
+        live_mode = 1;
+        broadcast_mode = 1;
+        printf("Live input from %s at %d baud.\n", argv[2], baud);
+    } else {
+        int arg = 1;
+        if (argc > 1 && strcmp(argv[1], "broadcast") == 0) {
+            broadcast_mode = 1;
+            arg = 2;
+        }
+        if (argc > arg + 1) {
+            data_folder = argv[arg + 1];
+        }
+        if (argc > arg) {
+            char *end;
+            replay_speedup = strtod(argv[arg], &end);
+            if (end == argv[arg] || *end != '\0' || replay_speedup < 0.0) {
+                fprintf(stderr, "Invalid replay speed-up '%s' (expected a number >= 0, 0 = unpaced)\n", argv[arg]);
+                return 1;
+            }
+        }
+        if (broadcast_mode && replay_speedup <= 0.0) {
+            fprintf(stderr, "Broadcast mode needs a replay speed-up > 0\n");
+            return 1;
+        }
+    }
+
     // Initialize Winsock
     if (WSAStartup(MAKEWORD(2,2), &wsaData) != 0) {
         fprintf(stderr, "WSAStartup failed: %d\n", WSAGetLastError());
         return 1;
     }
+    if (broadcast_mode && MULTICAST_GROUP[0] != '\0' && multicast_open(MULTICAST_GROUP) == 0) {
+        hub.tap = multicast_samples; // Set before the publisher's first sample
+    }
+    if (broadcast_mode && FANOUT_LOOPS >= 0 && fanout_start(FANOUT_LOOPS) > 0) {
+        hub.notify = fanout_notify;
+        max_clients = FANOUT_MAX_CLIENTS;
+    }
 
     // 1. Create socket
     server_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
@@ -91,123 +293,449 @@ int main() {
     }
 
     // 3. Listen for incoming connections
-    if (listen(server_sock, 5) == SOCKET_ERROR) {
+    if (listen(server_sock, LISTEN_BACKLOG) == SOCKET_ERROR) {
         fprintf(stderr, "Error listening: %d\n", WSAGetLastError());
         closesocket(server_sock);
         WSACleanup();
         exit(EXIT_FAILURE);
     }
 
-    printf("Server listening on port %d...\n", SERVER_PORT);
+    printf("Server listening on port %d (max %d concurrent clients)...\n", SERVER_PORT, max_clients);
+    metrics_start_reporter("server");
+    if (live_mode) {
+        printf("Streaming live samples in segments of %d.\n", LIVE_SEGMENT_SAMPLES);
+    } else if (broadcast_mode) {
+        printf("Broadcasting recordings to every client at x%g their sample rate.\n", replay_speedup);
+    } else if (replay_speedup > 0.0) {
+        printf("Replaying recordings at x%g their sample rate.\n", replay_speedup);
+    } else {
+        printf("Replaying whole files, unpaced.\n");
+    }
+
+    client_slots = CreateSemaphore(NULL, max_clients, max_clients, NULL);
+    if (client_slots == NULL) {
+        fprintf(stderr, "Error creating client slot semaphore: %lu\n", GetLastError());
+        closesocket(server_sock);
+        WSACleanup();
+        exit(EXIT_FAILURE);
+    }
 
     // Ensure data folder exists
     struct stat st = {0};
-    if (stat(DATA_FOLDER, &st) == -1) {
-        _mkdir(DATA_FOLDER); // Use _mkdir on Windows
-        printf("Created data folder: %s\n", DATA_FOLDER);
+    if (!live_mode && stat(data_folder, &st) == -1) {
+        _mkdir(data_folder); // Use _mkdir on Windows
+        printf("Created data folder: %s\n", data_folder);
+    }
+    if (!live_mode && catalog_open(&catalog, data_folder) != 0) {
+        fprintf(stderr, "Error indexing data folder %s\n", data_folder);
+        CloseHandle(client_slots);
+        closesocket(server_sock);
+        WSACleanup();
+        exit(EXIT_FAILURE);
+    }
+    if (broadcast_mode && !live_mode) {
+        HANDLE publisher = CreateThread(NULL, 0, broadcast_replay_thread, NULL, 0, NULL);
+        if (publisher == NULL) {
+            fprintf(stderr, "Error creating broadcast thread: %lu\n", GetLastError());
+            exit(EXIT_FAILURE);
+        }
+        CloseHandle(publisher);
     }
 
+    int next_client_id = 1;
     while (1) {
+        // Backpressure: while all slots are taken, new connections stay in the listen backlog
+        if (WaitForSingleObject(client_slots, 0) == WAIT_TIMEOUT) {
+            printf("All %d client slots busy, new connections will wait...\n", max_clients);
+            WaitForSingleObject(client_slots, INFINITE);
+        }
+
         printf("Waiting for client connection...\n");
         client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &client_addr_len);
         if (client_sock == INVALID_SOCKET) {
             fprintf(stderr, "Error accepting connection: %d\n", WSAGetLastError());
+            ReleaseSemaphore(client_slots, 1, NULL);
             continue;
         }
 
+        ClientSession *session = (ClientSession *)calloc(1, sizeof(ClientSession));
+        if (session == NULL) {
+            perror("Failed to allocate client session");
+            closesocket(client_sock);
+            ReleaseSemaphore(client_slots, 1, NULL);
+            continue;
+        }
+        session->sock = client_sock;
+        session->id = next_client_id++;
+        session->port = ntohs(client_addr.sin_port);
+        session->start_ms = GetTickCount64();
+
         // Use inet_ntoa for IP address to string conversion (most reliable on MinGW)
-        char client_ip[INET_ADDRSTRLEN]; 
         char *ip_str_inet_ntoa = inet_ntoa(client_addr.sin_addr); 
         if (ip_str_inet_ntoa != NULL) {
-            strncpy(client_ip, ip_str_inet_ntoa, sizeof(client_ip) - 1);
-            client_ip[sizeof(client_ip) - 1] = '\0';
+            strncpy(session->ip, ip_str_inet_ntoa, sizeof(session->ip) - 1);
+            session->ip[sizeof(session->ip) - 1] = '\0';
         } else {
             fprintf(stderr, "Error in inet_ntoa: %d\n", WSAGetLastError());
-            strcpy(client_ip, "UNKNOWN"); 
+            strcpy(session->ip, "UNKNOWN"); 
         }
-        
-        printf("Connection from %s:%d\n", client_ip, ntohs(client_addr.sin_port));
 
-        handle_client(client_sock); 
-                                    
-        printf("Client connection closed.\n");
-        closesocket(client_sock); 
+        LONG active = InterlockedIncrement(&active_clients);
+        printf("Connection #%d from %s:%d (active clients: %ld/%d)\n", session->id, session->ip, session->port, active, max_clients);
+
+        // Each client is served on its own thread so one slow replay never blocks the others
+        HANDLE client_thread = CreateThread(NULL, 0, client_thread_func, session, 0, NULL);
+        if (client_thread == NULL) {
+            fprintf(stderr, "Error creating client thread: %lu\n", GetLastError());
+            closesocket(client_sock);
+            free(session);
+            InterlockedDecrement(&active_clients);
+            ReleaseSemaphore(client_slots, 1, NULL);
+            continue;
+        }
+        CloseHandle(client_thread); // Thread cleans up after itself
     }
 
+    if (live_mode) {
+        live_source_stop(&live_source);
+    } else {
+        catalog_close(&catalog);
+    }
+    if (multicast_sock != INVALID_SOCKET) closesocket(multicast_sock);
+    CloseHandle(client_slots);
     closesocket(server_sock); 
     WSACleanup();
     return 0;
 }
 
-// Handles a single client connection
-void handle_client(SOCKET client_sock) {
+// Thread entry point for one client connection
+DWORD WINAPI client_thread_func(LPVOID lpParam) {
+    ClientSession *session = (ClientSession *)lpParam;
+
+    if (handle_client(session) == 0) {
+        end_client_session(session);
+    }
+    metrics_thread_exit(); // Its send records stay in the totals, the block goes back for the next client
+    return 0;
+}
+
+// Closes the connection, reports on it and gives its slot back (on whichever thread served it)
+void end_client_session(ClientSession *session) {
+    closesocket(session->sock);
+    LONG active = InterlockedDecrement(&active_clients);
+    printf("Client #%d connection closed (active clients: %ld/%d).\n", session->id, active, max_clients);
+    report_client_throughput(session);
+    char title[64];
+    snprintf(title, sizeof(title), "server, after client #%d", session->id);
+    metrics_dump(stderr, title);
+
+    free(session);
+    ReleaseSemaphore(client_slots, 1, NULL);
+}
+
+// Handles a single client connection. Returns 0 once the session is over, 1 if it was
+// handed over to a fan-out loop, which ends it.
+int handle_client(ClientSession *session) {
     // In a real C application, you'd implement the mode selection logic here.
     // For this simplified version, we'll hardcode to "interval" mode for demonstration.
-    const char *mode = "interval";
-    int interval_ms = 20; // Default interval
-
-    printf("Sending initial configuration...\n");
-    send_config(client_sock, interval_ms, mode);
-
-    DIR *d;
-    struct dirent *dir;
-    char filepath[256];
-    int file_count = 0;
-
-    d = opendir(DATA_FOLDER);
-    if (d) {
-        while ((dir = readdir(d)) != NULL) {
-            if (dir->d_type == DT_REG && strstr(dir->d_name, ".txt") != NULL) { // Check for regular file and .txt extension
-                file_count++;
-                snprintf(filepath, sizeof(filepath), "%s/%s", DATA_FOLDER, dir->d_name);
-                printf("Sending file: %s\n", dir->d_name);
-                send_file_by_path(client_sock, filepath);
-                Sleep(interval_ms); // Sleep for interval_ms milliseconds on Windows
-            }
+    const char *mode = live_mode ? "live" : broadcast_mode ? "broadcast" : "interval";
+    int interval_ms = live_mode ? LIVE_INTERVAL_MS : 20; // Default interval
+
+    printf("[Client #%d] Sending initial configuration...\n", session->id);
+    if (send_config(session, interval_ms, mode) != 0) {
+        return 0;
+    }
+    if (negotiate_encoding(session) != 0) {
+        return 0;
+    }
+    if (broadcast_mode) {
+        if (fanout_loop_count > 0 && fanout_hand_over(session) == 0) {
+            return 1;
         }
-        closedir(d);
-    } else {
-        perror("Could not open data directory");
-        send_control_message(client_sock, "NO_FILES_IN_FOLDER");
-        return;
+        int result = send_broadcast(session);
+        if (result < 0) {
+            printf("[Client #%d] Client stopped receiving, ending session.\n", session->id);
+        } else if (result == 0) {
+            printf("[Client #%d] Broadcast ended.\n", session->id);
+            send_control_message(session, "END_OF_TRANSMISSION");
+        }
+        return 0;
     }
 
+    // Served from one snapshot of the catalog; folder changes take effect from the next session
+    CatalogSnapshot *snapshot = catalog_acquire(&catalog);
+    int file_count = snapshot ? snapshot->count : 0;
+    int first = 0;
+    uint64_t first_offset = 0;
+    if (resume_position(session, snapshot, &first, &first_offset) != 0) {
+        catalog_snapshot_release(snapshot);
+        return 0;
+    }
+    if (session->bulk && file_count > 0) {
+        int result = send_files_bulk(session, snapshot, interval_ms, first, first_offset);
+        catalog_snapshot_release(snapshot);
+        if (result != 0) {
+            printf("[Client #%d] Client stopped receiving, ending session.\n", session->id);
+            return 0;
+        }
+        printf("[Client #%d] Finished sending files.\n", session->id);
+        send_control_message(session, "END_OF_TRANSMISSION");
+        return 0;
+    }
+    for (int i = first; i < file_count; i++) {
+        const CatalogEntry *entry = snapshot->entries[i];
+        double rate_hz = replay_rate_hz(entry, interval_ms);
+        uint64_t offset = (i == first) ? first_offset : 0;
+        LOG_VERBOSE("[Client #%d] Sending file: %s\n", session->id, entry->name);
+        int result = (session->encoding != ENCODING_TEXT) ? send_file_frames(session, entry, interval_ms, rate_hz, offset)
+                     : (ZERO_COPY_SEND && rate_hz <= 0.0 && offset == 0) ? send_file_by_path(session, entry->path)
+                     : send_mapped_file(session, entry, rate_hz, offset);
+        if (result != 0) {
+            printf("[Client #%d] Client stopped receiving, ending session.\n", session->id);
+            catalog_snapshot_release(snapshot);
+            return 0;
+        }
+        if (rate_hz <= 0.0) {
+            Sleep(interval_ms); // Unpaced replay: gap between whole files
+        }
+    }
+    catalog_snapshot_release(snapshot);
+
     if (file_count == 0) {
-        printf("No .txt files found in %s.\n", DATA_FOLDER);
-        send_control_message(client_sock, "NO_FILES_IN_FOLDER");
+        printf("No .txt files found in %s.\n", data_folder);
+        send_control_message(session, "NO_FILES_IN_FOLDER");
     } else {
-        printf("Finished sending files.\n");
-        send_control_message(client_sock, "END_OF_TRANSMISSION");
+        printf("[Client #%d] Finished sending files.\n", session->id);
+        send_control_message(session, "END_OF_TRANSMISSION");
     }
+    return 0;
+}
+
+// Where a session that asked to RESUME starts: the named file of the snapshot, part way
+// through, with the RESUMED answer sent. A file that is no longer there (or a name too long
+// to answer with) means a replay from the start. Returns -1 if the connection failed.
+int resume_position(ClientSession *session, const CatalogSnapshot *snapshot, int *first, uint64_t *first_offset) {
+    *first = 0;
+    *first_offset = 0;
+    if (session->resume_name[0] == '\0' || snapshot == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < snapshot->count; i++) {
+        if (strcmp(snapshot->entries[i]->name, session->resume_name) != 0) {
+            continue;
+        }
+        char message[MAX_HEADER_SIZE - FILENAME_LENGTH_BYTES - FILE_CONTENT_LENGTH_BYTES];
+        int len = snprintf(message, sizeof(message), "%s%s:%llu", RESUME_ACK_PREFIX, session->resume_name,
+                           (unsigned long long)session->resume_offset);
+        if (len < 0 || (size_t)len >= sizeof(message)) {
+            break;
+        }
+        printf("[Client #%d] Resuming at %s, byte %llu.\n", session->id, session->resume_name,
+               (unsigned long long)session->resume_offset);
+        *first = i;
+        *first_offset = session->resume_offset;
+        return send_control_message(session, message);
+    }
+    printf("[Client #%d] Can't resume at %s, replaying from the start.\n", session->id, session->resume_name);
+    return 0;
+}
+
+// Rate to stream a recording at: its own sample interval ("ms<N>" in the name, else the
+// session's interval) times the speed-up. 0 when replays are unpaced.
+double replay_rate_hz(const CatalogEntry *entry, int interval_ms) {
+    int sample_interval_ms = (entry->interval_ms > 0) ? entry->interval_ms : interval_ms;
+    if (replay_speedup <= 0.0 || sample_interval_ms <= 0) {
+        return 0.0;
+    }
+    return 1000.0 / sample_interval_ms * replay_speedup;
+}
+
+// End of the next `samples` samples of a file's content, from offset (a sample boundary, with
+// `next` the sample count up to the end); adc32 offsets are absolute, the others are walked.
+size_t content_sample_end(WireEncoding encoding, const char *content, size_t content_len, size_t offset, uint16_t *delta_left,
+                          size_t next, size_t samples) {
+    return (encoding == ENCODING_ADC32) ? adc_frames_offset(next)
+           : (encoding == ENCODING_DELTA) ? adc_delta_offset((const uint8_t *)content, content_len, offset, delta_left, samples)
+           : catalog_text_offset(content, content_len, offset, samples);
+}
+
+// Streams a file's content (after its header) at rate_hz samples per second: each tick sends
+// the bytes up to the last sample due by then. A resumed file starts at byte `start`, with
+// the samples before it counted as already sent. Prints the pacing stats for the file.
+int send_paced_content(ClientSession *session, const CatalogEntry *entry, const char *content, size_t content_len, double rate_hz,
+                       size_t start) {
+    ReplayPacer pacer;
+    if (replay_pacer_init(&pacer, rate_hz) != 0) {
+        return send_all(session, content + start, content_len - start);
+    }
+    size_t offset = 0;      // Sample boundary the next tick's bytes are counted from
+    size_t sent = start;    // Bytes of the content the client has
+    size_t next = 0;
+    size_t count = entry->sample_count;
+    uint16_t delta_left = 0; // Delta encoding: samples left in the frame offset is in
+    while (next < count && start > 0) {
+        uint16_t left = delta_left; // Probed on a copy: the frame state only moves with offset
+        size_t end = (next + 1 >= count) ? content_len
+                     : content_sample_end(session->encoding, content, content_len, offset, &left, next + 1, 1);
+        if (end > start) break;
+        offset = end;
+        delta_left = left;
+        next++;
+    }
+    replay_pacer_start_at(&pacer, next);
+    int result = 0;
+    while (next < count && result == 0) {
+        size_t n = replay_pacer_wait(&pacer, next, count);
+        next += n;
+        size_t end = (next >= count) ? content_len
+                     : content_sample_end(session->encoding, content, content_len, offset, &delta_left, next, n);
+        if (end > sent) {
+            result = send_all(session, content + sent, end - sent);
+            sent = end;
+        }
+        offset = end;
+    }
+    if (result == 0 && sent < content_len) {
+        result = send_all(session, content + sent, content_len - sent); // A file without samples
+    }
+
+    char stats[256];
+    replay_stats_format(&pacer, stats, sizeof(stats));
+    LOG_VERBOSE("[Client #%d] Paced %s: %s\n", session->id, entry->name, stats);
+    replay_pacer_free(&pacer);
+    return result;
+}
+
+// Prints how much data a client received and at what average rate
+void report_client_throughput(const ClientSession *session) {
+    double elapsed_s = (GetTickCount64() - session->start_ms) / 1000.0;
+    double kb_per_s = (elapsed_s > 0.0) ? (session->bytes_sent / 1024.0) / elapsed_s : 0.0;
+    printf("[Client #%d] %s:%d received %d files, %llu bytes in %.2f s (%.1f KB/s)\n",
+           session->id, session->ip, session->port, session->files_sent,
+           (unsigned long long)session->bytes_sent, elapsed_s, kb_per_s);
+    if (session->encoding != ENCODING_TEXT && session->text_bytes > 0 && session->bytes_sent > 0) {
+        printf("[Client #%d] %s encoding: %llu bytes of text recordings sent as %llu (%.2fx smaller)\n", session->id,
+               wire_encoding_name(session->encoding), (unsigned long long)session->text_bytes,
+               (unsigned long long)session->bytes_sent, (double)session->text_bytes / session->bytes_sent);
+    }
+}
+
+// Sends a whole buffer to the client, looping over partial sends, and counts the bytes.
+// The whole call is one METRIC_SEND record (waiting on a slow client included).
+int send_all(ClientSession *session, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    uint64_t begin = metrics_begin();
+    size_t total = len;
+    while (len > 0) {
+        int sent = send(session->sock, p, (int)len, 0);
+        if (sent == SOCKET_ERROR) {
+            return -1;
+        }
+        p += sent;
+        len -= sent;
+        session->bytes_sent += sent;
+    }
+    metrics_end(METRIC_SEND, begin, total);
+    return 0;
 }
 
 // Sends configuration data (interval and mode)
-void send_config(SOCKET client_sock, int interval_ms, const char *mode) {
+int send_config(ClientSession *session, int interval_ms, const char *mode) {
     char config_str[BUFFER_SIZE];
-    snprintf(config_str, sizeof(config_str), "INTERVAL:%d\\nMODE:%s\\n", interval_ms, mode);
+    // A broadcast can't be replayed in bulk for one client, so live and broadcast modes offer
+    // only themselves, and only the encodings the hub prepares
+    snprintf(config_str, sizeof(config_str), "INTERVAL:%d\\nMODE:%s\\nENCODINGS:%s,%s%s\\nMODES:%s\\n",
+             interval_ms, mode, ENCODING_NAME_TEXT, ENCODING_NAME_ADC32, broadcast_mode ? "" : "," ENCODING_NAME_DELTA,
+             broadcast_mode ? mode : "interval," BULK_MODE_NAME);
     
     size_t config_len = strlen(config_str);
     uint32_t net_config_len = htonl(config_len); // Convert to network byte order
 
-    if (send(client_sock, (const char*)&net_config_len, CONFIG_LENGTH_BYTES, 0) == SOCKET_ERROR) {
-        fprintf(stderr, "Error sending config length: %d\n", WSAGetLastError());
-        return;
+    // Length prefix and config text go out in one write
+    char message[CONFIG_LENGTH_BYTES + BUFFER_SIZE];
+    memcpy(message, &net_config_len, CONFIG_LENGTH_BYTES);
+    memcpy(message + CONFIG_LENGTH_BYTES, config_str, config_len);
+    if (send_all(session, message, CONFIG_LENGTH_BYTES + config_len) != 0) {
+        fprintf(stderr, "Error sending config: %d\n", WSAGetLastError());
+        return -1;
     }
-    if (send(client_sock, config_str, config_len, 0) == SOCKET_ERROR) {
-        fprintf(stderr, "Error sending config data: %d\n", WSAGetLastError());
-        return;
+    printf("[Client #%d] Sent config: %s\n", session->id, config_str);
+    return 0;
+}
+
+
+// Packs filename length, filename and content length into one buffer so the
+// whole header leaves in a single write. Returns the header size, 0 if it doesn't fit.
+size_t build_file_header(char *out, size_t out_size, const char *name, uint64_t content_len) {
+    size_t name_len = strlen(name);
+    size_t header_len = FILENAME_LENGTH_BYTES + name_len + FILE_CONTENT_LENGTH_BYTES;
+    if (header_len > out_size) {
+        return 0;
     }
-    printf("Sent config: %s", config_str);
+    uint32_t net_name_len = htonl((uint32_t)name_len);
+    uint64_t net_content_len = htobe64(content_len); // Use htobe64 for 8 bytes
+    memcpy(out, &net_name_len, FILENAME_LENGTH_BYTES);
+    memcpy(out + FILENAME_LENGTH_BYTES, name, name_len);
+    memcpy(out + FILENAME_LENGTH_BYTES + name_len, &net_content_len, FILE_CONTENT_LENGTH_BYTES);
+    return header_len;
 }
 
+// Sends header + file content. With ZERO_COPY_SEND the kernel sends the header
+// and the file in one TransmitFile call without copying through user space.
+// Note: client editions of Windows run at most two TransmitFile calls at once
+// and queue the rest; server editions have no such limit.
+int send_file_content(ClientSession *session, HANDLE file, const char *header, size_t header_len, uint64_t file_content_len) {
+#if ZERO_COPY_SEND
+    if (file_content_len <= 0x7FFFFFFE) { // TransmitFile sends at most 2^31 - 2 bytes per call
+        TRANSMIT_FILE_BUFFERS head_buffers;
+        head_buffers.Head = (PVOID)header;
+        head_buffers.HeadLength = (DWORD)header_len;
+        head_buffers.Tail = NULL;
+        head_buffers.TailLength = 0;
+        if (!TransmitFile(session->sock, file, 0, 0, NULL, &head_buffers, 0)) {
+            fprintf(stderr, "TransmitFile failed: %d\n", WSAGetLastError());
+            return -1;
+        }
+        session->bytes_sent += header_len + file_content_len;
+        return 0;
+    }
+#endif
+    // Copy loop: header first, then the content in BUFFER_SIZE chunks. The header has
+    // promised file_content_len bytes, so a read error or a file that ended early (or grew)
+    // fails the send and the session is closed rather than left out of step.
+    if (send_all(session, header, header_len) != 0) {
+        fprintf(stderr, "Error sending file header: %d\n", WSAGetLastError());
+        return -1;
+    }
+    char buffer[BUFFER_SIZE];
+    uint64_t sent = 0;
+    while (sent < file_content_len) {
+        DWORD want = (file_content_len - sent < BUFFER_SIZE) ? (DWORD)(file_content_len - sent) : BUFFER_SIZE;
+        DWORD bytes_read = 0;
+        if (!ReadFile(file, buffer, want, &bytes_read, NULL)) {
+            fprintf(stderr, "Error reading file content: %lu\n", GetLastError());
+            return -1;
+        }
+        if (bytes_read == 0) {
+            fprintf(stderr, "File ended after %llu of %llu bytes.\n", (unsigned long long)sent, (unsigned long long)file_content_len);
+            return -1;
+        }
+        if (send_all(session, buffer, bytes_read) != 0) {
+            fprintf(stderr, "Error sending file content: %d\n", WSAGetLastError());
+            return -1;
+        }
+        sent += bytes_read;
+    }
+    return 0;
+}
 
 // Sends a file from a given path using length-prefixing
-void send_file_by_path(SOCKET client_sock, const char *filepath) {
-    FILE *file = fopen(filepath, "rb");
-    if (file == NULL) {
-        perror("Error opening file");
-        send_control_message(client_sock, "FILE_NOT_FOUND"); // Send a specific error to client
-        return;
+int send_file_by_path(ClientSession *session, const char *filepath) {
+    HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Error opening file %s: %lu\n", filepath, GetLastError());
+        return send_control_message(session, "FILE_NOT_FOUND"); // Send a specific error to client
     }
 
     // Get filename from path
@@ -221,69 +749,740 @@ void send_file_by_path(SOCKET client_sock, const char *filepath) {
         filename++; 
     }
 
-    size_t filename_len = strlen(filename);
-    uint32_t net_filename_len = htonl(filename_len);
-
     // Get file content length
-    fseek(file, 0, SEEK_END);
-    size_t file_content_len = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    uint64_t net_file_content_len = htobe64(file_content_len); // Use htobe64 for 8 bytes
-
-    // 1. Send filename length
-    if (send(client_sock, (const char*)&net_filename_len, FILENAME_LENGTH_BYTES, 0) == SOCKET_ERROR) {
-        fprintf(stderr, "Error sending filename length: %d\n", WSAGetLastError());
-        fclose(file);
-        return;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        fprintf(stderr, "Error getting size of %s: %lu\n", filepath, GetLastError());
+        CloseHandle(file);
+        return send_control_message(session, "FILE_NOT_FOUND");
     }
+    uint64_t file_content_len = (uint64_t)file_size.QuadPart;
 
-    // 2. Send filename
-    if (send(client_sock, filename, filename_len, 0) == SOCKET_ERROR) {
-        fprintf(stderr, "Error sending filename: %d\n", WSAGetLastError());
-        fclose(file);
-        return;
+    char header[MAX_HEADER_SIZE];
+    size_t header_len = build_file_header(header, sizeof(header), filename, file_content_len);
+    if (header_len == 0) {
+        fprintf(stderr, "Filename too long to send: %s\n", filename);
+        CloseHandle(file);
+        return 0; // Skip this file, keep the session going
     }
 
-    // 3. Send file content length
-    if (send(client_sock, (const char*)&net_file_content_len, FILE_CONTENT_LENGTH_BYTES, 0) == SOCKET_ERROR) {
-        fprintf(stderr, "Error sending file content length: %d\n", WSAGetLastError());
-        fclose(file);
-        return;
+    ULONGLONG file_start_ms = GetTickCount64();
+    if (send_file_content(session, file, header, header_len, file_content_len) != 0) {
+        CloseHandle(file);
+        return -1;
     }
 
-    // 4. Send file content in chunks
-    char buffer[BUFFER_SIZE];
-    size_t bytes_read;
-    while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, file)) > 0) {
-        if (send(client_sock, buffer, bytes_read, 0) == SOCKET_ERROR) {
-            fprintf(stderr, "Error sending file content: %d\n", WSAGetLastError());
-            fclose(file);
-            return;
+    session->files_sent++;
+    double file_s = (GetTickCount64() - file_start_ms) / 1000.0;
+    // Corrected printf format for size_t using %lu (for unsigned long, most compatible)
+    LOG_VERBOSE("[Client #%d] Sent file: %s, Size: %lu bytes (%.1f KB/s)\n", session->id, filename, (unsigned long)file_content_len,
+           (file_s > 0.0) ? (file_content_len / 1024.0) / file_s : 0.0); 
+    CloseHandle(file);
+    return 0;
+}
+
+// Sends a recording straight from its mapped view in the catalog: no open, stat or read.
+// Unpaced, header and content leave in one gathered write; paced (rate_hz > 0), the
+// content follows the header sample by sample. A resumed file (offset > 0) is sent from
+// that byte on, and skipped if the client already has all of it.
+int send_mapped_file(ClientSession *session, const CatalogEntry *entry, double rate_hz, uint64_t offset) {
+    if (offset > 0 && offset >= entry->size) {
+        return 0;
+    }
+    const char *content = entry->data + offset;
+    uint64_t content_len = entry->size - offset;
+    char header[MAX_HEADER_SIZE];
+    size_t header_len = build_file_header(header, sizeof(header), entry->name, content_len);
+    if (header_len == 0) {
+        fprintf(stderr, "Filename too long to send: %s\n", entry->name);
+        return 0; // Skip this file, keep the session going
+    }
+
+    ULONGLONG file_start_ms = GetTickCount64();
+    int failed;
+    if (rate_hz > 0.0) {
+        failed = send_all(session, header, header_len) != 0 ||
+                 send_paced_content(session, entry, entry->data, (size_t)entry->size, rate_hz, (size_t)offset) != 0;
+    } else if (content_len <= 0x7FFFFFFF) {
+        WSABUF buffers[2] = { { (ULONG)header_len, header }, { (ULONG)content_len, (char *)content } };
+        DWORD sent = 0;
+        uint64_t begin = metrics_begin();
+        failed = (WSASend(session->sock, buffers, content_len > 0 ? 2 : 1, &sent, 0, NULL, NULL) == SOCKET_ERROR);
+        if (!failed) {
+            session->bytes_sent += sent;
+            metrics_end(METRIC_SEND, begin, sent);
         }
+    } else {
+        failed = send_all(session, header, header_len) != 0 || send_all(session, content, (size_t)content_len) != 0;
+    }
+    if (failed) {
+        fprintf(stderr, "Error sending file %s: %d\n", entry->name, WSAGetLastError());
+        return -1;
     }
 
-    // Corrected printf format for size_t using %lu (for unsigned long, most compatible)
-    printf("Sent file: %s, Size: %lu bytes\n", filename, (unsigned long)file_content_len); 
-    fclose(file);
+    session->files_sent++;
+    double file_s = (GetTickCount64() - file_start_ms) / 1000.0;
+    LOG_VERBOSE("[Client #%d] Sent file: %s, Size: %lu bytes (%.1f KB/s)\n", session->id, entry->name, (unsigned long)content_len,
+           (file_s > 0.0) ? (content_len / 1024.0) / file_s : 0.0);
+    return 0;
 }
 
 // Sends a simple control message (like NO_FILE_FOUND)
-void send_control_message(SOCKET client_sock, const char *message) {
-    size_t msg_len = strlen(message);
-    uint32_t net_msg_len = htonl(msg_len);
-    uint64_t net_zero_content_len = htobe64(0); // Control messages have 0 content length
+int send_control_message(ClientSession *session, const char *message) {
+    char header[MAX_HEADER_SIZE];
+    size_t header_len = build_file_header(header, sizeof(header), message, 0); // Control messages have 0 content length
+    if (header_len == 0 || send_all(session, header, header_len) != 0) {
+        fprintf(stderr, "Error sending control message %s: %d\n", message, WSAGetLastError());
+        return -1;
+    }
+    LOG_VERBOSE("[Client #%d] Sent control message: %s\n", session->id, message);
+    return 0;
+}
+// Waits briefly for the client's encoding hello (see adc_protocol.h).
+// Clients that send nothing stay on text. Returns -1 only if the connection failed.
+int negotiate_encoding(ClientSession *session) {
+    session->encoding = ENCODING_TEXT;
 
-    if (send(client_sock, (const char*)&net_msg_len, FILENAME_LENGTH_BYTES, 0) == SOCKET_ERROR) {
-        fprintf(stderr, "Error sending control message length: %d\n", WSAGetLastError());
-        return;
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(session->sock, &readable);
+    struct timeval timeout = { NEGOTIATION_TIMEOUT_MS / 1000, (NEGOTIATION_TIMEOUT_MS % 1000) * 1000 };
+    int ready = select(0, &readable, NULL, NULL, &timeout); // First argument is ignored on Windows
+    if (ready == SOCKET_ERROR) {
+        fprintf(stderr, "select failed while negotiating encoding: %d\n", WSAGetLastError());
+        return -1;
     }
-    if (send(client_sock, message, msg_len, 0) == SOCKET_ERROR) {
-        fprintf(stderr, "Error sending control message: %d\n", WSAGetLastError());
-        return;
+    if (ready == 0) {
+        printf("[Client #%d] No encoding hello, sending text.\n", session->id);
+        return 0;
+    }
+
+    uint32_t net_hello_len;
+    if (recv(session->sock, (char *)&net_hello_len, CONFIG_LENGTH_BYTES, MSG_WAITALL) != CONFIG_LENGTH_BYTES) {
+        fprintf(stderr, "[Client #%d] Disconnected during encoding negotiation.\n", session->id);
+        return -1;
+    }
+    uint32_t hello_len = ntohl(net_hello_len);
+    char hello[512];
+    if (hello_len >= sizeof(hello)) {
+        fprintf(stderr, "[Client #%d] Encoding hello too long (%u bytes).\n", session->id, hello_len);
+        return -1;
+    }
+    if (hello_len > 0 && recv(session->sock, hello, (int)hello_len, MSG_WAITALL) != (int)hello_len) {
+        fprintf(stderr, "[Client #%d] Disconnected during encoding negotiation.\n", session->id);
+        return -1;
+    }
+    hello[hello_len] = '\0';
+    if (resume_request_parse(hello, session->resume_name, sizeof(session->resume_name), &session->resume_offset) != 0) {
+        session->resume_name[0] = '\0';
+    } else if (broadcast_mode) {
+        printf("[Client #%d] Asked to resume %s; a broadcast carries on at its newest segment.\n", session->id, session->resume_name);
+        session->resume_name[0] = '\0';
+    }
+
+    int result = 0;
+    if (strstr(hello, ENCODING_ACK_PREFIX ENCODING_NAME_ADC32) != NULL) {
+        session->encoding = ENCODING_ADC32;
+        printf("[Client #%d] Client requested binary frames.\n", session->id);
+        result = send_control_message(session, ENCODING_ACK_PREFIX ENCODING_NAME_ADC32);
+    } else if (!broadcast_mode && strstr(hello, ENCODING_ACK_PREFIX ENCODING_NAME_DELTA) != NULL) {
+        session->encoding = ENCODING_DELTA;
+        printf("[Client #%d] Client requested compressed (delta) frames.\n", session->id);
+        result = send_control_message(session, ENCODING_ACK_PREFIX ENCODING_NAME_DELTA);
+    } else {
+        printf("[Client #%d] Client hello '%s', sending text.\n", session->id, hello);
+    }
+    if (result == 0 && !broadcast_mode && strstr(hello, BULK_MODE_REQUEST) != NULL) {
+        session->bulk = 1;
+        printf("[Client #%d] Client requested bulk replay.\n", session->id);
+        result = send_control_message(session, BULK_MODE_REQUEST);
+    }
+    return result;
+}
+
+// Sends a recording as binary ADC frames (adc32 or delta) instead of raw text, from the
+// samples the catalog parsed when it indexed the file. The file header carries the framed
+// size, so the length-prefixed layout is unchanged. Paced (rate_hz > 0), the frames follow
+// the header sample by sample. A resumed file is sent from byte `offset` of its frames
+// (the encoding is deterministic), and skipped if the client already has all of it.
+int send_file_frames(ClientSession *session, const CatalogEntry *entry, int interval_ms, double rate_hz, uint64_t offset) {
+    const int32_t *samples = entry->samples;
+    size_t sample_count = entry->sample_count;
+    const char *filename = entry->name;
+    size_t header_len = FILENAME_LENGTH_BYTES + strlen(filename) + FILE_CONTENT_LENGTH_BYTES;
+    if (header_len > MAX_HEADER_SIZE) {
+        fprintf(stderr, "Filename too long to send: %s\n", filename);
+        return 0;
+    }
+
+    // Header and frames share one buffer so they leave in a single send; the header goes
+    // in front once the frames (whose delta size is only known after encoding) are there
+    int delta = (session->encoding == ENCODING_DELTA);
+    size_t room = delta ? adc_delta_max_size(sample_count) : adc_frames_size(sample_count);
+    uint8_t *message = (uint8_t *)malloc(header_len + room);
+    if (message == NULL) {
+        perror("malloc for frames");
+        return -1;
+    }
+    uint32_t sample_rate_mhz = sample_rate_mhz_from_interval(interval_ms);
+    size_t frames_len = delta ? adc_delta_encode(samples, sample_count, sample_rate_mhz, message + header_len)
+                        : adc_frames_encode(samples, sample_count, sample_rate_mhz, message + header_len);
+    if (offset > 0 && offset >= frames_len) {
+        free(message);
+        return 0;
+    }
+    size_t rest = frames_len - (size_t)offset;
+
+    int result;
+    if (rate_hz > 0.0) {
+        build_file_header((char *)message, header_len, filename, rest);
+        result = (send_all(session, message, header_len) != 0) ? -1
+                 : send_paced_content(session, entry, (const char *)message + header_len, frames_len, rate_hz, (size_t)offset);
+    } else {
+        uint8_t *start = message + offset; // The header goes right in front of the bytes still to send
+        build_file_header((char *)start, header_len, filename, rest);
+        result = send_all(session, start, header_len + rest);
+    }
+    free(message);
+    if (result != 0) {
+        fprintf(stderr, "Error sending frames: %d\n", WSAGetLastError());
+        return -1;
+    }
+    session->files_sent++;
+    session->text_bytes += entry->size;
+    LOG_VERBOSE("[Client #%d] Sent file: %s, %lu samples in %lu bytes (text was %lu bytes)\n", session->id, filename,
+           (unsigned long)sample_count, (unsigned long)rest, (unsigned long)entry->size);
+    return 0;
+}
+
+// Bulk replay (MODE:bulk): every file back to back, no pacing and no gaps. A reader thread
+// prepares file N+1 while this thread sends file N; the stage times go to the client as a
+// BULK_STATS control message at the end. A resumed session starts at file `first`, byte
+// first_offset. Returns -1 if the client stopped receiving.
+int send_files_bulk(ClientSession *session, const CatalogSnapshot *snapshot, int interval_ms, int first, uint64_t first_offset) {
+    BulkPipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.session = session;
+    pipeline.snapshot = snapshot;
+    pipeline.interval_ms = interval_ms;
+    pipeline.first = first;
+    pipeline.first_offset = first_offset;
+    pipeline.filled = CreateSemaphore(NULL, 0, BULK_SLOTS, NULL);
+    pipeline.emptied = CreateSemaphore(NULL, BULK_SLOTS, BULK_SLOTS, NULL);
+    HANDLE reader = (pipeline.filled && pipeline.emptied)
+                    ? CreateThread(NULL, 0, bulk_reader_thread, &pipeline, 0, NULL) : NULL;
+    if (reader == NULL) {
+        fprintf(stderr, "Error starting bulk reader: %lu\n", GetLastError());
+        if (pipeline.filled) CloseHandle(pipeline.filled);
+        if (pipeline.emptied) CloseHandle(pipeline.emptied);
+        return -1;
+    }
+
+    BulkStats stats;
+    memset(&stats, 0, sizeof(stats));
+    double start = bulk_now();
+    int result = 0;
+    for (int i = first; i < snapshot->count; i++) {
+        WaitForSingleObject(pipeline.filled, INFINITE);
+        metrics_record(METRIC_QUEUE_DEPTH, (uint64_t)(pipeline.prepared - (i - first)), 0); // Files ready, this one included
+        BulkSlot *slot = &pipeline.slots[i % BULK_SLOTS];
+        if (slot->header_len > 0) {
+            double t = bulk_now();
+            result = (send_all(session, slot->header, slot->header_len) != 0 ||
+                      send_all(session, slot->content, slot->content_len) != 0) ? -1 : 0;
+            bulk_stage_end(&stats, BULK_STAGE_SEND, t);
+            if (result != 0) {
+                fprintf(stderr, "Error sending file %s: %d\n", slot->entry->name, WSAGetLastError());
+                break;
+            }
+            session->files_sent++;
+            session->text_bytes += slot->entry->size;
+            stats.files++;
+            stats.bytes += slot->content_len;
+            stats.samples += slot->entry->sample_count;
+        }
+        free(slot->owned);
+        slot->owned = NULL;
+        ReleaseSemaphore(pipeline.emptied, 1, NULL);
+    }
+    if (result != 0) {
+        InterlockedExchange(&pipeline.stop, 1);
+        ReleaseSemaphore(pipeline.emptied, BULK_SLOTS, NULL); // Wake the reader if it waits for a slot
+    }
+    WaitForSingleObject(reader, INFINITE);
+    CloseHandle(reader);
+    for (int s = 0; s < BULK_SLOTS; s++) {
+        free(pipeline.slots[s].owned); // Prepared but never sent
+    }
+    CloseHandle(pipeline.filled);
+    CloseHandle(pipeline.emptied);
+    if (result != 0) {
+        return -1;
+    }
+
+    stats.wall_s = bulk_now() - start;
+    stats.stage_s[BULK_STAGE_READ] = pipeline.read_s;
+    char message[MAX_HEADER_SIZE - FILENAME_LENGTH_BYTES - FILE_CONTENT_LENGTH_BYTES];
+    int len = snprintf(message, sizeof(message), "%s", BULK_STATS_PREFIX);
+    bulk_stats_format(&stats, ',', message + len, sizeof(message) - (size_t)len);
+    printf("[Client #%d] Bulk replay: %llu files, %llu bytes in %.3f s (read %.3f s, send %.3f s)\n", session->id,
+           (unsigned long long)stats.files, (unsigned long long)stats.bytes, stats.wall_s,
+           stats.stage_s[BULK_STAGE_READ], stats.stage_s[BULK_STAGE_SEND]);
+    return send_control_message(session, message);
+}
+
+// Bulk replay reader: prepares each file of the snapshot in turn, at most BULK_SLOTS ahead
+DWORD WINAPI bulk_reader_thread(LPVOID lpParam) {
+    BulkPipeline *pipeline = (BulkPipeline *)lpParam;
+    for (int i = pipeline->first; i < pipeline->snapshot->count; i++) {
+        WaitForSingleObject(pipeline->emptied, INFINITE);
+        if (pipeline->stop) {
+            break;
+        }
+        double t = bulk_now();
+        bulk_prepare_slot(&pipeline->slots[i % BULK_SLOTS], pipeline->snapshot->entries[i], pipeline->session->encoding,
+                          pipeline->interval_ms, (i == pipeline->first) ? pipeline->first_offset : 0);
+        pipeline->read_s += bulk_now() - t;
+        InterlockedIncrement(&pipeline->prepared);
+        ReleaseSemaphore(pipeline->filled, 1, NULL);
+    }
+    metrics_thread_exit();
+    return 0;
+}
+
+// Builds a file's header and content for the bulk sender. Text is sent from the mapped view,
+// which is touched page by page here so the sender never waits on a page fault; binary
+// frames are encoded into a new buffer. A resumed file's content starts at byte `offset`.
+// Returns 0, or -1 if the file has to be skipped (also when the client has all of it).
+int bulk_prepare_slot(BulkSlot *slot, const CatalogEntry *entry, WireEncoding encoding, int interval_ms, uint64_t offset) {
+    slot->entry = entry;
+    slot->owned = NULL;
+    slot->content = entry->data;
+    slot->content_len = (size_t)entry->size;
+    if (encoding != ENCODING_TEXT) {
+        int delta = (encoding == ENCODING_DELTA);
+        size_t room = delta ? adc_delta_max_size(entry->sample_count) : adc_frames_size(entry->sample_count);
+        slot->owned = (uint8_t *)malloc(room > 0 ? room : 1);
+        if (slot->owned == NULL) {
+            perror("malloc for frames");
+            slot->header_len = 0;
+            return -1;
+        }
+        uint32_t sample_rate_mhz = sample_rate_mhz_from_interval(interval_ms);
+        slot->content_len = delta ? adc_delta_encode(entry->samples, entry->sample_count, sample_rate_mhz, slot->owned)
+                            : adc_frames_encode(entry->samples, entry->sample_count, sample_rate_mhz, slot->owned);
+        slot->content = (const char *)slot->owned;
+    }
+    if (offset > 0 && offset >= slot->content_len) {
+        slot->header_len = 0;
+        return -1;
+    }
+    slot->content += offset;
+    slot->content_len -= (size_t)offset;
+    if (encoding == ENCODING_TEXT) {
+        volatile char sink = 0;
+        for (size_t page = 0; page < slot->content_len; page += 4096) {
+            sink ^= slot->content[page];
+        }
+        (void)sink;
+    }
+    slot->header_len = build_file_header(slot->header, sizeof(slot->header), entry->name, slot->content_len);
+    if (slot->header_len == 0) {
+        fprintf(stderr, "Filename too long to send: %s\n", entry->name);
+        return -1;
+    }
+    return 0;
+}
+
+// Broadcast sessions (live and broadcast modes): the client subscribes to the hub and is
+// sent each segment from the hub's shared buffers as it fills, header first, so clients
+// read segments exactly like the files of a paced replay. Under SLOW_CLIENT_POLICY a
+// client that falls behind either skips segments (counted) or is disconnected.
+// Returns 0 once the publisher stopped, 1 if it stopped mid-segment or the client was too
+// slow (the connection just ends), -1 if the client failed.
+int send_broadcast(ClientSession *session) {
+    BroadcastSubscriber sub;
+    broadcast_subscribe(&sub, session->encoding);
+    int result = 0;
+    int started = 0;            // A segment was begun; BEGIN and STOPPED come only after it was sent whole
+    while (1) {
+        const uint8_t *data = NULL;
+        size_t len = 0;
+        BroadcastEvent event = broadcast_next(&hub, &sub, &data, &len, BROADCAST_WAIT_MS);
+        if (event == BROADCAST_BEGIN) {
+            session->files_sent += started;
+            started = 1;
+            char header[MAX_HEADER_SIZE];
+            size_t header_len = build_file_header(header, sizeof(header), sub.segment->name, sub.segment->length[sub.encoding]);
+            LOG_VERBOSE("[Client #%d] Sending segment: %s\n", session->id, sub.segment->name);
+            if (header_len == 0 || send_all(session, header, header_len) != 0) {
+                result = -1;
+                break;
+            }
+        } else if (event == BROADCAST_DATA) {
+            metrics_record(METRIC_QUEUE_DEPTH, len, 0);
+            if (send_all(session, data, len) != 0) {
+                result = -1;
+                break;
+            }
+        } else if (event == BROADCAST_SLOW) {
+            printf("[Client #%d] Too far behind the broadcast, disconnecting.\n", session->id);
+            result = 1;
+            break;
+        } else if (event == BROADCAST_CUT) {
+            result = 1;
+            break;
+        } else if (event == BROADCAST_STOPPED) {
+            session->files_sent += started;
+            break;
+        }
     }
-    if (send(client_sock, (const char*)&net_zero_content_len, FILE_CONTENT_LENGTH_BYTES, 0) == SOCKET_ERROR) {
-        fprintf(stderr, "Error sending zero content length for control message: %d\n", WSAGetLastError());
+    broadcast_unsubscribe(&sub);
+    printf("[Client #%d] Broadcast: %d segments, %llu skipped while behind.\n", session->id, session->files_sent,
+           (unsigned long long)sub.dropped);
+    return result;
+}
+
+// Starts `count` fan-out loops (0 = one per logical processor), each on its own thread.
+// Live and broadcast clients are handed to them after the negotiation, so any number of
+// clients are served by a few threads, every send straight from the hub's buffers with
+// FANOUT_SENDS_PER_CLIENT outstanding per client. Returns the loops started; with none,
+// each client keeps its own thread (send_broadcast()).
+int fanout_start(int count) {
+    if (count <= 0) {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        count = (info.dwNumberOfProcessors > 0) ? (int)info.dwNumberOfProcessors : 1;
+    }
+    fanout_loops = (FanoutLoop *)calloc((size_t)count, sizeof(FanoutLoop));
+    if (fanout_loops == NULL) {
+        perror("Failed to allocate fan-out loops");
+        return 0;
+    }
+    int started = 0;
+    while (started < count) {
+        FanoutLoop *fanout = &fanout_loops[started];
+        if (async_loop_init(&fanout->loop) != 0) {
+            break;
+        }
+        InitializeCriticalSection(&fanout->lock);
+        HANDLE thread = CreateThread(NULL, 0, fanout_thread, fanout, 0, NULL);
+        if (thread == NULL) {
+            fprintf(stderr, "Error creating fan-out thread: %lu\n", GetLastError());
+            DeleteCriticalSection(&fanout->lock);
+            async_loop_close(&fanout->loop);
+            break;
+        }
+        CloseHandle(thread);
+        started++;
+    }
+    InterlockedExchange(&fanout_loop_count, started);
+    if (started > 0) {
+        printf("Serving live/broadcast clients from %d event loops (up to %d clients).\n", started, FANOUT_MAX_CLIENTS);
+    }
+    return started;
+}
+
+// The hub's notify hook: every loop looks for new data
+void fanout_notify(void *ctx) {
+    (void)ctx;
+    for (LONG i = 0; i < fanout_loop_count; i++) {
+        fanout_wake(&fanout_loops[i]);
+    }
+}
+
+// Wakes a loop; wakes that come while one is pending are merged into it
+void fanout_wake(FanoutLoop *fanout) {
+    if (InterlockedExchange(&fanout->wake_posted, 1) == 0 && async_post(&fanout->loop, &fanout->wake, 0, fanout_woken, fanout) != 0) {
+        InterlockedExchange(&fanout->wake_posted, 0); // The loop still looks every BROADCAST_WAIT_MS
+    }
+}
+
+void fanout_woken(AsyncOp *op, long result) {
+    (void)result;
+    InterlockedExchange(&((FanoutLoop *)op->ctx)->wake_posted, 0);
+}
+
+// Gives a negotiated live/broadcast session to the next loop. Returns 0, or -1 if it
+// couldn't be (the caller then serves it on its own thread).
+int fanout_hand_over(ClientSession *session) {
+    FanoutClient *client = (FanoutClient *)calloc(1, sizeof(FanoutClient));
+    if (client == NULL) {
+        perror("Failed to allocate fan-out client");
+        return -1;
+    }
+    client->session = session;
+    broadcast_subscribe(&client->sub, session->encoding);
+    FanoutLoop *fanout = &fanout_loops[(ULONG)(InterlockedIncrement(&fanout_next) - 1) % (ULONG)fanout_loop_count];
+    EnterCriticalSection(&fanout->lock);
+    client->next = fanout->handed_over;
+    fanout->handed_over = client;
+    LeaveCriticalSection(&fanout->lock);
+    fanout_wake(fanout);
+    LOG_VERBOSE("[Client #%d] Handed over to event loop %d.\n", session->id, (int)(fanout - fanout_loops));
+    return 0;
+}
+
+// A fan-out loop: runs the send completions, then gives every client what the hub has
+// for it, and ends the sessions that are done
+DWORD WINAPI fanout_thread(LPVOID param) {
+    FanoutLoop *fanout = (FanoutLoop *)param;
+    while (1) {
+        if (async_loop_run(&fanout->loop, BROADCAST_WAIT_MS) < 0) {
+            fprintf(stderr, "Fan-out loop wait failed: %lu\n", GetLastError());
+            Sleep(BROADCAST_WAIT_MS);
+        }
+
+        EnterCriticalSection(&fanout->lock);
+        FanoutClient *arrived = fanout->handed_over;
+        fanout->handed_over = NULL;
+        LeaveCriticalSection(&fanout->lock);
+        while (arrived != NULL) {
+            FanoutClient *client = arrived;
+            arrived = client->next;
+            if (async_attach(&fanout->loop, &client->channel, client->session->sock) != 0) {
+                client->ending = 1;
+                client->result = -1;
+            }
+            client->next = fanout->clients;
+            fanout->clients = client;
+        }
+
+        FanoutClient **link = &fanout->clients;
+        while (*link != NULL) {
+            FanoutClient *client = *link;
+            if (fanout_pump(client)) {
+                *link = client->next;
+                fanout_finish(client);
+            } else {
+                link = &client->next;
+            }
+        }
+    }
+    return 0;
+}
+
+// Starts as many of the client's sends as FANOUT_SENDS_PER_CLIENT allows, with the events
+// send_broadcast() handles. Returns 1 once the session is over: nothing more to send and
+// nothing in flight.
+int fanout_pump(FanoutClient *client) {
+    ClientSession *session = client->session;
+    BroadcastSubscriber *sub = &client->sub;
+    while (!client->ending && client->in_flight < FANOUT_SENDS_PER_CLIENT) {
+        const uint8_t *data = NULL;
+        size_t len = 0;
+        BroadcastEvent event = broadcast_next(&hub, sub, &data, &len, 0);
+        if (event == BROADCAST_IDLE) {
+            break;
+        }
+        char header[MAX_HEADER_SIZE];
+        size_t header_len;
+        if (event == BROADCAST_BEGIN) {
+            session->files_sent += client->started;
+            client->started = 1;
+            header_len = build_file_header(header, sizeof(header), sub->segment->name, sub->segment->length[sub->encoding]);
+            LOG_VERBOSE("[Client #%d] Sending segment: %s\n", session->id, sub->segment->name);
+            if (header_len == 0 || fanout_send(client, NULL, header, header_len) != 0) {
+                client->result = -1;
+                client->ending = 1;
+            }
+        } else if (event == BROADCAST_DATA) {
+            metrics_record(METRIC_QUEUE_DEPTH, len, 0);
+            if (fanout_send(client, sub->segment, data, len) != 0) {
+                client->result = -1;
+                client->ending = 1;
+            }
+        } else if (event == BROADCAST_SLOW) {
+            printf("[Client #%d] Too far behind the broadcast, disconnecting.\n", session->id);
+            client->result = 1;
+            client->ending = 1;
+        } else if (event == BROADCAST_CUT) {
+            client->result = 1;
+            client->ending = 1;
+        } else if (event == BROADCAST_STOPPED) {
+            session->files_sent += client->started;
+            client->ending = 1;
+            header_len = build_file_header(header, sizeof(header), "END_OF_TRANSMISSION", 0);
+            client->result = fanout_send(client, NULL, header, header_len);
+        }
+    }
+    return client->ending && client->in_flight == 0;
+}
+
+// Starts sending len bytes: a header (segment NULL; copied into the send) or a piece of
+// segment, which stays referenced until the bytes are gone. Returns 0, or -1.
+int fanout_send(FanoutClient *client, BroadcastSegment *segment, const void *data, size_t len) {
+    FanoutSend *out = NULL;
+    for (int i = 0; i < FANOUT_SENDS_PER_CLIENT && out == NULL; i++) {
+        if (!client->sends[i].busy) out = &client->sends[i];
+    }
+    if (out == NULL || (segment == NULL && len > sizeof(out->header))) {
+        return -1;
+    }
+    if (segment == NULL) {
+        memcpy(out->header, data, len);
+        data = out->header;
+    } else {
+        atomic_fetch_add(&segment->refs, 1);
+    }
+    out->client = client;
+    out->segment = segment;
+    out->begin = metrics_begin();
+    if (async_send(&client->channel, &out->op, data, len, fanout_sent, out) != 0) {
+        broadcast_segment_release(segment);
+        out->segment = NULL;
+        return -1;
+    }
+    out->busy = 1;
+    client->in_flight++;
+    return 0;
+}
+
+// Completion of a fan-out send. A failed one ends the session, and the client's other
+// sends are cancelled.
+void fanout_sent(AsyncOp *op, long result) {
+    FanoutSend *out = (FanoutSend *)op->ctx;
+    FanoutClient *client = out->client;
+    broadcast_segment_release(out->segment);
+    out->segment = NULL;
+    out->busy = 0;
+    client->in_flight--;
+    if (result < 0) {
+        if (client->result >= 0) async_cancel(&client->channel);
+        client->result = -1;
+        client->ending = 1;
         return;
     }
-    printf("Sent control message: %s\n", message);
-}
\ No newline at end of file
+    client->session->bytes_sent += (uint64_t)result;
+    metrics_end(METRIC_SEND, out->begin, (uint64_t)result);
+}
+
+// Ends a fan-out client's session, with send_broadcast()'s messages
+void fanout_finish(FanoutClient *client) {
+    ClientSession *session = client->session;
+    broadcast_unsubscribe(&client->sub);
+    printf("[Client #%d] Broadcast: %d segments, %llu skipped while behind.\n", session->id, session->files_sent,
+           (unsigned long long)client->sub.dropped);
+    if (client->result < 0) {
+        printf("[Client #%d] Client stopped receiving, ending session.\n", session->id);
+    } else if (client->result == 0) {
+        printf("[Client #%d] Broadcast ended.\n", session->id);
+    }
+    async_detach(&client->channel);
+    free(client);
+    end_client_session(session);
+}
+
+// Tap for the hub: every published sample also goes to MULTICAST_GROUP, as one adc32 frame
+// (up to ADC_FRAME_SAMPLES samples, not padded) per datagram. Frame sequence numbers run
+// on across datagrams, so a receiver can tell how many it lost.
+void multicast_samples(const int32_t *samples, int count, uint32_t sample_rate_mhz, void *ctx) {
+    (void)ctx;
+    uint8_t datagram[ADC_FRAME_BYTES];
+    for (int done = 0; done < count; done += ADC_FRAME_SAMPLES) {
+        int n = (count - done < ADC_FRAME_SAMPLES) ? count - done : ADC_FRAME_SAMPLES;
+        adc_frame_put_header(datagram, multicast_sequence++, sample_rate_mhz, (uint16_t)n);
+        for (int i = 0; i < n; i++) {
+            put_le32(datagram + ADC_FRAME_HEADER_BYTES + i * 4, (uint32_t)samples[done + i]);
+        }
+        sendto(multicast_sock, (const char *)datagram, ADC_FRAME_HEADER_BYTES + n * 4, 0,
+               (const struct sockaddr *)&multicast_addr, sizeof(multicast_addr));
+    }
+}
+
+// Opens the UDP socket for multicast_samples(). Returns 0, or -1 with the reason printed.
+int multicast_open(const char *group) {
+    multicast_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (multicast_sock == INVALID_SOCKET) {
+        fprintf(stderr, "Error creating multicast socket: %d\n", WSAGetLastError());
+        return -1;
+    }
+    DWORD ttl = MULTICAST_TTL;
+    setsockopt(multicast_sock, IPPROTO_IP, IP_MULTICAST_TTL, (const char *)&ttl, sizeof(ttl));
+    memset(&multicast_addr, 0, sizeof(multicast_addr));
+    multicast_addr.sin_family = AF_INET;
+    multicast_addr.sin_port = htons(MULTICAST_PORT);
+    multicast_addr.sin_addr.s_addr = inet_addr(group);
+    if (multicast_addr.sin_addr.s_addr == INADDR_NONE) {
+        fprintf(stderr, "Invalid multicast group '%s'\n", group);
+        closesocket(multicast_sock);
+        multicast_sock = INVALID_SOCKET;
+        return -1;
+    }
+    printf("Also multicasting samples to %s:%d.\n", group, MULTICAST_PORT);
+    return 0;
+}
+
+// A recording published to the hub: the text is the catalog's mapped view, and the adc32
+// frames are encoded once (after the struct) for every subscriber
+typedef struct {
+    BroadcastSegment segment;
+    CatalogEntry *entry;        // Reference held until the last subscriber is done
+} ReplaySegment;
+
+void replay_segment_free(BroadcastSegment *segment) {
+    catalog_entry_release(((ReplaySegment *)segment)->entry);
+    free(segment);
+}
+
+// Publishes one recording to the hub at its sample rate (times replay_speedup). Returns
+// 0, or -1 if it couldn't be prepared.
+int broadcast_replay_file(CatalogEntry *entry, int interval_ms) {
+    size_t frames_len = adc_frames_size(entry->sample_count);
+    ReplaySegment *replay = (ReplaySegment *)calloc(1, sizeof(ReplaySegment) + frames_len);
+    if (replay == NULL) {
+        perror("malloc for broadcast segment");
+        return -1;
+    }
+    InterlockedIncrement(&entry->refs);
+    replay->entry = entry;
+    BroadcastSegment *segment = &replay->segment;
+    uint8_t *frames = (uint8_t *)(replay + 1);
+    uint32_t sample_rate_mhz = sample_rate_mhz_from_interval(interval_ms);
+    atomic_init(&segment->refs, 1);
+    snprintf(segment->name, sizeof(segment->name), "%s", entry->name);
+    segment->length[ENCODING_TEXT] = (size_t)entry->size;
+    segment->length[ENCODING_ADC32] = frames_len;
+    segment->content[ENCODING_TEXT] = (const uint8_t *)entry->data;
+    segment->content[ENCODING_ADC32] = frames;
+    segment->free_fn = replay_segment_free;
+    adc_frames_encode(entry->samples, entry->sample_count, sample_rate_mhz, frames);
+    broadcast_publish(&hub, segment);
+
+    ReplayPacer pacer;
+    if (entry->sample_count > 0 && replay_pacer_init(&pacer, replay_rate_hz(entry, interval_ms)) == 0) {
+        replay_pacer_start(&pacer);
+        size_t next = 0, text_ready = 0;
+        while (next < entry->sample_count) {
+            size_t n = replay_pacer_wait(&pacer, next, entry->sample_count);
+            broadcast_samples(&hub, entry->samples + next, (int)n, sample_rate_mhz);
+            text_ready = catalog_text_offset(entry->data, (size_t)entry->size, text_ready, n);
+            next += n;
+            broadcast_advance(&hub, segment, text_ready, adc_frames_offset(next));
+        }
+        replay_pacer_free(&pacer);
+    }
+    broadcast_advance(&hub, segment, segment->length[ENCODING_TEXT], frames_len); // Lines after the last sample
+    return 0;
+}
+
+// Broadcast mode's publisher: the catalog, file after file, round and round (picking up
+// folder changes at the start of each round)
+DWORD WINAPI broadcast_replay_thread(LPVOID param) {
+    (void)param;
+    int interval_ms = 20; // Default interval, as for sessions
+    while (1) {
+        CatalogSnapshot *snapshot = catalog_acquire(&catalog);
+        if (snapshot->count == 0) {
+            catalog_snapshot_release(snapshot);
+            Sleep(1000);
+            continue;
+        }
+        for (int i = 0; i < snapshot->count; i++) {
+            LOG_VERBOSE("Broadcasting file: %s\n", snapshot->entries[i]->name);
+            broadcast_replay_file(snapshot->entries[i], interval_ms);
+        }
+        catalog_snapshot_release(snapshot);
+    }
+    return 0;
+}
@@ -0,0 +1,285 @@
+// Binary column archive for one processed recording (output_data/all_data_<file>.bin), or
+// for one load cell of a multi-channel recording (all_data_<file>.ch<n>.bin).
+// Replaces formatting every weight with fprintf: the values are written as they are in
+// memory, one fwrite per column, so a 70k-sample file costs a few hundred KiB of I/O.
+//
+// Layout (little-endian, the byte order of every host these tools run on):
+//   ArchiveHeader          256 bytes: magic, calibration, sample rate, sizes
+//   ArchiveColumnEntry[]   column_count entries of 64 bytes: name, type, count, offset
+//   column data            each column starts at a multiple of ARCHIVE_ALIGN bytes
+//
+// Every offset is from the start of the file, so a reader can read or mmap the whole file
+// and use the columns in place (archive_find_column() does the bounds checks). Columns of
+// an archive written here: "fir_coefficients", "raw_weight", "filtered_weight", and when
+// a spectrum was computed "fft_frequency_hz" and "fft_magnitude".
+//
+// archive_write() takes whole columns; an ArchiveStream builds the same file block by block
+// as samples arrive (the clients' streaming receive path), with the counts filled in at the end.
+#ifndef WEIGHT_ARCHIVE_H
+#define WEIGHT_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARCHIVE_MAGIC "LCARCH1"         // 8 bytes with the terminator
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BYTE_ORDER 0x01020304u  // Reads back as 0x04030201 on a host of the other endianness
+#define ARCHIVE_ALIGN 64                // Column data alignment (a cache line; fine for SIMD loads)
+#define ARCHIVE_NAME_BYTES 32
+#define ARCHIVE_MAX_COLUMNS 16
+#define ARCHIVE_WRITE_BUFFER (1 << 20)  // stdio buffer for the header, directory and padding
+#define ARCHIVE_COPY_BYTES (1 << 16)    // Chunk a spilled stream column is copied into the archive in
+
+typedef enum {
+    ARCHIVE_F32 = 1,
+    ARCHIVE_F64 = 2
+} ArchiveType;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;        // ARCHIVE_BYTE_ORDER as the writer saw it
+    uint32_t header_bytes;      // sizeof(ArchiveHeader)
+    uint32_t column_count;
+    uint64_t sample_count;      // Length of the weight columns
+    double sample_rate_hz;
+    double zero_cal;            // Calibration used for normalize_to_weight()
+    double scale_cal;
+    uint32_t fir_taps;          // Length of the fir_coefficients column
+    uint32_t fft_size;          // FFT window the spectrum columns came from (0 = none)
+    char source_name[192];      // Recording the archive was made from
+} ArchiveHeader;
+
+typedef struct {
+    char name[ARCHIVE_NAME_BYTES];
+    uint32_t type;              // ArchiveType
+    uint32_t element_bytes;     // 4 or 8
+    uint64_t count;             // Values in the column
+    uint64_t offset;            // File offset of the first value (multiple of ARCHIVE_ALIGN)
+    uint64_t reserved;
+} ArchiveColumnEntry;
+
+_Static_assert(sizeof(ArchiveHeader) == 256, "ArchiveHeader is a fixed on-disk layout");
+_Static_assert(sizeof(ArchiveColumnEntry) == 64, "ArchiveColumnEntry is a fixed on-disk layout");
+
+// One column to write; data holds count values of the given type
+typedef struct {
+    const char *name;
+    ArchiveType type;
+    const void *data;
+    uint64_t count;
+} ArchiveColumn;
+
+static inline size_t archive_type_bytes(ArchiveType type) {
+    return (type == ARCHIVE_F32) ? 4 : 8;
+}
+
+static inline uint64_t archive_align(uint64_t offset) {
+    return (offset + ARCHIVE_ALIGN - 1) / ARCHIVE_ALIGN * ARCHIVE_ALIGN;
+}
+
+// Fills in everything but the sizes, which the caller sets (sample_count, fir_taps, fft_size)
+static inline void archive_header_init(ArchiveHeader *header, const char *source_name, double sample_rate_hz,
+                                       double zero_cal, double scale_cal) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, ARCHIVE_MAGIC, sizeof(header->magic));
+    header->version = ARCHIVE_VERSION;
+    header->byte_order = ARCHIVE_BYTE_ORDER;
+    header->header_bytes = sizeof(ArchiveHeader);
+    header->sample_rate_hz = sample_rate_hz;
+    header->zero_cal = zero_cal;
+    header->scale_cal = scale_cal;
+    snprintf(header->source_name, sizeof(header->source_name), "%s", source_name);
+}
+
+// Writes header, column directory and columns to path. Returns 0, or -1 (errno set by stdio).
+static inline int archive_write(const char *path, ArchiveHeader *header, const ArchiveColumn *columns, int column_count) {
+    if (column_count < 0 || column_count > ARCHIVE_MAX_COLUMNS) return -1;
+    ArchiveColumnEntry entries[ARCHIVE_MAX_COLUMNS];
+    memset(entries, 0, sizeof(entries));
+    header->column_count = (uint32_t)column_count;
+    uint64_t offset = sizeof(ArchiveHeader) + (uint64_t)column_count * sizeof(ArchiveColumnEntry);
+    for (int c = 0; c < column_count; c++) {
+        snprintf(entries[c].name, sizeof(entries[c].name), "%s", columns[c].name);
+        entries[c].type = (uint32_t)columns[c].type;
+        entries[c].element_bytes = (uint32_t)archive_type_bytes(columns[c].type);
+        entries[c].count = columns[c].count;
+        entries[c].offset = archive_align(offset);
+        offset = entries[c].offset + entries[c].count * entries[c].element_bytes;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return -1;
+    char *buffer = (char *)malloc(ARCHIVE_WRITE_BUFFER);
+    if (buffer) setvbuf(fp, buffer, _IOFBF, ARCHIVE_WRITE_BUFFER);
+
+    static const char zeros[ARCHIVE_ALIGN] = {0};
+    int ok = fwrite(header, sizeof(*header), 1, fp) == 1 &&
+             (column_count == 0 || fwrite(entries, sizeof(ArchiveColumnEntry), (size_t)column_count, fp) == (size_t)column_count);
+    uint64_t written = sizeof(ArchiveHeader) + (uint64_t)column_count * sizeof(ArchiveColumnEntry);
+    for (int c = 0; ok && c < column_count; c++) {
+        size_t pad = (size_t)(entries[c].offset - written);
+        size_t bytes = (size_t)(entries[c].count * entries[c].element_bytes);
+        ok = (pad == 0 || fwrite(zeros, 1, pad, fp) == pad) &&
+             (bytes == 0 || fwrite(columns[c].data, 1, bytes, fp) == bytes); // Large writes bypass the buffer
+        written = entries[c].offset + bytes;
+    }
+    if (fclose(fp) != 0) ok = 0;
+    free(buffer);
+    return ok ? 0 : -1;
+}
+
+// An archive written while its samples arrive, when the sample count is only known at the
+// end. Streamed columns are F64. The first goes straight into the file after room for the
+// header and a full directory; the others go to spill files beside it (<path>.<n>.tmp),
+// copied in after it by archive_stream_finish(), which then writes the columns only known
+// at the end (coefficients, spectrum) and last the header and directory with the real counts.
+typedef struct {
+    FILE *file;                 // NULL = not open
+    FILE *spill[ARCHIVE_MAX_COLUMNS]; // Streamed columns after the first, until the finish
+    char path[512];
+    char names[ARCHIVE_MAX_COLUMNS][ARCHIVE_NAME_BYTES];
+    int column_count;           // Streamed columns
+    uint64_t count;             // Values in each of them so far
+    int failed;                 // A write failed; the finish reports it
+} ArchiveStream;
+
+// Where the first streamed column starts: past the header and a directory of ARCHIVE_MAX_COLUMNS entries
+#define ARCHIVE_STREAM_DATA_OFFSET archive_align(sizeof(ArchiveHeader) + ARCHIVE_MAX_COLUMNS * sizeof(ArchiveColumnEntry))
+
+static inline void archive_spill_path(char *out, size_t size, const char *path, int column) {
+    snprintf(out, size, "%s.%d.tmp", path, column);
+}
+
+// Closes and deletes the spill files
+static inline void archive_stream_drop_spills(ArchiveStream *stream) {
+    char spill_path[sizeof(stream->path) + 16];
+    for (int c = 1; c < stream->column_count; c++) {
+        if (stream->spill[c] == NULL) continue;
+        fclose(stream->spill[c]);
+        stream->spill[c] = NULL;
+        archive_spill_path(spill_path, sizeof(spill_path), stream->path, c);
+        remove(spill_path);
+    }
+}
+
+// Opens path for column_count streamed columns named names. Returns 0, or -1 (errno set
+// by stdio) with nothing left open.
+static inline int archive_stream_open(ArchiveStream *stream, const char *path, const char *const *names, int column_count) {
+    memset(stream, 0, sizeof(*stream));
+    if (column_count < 1 || column_count > ARCHIVE_MAX_COLUMNS) return -1;
+    snprintf(stream->path, sizeof(stream->path), "%s", path);
+    stream->column_count = column_count;
+    for (int c = 0; c < column_count; c++) {
+        snprintf(stream->names[c], sizeof(stream->names[c]), "%s", names[c]);
+    }
+    FILE *fp = fopen(stream->path, "wb");
+    if (fp == NULL) return -1;
+    static const char zeros[ARCHIVE_ALIGN] = {0};
+    int ok = 1;
+    for (uint64_t n = 0; ok && n < ARCHIVE_STREAM_DATA_OFFSET; n += ARCHIVE_ALIGN) { // Header and directory go here at the end
+        ok = fwrite(zeros, 1, ARCHIVE_ALIGN, fp) == ARCHIVE_ALIGN;
+    }
+    char spill_path[sizeof(stream->path) + 16];
+    for (int c = 1; ok && c < column_count; c++) {
+        archive_spill_path(spill_path, sizeof(spill_path), stream->path, c);
+        stream->spill[c] = fopen(spill_path, "w+b");
+        ok = (stream->spill[c] != NULL);
+    }
+    if (!ok) {
+        archive_stream_drop_spills(stream);
+        fclose(fp);
+        remove(stream->path);
+        return -1;
+    }
+    stream->file = fp;
+    return 0;
+}
+
+// Appends count values to every streamed column (columns[c] for column c)
+static inline void archive_stream_append(ArchiveStream *stream, const double *const *columns, size_t count) {
+    if (stream->file == NULL || count == 0) return;
+    for (int c = 0; c < stream->column_count; c++) {
+        FILE *fp = (c == 0) ? stream->file : stream->spill[c];
+        if (fwrite(columns[c], sizeof(double), count, fp) != count) stream->failed = 1;
+    }
+    stream->count += count;
+}
+
+// Completes an open stream: the spilled columns are copied in, the extra columns written
+// whole after them, then the header (sample_count set here) and directory at the front.
+// The stream is closed either way; returns 0, or -1 if a write failed.
+static inline int archive_stream_finish(ArchiveStream *stream, ArchiveHeader *header, const ArchiveColumn *extra, int extra_count) {
+    if (stream->file == NULL) return -1;
+    int column_count = stream->column_count + extra_count;
+    int ok = !stream->failed && extra_count >= 0 && column_count <= ARCHIVE_MAX_COLUMNS;
+    if (!ok) column_count = stream->column_count;
+    ArchiveColumnEntry entries[ARCHIVE_MAX_COLUMNS];
+    memset(entries, 0, sizeof(entries));
+    static const char zeros[ARCHIVE_ALIGN] = {0};
+    char chunk[ARCHIVE_COPY_BYTES];
+    uint64_t written = ARCHIVE_STREAM_DATA_OFFSET;
+    for (int c = 0; c < column_count; c++) {
+        int streamed = (c < stream->column_count);
+        const ArchiveColumn *column = streamed ? NULL : &extra[c - stream->column_count];
+        snprintf(entries[c].name, sizeof(entries[c].name), "%s", streamed ? stream->names[c] : column->name);
+        entries[c].type = (uint32_t)(streamed ? ARCHIVE_F64 : column->type);
+        entries[c].element_bytes = (uint32_t)archive_type_bytes((ArchiveType)entries[c].type);
+        entries[c].count = streamed ? stream->count : column->count;
+        entries[c].offset = archive_align(written);
+        size_t pad = (size_t)(entries[c].offset - written);
+        size_t bytes = (size_t)(entries[c].count * entries[c].element_bytes);
+        written = entries[c].offset + bytes;
+        if (c == 0 || !ok) continue; // The first column is in place already
+        ok = (pad == 0 || fwrite(zeros, 1, pad, stream->file) == pad);
+        if (streamed) {
+            FILE *spill = stream->spill[c];
+            ok = ok && fflush(spill) == 0 && fseek(spill, 0, SEEK_SET) == 0;
+            for (size_t left = bytes; ok && left > 0;) {
+                size_t n = (left < sizeof(chunk)) ? left : sizeof(chunk);
+                ok = fread(chunk, 1, n, spill) == n && fwrite(chunk, 1, n, stream->file) == n;
+                left -= n;
+            }
+        } else {
+            ok = (bytes == 0 || fwrite(column->data, 1, bytes, stream->file) == bytes);
+        }
+    }
+    header->column_count = (uint32_t)column_count;
+    header->sample_count = stream->count;
+    ok = ok && fseek(stream->file, 0, SEEK_SET) == 0 && fwrite(header, sizeof(*header), 1, stream->file) == 1 &&
+         fwrite(entries, sizeof(ArchiveColumnEntry), (size_t)column_count, stream->file) == (size_t)column_count;
+    if (fclose(stream->file) != 0) ok = 0;
+    stream->file = NULL;
+    archive_stream_drop_spills(stream);
+    return ok ? 0 : -1;
+}
+
+// Looks a column up in an archive held in memory (read whole or mmapped). Returns a pointer
+// to its values, or NULL if the archive is malformed, from the other byte order, or has no
+// such column. type_out and count_out may be NULL.
+static inline const void *archive_find_column(const void *archive, size_t archive_bytes, const char *name,
+                                              ArchiveType *type_out, uint64_t *count_out) {
+    const ArchiveHeader *header = (const ArchiveHeader *)archive;
+    if (archive_bytes < sizeof(ArchiveHeader) || memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != ARCHIVE_VERSION || header->byte_order != ARCHIVE_BYTE_ORDER ||
+        header->column_count > ARCHIVE_MAX_COLUMNS ||
+        archive_bytes < header->header_bytes + (uint64_t)header->column_count * sizeof(ArchiveColumnEntry)) {
+        return NULL;
+    }
+    const ArchiveColumnEntry *entries = (const ArchiveColumnEntry *)((const char *)archive + header->header_bytes);
+    for (uint32_t c = 0; c < header->column_count; c++) {
+        if (strncmp(entries[c].name, name, ARCHIVE_NAME_BYTES) != 0) continue;
+        if (entries[c].element_bytes == 0 || entries[c].offset > archive_bytes ||
+            entries[c].count > (archive_bytes - entries[c].offset) / entries[c].element_bytes) {
+            return NULL;
+        }
+        if (type_out) *type_out = (ArchiveType)entries[c].type;
+        if (count_out) *count_out = entries[c].count;
+        return (const char *)archive + entries[c].offset;
+    }
+    return NULL;
+}
+
+#endif // WEIGHT_ARCHIVE_H
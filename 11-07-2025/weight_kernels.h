@@ -0,0 +1,212 @@
+// Vectorised ADC-count kernels for the clients: calibration to kg, DC mean and offset removal.
+//
+// Calibration is folded into one multiply and one add per sample,
+//   weight = adc * scale + offset,  scale = 1 / (2^31 * SCALE_CAL),  offset = -ZERO_CAL / SCALE_CAL
+// computed once (WEIGHT_CALIBRATION() is a constant expression), instead of a division and a
+// SCALE_CAL == 0 branch per sample. The result matches (adc / 2^31 - ZERO_CAL) / SCALE_CAL to
+// within a few ulp.
+//
+// The DC mean is an exact int64 sum of the counts divided once, not a float32 running sum
+// (which loses the low digits of ~70k values around 2^31).
+//
+// Kernels exist for SSE2 (every x86-64), AVX2 (picked at run time with
+// __builtin_cpu_supports), NEON (aarch64) and plain C. Every version rounds exactly like the
+// scalar one (convert, multiply, add; no FMA), so the choice never changes the output. The
+// x86 versions take the low 32 bits of each long: the counts are 32-bit ADC samples.
+#ifndef WEIGHT_KERNELS_H
+#define WEIGHT_KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define WEIGHT_KERNELS_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define WEIGHT_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct {
+    double scale;              // kg per ADC count
+    double offset;             // kg at count 0
+} WeightCalibration;
+
+// Constant initializer; a zero scale_cal gives weights of 0 (what normalize_to_weight() returned)
+#define WEIGHT_CALIBRATION(zero_cal, scale_cal) \
+    { ((scale_cal) == 0 ? 0.0 : 1.0 / (2147483648.0 * (scale_cal))), ((scale_cal) == 0 ? 0.0 : -(zero_cal) / (scale_cal)) }
+
+typedef enum {
+    WEIGHT_SIMD_SCALAR = 0,
+    WEIGHT_SIMD_SSE2,
+    WEIGHT_SIMD_AVX2,
+    WEIGHT_SIMD_NEON,
+    WEIGHT_SIMD_COUNT
+} WeightSimd;
+
+typedef struct {
+    WeightSimd level;
+    const char *name;
+    void (*affine)(const long *adc, int count, double scale, double offset, double *out); // out[i] = adc[i] * scale + offset
+    int64_t (*sum)(const long *adc, int count);
+} WeightKernels;
+
+static inline double weight_from_adc(const WeightCalibration *cal, long adc) {
+    return (double)adc * cal->scale + cal->offset;
+}
+
+static void weight_affine_scalar(const long *adc, int count, double scale, double offset, double *out) {
+    for (int i = 0; i < count; i++) out[i] = (double)adc[i] * scale + offset;
+}
+
+static int64_t weight_sum_scalar(const long *adc, int count) {
+    int64_t sum = 0;
+    for (int i = 0; i < count; i++) sum += adc[i];
+    return sum;
+}
+
+#if WEIGHT_KERNELS_X86
+// Four longs into the low 128 bits as int32s
+static inline __m128i weight_load4_sse2(const long *adc) {
+    if (sizeof(long) == 4) return _mm_loadu_si128((const __m128i *)adc);
+    __m128i lo = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)adc), _MM_SHUFFLE(3, 3, 2, 0));
+    __m128i hi = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(adc + 2)), _MM_SHUFFLE(3, 3, 2, 0));
+    return _mm_unpacklo_epi64(lo, hi);
+}
+
+static void weight_affine_sse2(const long *adc, int count, double scale, double offset, double *out) {
+    __m128d vscale = _mm_set1_pd(scale), voffset = _mm_set1_pd(offset);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = weight_load4_sse2(adc + i);
+        __m128d a = _mm_cvtepi32_pd(v);
+        __m128d b = _mm_cvtepi32_pd(_mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(a, vscale), voffset));
+        _mm_storeu_pd(out + i + 2, _mm_add_pd(_mm_mul_pd(b, vscale), voffset));
+    }
+    weight_affine_scalar(adc + i, count - i, scale, offset, out + i);
+}
+
+static int64_t weight_sum_sse2(const long *adc, int count) {
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = weight_load4_sse2(adc + i);
+        __m128i sign = _mm_srai_epi32(v, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign)); // Sign-extended to int64
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] + weight_sum_scalar(adc + i, count - i);
+}
+
+__attribute__((target("avx2"))) static inline __m128i weight_load4_avx2(const long *adc) {
+    if (sizeof(long) == 4) return _mm_loadu_si128((const __m128i *)adc);
+    __m256i v = _mm256_loadu_si256((const __m256i *)adc);
+    return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6)));
+}
+
+__attribute__((target("avx2"))) static void weight_affine_avx2(const long *adc, int count, double scale, double offset,
+                                                               double *out) {
+    __m256d vscale = _mm256_set1_pd(scale), voffset = _mm256_set1_pd(offset);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256d a = _mm256_cvtepi32_pd(weight_load4_avx2(adc + i));
+        __m256d b = _mm256_cvtepi32_pd(weight_load4_avx2(adc + i + 4));
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(a, vscale), voffset));
+        _mm256_storeu_pd(out + i + 4, _mm256_add_pd(_mm256_mul_pd(b, vscale), voffset));
+    }
+    weight_affine_scalar(adc + i, count - i, scale, offset, out + i);
+}
+
+__attribute__((target("avx2"))) static int64_t weight_sum_avx2(const long *adc, int count) {
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(weight_load4_avx2(adc + i)));
+        acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(weight_load4_avx2(adc + i + 4)));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + weight_sum_scalar(adc + i, count - i);
+}
+#endif
+
+#if WEIGHT_KERNELS_NEON
+static void weight_affine_neon(const long *adc, int count, double scale, double offset, double *out) {
+    float64x2_t vscale = vdupq_n_f64(scale), voffset = vdupq_n_f64(offset);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float64x2_t a = vcvtq_f64_s64(vld1q_s64((const int64_t *)adc + i));
+        float64x2_t b = vcvtq_f64_s64(vld1q_s64((const int64_t *)adc + i + 2));
+        vst1q_f64(out + i, vaddq_f64(vmulq_f64(a, vscale), voffset)); // Not vfmaq: same rounding as scalar
+        vst1q_f64(out + i + 2, vaddq_f64(vmulq_f64(b, vscale), voffset));
+    }
+    weight_affine_scalar(adc + i, count - i, scale, offset, out + i);
+}
+
+static int64_t weight_sum_neon(const long *adc, int count) {
+    int64x2_t acc = vdupq_n_s64(0);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) acc = vaddq_s64(acc, vld1q_s64((const int64_t *)adc + i));
+    return vaddvq_s64(acc) + weight_sum_scalar(adc + i, count - i);
+}
+#endif
+
+static const WeightKernels weight_kernel_table[WEIGHT_SIMD_COUNT] = {
+    { WEIGHT_SIMD_SCALAR, "scalar", weight_affine_scalar, weight_sum_scalar },
+#if WEIGHT_KERNELS_X86
+    { WEIGHT_SIMD_SSE2, "sse2", weight_affine_sse2, weight_sum_sse2 },
+    { WEIGHT_SIMD_AVX2, "avx2", weight_affine_avx2, weight_sum_avx2 },
+#else
+    { WEIGHT_SIMD_SSE2, "sse2", NULL, NULL },
+    { WEIGHT_SIMD_AVX2, "avx2", NULL, NULL },
+#endif
+#if WEIGHT_KERNELS_NEON
+    { WEIGHT_SIMD_NEON, "neon", weight_affine_neon, weight_sum_neon },
+#else
+    { WEIGHT_SIMD_NEON, "neon", NULL, NULL },
+#endif
+};
+
+// The kernels for one level, or NULL if this build or CPU can't run them
+static inline const WeightKernels *weight_kernels_for(WeightSimd level) {
+    if (level < 0 || level >= WEIGHT_SIMD_COUNT || weight_kernel_table[level].affine == NULL) return NULL;
+#if WEIGHT_KERNELS_X86 && defined(__GNUC__)
+    if (level == WEIGHT_SIMD_AVX2 && !__builtin_cpu_supports("avx2")) return NULL;
+#endif
+    return &weight_kernel_table[level];
+}
+
+// The fastest kernels this CPU runs, chosen on first use (the race between threads
+// choosing at the same time is harmless: they all pick the same table)
+static inline const WeightKernels *weight_kernels(void) {
+    static const WeightKernels *best = NULL;
+    if (best == NULL) {
+        const WeightKernels *found = &weight_kernel_table[WEIGHT_SIMD_SCALAR];
+        for (int level = WEIGHT_SIMD_SCALAR + 1; level < WEIGHT_SIMD_COUNT; level++) {
+            const WeightKernels *k = weight_kernels_for((WeightSimd)level); // Later levels are faster
+            if (k) found = k;
+        }
+        best = found;
+    }
+    return best;
+}
+
+// out[i] = weight of adc[i]
+static inline void adc_to_weights(const WeightCalibration *cal, const long *adc, double *out, int count) {
+    weight_kernels()->affine(adc, count, cal->scale, cal->offset, out);
+}
+
+// Exact mean of the counts (0 for no samples)
+static inline double adc_mean(const long *adc, int count) {
+    return (count > 0) ? (double)weight_kernels()->sum(adc, count) / count : 0.0;
+}
+
+// out[i] = adc[i] - offset, e.g. with offset = adc_mean() for DC removal
+static inline void adc_remove_offset(const long *adc, double offset, double *out, int count) {
+    weight_kernels()->affine(adc, count, 1.0, -offset, out);
+}
+
+#endif // WEIGHT_KERNELS_H
@@ -0,0 +1,213 @@
+// Fixed pool of worker threads for the clients' whole-file DSP stage.
+//
+// The receive loop submits one job per received file and goes straight back to the
+// socket; a free worker runs the job (parse, filter, write its own output file), so files
+// finish and are written in completion order rather than arrival order. Each worker has
+// an index in [0, worker_count) that the run callback uses to pick per-worker state
+// (FIR history, stage counters), so nothing the jobs touch is shared.
+//
+// Memory is bounded: every job declares the bytes it holds (its received content), and
+// worker_pool_submit() blocks while queued plus running jobs would exceed max_bytes. A
+// single job larger than the budget is still accepted once the pool is idle.
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>    // For CreateThread, CRITICAL_SECTION, CONDITION_VARIABLE
+#else
+#include <pthread.h>
+#include <unistd.h>     // For sysconf
+#endif
+
+#define WORKER_POOL_MAX_THREADS 64
+
+// Runs one job on worker number `worker`; owns arg from here on
+typedef void (*WorkerPoolRun)(void *arg, int worker);
+
+typedef struct WorkerPoolJob {
+    void *arg;
+    size_t bytes;
+    struct WorkerPoolJob *next;
+} WorkerPoolJob;
+
+typedef struct WorkerPool WorkerPool;
+
+typedef struct {
+    WorkerPool *pool;
+    int index;
+} WorkerPoolThread;
+
+struct WorkerPool {
+    WorkerPoolRun run;
+    int worker_count;
+    size_t max_bytes;           // In-flight budget (queued + running jobs)
+    size_t bytes_in_flight;
+    int jobs_in_flight;
+    WorkerPoolJob *head;        // Queue of jobs no worker has taken yet
+    WorkerPoolJob *tail;
+    int closing;                // No more jobs; workers exit once the queue is empty
+    uint64_t jobs_done;
+    uint64_t submit_waits;      // Times the receive loop blocked on the budget
+    int submit_depth;           // jobs_in_flight just after the newest submit (read by the submitting thread)
+#ifdef _WIN32
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE work_ready;
+    CONDITION_VARIABLE job_done;
+    HANDLE threads[WORKER_POOL_MAX_THREADS];
+#else
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t job_done;
+    pthread_t threads[WORKER_POOL_MAX_THREADS];
+#endif
+    WorkerPoolThread thread_args[WORKER_POOL_MAX_THREADS];
+};
+
+#ifdef _WIN32
+#define WORKER_POOL_LOCK(p) EnterCriticalSection(&(p)->lock)
+#define WORKER_POOL_UNLOCK(p) LeaveCriticalSection(&(p)->lock)
+#define WORKER_POOL_WAIT(p, cond) SleepConditionVariableCS(&(p)->cond, &(p)->lock, INFINITE)
+#define WORKER_POOL_SIGNAL(p, cond) WakeConditionVariable(&(p)->cond)
+#define WORKER_POOL_BROADCAST(p, cond) WakeAllConditionVariable(&(p)->cond)
+#else
+#define WORKER_POOL_LOCK(p) pthread_mutex_lock(&(p)->lock)
+#define WORKER_POOL_UNLOCK(p) pthread_mutex_unlock(&(p)->lock)
+#define WORKER_POOL_WAIT(p, cond) pthread_cond_wait(&(p)->cond, &(p)->lock)
+#define WORKER_POOL_SIGNAL(p, cond) pthread_cond_signal(&(p)->cond)
+#define WORKER_POOL_BROADCAST(p, cond) pthread_cond_broadcast(&(p)->cond)
+#endif
+
+// Logical processors, at least 1
+static inline int worker_pool_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (count > 0) ? count : 1;
+}
+
+static inline void worker_pool_main(WorkerPoolThread *self) {
+    WorkerPool *pool = self->pool;
+    WORKER_POOL_LOCK(pool);
+    for (;;) {
+        while (pool->head == NULL && !pool->closing) WORKER_POOL_WAIT(pool, work_ready);
+        WorkerPoolJob *job = pool->head;
+        if (job == NULL) break; // Closing and drained
+        pool->head = job->next;
+        if (pool->head == NULL) pool->tail = NULL;
+        WORKER_POOL_UNLOCK(pool);
+
+        pool->run(job->arg, self->index);
+
+        WORKER_POOL_LOCK(pool);
+        pool->bytes_in_flight -= job->bytes;
+        pool->jobs_in_flight--;
+        pool->jobs_done++;
+        free(job);
+        WORKER_POOL_BROADCAST(pool, job_done);
+    }
+    WORKER_POOL_UNLOCK(pool);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_pool_thread(LPVOID param) {
+    worker_pool_main((WorkerPoolThread *)param);
+    return 0;
+}
+#else
+static void *worker_pool_thread(void *param) {
+    worker_pool_main((WorkerPoolThread *)param);
+    return NULL;
+}
+#endif
+
+// worker_count <= 0 means one per logical processor. Returns the number of workers
+// started, or -1 if none could be (the caller then processes on its own thread).
+static inline int worker_pool_start(WorkerPool *pool, int worker_count, size_t max_bytes, WorkerPoolRun run) {
+    memset(pool, 0, sizeof(*pool));
+    if (worker_count <= 0) worker_count = worker_pool_cpu_count();
+    if (worker_count > WORKER_POOL_MAX_THREADS) worker_count = WORKER_POOL_MAX_THREADS;
+    pool->run = run;
+    pool->max_bytes = max_bytes;
+#ifdef _WIN32
+    InitializeCriticalSection(&pool->lock);
+    InitializeConditionVariable(&pool->work_ready);
+    InitializeConditionVariable(&pool->job_done);
+#else
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->job_done, NULL);
+#endif
+    for (int i = 0; i < worker_count; i++) {
+        pool->thread_args[i].pool = pool;
+        pool->thread_args[i].index = i;
+#ifdef _WIN32
+        pool->threads[i] = CreateThread(NULL, 0, worker_pool_thread, &pool->thread_args[i], 0, NULL);
+        if (pool->threads[i] == NULL) break;
+#else
+        if (pthread_create(&pool->threads[i], NULL, worker_pool_thread, &pool->thread_args[i]) != 0) break;
+#endif
+        pool->worker_count++;
+    }
+    return (pool->worker_count > 0) ? pool->worker_count : -1;
+}
+
+// Queues a job holding `bytes` of memory, waiting first while the budget is used up.
+// Returns 0, or -1 if the job couldn't be queued (the caller still owns arg).
+static inline int worker_pool_submit(WorkerPool *pool, void *arg, size_t bytes) {
+    WorkerPoolJob *job = (WorkerPoolJob *)malloc(sizeof(WorkerPoolJob));
+    if (job == NULL) return -1;
+    job->arg = arg;
+    job->bytes = bytes;
+    job->next = NULL;
+
+    WORKER_POOL_LOCK(pool);
+    if (pool->jobs_in_flight > 0 && pool->bytes_in_flight + bytes > pool->max_bytes) {
+        pool->submit_waits++;
+        while (pool->jobs_in_flight > 0 && pool->bytes_in_flight + bytes > pool->max_bytes) {
+            WORKER_POOL_WAIT(pool, job_done);
+        }
+    }
+    pool->bytes_in_flight += bytes;
+    pool->jobs_in_flight++;
+    pool->submit_depth = pool->jobs_in_flight;
+    if (pool->tail) pool->tail->next = job;
+    else pool->head = job;
+    pool->tail = job;
+    WORKER_POOL_SIGNAL(pool, work_ready);
+    WORKER_POOL_UNLOCK(pool);
+    return 0;
+}
+
+// Runs every queued job to completion and stops the workers
+static inline void worker_pool_finish(WorkerPool *pool) {
+    WORKER_POOL_LOCK(pool);
+    pool->closing = 1;
+    WORKER_POOL_BROADCAST(pool, work_ready);
+    WORKER_POOL_UNLOCK(pool);
+    for (int i = 0; i < pool->worker_count; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+#ifdef _WIN32
+    DeleteCriticalSection(&pool->lock);
+#else
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->job_done);
+#endif
+}
+
+#endif // WORKER_POOL_H